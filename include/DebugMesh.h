@@ -22,32 +22,103 @@
 
 #pragma once
 
+#include "Deformer.h"
+
 #include "cinder/Color.h"
-#include "cinder/GeomIo.h"
 #include "cinder/TriMesh.h"
+#include "cinder/gl/Batch.h"
+#include "cinder/gl/Vbo.h"
+
+#include <algorithm>
+
+class ThreadPool;
+
+typedef std::shared_ptr<class DebugMesh>	DebugMeshRef;
 
-class DebugMesh : public ci::geom::Source
-{
+//! Lines along the normals of a mesh, and along its tangents and bitangents if it has them. Nothing is
+//! copied up front: the end points are written straight from the mesh into a buffer the caller provides,
+//! or into a mapped vertex buffer, in one parallel pass. The lines are grouped by kind and drawn as
+//! plain LINES, two vertices each, with one color per kind, so there are no indices and no colors to store.
+//!
+//! On large meshes, setMaxLines() caps the lines at a budget. Only one vertex per cell of a spatial hash
+//! grid gets lines, with cells as wide as the lines are long, or wider where that would still exceed
+//! the budget. The sample covers the surface evenly, however finely it is tessellated.
+//!
+//! To follow a deformation, update() rewrites only the end points from the deformed positions and
+//! normals each frame. It writes into one of a few regions of a persistently mapped buffer while the GPU
+//! may still be drawing from the others, and waits on a fence only if it gets that far ahead.
+class DebugMesh {
 public:
-	DebugMesh(void);
-	DebugMesh(const ci::TriMesh& mesh, const ci::ColorA& color);
-	~DebugMesh(void);
+	typedef enum { NORMALS, TANGENTS, BITANGENTS, NUM_KINDS } Kind;
+
+	//! Keeps \a mesh, which must not change as long as the lines may still be written. Normals are drawn in
+	//! \a color, tangents in red and bitangents in green.
+	static DebugMeshRef	create( const ci::TriMeshRef &mesh, const ci::ColorA &color, ThreadPool *pool = nullptr ) { return DebugMeshRef( new DebugMesh( mesh, color, pool ) ); }
+
+	~DebugMesh();
+
+	const ci::TriMeshRef&	getMesh() const { return mMesh; }
 
-	void						clear();
-	void						setMesh(const ci::TriMesh& mesh);
+	//! Samples the mesh for at most \a maxLines lines of each kind; 0 gives every vertex its lines. The lines
+	//! have to be uploaded again afterwards.
+	void				setMaxLines( size_t maxLines, ThreadPool *pool = nullptr );
+	size_t				getMaxLines() const { return mMaxLines; }
+	//! The vertices the lines start at, in increasing order; empty if every vertex has lines.
+	const std::vector<uint32_t>&	getVertices() const { return mVertices; }
 
-	virtual size_t				getNumVertices() const override { return mVertices.size(); }
-	virtual size_t				getNumIndices() const override { return mIndices.size(); }
-	virtual ci::geom::Primitive	getPrimitive() const override { return ci::geom::Primitive::LINES; }
-	virtual uint8_t				getAttribDims( ci::geom::Attrib attr ) const override;
-	
-	virtual void				loadInto( ci::geom::Target *target ) const override;
+	//! Lines of \a kind: one per (sampled) vertex, or none if the mesh lacks the normals or tangents they need.
+	size_t				getNumLines( Kind kind ) const { return kind < mNumKinds ? mNumLinesPerKind : 0; }
+	//! Two per line, all kinds together.
+	size_t				getNumVertices() const { return 2 * mNumLinesPerKind * mNumKinds; }
+	const ci::ColorA&	getColor( Kind kind ) const { return mColors[kind]; }
+	//! Length of the lines, a 25th of the largest extent of the mesh.
+	float				getScale() const { return mScale; }
+
+	//! Writes the end points of all lines into getNumVertices() positions at \a positions: the normals
+	//! first, then the tangents, then the bitangents.
+	void				write( ci::vec3 *positions, ThreadPool *pool = nullptr ) const;
+	//! Writes the lines straight into a mapped vertex buffer and creates the batches that draw them. Needs
+	//! the GL context; draw() calls it when needed.
+	void				upload( ThreadPool *pool = nullptr );
+	bool				isUploaded() const { return (bool) mVbo; }
+	//! Moves the lines onto deformed vertices, with positions, normals and tangents \a stride floats apart.
+	//! There is one vertex per vertex of the mesh in \a deformed, or only those of getVertices(), in that
+	//! order, if \a sampled. The tangents should have been carried along by the deformation (see
+	//! VertexStreams); without them, those of the mesh at rest are used. Either way they are made
+	//! perpendicular to the deformed normals again. Needs the GL context; call it once per frame, before drawing.
+	void				update( const DeformInput &deformed, size_t stride, bool sampled, ThreadPool *pool = nullptr );
+	//! Draws every kind of line in its own color with the stock color shader.
+	void				draw();
+
+	//! GPU memory the lines take once uploaded, times the number of regions once updated.
+	size_t				getByteSize() const { return getNumVertices() * sizeof( ci::vec3 ) * std::max<size_t>( mNumRegions, 1 ); }
+	//! GPU memory the lines take at most: as many regions as update() cycles through.
+	size_t				getMaxByteSize() const { return getNumVertices() * sizeof( ci::vec3 ) * NUM_REGIONS; }
 
 private:
-	std::vector<ci::vec3>		mVertices;
-	std::vector<ci::Color>		mColors;
-	std::vector<ci::uint32_t>	mIndices;
+	DebugMesh( const ci::TriMeshRef &mesh, const ci::ColorA &color, ThreadPool *pool );
 
-	ci::ColorA					mColor;
-};
+	//! Lets go of the buffer and the batches.
+	void				release();
+	//! Creates the buffer for \a numRegions copies of the lines, and the batches that draw each copy.
+	void				allocate( size_t numRegions );
 
+	//! Regions update() cycles through: one being written, the others still queued for drawing.
+	static const size_t	NUM_REGIONS = 3;
+
+	ci::TriMeshRef		mMesh;
+	ci::vec3			mLower;				// of the bounds of the mesh, the corner of the sampling grid
+	size_t				mMaxLines;
+	std::vector<uint32_t>	mVertices;		// see getVertices()
+	size_t				mNumLinesPerKind;
+	size_t				mNumKinds;
+	float				mScale;
+	ci::ColorA			mColors[NUM_KINDS];
+
+	ci::gl::VboRef		mVbo;
+	ci::gl::BatchRef	mBatches[NUM_REGIONS][NUM_KINDS];	// each a range of mVbo
+	size_t				mNumRegions;						// 1 until update() is first called
+	size_t				mRegion;							// the one draw() uses
+	ci::vec3			*mMapped;							// all regions, if mapped persistently
+	GLsync				mFences[NUM_REGIONS];				// passed once the GPU is done with a region
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "DeformKernels.h"
+#include "Deformer.h"
+
+#include "cinder/AxisAlignedBox.h"
+#include "cinder/TriMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+class ThreadPool;
+
+//! A closed range of floats. Every operation below returns a range that holds the result for any choice
+//! of operands within theirs, so running a deformation on the ranges of its inputs bounds its outputs
+//! without touching a vertex. Operands are treated as independent, so the ranges are conservative rather
+//! than tight when the same value enters an expression twice.
+struct Interval {
+	float	lo, hi;
+
+	Interval() {}
+	Interval( float f ) : lo( f ), hi( f ) {}
+	Interval( float lo, float hi ) : lo( lo ), hi( hi ) {}
+
+	//! The range holding nothing; including any value into it gives that value.
+	static Interval	empty() { return Interval( std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() ); }
+	static Interval	whole() { return Interval( -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() ); }
+
+	bool			isEmpty() const { return lo > hi; }
+	void			include( const Interval &other ) { lo = std::min( lo, other.lo ); hi = std::max( hi, other.hi ); }
+};
+
+inline Interval operator+( Interval a, Interval b ) { return Interval( a.lo + b.lo, a.hi + b.hi ); }
+inline Interval operator-( Interval a, Interval b ) { return Interval( a.lo - b.hi, a.hi - b.lo ); }
+inline Interval operator-( Interval a ) { return Interval( -a.hi, -a.lo ); }
+inline Interval operator*( Interval a, Interval b )
+{
+	float p0 = a.lo * b.lo, p1 = a.lo * b.hi, p2 = a.hi * b.lo, p3 = a.hi * b.hi;
+	return Interval( std::min( std::min( p0, p1 ), std::min( p2, p3 ) ), std::max( std::max( p0, p1 ), std::max( p2, p3 ) ) );
+}
+//! Anything goes if \a b holds zero.
+inline Interval operator/( Interval a, Interval b )
+{
+	if( b.lo <= 0.0f && b.hi >= 0.0f )
+		return Interval::whole();
+	return a * Interval( 1.0f / b.hi, 1.0f / b.lo );
+}
+
+//! a * a, which unlike a * a never goes below zero.
+inline Interval sqr( Interval a )
+{
+	float l = a.lo * a.lo, h = a.hi * a.hi;
+	if( a.lo >= 0.0f )
+		return Interval( l, h );
+	if( a.hi <= 0.0f )
+		return Interval( h, l );
+	return Interval( 0.0f, std::max( l, h ) );
+}
+
+//! Negative values are left out; their square root is not a number and no bound holds it anyway.
+inline Interval sqrt( Interval a ) { return Interval( std::sqrt( std::max( a.lo, 0.0f ) ), std::sqrt( std::max( a.hi, 0.0f ) ) ); }
+
+inline Interval hull( Interval a, Interval b ) { return Interval( std::min( a.lo, b.lo ), std::max( a.hi, b.hi ) ); }
+inline Interval intersect( Interval a, Interval b ) { return Interval( std::max( a.lo, b.lo ), std::min( a.hi, b.hi ) ); }
+
+//! GLSL's mix(). Amounts within [0, 1] keep the result between the ends, which is usually the tighter bound.
+inline Interval mixBounds( Interval a, Interval b, Interval t )
+{
+	Interval blended = a * ( Interval( 1.0f ) - t ) + b * t;
+	return t.lo >= 0.0f && t.hi <= 1.0f ? intersect( blended, hull( a, b ) ) : blended;
+}
+
+inline kernels::Vec3<Interval> mixBounds( const kernels::Vec3<Interval> &a, const kernels::Vec3<Interval> &b, Interval t )
+{
+	return kernels::Vec3<Interval>( mixBounds( a.x, b.x, t ), mixBounds( a.y, b.y, t ), mixBounds( a.z, b.z, t ) );
+}
+
+//! Ranges of the sine and cosine over \a angle, widened by the error of \a accuracy.
+void sinCosBounds( Interval angle, TrigAccuracy accuracy, Interval *s, Interval *c );
+
+//! Exact ranges of interleaved data: \a count elements of \a components floats each, one range per
+//! component. The reduction runs on SIMD registers, \a components of them at a time so that every lane
+//! always sees the same component, and is spread over \a pool if it is not null.
+void calcRanges( const float *values, size_t count, size_t components, Interval *ranges, ThreadPool *pool = nullptr );
+
+//! Exact box around the positions in \a streams; see calcRanges().
+ci::AxisAlignedBox3f calcPositionBounds( const VertexStreams &streams, ThreadPool *pool = nullptr );
+
+//! Ranges of the rest data a deformation starts from, see Deformer::getBounds().
+struct RestBounds {
+	//! Holds nothing.
+	RestBounds();
+	//! Exact ranges of the positions and texture coordinates of \a rest.
+	explicit RestBounds( const VertexStreams &rest, ThreadPool *pool = nullptr );
+	explicit RestBounds( const ci::TriMesh &rest, ThreadPool *pool = nullptr );
+
+	bool					isEmpty() const { return position.x.isEmpty(); }
+
+	kernels::Vec3<Interval>	position;
+	Interval				u, v;
+};
+
+//! The box around \a bounds, grown by a few units in the last place so that it also holds what float
+//! rounding in the deformation (on the CPU or in the shaders) makes of values right at the edges.
+ci::AxisAlignedBox3f toBox( const kernels::Vec3<Interval> &bounds );
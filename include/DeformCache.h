@@ -0,0 +1,114 @@
+#pragma once
+
+#include "DeformCodec.h"
+#include "Deformer.h"
+#include "MappedFile.h"
+
+#include <functional>
+
+class ThreadPool;
+
+typedef std::shared_ptr<class DeformCache>	DeformCacheRef;
+
+//! Deformed positions and normals of a mesh, precomputed for a range of times and stored in a single
+//! memory-mapped file. Playback costs the same for every transformation: look up the frame and hand its
+//! bytes to a vertex buffer.
+//!
+//! The file starts with a Header and numFrames FrameEntry records, followed by the frames. With
+//! ENCODING_FLOAT32 each frame is aligned to FRAME_ALIGNMENT bytes and holds numVertices interleaved
+//! (position, normal) float triplets, which is also the layout of the playback vertex buffer. With
+//! ENCODING_QUANTIZED the frames are packed back to back in DeformCodec's format, about a tenth of the
+//! size, with a key frame every keyFrameInterval frames. All values are little-endian.
+class DeformCache {
+public:
+	static const uint32_t	VERSION = 1;
+	static const size_t		FLOATS_PER_VERTEX = 6;
+	static const size_t		VERTEX_STRIDE = FLOATS_PER_VERTEX * sizeof( float );
+	static const size_t		FRAME_ALIGNMENT = 4096;
+
+	typedef enum { ENCODING_FLOAT32, ENCODING_QUANTIZED } Encoding;
+
+	struct Header {
+		char		magic[8];			// "XFRMCACH"
+		uint32_t	version;
+		uint32_t	encoding;
+		uint32_t	numVertices;
+		uint32_t	numFrames;
+		float		startTime;
+		float		frameRate;
+		uint64_t	frameIndexOffset;
+		// the transformation and parameters the frames were baked with, for reference
+		uint32_t	deformerType;
+		float		angleDegMax, height;
+		float		centerPoint[3];
+		float		xlim, ylim, zlim;
+		float		move;
+		uint32_t	flag;
+		// ENCODING_QUANTIZED only
+		float		boundsMin[3], boundsMax[3];	// of all positions in the sequence
+		uint32_t	keyFrameInterval;
+		uint32_t	reserved[2];
+	};
+
+	struct FrameEntry {
+		uint64_t	offset;				// from the start of the file
+		uint64_t	size;				// in bytes
+		float		time;
+		uint32_t	prediction;			// DeformCodec::Prediction, PREDICT_NONE for ENCODING_FLOAT32
+	};
+
+	//! Called before each frame is baked with the frame's time, so parameters other than elapsedSeconds
+	//! can be animated as well.
+	typedef std::function<void( float time, DeformParams *params )>	AnimateFn;
+
+	//! Evaluates \a deformer on \a rest at \a frameRate over [\a startTime, \a endTime) and writes the
+	//! result to \a path. The file is written under a temporary name and renamed when complete, so readers
+	//! never see a partial cache. Frames are deformed on \a pool if given. ENCODING_QUANTIZED evaluates
+	//! the sequence twice, first to find its bounds. Throws on I/O errors.
+	static void				bake( const std::string &path, const Deformer &deformer, const VertexStreams &rest, float startTime, float endTime,
+								float frameRate, ThreadPool *pool = nullptr, const AnimateFn &animate = AnimateFn(),
+								Encoding encoding = ENCODING_FLOAT32, uint32_t keyFrameInterval = 30 );
+
+	//! Maps the cache at \a path. Throws DeformCacheExc if it is not a valid cache.
+	static DeformCacheRef	open( const std::string &path );
+
+	const Header&			getHeader() const { return *mHeader; }
+	Encoding				getEncoding() const { return static_cast<Encoding>( mHeader->encoding ); }
+	size_t					getNumVertices() const { return mHeader->numVertices; }
+	size_t					getNumFrames() const { return mHeader->numFrames; }
+	float					getStartTime() const { return mHeader->startTime; }
+	float					getFrameRate() const { return mHeader->frameRate; }
+	float					getDuration() const { return getNumFrames() / getFrameRate(); }
+
+	//! Frame to show at \a time. Outside the baked range the sequence repeats if \a loop, or clamps otherwise.
+	size_t					getFrameIndex( float time, bool loop = true ) const;
+	const FrameEntry&		getFrameEntry( size_t frame ) const { return mFrames[frame]; }
+	//! FLOATS_PER_VERTEX floats per vertex: position x, y, z and normal x, y, z. Points into the mapping
+	//! for ENCODING_FLOAT32; compressed frames are decoded into a buffer that stays valid until the next
+	//! call. Reading frames in order decodes each one once; other orders decode from the closest key frame
+	//! before \a frame. Throws DeformCacheExc if the frame data is corrupt.
+	const float*			readFrame( size_t frame );
+	//! Size of a decoded frame in bytes.
+	size_t					getFrameSize() const { return getNumVertices() * VERTEX_STRIDE; }
+	//! Total size of the frame data as stored.
+	size_t					getStoredSize() const;
+
+	const MappedFileRef&	getFile() const { return mFile; }
+
+private:
+	DeformCache( const MappedFileRef &file );
+
+	MappedFileRef		mFile;
+	const Header		*mHeader;
+	const FrameEntry	*mFrames;
+
+	std::unique_ptr<DeformCodec>	mCodec;
+	std::vector<float>				mDecoded;
+	size_t							mDecodedFrame;
+};
+
+class DeformCacheExc : public std::runtime_error {
+public:
+	DeformCacheExc( const std::string &path, const std::string &what )
+		: std::runtime_error( "DeformCache '" + path + "': " + what ) {}
+};
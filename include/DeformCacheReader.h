@@ -0,0 +1,90 @@
+#pragma once
+
+#include "DeformCache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+typedef std::shared_ptr<class DeformCacheReader>	DeformCacheReaderRef;
+
+//! Plays a DeformCache back without touching the disk on the calling thread. A background thread reads
+//! and decodes the frames ahead of playback into a ring of frame buffers; update() only looks at what
+//! is ready and never waits. The ring is single-producer, single-consumer and lock-free: the reader
+//! thread only advances the write position and update() only the read position.
+//!
+//! The reader takes over the cache: do not call readFrame() on it while the reader exists.
+class DeformCacheReader {
+public:
+	//! What to do when playback gets ahead of the reader. DROP_FRAMES stays in sync with the clock and
+	//! skips the frames that were not ready in time; KEEP_FRAMES shows every frame in order and lets
+	//! playback fall behind the clock instead.
+	typedef enum { DROP_FRAMES, KEEP_FRAMES } DropPolicy;
+
+	struct Stats {
+		uint64_t	framesRead;			// decoded by the reader thread
+		uint64_t	framesShown;		// handed out by update()
+		uint64_t	framesDropped;		// passed over without being shown
+		uint64_t	stalls;				// update() calls that could not show the frame the clock asked for
+	};
+
+	//! Starts reading \a cache with room for \a readAhead frames ahead of the one shown. Frames repeat
+	//! past the end of the cache if \a loop.
+	static DeformCacheReaderRef	create( const DeformCacheRef &cache, size_t readAhead = 8, DropPolicy dropPolicy = DROP_FRAMES, bool loop = true )
+	{
+		return DeformCacheReaderRef( new DeformCacheReader( cache, readAhead, dropPolicy, loop ) );
+	}
+
+	~DeformCacheReader();
+
+	//! Returns the frame to show at \a time (same layout as DeformCache::readFrame()), or null if the frame
+	//! shown last is still the best one available. The data stays valid until the next call.
+	const float*			update( float time );
+
+	const DeformCacheRef&	getCache() const { return mCache; }
+	size_t					getReadAhead() const { return mSlots.size() - 1; }
+	DropPolicy				getDropPolicy() const { return mDropPolicy; }
+	//! Call from the thread that calls update().
+	Stats					getStats() const;
+
+private:
+	DeformCacheReader( const DeformCacheRef &cache, size_t readAhead, DropPolicy dropPolicy, bool loop );
+	DeformCacheReader( const DeformCacheReader & );
+	DeformCacheReader& operator=( const DeformCacheReader & );
+
+	struct Slot {
+		std::vector<float>	mData;
+		int64_t				mFrame;			// position in the (looped) sequence, not in the cache
+		uint32_t			mGeneration;	// seek generation the frame was read for
+	};
+
+	void		readLoop();
+	size_t		getCacheFrame( int64_t frame ) const;
+	//! Hints the system to start reading the stored data of \a frame.
+	void		prefetch( int64_t frame ) const;
+
+	DeformCacheRef			mCache;
+	DropPolicy				mDropPolicy;
+	bool					mLoop;
+	std::vector<Slot>		mSlots;
+
+	// ring positions; slots [mReadPosition, mWritePosition) hold frames that are ready
+	std::atomic<uint64_t>	mWritePosition, mReadPosition;
+	// requests from update() to the reader thread
+	std::atomic<int64_t>	mWantedFrame, mSeekFrame;
+	std::atomic<uint32_t>	mSeekGeneration;
+	std::atomic<bool>		mQuit;
+	std::atomic<uint64_t>	mFramesRead;
+
+	// used by update() only
+	bool					mHolding, mStarted;
+	int64_t					mShownFrame;
+	uint32_t				mGeneration;
+	uint64_t				mFramesShown, mFramesDropped, mStalls;
+
+	// lets the reader thread sleep while the ring is full
+	std::mutex				mMutex;
+	std::condition_variable	mWakeUp;
+	std::thread				mThread;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "cinder/Vector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! Lossy compression of deformation frames, six floats per vertex (position x, y, z, normal x, y, z).
+//!
+//! Positions are quantized to 16 bits within a bounding box that covers the whole sequence and normals
+//! to two 16-bit octahedral coordinates. Every frame except key frames stores the difference between
+//! its quantized values and a prediction from the frames before, which is exact, so errors never
+//! accumulate. The residuals are zigzag-coded and bit-packed in blocks of BLOCK_SIZE values with the
+//! smallest width that fits the block. The packing is interleaved over eight 16-bit lanes, so that
+//! decoding is a handful of SIMD shifts per value.
+//!
+//! Encoder and decoder keep the quantized values of the last two frames; frames have to be decoded in
+//! the order they were encoded, starting at a key frame.
+class DeformCodec {
+public:
+	//! How a frame is predicted: not at all (key frame), from the previous frame, or extrapolated
+	//! linearly from the previous two.
+	typedef enum { PREDICT_NONE, PREDICT_PREVIOUS, PREDICT_LINEAR } Prediction;
+
+	static const size_t	FLOATS_PER_VERTEX = 6;
+	//! Quantized components per vertex: position x, y, z and octahedral u, v.
+	static const size_t	NUM_COMPONENTS = 5;
+	static const size_t	BLOCK_SIZE = 128;
+
+	DeformCodec( size_t numVertices, const ci::vec3 &boundsMin, const ci::vec3 &boundsMax );
+
+	//! Appends the encoding of \a frame to \a out. PREDICT_LINEAR needs two frames since the last key
+	//! frame and PREDICT_PREVIOUS one; fewer fall back to the next simpler prediction. Returns the
+	//! prediction used, which decode() must be given.
+	Prediction	encode( const float *frame, Prediction prediction, std::vector<uint8_t> *out );
+	//! Decodes \a size bytes at \a data into \a frame, or only advances the prediction state if \a frame
+	//! is null. Returns false if the data is malformed.
+	bool		decode( const uint8_t *data, size_t size, Prediction prediction, float *frame );
+
+	size_t		getNumVertices() const { return mNumVertices; }
+	//! Largest distance between a position and its decoded value.
+	float		getPositionTolerance() const;
+
+private:
+	void		quantize( const float *frame, uint16_t *quantized ) const;
+	void		dequantize( const uint16_t *quantized, float *frame ) const;
+
+	size_t					mNumVertices, mNumBlocks;
+	ci::vec3				mBoundsMin, mScale;
+	// quantized values of the last two frames, block by block and component by component within a block
+	std::vector<uint16_t>	mPrevious, mBeforePrevious;
+	size_t					mHistory;			// frames the prediction can use, 0 to 2
+};
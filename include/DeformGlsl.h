@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+//! GLSL fragments shared by the transformation shaders. The stage functions have a CPU counterpart in
+//! DeformPipeline.h; keep the two in sync.
+//!
+//! All transformations are permutations of a single vertex shader, uberVertexShader(). A permutation is
+//! a set of feature bits naming the stage in each of up to MAX_STAGES slots; defines() turns them into the
+//! #define lines that pull in the stage functions and call them in order.
+struct DeformGlsl {
+	//! The branch stages blend towards the rest position run through other stages, see stage::RestBranch.
+	typedef enum { NO_STAGE, TWIST, STRETCH, SPHERE, PLANE_MORPH, TWIST_BRANCH, TWIST_STRETCH_BRANCH, NUM_STAGE_TYPES } StageType;
+
+	//! Slots of a permutation, enough for the longest pipeline.
+	static const size_t	MAX_STAGES = 3;
+	//! Bits per slot in a permutation.
+	static const int	STAGE_BITS = 4;
+
+	//! The feature bits running \a stages in order, the first in the lowest bits. No stages at all give 0,
+	//! which draws positions and normals as they are, e.g. deformed ones from a cache.
+	static uint32_t		permutation( const StageType *stages, size_t count );
+	//! The #define lines selecting \a permutation in uberVertexShader().
+	static std::string	defines( uint32_t permutation );
+
+	//! The vertex shader of every transformation; the defines go right after its #version line.
+	static const std::string&	uberVertexShader();
+
+	//! Version, uniforms, vertex inputs/outputs and the transformNormal() helper used by every transformation shader.
+	static const char*	vertexHeader();
+	//! Writes 'position' and 'normal' to the fragment stage and closes main().
+	static const char*	vertexFooter();
+	//! The Phong fragment shader all transformations share.
+	static const char*	phongFragment();
+
+	//! Stages with a per-vertex invariant also define it as a function of the position (e.g.
+	//! twistInvariant()) and take it as an extra argument.
+	static const char*	twistStage();
+	static const char*	stretchStage();
+	static const char*	sphereStage();
+	static const char*	planeMorphStage();
+	//! Need twistStage(), and stretchStage() for the second one.
+	static const char*	twistBranchStage();
+	static const char*	twistStretchBranchStage();
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "Deformer.h"
+#include "SimdMath.h"
+
+//! Building blocks shared by the Deformer kernels and DeformPipeline stages.
+namespace kernels {
+
+// Positions follow the GLSL line by line (including operation order and float literals), so that the
+// CPU result matches what the vertex shaders produce. Each mapping also returns its Jacobian, which is
+// used to carry normals and tangents along (see transformNormal() and transformTangent()).
+
+template<typename V>
+struct Vec3 {
+	V x, y, z;
+
+	Vec3() {}
+	Vec3( V x, V y, V z ) : x( x ), y( y ), z( z ) {}
+};
+
+//! Partial derivatives of a mapping along x, y and z, i.e. the columns of its Jacobian matrix.
+template<typename V>
+struct Jacobian {
+	Vec3<V> dx, dy, dz;
+};
+
+template<typename V>
+TRANSFORM_INLINE Vec3<V> mix3( const Vec3<V> &a, const Vec3<V> &b, V t )
+{
+	return Vec3<V>( simdMix( a.x, b.x, t ), simdMix( a.y, b.y, t ), simdMix( a.z, b.z, t ) );
+}
+
+template<typename V>
+TRANSFORM_INLINE Vec3<V> cross3( const Vec3<V> &a, const Vec3<V> &b )
+{
+	return Vec3<V>( a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x );
+}
+
+template<typename V>
+TRANSFORM_INLINE Vec3<V> normalize3( const Vec3<V> &a )
+{
+	V invLength = V( 1.0f ) / sqrt( max( a.x * a.x + a.y * a.y + a.z * a.z, V( 1e-30f ) ) );
+	return Vec3<V>( a.x * invLength, a.y * invLength, a.z * invLength );
+}
+
+template<typename V>
+TRANSFORM_INLINE Vec3<V> loadPosition( const DeformInput &in, size_t i )
+{
+	return Vec3<V>( V::load( in.px + i ), V::load( in.py + i ), V::load( in.pz + i ) );
+}
+
+template<typename V>
+TRANSFORM_INLINE Vec3<V> loadNormal( const DeformInput &in, size_t i )
+{
+	return Vec3<V>( V::load( in.nx + i ), V::load( in.ny + i ), V::load( in.nz + i ) );
+}
+
+template<typename V>
+TRANSFORM_INLINE Vec3<V> loadTangent( const DeformInput &in, size_t i )
+{
+	return Vec3<V>( V::load( in.tx + i ), V::load( in.ty + i ), V::load( in.tz + i ) );
+}
+
+template<typename V>
+TRANSFORM_INLINE void storeResult( const DeformOutput &out, size_t i, const Vec3<V> &p, const Vec3<V> &n )
+{
+	p.x.store( out.px + i ); p.y.store( out.py + i ); p.z.store( out.pz + i );
+	n.x.store( out.nx + i ); n.y.store( out.ny + i ); n.z.store( out.nz + i );
+}
+
+template<typename V>
+TRANSFORM_INLINE void storeTangent( const DeformOutput &out, size_t i, const Vec3<V> &t )
+{
+	t.x.store( out.tx + i ); t.y.store( out.ty + i ); t.z.store( out.tz + i );
+}
+
+//! Transforms normal \a n by the blended mapping mix(identity, f, \a amount), whose Jacobian is
+//! mix(I, J, amount). Normals transform with the inverse-transpose; we use the cofactor matrix
+//! (determinant times inverse-transpose), which has the same direction and never divides.
+template<typename V>
+TRANSFORM_INLINE Vec3<V> transformNormal( const Jacobian<V> &j, V amount, const Vec3<V> &n )
+{
+	const V zero( 0.0f ), one( 1.0f );
+	Vec3<V> a( simdMix( one, j.dx.x, amount ), simdMix( zero, j.dx.y, amount ), simdMix( zero, j.dx.z, amount ) );
+	Vec3<V> b( simdMix( zero, j.dy.x, amount ), simdMix( one, j.dy.y, amount ), simdMix( zero, j.dy.z, amount ) );
+	Vec3<V> c( simdMix( zero, j.dz.x, amount ), simdMix( zero, j.dz.y, amount ), simdMix( one, j.dz.z, amount ) );
+
+	Vec3<V> bc = cross3( b, c ), ca = cross3( c, a ), ab = cross3( a, b );
+	return Vec3<V>( n.x * bc.x + n.y * ca.x + n.z * ab.x,
+	                n.x * bc.y + n.y * ca.y + n.z * ab.y,
+	                n.x * bc.z + n.y * ca.z + n.z * ab.z );
+}
+
+//! Transforms tangent \a t by the blended mapping mix(identity, f, \a amount). Tangents lie in the
+//! surface and transform with the Jacobian itself: mix(t, J * t, amount).
+template<typename V>
+TRANSFORM_INLINE Vec3<V> transformTangent( const Jacobian<V> &j, V amount, const Vec3<V> &t )
+{
+	Vec3<V> jt( j.dx.x * t.x + j.dy.x * t.y + j.dz.x * t.z,
+	            j.dx.y * t.x + j.dy.y * t.y + j.dz.y * t.z,
+	            j.dx.z * t.x + j.dy.z * t.y + j.dz.z * t.z );
+	return mix3( t, jt, amount );
+}
+
+// Terms that are uniform across all vertices of a frame.
+struct FrameTerms {
+	FrameTerms( const DeformParams &params )
+	{
+		sinTime = std::sin( params.elapsedSeconds );
+		float angleDeg = params.angleDegMax * sinTime;
+		angleRad = angleDeg * 3.14159f / 180.0f;
+		angleRadPerUnit = angleRad / params.height;
+	}
+
+	float	sinTime;
+	float	angleRad;
+	float	angleRadPerUnit;	// derivative of the twist angle along y
+};
+
+// (height*0.5 + ciPosition.y)/height, the part of the twist angle that does not change over time.
+template<typename V>
+TRANSFORM_INLINE V twistFactor( V y, const DeformParams &params )
+{
+	return ( V( params.height * 0.5f ) + y ) / V( params.height );
+}
+
+// float ang = (height*0.5 + ciPosition.y)/height * angle_rad;
+template<typename V>
+TRANSFORM_INLINE V twistAngle( V factor, const FrameTerms &terms )
+{
+	return factor * V( terms.angleRad );
+}
+
+// DoTwist: rotation around y by an angle that grows linearly with y.
+template<typename V>
+TRANSFORM_INLINE Vec3<V> twist( const Vec3<V> &p, V st, V ct, V angleRadPerUnit, Jacobian<V> *j )
+{
+	Vec3<V> q( p.x * ct - p.z * st, p.y, p.x * st + p.z * ct );
+
+	const V zero( 0.0f ), one( 1.0f );
+	j->dx = Vec3<V>( ct, zero, st );
+	j->dy = Vec3<V>( -angleRadPerUnit * q.z, one, angleRadPerUnit * q.x );
+	j->dz = Vec3<V>( -st, zero, ct );
+	return q;
+}
+
+// float dist = abs(distance(centerPoint, pos));
+template<typename V>
+TRANSFORM_INLINE V stretchDistance( const Vec3<V> &p, const DeformParams &params )
+{
+	V dx = V( params.centerPoint.x ) - p.x;
+	V dy = V( params.centerPoint.y ) - p.y;
+	V dz = V( params.centerPoint.z ) - p.z;
+	return abs( sqrt( dx * dx + dy * dy + dz * dz ) );
+}
+
+// stretch: scales each axis by \a dist, the distance of \a p to centerPoint.
+template<typename V>
+TRANSFORM_INLINE Vec3<V> stretch( const Vec3<V> &p, V dist, const DeformParams &params, Jacobian<V> *j )
+{
+	V dx = V( params.centerPoint.x ) - p.x;
+	V dy = V( params.centerPoint.y ) - p.y;
+	V dz = V( params.centerPoint.z ) - p.z;
+
+	V kx = V( params.xlim ) / V( 2.0f ), ky = V( params.ylim ) / V( 2.0f ), kz( params.zlim );
+	Vec3<V> q( V( params.xlim ) * dist / V( 2.0f ) * p.x, V( params.ylim ) * dist / V( 2.0f ) * p.y, V( params.zlim ) * dist * p.z );
+
+	// d(dist)/dp = (p - centerPoint) / dist
+	V invDist = V( 1.0f ) / max( dist, V( 1e-20f ) );
+	V gx = -dx * invDist, gy = -dy * invDist, gz = -dz * invDist;
+	V sx = kx * p.x, sy = ky * p.y, sz = kz * p.z;
+	j->dx = Vec3<V>( kx * dist + sx * gx, sy * gx, sz * gx );
+	j->dy = Vec3<V>( sx * gy, ky * dist + sy * gy, sz * gy );
+	j->dz = Vec3<V>( sx * gz, sy * gz, kz * dist + sz * gz );
+	return q;
+}
+
+// sphere: maps the unit cube onto the unit sphere.
+template<typename V>
+TRANSFORM_INLINE Vec3<V> sphere( const Vec3<V> &p, Jacobian<V> *j )
+{
+	const V one( 1.0f ), two( 2.0f ), three( 3.0f );
+	V xx = p.x * p.x, yy = p.y * p.y, zz = p.z * p.z;
+	V sx = sqrt( one - ( yy / two ) - ( zz / two ) + ( yy * p.z * p.z / three ) );
+	V sy = sqrt( one - ( zz / two ) - ( xx / two ) + ( zz * p.x * p.x / three ) );
+	V sz = sqrt( one - ( xx / two ) - ( yy / two ) + ( xx * p.y * p.y / three ) );
+
+	// d(x sqrt(A))/dy = x A' / (2 sqrt(A)) with A' = y (2/3 z^2 - 1), hence the division by two; likewise for the others
+	const V eps( 1e-20f );
+	V hx = p.x / max( sx, eps ), hy = p.y / max( sy, eps ), hz = p.z / max( sz, eps );
+	V twoThirds = two / three;
+	j->dx = Vec3<V>( sx, hy * p.x * ( twoThirds * zz - one ) / two, hz * p.x * ( twoThirds * yy - one ) / two );
+	j->dy = Vec3<V>( hx * p.y * ( twoThirds * zz - one ) / two, sy, hz * p.y * ( twoThirds * xx - one ) / two );
+	j->dz = Vec3<V>( hx * p.z * ( twoThirds * yy - one ) / two, hy * p.z * ( twoThirds * xx - one ) / two, sz );
+
+	return Vec3<V>( p.x * sx, p.y * sy, p.z * sz );
+}
+
+// vec3 goalPosition = 5.0 * vec3(-ciTexCoord0.x,ciTexCoord0.y,-ciTexCoord0.x)
+template<typename V>
+TRANSFORM_INLINE Vec3<V> planeGoal( const DeformInput &in, size_t i )
+{
+	V u = V::load( in.u + i ), v = V::load( in.v + i );
+	const V five( 5.0f );
+	return Vec3<V>( five * -u, five * v, five * -u );
+}
+
+} // namespace kernels
@@ -0,0 +1,643 @@
+#pragma once
+
+#include "DeformBounds.h"
+#include "DeformGlsl.h"
+#include "DeformKernels.h"
+#include "Deformer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//! Per-vertex information a stage may need besides the running position and normal.
+struct StageContext {
+	const DeformParams			&mParams;
+	const kernels::FrameTerms	&mTerms;
+	const DeformInput			&mRest;
+	size_t						mIndex;
+};
+
+//! What a stage may need to bound its results, see Pipeline::getBounds().
+struct BoundContext {
+	const DeformParams			&mParams;
+	Interval					mAngleRad;		// FrameTerms::angleRad
+	const RestBounds			&mRest;
+};
+
+//! Stages that can be chained in a Pipeline. Each one transforms the running position, carries the
+//! normal along with the Jacobian of the blended mapping and blends the result in by \a amount. The
+//! tangent, if \a t is not null, is carried along with the Jacobian as well. The CPU code mirrors the
+//! GLSL of the DeformGlsl stage named by glslStage().
+//!
+//! A stage may have a per-vertex invariant: a term that depends only on its input position and on
+//! parameters that stay fixed for a mesh (HAS_INVARIANT). When the stage comes first in a pipeline its
+//! input is the rest position, so Pipeline::bake() can compute the term once per mesh and apply() reads
+//! it back instead. sameInvariant() tells whether two parameter sets give the same invariant.
+//!
+//! If the per-frame work on the invariant is expensive and many vertices share its value (USES_RINGS),
+//! bake() also groups the vertices into rings; evaluateRings() then computes that work once per ring and
+//! applyRing() picks up the result of the vertex's ring.
+//!
+//! bound() runs the same mapping on ranges instead of values (see Interval): given positions within \a p,
+//! it leaves \a p holding the results for any amount within \a amount.
+//!
+//! A RestBranch runs other stages on the rest position instead of the running one, in a branch of its own,
+//! and blends the running position towards the branch's result.
+namespace kernels {
+
+template<typename V, typename... Stages>
+struct StageChain;
+
+template<typename... Stages>
+struct BoundChain;
+
+} // namespace kernels
+
+namespace stage {
+
+struct Twist {
+	static const bool	HAS_INVARIANT = true;
+	static const bool	USES_RINGS = true;
+
+	static DeformGlsl::StageType	glslStage() { return DeformGlsl::TWIST; }
+
+	static bool sameInvariant( const DeformParams &a, const DeformParams &b ) { return a.height == b.height; }
+
+	template<typename V>
+	static TRANSFORM_INLINE V invariant( const kernels::Vec3<V> &p, const DeformParams &params )
+	{
+		return kernels::twistFactor( p.y, params );
+	}
+
+	template<typename V>
+	static TRANSFORM_INLINE void apply( kernels::Vec3<V> &p, kernels::Vec3<V> &n, kernels::Vec3<V> *t, V amount, V factor, const StageContext &ctx )
+	{
+		V st, ct;
+		simdSinCos( kernels::twistAngle( factor, ctx.mTerms ), &st, &ct, ctx.mParams.trigAccuracy );
+		rotate( p, n, t, amount, st, ct, ctx );
+	}
+
+	//! All vertices of a ring have the same height and thus the same twist angle, so the sine and cosine
+	//! are evaluated once per ring. \a terms receives them interleaved.
+	static void evaluateRings( const std::vector<float> &ringFactors, const DeformParams &params, const kernels::FrameTerms &frameTerms, std::vector<float> *terms )
+	{
+		size_t numRings = ringFactors.size();
+		terms->resize( 2 * numRings );
+
+		float *sines = terms->data(), *cosines = terms->data() + numRings;
+		for( size_t r = 0; r < numRings; ++r ) {
+			SimdScalar st, ct;
+			simdSinCos( kernels::twistAngle( SimdScalar( ringFactors[r] ), frameTerms ), &st, &ct, params.trigAccuracy );
+			sines[r] = st.v;
+			cosines[r] = ct.v;
+		}
+	}
+
+	template<typename V>
+	static TRANSFORM_INLINE void applyRing( kernels::Vec3<V> &p, kernels::Vec3<V> &n, kernels::Vec3<V> *t, V amount, const int32_t *ring, const std::vector<float> &terms,
+		const StageContext &ctx )
+	{
+		size_t numRings = terms.size() / 2;
+		V st = V::gather( terms.data(), ring ), ct = V::gather( terms.data() + numRings, ring );
+		rotate( p, n, t, amount, st, ct, ctx );
+	}
+
+	static void bound( kernels::Vec3<Interval> &p, Interval amount, const BoundContext &ctx )
+	{
+		Interval st, ct;
+		sinCosBounds( kernels::twistFactor( p.y, ctx.mParams ) * ctx.mAngleRad, ctx.mParams.trigAccuracy, &st, &ct );
+		kernels::Vec3<Interval> q( p.x * ct - p.z * st, p.y, p.x * st + p.z * ct );
+
+		// a rotation around y keeps the distance to the axis, which is tighter for wide angles
+		float radius = sqrt( sqr( p.x ) + sqr( p.z ) ).hi;
+		q.x = intersect( q.x, Interval( -radius, radius ) );
+		q.z = intersect( q.z, Interval( -radius, radius ) );
+		p = mixBounds( p, q, amount );
+	}
+
+private:
+	template<typename V>
+	static TRANSFORM_INLINE void rotate( kernels::Vec3<V> &p, kernels::Vec3<V> &n, kernels::Vec3<V> *t, V amount, V st, V ct, const StageContext &ctx )
+	{
+		kernels::Jacobian<V> j;
+		kernels::Vec3<V> twistedPosition = kernels::twist( p, st, ct, V( ctx.mTerms.angleRadPerUnit ), &j );
+		n = kernels::transformNormal( j, amount, n );
+		if( t )
+			*t = kernels::transformTangent( j, amount, *t );
+		p = kernels::mix3( p, twistedPosition, amount );
+	}
+};
+
+struct Stretch {
+	static const bool	HAS_INVARIANT = true;
+	static const bool	USES_RINGS = false;
+
+	static DeformGlsl::StageType	glslStage() { return DeformGlsl::STRETCH; }
+
+	static bool sameInvariant( const DeformParams &a, const DeformParams &b ) { return a.centerPoint == b.centerPoint; }
+
+	template<typename V>
+	static TRANSFORM_INLINE V invariant( const kernels::Vec3<V> &p, const DeformParams &params )
+	{
+		return kernels::stretchDistance( p, params );
+	}
+
+	template<typename V>
+	static TRANSFORM_INLINE void apply( kernels::Vec3<V> &p, kernels::Vec3<V> &n, kernels::Vec3<V> *t, V amount, V dist, const StageContext &ctx )
+	{
+		kernels::Jacobian<V> j;
+		kernels::Vec3<V> stretchedPosition = kernels::stretch( p, dist, ctx.mParams, &j );
+		n = kernels::transformNormal( j, amount, n );
+		if( t )
+			*t = kernels::transformTangent( j, amount, *t );
+		p = kernels::mix3( p, stretchedPosition, amount );
+	}
+
+	static void bound( kernels::Vec3<Interval> &p, Interval amount, const BoundContext &ctx )
+	{
+		const DeformParams &params = ctx.mParams;
+		Interval dist = sqrt( sqr( Interval( params.centerPoint.x ) - p.x ) + sqr( Interval( params.centerPoint.y ) - p.y ) + sqr( Interval( params.centerPoint.z ) - p.z ) );
+		kernels::Vec3<Interval> q( Interval( params.xlim ) * dist / Interval( 2.0f ) * p.x, Interval( params.ylim ) * dist / Interval( 2.0f ) * p.y,
+			Interval( params.zlim ) * dist * p.z );
+		p = mixBounds( p, q, amount );
+	}
+};
+
+struct Sphere {
+	static const bool	HAS_INVARIANT = false;
+	static const bool	USES_RINGS = false;
+
+	static DeformGlsl::StageType	glslStage() { return DeformGlsl::SPHERE; }
+
+	static bool sameInvariant( const DeformParams &, const DeformParams & ) { return true; }
+
+	template<typename V>
+	static TRANSFORM_INLINE V invariant( const kernels::Vec3<V> &, const DeformParams & ) { return V( 0.0f ); }
+
+	template<typename V>
+	static TRANSFORM_INLINE void apply( kernels::Vec3<V> &p, kernels::Vec3<V> &n, kernels::Vec3<V> *t, V amount, V /*invariant*/, const StageContext & /*ctx*/ )
+	{
+		kernels::Jacobian<V> j;
+		kernels::Vec3<V> spherePosition = kernels::sphere( p, &j );
+		n = kernels::transformNormal( j, amount, n );
+		if( t )
+			*t = kernels::transformTangent( j, amount, *t );
+		p = kernels::mix3( p, spherePosition, amount );
+	}
+
+	static void bound( kernels::Vec3<Interval> &p, Interval amount, const BoundContext & /*ctx*/ )
+	{
+		const Interval one( 1.0f ), two( 2.0f ), three( 3.0f );
+		Interval xx = sqr( p.x ), yy = sqr( p.y ), zz = sqr( p.z );
+		Interval sx = sqrt( one - ( yy / two ) - ( zz / two ) + ( yy * zz / three ) );
+		Interval sy = sqrt( one - ( zz / two ) - ( xx / two ) + ( zz * xx / three ) );
+		Interval sz = sqrt( one - ( xx / two ) - ( yy / two ) + ( xx * yy / three ) );
+		p = mixBounds( p, kernels::Vec3<Interval>( p.x * sx, p.y * sy, p.z * sz ), amount );
+	}
+};
+
+//! Morphs towards the plane spanned by the texture coordinates. The goal does not depend on the position,
+//! so the Jacobian is (1 - amount) * I and leaves normals unchanged; they are blended towards the goal
+//! plane's normal instead, and tangents, which follow the first texture coordinate, towards its u axis.
+struct PlaneMorph {
+	static const bool	HAS_INVARIANT = false;
+	static const bool	USES_RINGS = false;
+
+	static DeformGlsl::StageType	glslStage() { return DeformGlsl::PLANE_MORPH; }
+
+	static bool sameInvariant( const DeformParams &, const DeformParams & ) { return true; }
+
+	template<typename V>
+	static TRANSFORM_INLINE V invariant( const kernels::Vec3<V> &, const DeformParams & ) { return V( 0.0f ); }
+
+	template<typename V>
+	static TRANSFORM_INLINE void apply( kernels::Vec3<V> &p, kernels::Vec3<V> &n, kernels::Vec3<V> *t, V amount, V /*invariant*/, const StageContext &ctx )
+	{
+		const kernels::Vec3<V> planeNormal( V( 0.70710678f ), V( 0.0f ), V( -0.70710678f ) );
+		const kernels::Vec3<V> planeTangent( V( -0.70710678f ), V( 0.0f ), V( -0.70710678f ) );
+		p = kernels::mix3( p, kernels::planeGoal<V>( ctx.mRest, ctx.mIndex ), amount );
+		n = kernels::mix3( kernels::normalize3( n ), planeNormal, amount );
+		if( t )
+			*t = kernels::mix3( kernels::normalize3( *t ), planeTangent, amount );
+	}
+
+	static void bound( kernels::Vec3<Interval> &p, Interval amount, const BoundContext &ctx )
+	{
+		const Interval five( 5.0f );
+		p = mixBounds( p, kernels::Vec3<Interval>( five * -ctx.mRest.u, five * ctx.mRest.v, five * -ctx.mRest.u ), amount );
+	}
+};
+
+//! Runs \a Branch on the rest position and normal at full amount and blends the running position towards
+//! the result. The normals of the two are blended, as the branch and the running position are separate
+//! surfaces, and so are the tangents. \a Glsl names the matching stage of DeformGlsl.
+template<DeformGlsl::StageType Glsl, typename... Branch>
+struct RestBranch {
+	static const bool	HAS_INVARIANT = false;
+	static const bool	USES_RINGS = false;
+
+	static DeformGlsl::StageType	glslStage() { return Glsl; }
+
+	static bool sameInvariant( const DeformParams &, const DeformParams & ) { return true; }
+
+	template<typename V>
+	static TRANSFORM_INLINE V invariant( const kernels::Vec3<V> &, const DeformParams & ) { return V( 0.0f ); }
+
+	template<typename V>
+	static TRANSFORM_INLINE void apply( kernels::Vec3<V> &p, kernels::Vec3<V> &n, kernels::Vec3<V> *t, V amount, V /*invariant*/, const StageContext &ctx )
+	{
+		float full[sizeof...( Branch )];
+		std::fill( full, full + sizeof...( Branch ), 1.0f );
+
+		kernels::Vec3<V> branchPosition = kernels::loadPosition<V>( ctx.mRest, ctx.mIndex );
+		kernels::Vec3<V> branchNormal = kernels::loadNormal<V>( ctx.mRest, ctx.mIndex );
+		kernels::Vec3<V> branchTangent;
+		if( t )
+			branchTangent = kernels::loadTangent<V>( ctx.mRest, ctx.mIndex );
+		kernels::StageChain<V, Branch...>::run( branchPosition, branchNormal, t ? &branchTangent : nullptr, full, nullptr, ctx );
+		p = kernels::mix3( p, branchPosition, amount );
+		n = kernels::mix3( kernels::normalize3( n ), kernels::normalize3( branchNormal ), amount );
+		if( t )
+			*t = kernels::mix3( kernels::normalize3( *t ), kernels::normalize3( branchTangent ), amount );
+	}
+
+	static void bound( kernels::Vec3<Interval> &p, Interval amount, const BoundContext &ctx )
+	{
+		Interval full[sizeof...( Branch )];
+		std::fill( full, full + sizeof...( Branch ), Interval( 1.0f ) );
+
+		kernels::Vec3<Interval> branchPosition = ctx.mRest.position;
+		kernels::BoundChain<Branch...>::run( branchPosition, full, ctx );
+		p = mixBounds( p, branchPosition, amount );
+	}
+};
+
+typedef RestBranch<DeformGlsl::TWIST_BRANCH, Twist>						TwistBranch;
+typedef RestBranch<DeformGlsl::TWIST_STRETCH_BRANCH, Twist, Stretch>	TwistStretchBranch;
+
+} // namespace stage
+
+namespace kernels {
+
+// Runs the stages in order. \a invariants holds the first stage's baked invariants, or is null; so is \a t
+// when no tangents are carried along.
+template<typename V>
+struct StageChain<V> {
+	static TRANSFORM_INLINE void run( Vec3<V> &, Vec3<V> &, Vec3<V> *, const float *, const float *, const StageContext & ) {}
+};
+
+template<typename V, typename First, typename... Rest>
+struct StageChain<V, First, Rest...> {
+	static TRANSFORM_INLINE void run( Vec3<V> &p, Vec3<V> &n, Vec3<V> *t, const float *amounts, const float *invariants, const StageContext &ctx )
+	{
+		V invariant = invariants ? V::load( invariants + ctx.mIndex ) : First::invariant( p, ctx.mParams );
+		First::apply( p, n, t, V( amounts[0] ), invariant, ctx );
+		StageChain<V, Rest...>::run( p, n, t, amounts + 1, nullptr, ctx );
+	}
+};
+
+// Bounds the stages in order, see Pipeline::getBounds().
+template<>
+struct BoundChain<> {
+	static void run( Vec3<Interval> &, const Interval *, const BoundContext & ) {}
+};
+
+template<typename First, typename... Rest>
+struct BoundChain<First, Rest...> {
+	static void run( Vec3<Interval> &p, const Interval *amounts, const BoundContext &ctx )
+	{
+		First::bound( p, amounts[0], ctx );
+		BoundChain<Rest...>::run( p, amounts + 1, ctx );
+	}
+};
+
+template<typename First, typename... Rest>
+struct FirstStage {
+	typedef First Type;
+};
+
+// Runs the stages when the first one works on rings; only instantiated for stages with USES_RINGS.
+template<bool UsesRings>
+struct RingChain {
+	template<typename First>
+	static void evaluate( const std::vector<float> &, const DeformParams &, const FrameTerms &, std::vector<float> * ) {}
+
+	template<typename V, typename First, typename... Rest>
+	static TRANSFORM_INLINE void run( Vec3<V> &, Vec3<V> &, Vec3<V> *, const float *, const int32_t *, const std::vector<float> &, const StageContext & ) {}
+};
+
+template<>
+struct RingChain<true> {
+	template<typename First>
+	static void evaluate( const std::vector<float> &ringValues, const DeformParams &params, const FrameTerms &frameTerms, std::vector<float> *terms )
+	{
+		First::evaluateRings( ringValues, params, frameTerms, terms );
+	}
+
+	template<typename V, typename First, typename... Rest>
+	static TRANSFORM_INLINE void run( Vec3<V> &p, Vec3<V> &n, Vec3<V> *t, const float *amounts, const int32_t *ring, const std::vector<float> &terms,
+		const StageContext &ctx )
+	{
+		First::applyRing( p, n, t, V( amounts[0] ), ring, terms, ctx );
+		StageChain<V, Rest...>::run( p, n, t, amounts + 1, nullptr, ctx );
+	}
+};
+
+} // namespace kernels
+
+//! A chain of stages fused into a single pass: every vertex is loaded once, runs through all stages in
+//! registers and is stored once, so no intermediate buffers are written. Stage i is blended in by
+//! getMix()[i], times (1 + sin(elapsedSeconds)) if the stage is animated. Normals, and tangents if both
+//! the rest and the result data have them, are transformed alongside the positions and normalized once
+//! at the end. glslPermutation() selects the matching
+//! permutation of DeformGlsl::uberVertexShader(), which expects the values of getAmounts() in the 'stageAmount' uniform array and, if
+//! hasRestInvariant(), the baked invariants (see bake()) in the 'restInvariant' vertex attribute.
+template<typename... Stages>
+class Pipeline {
+	typedef typename kernels::FirstStage<Stages...>::Type	First;
+
+public:
+	static const size_t NUM_STAGES = sizeof...( Stages );
+	static_assert( sizeof...( Stages ) > 0, "a pipeline needs at least one stage" );
+	static_assert( sizeof...( Stages ) <= DeformGlsl::MAX_STAGES, "the shader has no slots for more stages" );
+
+	//! Whether the first stage has a per-vertex invariant that bake() can precompute.
+	static bool			hasRestInvariant() { return First::HAS_INVARIANT; }
+
+	Pipeline()
+	{
+		for( size_t i = 0; i < NUM_STAGES; ++i ) {
+			mMix[i] = 0.5f;
+			mAnimated[i] = true;
+		}
+	}
+
+	//! Sets the mix factor of \a stage. If \a animated, the factor is scaled by (1 + sin(elapsedSeconds)).
+	Pipeline&			mix( size_t stage, float amount, bool animated = true ) { mMix[stage] = amount; mAnimated[stage] = animated; return *this; }
+	const float*		getMix() const { return mMix; }
+	bool				isAnimated( size_t stage ) const { return mAnimated[stage]; }
+
+	//! Writes the blend amount of each stage at \a elapsedSeconds into \a amounts (NUM_STAGES floats).
+	void getAmounts( float elapsedSeconds, float *amounts ) const
+	{
+		amountsFromSinTime( std::sin( elapsedSeconds ), amounts );
+	}
+
+	//! Drops the baked invariants if \a params changes a value they were computed from.
+	void setParams( const DeformParams &params )
+	{
+		if( ! First::sameInvariant( mParams, params ) )
+			mRestInvariants.reset();
+
+		mParams = params;
+	}
+	const DeformParams&	getParams() const { return mParams; }
+
+	//! Computes the first stage's invariant for every vertex of \a rest with the current parameters, so
+	//! that apply() only does the time-dependent work. Until the next bake() or clearBaked(), apply() must
+	//! be given the same rest data. Does nothing if !hasRestInvariant(). If the first stage uses rings,
+	//! vertices whose invariants are within \a ringQuantization are grouped (see RestInvariants::buildRings());
+	//! 0 groups equal values only and keeps the result identical to the unbaked one.
+	void bake( const VertexStreams &rest, float ringQuantization = 0.0f )
+	{
+		mRestInvariants.reset();
+		if( ! hasRestInvariant() )
+			return;
+
+		DeformInput input = rest.getInput();
+		size_t n = rest.getNumVertices();
+		std::shared_ptr<RestInvariants> invariants = std::make_shared<RestInvariants>();
+		invariants->values.resize( n );
+
+		float *values = invariants->values.data();
+		size_t i = 0;
+		for( ; i + SimdFloat::Width <= n; i += SimdFloat::Width )
+			First::invariant( kernels::loadPosition<SimdFloat>( input, i ), mParams ).store( values + i );
+		for( ; i < n; ++i )
+			First::invariant( kernels::loadPosition<SimdScalar>( input, i ), mParams ).store( values + i );
+
+		if( First::USES_RINGS )
+			invariants->buildRings( ringQuantization );
+
+		mRestInvariants = invariants;
+	}
+
+	void				clearBaked() { mRestInvariants.reset(); }
+	bool				isBaked() const { return (bool) mRestInvariants; }
+	//! One value per rest vertex, to be uploaded as the 'restInvariant' attribute. Null if not baked.
+	RestInvariantsRef	getRestInvariants() const { return mRestInvariants; }
+	//! Uses \a invariants baked by a pipeline with the same first stage and parameters \a bakedParams.
+	//! They are ignored if they do not match the current parameters.
+	void setRestInvariants( const RestInvariantsRef &invariants, const DeformParams &bakedParams )
+	{
+		mRestInvariants = First::sameInvariant( mParams, bakedParams ) ? invariants : RestInvariantsRef();
+	}
+
+	void apply( const VertexStreams &rest, VertexStreams *result ) const
+	{
+		if( result->getNumVertices() != rest.getNumVertices() || result->hasTangents() != rest.hasTangents() )
+			result->resize( rest.getNumVertices(), rest.hasTangents() );
+
+		apply( rest.getInput(), result->getOutput(), 0, rest.getNumVertices() );
+	}
+
+	void apply( const VertexStreams &rest, VertexStreams *result, ThreadPool &pool ) const
+	{
+		if( result->getNumVertices() != rest.getNumVertices() || result->hasTangents() != rest.hasTangents() )
+			result->resize( rest.getNumVertices(), rest.hasTangents() );
+
+		// everything the chunks share is computed once, up front
+		Frame frame( *this, rest.getNumVertices() );
+		DeformInput input = rest.getInput();
+		DeformOutput output = result->getOutput();
+		pool.parallelFor( rest.getNumVertices(), Deformer::CHUNK_SIZE, [&]( size_t begin, size_t end ) {
+			applyRange( frame, input, output, begin, end );
+		} );
+	}
+
+	//! Deforms vertices [\a begin, \a end). Both views must hold at least \a end vertices. Calling this for
+	//! each chunk of a mesh repeats the per-frame work; the ThreadPool overload above does it once.
+	void apply( const DeformInput &rest, const DeformOutput &result, size_t begin, size_t end ) const
+	{
+		applyRange( Frame( *this, end ), rest, result, begin, end );
+	}
+
+	//! Conservative bounds of the positions apply() makes of rest data within \a rest with the current
+	//! parameters, found by running the stages on ranges (see Interval) instead of on vertices.
+	ci::AxisAlignedBox3f getBounds( const RestBounds &rest ) const
+	{
+		return calcBounds( rest, Interval( std::sin( mParams.elapsedSeconds ) ), Interval( mParams.angleDegMax ) );
+	}
+
+	//! Same as above, but for every elapsedSeconds and every angleDegMax within \a angleDegMax: a box
+	//! that holds the whole animation.
+	ci::AxisAlignedBox3f getAnimationBounds( const RestBounds &rest, Interval angleDegMax ) const
+	{
+		return calcBounds( rest, Interval( -1.0f, 1.0f ), angleDegMax );
+	}
+
+	//! The feature bits of the stages in DeformGlsl::uberVertexShader().
+	static uint32_t glslPermutation()
+	{
+		const DeformGlsl::StageType stages[] = { Stages::glslStage()... };
+		return DeformGlsl::permutation( stages, NUM_STAGES );
+	}
+
+private:
+	//! What all vertices of one frame share: the frame terms, the stage amounts and, if the first stage
+	//! works on rings, the evaluated terms of every ring.
+	struct Frame {
+		Frame( const Pipeline &pipeline, size_t numVertices )
+			: terms( pipeline.mParams ), baked( nullptr )
+		{
+			pipeline.amountsFromSinTime( terms.sinTime, amounts );
+
+			const RestInvariantsRef &invariants = pipeline.mRestInvariants;
+			if( invariants && numVertices <= invariants->values.size() )
+				baked = invariants.get();
+
+			// RestInvariants::buildRings() already left out the rings of meshes with too few vertices per ring
+			if( baked && First::USES_RINGS && baked->getNumRings() > 0 )
+				kernels::RingChain<First::USES_RINGS>::template evaluate<First>( baked->ringValues, pipeline.mParams, terms, &ringTerms );
+		}
+
+		kernels::FrameTerms	terms;
+		float				amounts[NUM_STAGES];
+		const RestInvariants	*baked;			// null if not baked for this rest data
+		std::vector<float>	ringTerms;		// empty without rings
+	};
+
+	void applyRange( const Frame &frame, const DeformInput &rest, const DeformOutput &result, size_t begin, size_t end ) const
+	{
+		const bool tangents = rest.tx && result.tx;
+		if( ! frame.ringTerms.empty() ) {
+			const int32_t *ringIndices = frame.baked->ringIndices.data();
+			size_t i = begin;
+			for( ; i + SimdFloat::Width <= end; i += SimdFloat::Width )
+				runRings<SimdFloat>( frame.terms, frame.amounts, ringIndices, frame.ringTerms, rest, result, tangents, i );
+			for( ; i < end; ++i )
+				runRings<SimdScalar>( frame.terms, frame.amounts, ringIndices, frame.ringTerms, rest, result, tangents, i );
+			return;
+		}
+
+		const float *invariants = frame.baked ? frame.baked->values.data() : nullptr;
+
+		size_t i = begin;
+		for( ; i + SimdFloat::Width <= end; i += SimdFloat::Width )
+			run<SimdFloat>( frame.terms, frame.amounts, invariants, rest, result, tangents, i );
+		for( ; i < end; ++i )
+			run<SimdScalar>( frame.terms, frame.amounts, invariants, rest, result, tangents, i );
+	}
+
+	ci::AxisAlignedBox3f calcBounds( const RestBounds &rest, Interval sinTime, Interval angleDegMax ) const
+	{
+		if( rest.isEmpty() )
+			return ci::AxisAlignedBox3f( ci::vec3( 0.0f ), ci::vec3( 0.0f ) );
+
+		// as in kernels::FrameTerms and amountsFromSinTime()
+		Interval amounts[NUM_STAGES];
+		for( size_t s = 0; s < NUM_STAGES; ++s )
+			amounts[s] = mAnimated[s] ? Interval( mMix[s] ) * ( Interval( 1.0f ) + sinTime ) : Interval( mMix[s] );
+		BoundContext ctx = { mParams, angleDegMax * sinTime * Interval( 3.14159f ) / Interval( 180.0f ), rest };
+
+		kernels::Vec3<Interval> p = rest.position;
+		kernels::BoundChain<Stages...>::run( p, amounts, ctx );
+		return toBox( p );
+	}
+
+	void amountsFromSinTime( float sinTime, float *amounts ) const
+	{
+		for( size_t s = 0; s < NUM_STAGES; ++s )
+			amounts[s] = mAnimated[s] ? mMix[s] * ( 1.0f + sinTime ) : mMix[s];
+	}
+
+	template<typename V>
+	TRANSFORM_INLINE void run( const kernels::FrameTerms &terms, const float *amounts, const float *invariants, const DeformInput &rest, const DeformOutput &result,
+		bool tangents, size_t i ) const
+	{
+		StageContext ctx = { mParams, terms, rest, i };
+
+		kernels::Vec3<V> p = kernels::loadPosition<V>( rest, i );
+		kernels::Vec3<V> n = kernels::loadNormal<V>( rest, i );
+		kernels::Vec3<V> t;
+		if( tangents )
+			t = kernels::loadTangent<V>( rest, i );
+		kernels::StageChain<V, Stages...>::run( p, n, tangents ? &t : nullptr, amounts, invariants, ctx );
+		kernels::storeResult( result, i, p, kernels::normalize3( n ) );
+		if( tangents )
+			kernels::storeTangent( result, i, kernels::normalize3( t ) );
+	}
+
+	template<typename V>
+	TRANSFORM_INLINE void runRings( const kernels::FrameTerms &terms, const float *amounts, const int32_t *ringIndices, const std::vector<float> &ringTerms,
+		const DeformInput &rest, const DeformOutput &result, bool tangents, size_t i ) const
+	{
+		StageContext ctx = { mParams, terms, rest, i };
+
+		kernels::Vec3<V> p = kernels::loadPosition<V>( rest, i );
+		kernels::Vec3<V> n = kernels::loadNormal<V>( rest, i );
+		kernels::Vec3<V> t;
+		if( tangents )
+			t = kernels::loadTangent<V>( rest, i );
+		kernels::RingChain<First::USES_RINGS>::template run<V, Stages...>( p, n, tangents ? &t : nullptr, amounts, ringIndices + i, ringTerms, ctx );
+		kernels::storeResult( result, i, p, kernels::normalize3( n ) );
+		if( tangents )
+			kernels::storeTangent( result, i, kernels::normalize3( t ) );
+	}
+
+	DeformParams	mParams;
+	float			mMix[sizeof...( Stages )];
+	bool			mAnimated[sizeof...( Stages )];
+	RestInvariantsRef	mRestInvariants;
+};
+
+//! Plane morph, formerly the hand-written plane shader. It follows time while DeformParams::flag is set
+//! and uses DeformParams::move otherwise; see createPlanePipeline().
+typedef Pipeline<stage::PlaneMorph>									PlanePipeline;
+typedef Pipeline<stage::Twist>										TwistPipeline;
+typedef Pipeline<stage::Stretch>									SquashPipeline;
+//! A constant stretch followed by an animated one, formerly the hand-written Squash2 shader.
+typedef Pipeline<stage::Stretch, stage::Stretch>					Squash2Pipeline;
+typedef Pipeline<stage::Sphere>										SpherePipeline;
+//! The formerly hand-written Custom23 shader: the rest position, blended towards its stretched twist and
+//! then towards its plain twist.
+typedef Pipeline<stage::TwistStretchBranch, stage::TwistBranch>		Custom23Pipeline;
+//! The formerly hand-written Custom123 shader: the plane morph, blended towards the stretched twist of the
+//! rest position and then towards its plain twist.
+typedef Pipeline<stage::PlaneMorph, stage::TwistStretchBranch, stage::TwistBranch>	Custom123Pipeline;
+
+inline PlanePipeline createPlanePipeline( bool animated, float move )
+{
+	return animated ? PlanePipeline().mix( 0, 0.5f ) : PlanePipeline().mix( 0, move, false );
+}
+
+inline TwistPipeline createTwistPipeline()
+{
+	return TwistPipeline().mix( 0, 0.2f );
+}
+
+inline SquashPipeline createSquashPipeline()
+{
+	return SquashPipeline().mix( 0, 0.5f );
+}
+
+inline Squash2Pipeline createSquash2Pipeline()
+{
+	return Squash2Pipeline().mix( 0, 0.8f, false ).mix( 1, 0.5f );
+}
+
+inline SpherePipeline createSpherePipeline()
+{
+	return SpherePipeline().mix( 0, 0.5f );
+}
+
+inline Custom23Pipeline createCustom23Pipeline()
+{
+	return Custom23Pipeline().mix( 0, 0.1f ).mix( 1, 0.1f );
+}
+
+inline Custom123Pipeline createCustom123Pipeline()
+{
+	return Custom123Pipeline().mix( 0, 0.5f ).mix( 1, 0.1f ).mix( 2, 0.1f );
+}
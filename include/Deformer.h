@@ -0,0 +1,147 @@
+#pragma once
+
+#include "SimdTrig.h"
+
+#include "cinder/AxisAlignedBox.h"
+#include "cinder/TriMesh.h"
+#include "cinder/Vector.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+struct RestBounds;
+
+//! The values the transformation shaders receive as uniforms, so the CPU path can be fed the same state.
+struct DeformParams {
+	DeformParams();
+
+	float		elapsedSeconds;		// ciElapsedSeconds
+	float		angleDegMax;		// angle_deg_max
+	float		height;				// height
+	ci::vec3	centerPoint;		// centerPoint
+	float		xlim, ylim, zlim;	// stretch limits
+	bool		flag;				// plane morph follows time (true) or 'move' (false)
+	float		move;				// plane morph amount when flag is false
+
+	TrigAccuracy	trigAccuracy;	// CPU only: per-vertex sin/cos from the C library or a polynomial
+};
+
+//! Read-only view on structure-of-arrays vertex data. The tangents are optional; without them the
+//! pointers are null.
+struct DeformInput {
+	const float	*px, *py, *pz;
+	const float	*nx, *ny, *nz;
+	const float	*u, *v;
+	const float	*tx, *ty, *tz;
+};
+
+//! Writable view on structure-of-arrays vertex data. Tangents are written only if both views have them.
+struct DeformOutput {
+	float		*px, *py, *pz;
+	float		*nx, *ny, *nz;
+	float		*tx, *ty, *tz;
+};
+
+//! Owns one float array per vertex component (positions, normals and texture coordinates, and optionally
+//! tangents).
+class VertexStreams {
+public:
+	typedef enum { POSITION_X, POSITION_Y, POSITION_Z, NORMAL_X, NORMAL_Y, NORMAL_Z, TEX_COORD_U, TEX_COORD_V, TANGENT_X, TANGENT_Y, TANGENT_Z, NUM_STREAMS } Stream;
+
+	VertexStreams();
+	explicit VertexStreams( const ci::TriMesh &mesh, bool withTangents = false );
+
+	//! Copies positions, normals and texture coordinates from \a mesh, and its tangents if \a withTangents
+	//! and it has any. Missing attributes are zero-filled.
+	void			setMesh( const ci::TriMesh &mesh, bool withTangents = false );
+	//! Writes positions and normals back into \a mesh, which must have the same number of vertices.
+	void			copyTo( ci::TriMesh *mesh ) const;
+	//! Copies the vertices \a indices of \a source, in that order.
+	void			gather( const VertexStreams &source, const std::vector<uint32_t> &indices );
+
+	//! The tangent streams are kept only \a withTangents; they are empty otherwise.
+	void			resize( size_t numVertices, bool withTangents = false );
+	size_t			getNumVertices() const { return mNumVertices; }
+	bool			hasTangents() const { return mHasTangents; }
+
+	//! The tangent streams are empty unless hasTangents().
+	float*			getStream( Stream stream ) { return mStreams[stream].data(); }
+	const float*	getStream( Stream stream ) const { return mStreams[stream].data(); }
+
+	DeformInput		getInput() const;
+	DeformOutput	getOutput();
+
+private:
+	size_t				mNumVertices;
+	bool				mHasTangents;
+	std::vector<float>	mStreams[NUM_STREAMS];
+};
+
+//! Per-vertex terms baked from rest positions (see Pipeline::bake()), shared between pipeline copies.
+struct RestInvariants {
+	std::vector<float>		values;			// one per vertex
+
+	//! Groups vertices with the same value into rings (the primitives are built from rings of equal
+	//! height), so per-frame work that only depends on the value is done once per ring. Values within
+	//! \a quantization of each other share a ring, which then uses the bucket's center; 0 only groups
+	//! exactly equal values. Leaves the rings empty if there would be more than one per \a minRingSize vertices.
+	void					buildRings( float quantization = 0.0f, size_t minRingSize = 4 );
+	size_t					getNumRings() const { return ringValues.size(); }
+
+	std::vector<int32_t>	ringIndices;	// one per vertex, empty without rings
+	std::vector<float>		ringValues;		// one per ring
+};
+
+typedef std::shared_ptr<const RestInvariants>	RestInvariantsRef;
+
+//! CPU implementation of the transformations in GeometryApp's shaders. Each type runs the Pipeline its
+//! shader is generated from, so positions and (analytically transformed) normals match the GPU.
+class Deformer {
+public:
+	//! Same order as GeometryApp::Transformative.
+	typedef enum { PLANE, TWIST, SQUASH, SQUASH2, SPHERE, CUSTOM23, CUSTOM123 } Type;
+
+	Deformer( Type type = PLANE );
+
+	void				setType( Type type ) { mType = type; }
+	Type				getType() const { return mType; }
+
+	void				setParams( const DeformParams &params ) { mParams = params; }
+	const DeformParams&	getParams() const { return mParams; }
+
+	//! Precomputes the per-vertex terms of the current type that depend only on \a rest and on parameters
+	//! that stay fixed for a mesh (centerPoint, height). apply() uses them as long as the type and those
+	//! parameters do not change, and must then be given the same rest data. See Pipeline::bake() for
+	//! \a ringQuantization.
+	void				bake( const VertexStreams &rest, float ringQuantization = 0.0f );
+	void				clearBaked() { mRestInvariants.reset(); }
+
+	//! Deforms all vertices of \a rest into \a result, resizing it if necessary. Tangents are carried along
+	//! if \a rest has them.
+	void				apply( const VertexStreams &rest, VertexStreams *result ) const;
+	//! Same as above, but splits the vertices into cache-sized chunks and spreads them over \a pool.
+	//! The result is bit-identical to the single-threaded version.
+	void				apply( const VertexStreams &rest, VertexStreams *result, ThreadPool &pool ) const;
+	//! Deforms vertices [\a begin, \a end). Both views must hold at least \a end vertices. The per-frame
+	//! terms (e.g. the sines of every ring) are computed on each call, so prefer the overloads above for whole meshes.
+	void				apply( const DeformInput &rest, const DeformOutput &result, size_t begin, size_t end ) const;
+
+	//! Conservative bounds of the positions apply() makes of rest data within \a rest with the current type
+	//! and parameters. Nothing is deformed; see Pipeline::getBounds().
+	ci::AxisAlignedBox3f	getBounds( const RestBounds &rest ) const;
+	//! Same as above, for every elapsedSeconds and every angleDegMax within [\a minAngleDeg, \a maxAngleDeg].
+	ci::AxisAlignedBox3f	getAnimationBounds( const RestBounds &rest, float minAngleDeg, float maxAngleDeg ) const;
+
+	//! Number of vertices per chunk when running in parallel. Rest and result data of one chunk fit in L2.
+	static const size_t	CHUNK_SIZE = 4096;
+
+private:
+	Type				mType;
+	DeformParams		mParams;
+
+	RestInvariantsRef	mRestInvariants;
+	Type				mBakedType;
+	DeformParams		mBakedParams;
+};
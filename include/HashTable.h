@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//! Helpers for the concurrent open-addressing hash tables of the mesh builders: power-of-two tables whose
+//! slots are picked from the top bits of a multiplicative (Fibonacci) hash.
+
+//! Smallest power of two above \a count (at least 64), and the shift that maps a 64-bit hash onto it.
+inline size_t tableCapacity( size_t count, size_t *shift )
+{
+	size_t capacity = 64;
+	*shift = 58;
+	while( capacity <= count ) {
+		capacity *= 2;
+		--*shift;
+	}
+	return capacity;
+}
+
+//! The slot of \a key in a table of tableCapacity() slots, given the shift it returned.
+inline size_t hashSlot( uint64_t key, size_t shift )
+{
+	return (size_t)( ( key * 0x9E3779B97F4A7C15ull ) >> shift );
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+//! Picks one of a chain of levels of detail, coarsest first, once per frame. A level is dropped when
+//! frames keep taking noticeably longer than the target, or when it has many more triangles than the
+//! object covers pixels on screen. A finer level is only tried after frames have met the target for a
+//! while, and only if it has been built already (see setTriangleCount()). A level that turned out to be
+//! too slow is not tried again for a while, twice as long after every failure, so that the selection
+//! settles instead of popping back and forth.
+//!
+//! Frame times are measured between frames rather than per draw, so a vertically synced frame that
+//! meets the target counts as fast enough; headroom beyond that can only be found by trying.
+class LodSelector {
+public:
+	explicit LodSelector( size_t numLevels = 1, double targetFrameTime = 1.0 / 60.0 );
+
+	//! Starts over with \a numLevels levels at \a level, forgetting triangle counts and history.
+	void	reset( size_t numLevels, size_t level );
+
+	void	setTargetFrameTime( double seconds ) { mTargetFrameTime = seconds; }
+	double	getTargetFrameTime() const { return mTargetFrameTime; }
+
+	//! Marks \a level as built, with \a count triangles. Levels that have not been built are never stepped up to.
+	void	setTriangleCount( size_t level, size_t count );
+
+	//! Feeds the duration of the previous frame in seconds and the area in pixels the object covers on
+	//! screen, and returns the level to draw this frame.
+	size_t	update( double frameTime, float screenArea );
+
+	size_t	getLevel() const { return mLevel; }
+	size_t	getNumLevels() const { return mLevels.size(); }
+	//! Exponential moving average of the frame times fed since the last level change.
+	double	getSmoothedFrameTime() const { return mSmoothedFrameTime; }
+
+private:
+	struct Level {
+		size_t	triangles;			// 0 until built
+		double	blockedUntil;		// not tried again before this time
+		double	backoff;			// how long it is blocked the next time it turns out too slow
+	};
+
+	void	setLevel( size_t level );
+
+	std::vector<Level>	mLevels;
+	size_t				mLevel;
+	double				mTargetFrameTime;
+	double				mTime;				// sum of the frame times fed so far
+	double				mLevelTime;			// at mLevel
+	double				mSmoothedFrameTime;
+	double				mSlowTime, mFastTime;	// how long frames have been too slow or fast enough in a row
+	bool				mProbing;			// mLevel was stepped up to and has not proven itself yet
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+typedef std::shared_ptr<class MappedFile>	MappedFileRef;
+
+//! A file mapped into memory in one piece. Pages are loaded on first access and shared with every other
+//! process mapping the same file.
+class MappedFile {
+public:
+	typedef enum { READ, READ_WRITE } Mode;
+	//! Expected access to a range of the file (see advise()).
+	typedef enum { ADVISE_NORMAL, ADVISE_SEQUENTIAL, ADVISE_WILL_NEED, ADVISE_DONT_NEED } Advice;
+
+	//! Maps the existing file at \a path. Throws MappedFileExc on failure.
+	static MappedFileRef	open( const std::string &path, Mode mode = READ );
+	//! Creates (or truncates) the file at \a path with \a size bytes and maps it for writing.
+	static MappedFileRef	create( const std::string &path, size_t size );
+
+	~MappedFile();
+
+	const uint8_t*			getData() const { return mData; }
+	//! Only valid for READ_WRITE mappings.
+	uint8_t*				getData() { return mData; }
+	size_t					getSize() const { return mSize; }
+	Mode					getMode() const { return mMode; }
+	const std::string&		getPath() const { return mPath; }
+
+	//! Writes modified pages back to the file.
+	void					flush();
+	//! Tells the system how [\a offset, \a offset + \a size) is going to be accessed: ADVISE_WILL_NEED starts
+	//! reading it in the background, ADVISE_DONT_NEED lets the pages go (they are read again on the next
+	//! access). Only a hint; it does nothing on Windows.
+	void					advise( size_t offset, size_t size, Advice advice ) const;
+
+private:
+	MappedFile( const std::string &path, Mode mode, size_t createSize );
+	MappedFile( const MappedFile & );
+	MappedFile& operator=( const MappedFile & );
+
+	std::string		mPath;
+	Mode			mMode;
+	uint8_t			*mData;
+	size_t			mSize;
+#if defined( _WIN32 )
+	void			*mFile, *mMapping;
+#else
+	int				mFile;
+#endif
+};
+
+class MappedFileExc : public std::runtime_error {
+public:
+	MappedFileExc( const std::string &path, const std::string &what )
+		: std::runtime_error( "MappedFile '" + path + "': " + what ) {}
+};
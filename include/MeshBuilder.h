@@ -0,0 +1,77 @@
+#pragma once
+
+#include "DebugMesh.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+
+#include "cinder/GeomIo.h"
+#include "cinder/TriMesh.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+typedef std::shared_ptr<class MeshBuilder>	MeshBuilderRef;
+
+//! Builds meshes on a thread of its own, so the caller can keep drawing the previous mesh meanwhile.
+//! Only the most recent request matters: a new request replaces one that has not started yet and
+//! cancels one in progress at the next opportunity. Everything done here is CPU work; uploading the
+//! result is left to the caller's (GL) thread.
+//!
+//! Meshes the caller will probably need soon can be queued with prefetch(); they are built, in order,
+//! whenever there is no request. A prefetch in progress is finished before the next request starts.
+class MeshBuilder {
+public:
+	struct Result {
+		MeshKey						key;
+		ci::TriMeshRef				mesh;
+		ci::vec3					center;		// of the bounding box before subdivision
+		DebugMeshRef				normals;	// not uploaded yet
+		MeshOptimizer::Stats		optimization;
+	};
+
+	static MeshBuilderRef	create() { return MeshBuilderRef( new MeshBuilder ); }
+
+	~MeshBuilder();
+
+	//! Starts building \a source subdivided as \a key says, unless \a key is being built already.
+	void			request( const MeshKey &key, const ci::geom::SourceRef &source );
+	//! Forgets the current request; its result, if any, is never returned.
+	void			cancel();
+	//! Queues \a source to be built while there is nothing else to do, unless \a key is queued or requested already.
+	void			prefetch( const MeshKey &key, const ci::geom::SourceRef &source );
+	//! Empties the prefetch queue. A prefetch in progress still finishes.
+	void			cancelPrefetches();
+	//! Whether a request has been made whose result has not been taken yet.
+	bool			isBuilding() const;
+	//! Moves the oldest finished mesh into \a result: the current request's or a prefetched one. Returns false if there is none.
+	bool			takeResult( Result *result );
+
+	//! Builds synchronously on the calling thread, subdividing and decimating on the shared ThreadPool, and reorders
+	//! the result for drawing (see MeshOptimizer). Returns false if \a isCancelled returned true in between.
+	static bool		build( const ci::geom::Source &source, const MeshKey &key, Result *result, const std::function<bool()> &isCancelled = std::function<bool()>() );
+
+private:
+	MeshBuilder();
+	MeshBuilder( const MeshBuilder & );
+	MeshBuilder& operator=( const MeshBuilder & );
+
+	void			buildLoop();
+
+	mutable std::mutex		mMutex;
+	std::condition_variable	mWakeUp;
+	ci::geom::SourceRef		mSource;		// of a request that has not started yet
+	MeshKey					mKey;
+	bool					mActive, mQuit;
+	std::deque<std::pair<MeshKey, ci::geom::SourceRef>>	mPrefetches;
+	bool					mPrefetching;	// the build in progress is a prefetch of mPrefetchKey
+	MeshKey					mPrefetchKey;
+	std::deque<Result>		mResults;
+	// bumped by every request and cancel(), so the build in progress can tell it was superseded
+	std::atomic<uint32_t>	mGeneration;
+	std::thread				mThread;
+};
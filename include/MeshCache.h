@@ -0,0 +1,93 @@
+#pragma once
+
+#include "DebugMesh.h"
+#include "DeformBounds.h"
+
+#include "cinder/TriMesh.h"
+#include "cinder/gl/Batch.h"
+#include "cinder/gl/Vbo.h"
+#include "cinder/gl/VboMesh.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//! Everything that determines the geometry of a primitive in GeometryApp.
+struct MeshKey {
+	int			primitive;
+	int			quality;
+	int			subdivision;
+	bool		smooth;			// Loop rather than linear subdivision
+	int			detail;			// percentage of the triangles kept by decimation after subdivision; 100 keeps all
+	uint32_t	attributes;		// bit (1 << geom::Attrib) for each optional attribute that is enabled
+
+	bool operator<( const MeshKey &other ) const;
+	bool operator==( const MeshKey &other ) const;
+};
+
+typedef std::vector<std::pair<ci::geom::BufferLayout, ci::gl::VboRef>>	VertexBuffers;
+typedef std::shared_ptr<struct MeshCacheEntry>							MeshCacheEntryRef;
+
+//! A mesh on the CPU and on the GPU, plus what has been derived from it so far. The mesh is uploaded
+//! once; every batch drawing it references the same buffers.
+struct MeshCacheEntry {
+	//! Uploads every attribute of \a mesh into a buffer of its own, so batches can pick the ones they need.
+	static MeshCacheEntryRef	create( const ci::TriMeshRef &mesh, const ci::vec3 &center );
+
+	//! A VboMesh drawing the cached buffers plus \a extraBuffers. With \a withPositionsAndNormals false
+	//! the caller supplies positions and normals itself.
+	ci::gl::VboMeshRef			createVboMesh( const VertexBuffers &extraBuffers = VertexBuffers(), bool withPositionsAndNormals = true ) const;
+
+	//! Approximate CPU and GPU memory held by the entry.
+	size_t						getByteSize() const;
+
+	ci::TriMeshRef				mesh;
+	ci::vec3					center;				// of the bounding box before subdivision
+	float						radius;				// of a sphere around center that holds the mesh
+	RestBounds					restBounds;			// exact, for Deformer::getBounds()
+	VertexBuffers				vertexBuffers;		// one per attribute
+	ci::gl::VboRef				indices;
+	ci::gl::VboMeshRef			vboMesh;			// all of the buffers above, for batches that need nothing else
+	std::map<int, ci::gl::VboRef>	restInvariants;	// per transformation, see GeometryApp::createDeformBatch()
+	DebugMeshRef				normals;			// uploaded when first shown, then drawn by every view that shows normals
+};
+
+//! Keeps the most recently used meshes within a memory budget, so switching back to a primitive,
+//! quality or subdivision level that was built before costs nothing. Entries stay alive while someone
+//! else holds on to them, even after they were evicted.
+class MeshCache {
+public:
+	explicit MeshCache( size_t budget = 512 * 1024 * 1024 );
+
+	//! Returns the entry for \a key and marks it as most recently used, or null if there is none.
+	MeshCacheEntryRef	find( const MeshKey &key );
+	//! Adds \a entry, then evicts least recently used entries until the cache fits its budget again. The
+	//! entry just added is kept even if it exceeds the budget on its own.
+	void				insert( const MeshKey &key, const MeshCacheEntryRef &entry );
+	void				clear();
+
+	void				setBudget( size_t budget ) { mBudget = budget; evict(); }
+	size_t				getBudget() const { return mBudget; }
+	//! Bytes held by the entries, as estimated when they were inserted.
+	size_t				getSize() const { return mSize; }
+	size_t				getNumEntries() const { return mEntries.size(); }
+	size_t				getNumHits() const { return mNumHits; }
+	size_t				getNumMisses() const { return mNumMisses; }
+
+private:
+	struct Item {
+		MeshKey				key;
+		MeshCacheEntryRef	entry;
+		size_t				size;
+	};
+	typedef std::list<Item>	ItemList;
+
+	void				evict();
+
+	ItemList								mEntries;		// most recently used first
+	std::map<MeshKey, ItemList::iterator>	mLookup;
+	size_t									mBudget, mSize;
+	size_t									mNumHits, mNumMisses;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include "cinder/TriMesh.h"
+
+#include <functional>
+
+//! Quadric error metric simplification of indexed triangle meshes (Garland and Heckbert, "Surface
+//! Simplification Using Quadric Error Metrics", 1997), spread over a ThreadPool.
+//!
+//! Vertices are removed by half-edge collapses, cheapest first from a priority queue. Moving a vertex onto
+//! a neighbor costs the area-weighted squared distance to the planes of the triangles it has absorbed so
+//! far, plus the error this makes in normals and texture coordinates, measured with the attribute
+//! quadrics of Hoppe ("New Quadric Metric for Simplifying Meshes with Appearance Attributes", 1999). As
+//! vertices only ever move onto other vertices, no attribute values are made up. Vertices on an open
+//! border only move along it, those on a texture or normal seam only along the seam, together with their
+//! copy on the other side; corners where more than two copies meet never move.
+//!
+//! Space is first cut into a grid of cells, each simplified on its own while vertices with triangles in
+//! more than one cell stay put; a final pass over the whole mesh takes care of the cell borders and
+//! reaches the exact target. The grid only depends on the mesh, so the result does not depend on the
+//! number of threads.
+struct MeshDecimation {
+	//! Returns a copy of \a mesh with at most \a targetTriangles triangles, or with as few as can be reached
+	//! without folding the surface over, or null if \a isCancelled returned true in between. Positions,
+	//! normals, texture coordinates and colors are kept, tangents are not. Runs on the calling thread if
+	//! \a pool is null.
+	static ci::TriMeshRef	decimate( const ci::TriMesh &mesh, size_t targetTriangles, ThreadPool *pool = nullptr,
+								const std::function<bool()> &isCancelled = std::function<bool()>() );
+};
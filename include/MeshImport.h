@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include "cinder/TriMesh.h"
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+//! Loads triangle meshes from Wavefront OBJ, PLY and STL files (ASCII or binary), spread over a ThreadPool.
+//!
+//! The file is mapped into memory and parsed in place. Text is cut into chunks of a few megabytes at line
+//! breaks; a first parallel pass counts what every chunk holds, so that the second one can parse all
+//! chunks at once straight into the final arrays. Numbers are read eight digits at a time with a few
+//! integer operations on a 64-bit word instead of going through strtod and the locale. Binary records
+//! are decoded in parallel as they are. The result does not depend on the number of threads.
+//!
+//! Vertices shared by faces in the file stay shared: OBJ corners with the same position, texture
+//! coordinate and normal become one vertex, and the separate corners of STL triangles are welded where
+//! their positions are exactly equal.
+struct MeshImport {
+	//! Loads the mesh at \a path, picking the format by its extension. Polygons are split into triangle fans,
+	//! and smooth normals are computed if the file has none. Returns null if \a isCancelled returned true
+	//! between two passes. Throws MeshImportExc if the file cannot be read or parsed. Runs on the calling
+	//! thread if \a pool is null.
+	static ci::TriMeshRef	load( const std::string &path, ThreadPool *pool = nullptr,
+								const std::function<bool()> &isCancelled = std::function<bool()>() );
+};
+
+class MeshImportExc : public std::runtime_error {
+public:
+	MeshImportExc( const std::string &path, const std::string &what )
+		: std::runtime_error( "MeshImport '" + path + "': " + what ) {}
+};
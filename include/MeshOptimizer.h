@@ -0,0 +1,41 @@
+#pragma once
+
+#include "cinder/TriMesh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! Reorders the triangles and vertices of a mesh for the GPU, without changing what it looks like.
+//!
+//! Triangles are ordered with Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+//! Locality and Reduced Overdraw", 2007): the mesh is traversed as a series of fans, each around the
+//! vertex most likely to still be in the post-transform cache, so that most vertices are shaded once.
+//! The traversal breaks into clusters wherever it has to jump; the clusters are then sorted so that
+//! those facing outwards are drawn first, which helps early depth rejection. Finally the vertices are
+//! renumbered in the order they are first used, so that vertex fetch reads memory sequentially.
+struct MeshOptimizer {
+	//! Post-transform cache entries the triangle order is optimized for, and ACMR is measured with.
+	static const size_t	CACHE_SIZE = 16;
+
+	struct Stats {
+		float	acmrBefore, acmrAfter;
+	};
+
+	//! Average cache miss ratio: vertices shaded per triangle with a FIFO cache of \a cacheSize entries.
+	//! Ranges from 3 (no reuse) down to about 0.5 on large regular meshes.
+	static float	calcAcmr( const uint32_t *indices, size_t numIndices, size_t numVertices, size_t cacheSize = CACHE_SIZE );
+
+	//! Reorders the triangles in \a indices with Tipsify. If \a clusters is not null, it receives the
+	//! first index of every cluster, starting with 0.
+	static void		optimizeVertexCache( uint32_t *indices, size_t numIndices, size_t numVertices, size_t cacheSize = CACHE_SIZE,
+						std::vector<size_t> *clusters = nullptr );
+	//! Reorders \a clusters (see optimizeVertexCache()) by how much they face away from the center of
+	//! the mesh, most first. The triangles within a cluster keep their order.
+	static void		optimizeOverdraw( uint32_t *indices, size_t numIndices, const std::vector<size_t> &clusters, const float *positions, size_t positionDims );
+	//! Renumbers the vertices of \a mesh in the order in which the triangles use them. Unused vertices move to the end.
+	static void		optimizeVertexFetch( ci::TriMesh *mesh );
+
+	//! All of the above.
+	static Stats	optimize( ci::TriMesh *mesh );
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include "cinder/TriMesh.h"
+
+#include <functional>
+
+//! Subdivision of indexed triangle meshes, spread over a ThreadPool.
+//!
+//! Each pass first builds a table of the unique edges, an open-addressing hash map that all threads
+//! insert into at once, and numbers the edges in the order they first appear in the index list. New
+//! vertices and triangles are then written in parallel into arrays sized exactly from the triangle and
+//! edge counts, so the vertices on an edge are shared by both triangles next to it. The result does not
+//! depend on the number of threads.
+struct MeshSubdivision {
+	//! LINEAR splits every edge into \a divisions segments and every triangle into divisions^2 flat
+	//! triangles, like TriMesh::subdivide(). LOOP runs divisions - 1 rounds of Loop subdivision, each
+	//! splitting every triangle into four and smoothing positions and normals; texture coordinates and
+	//! colors are interpolated linearly. LOOP welds vertices with equal positions, so texture seams and
+	//! the poles of the built-in primitives stay closed; edges with a single triangle are kept as creases.
+	typedef enum { LINEAR, LOOP } Scheme;
+
+	//! Returns the subdivided copy of \a mesh, or null if \a isCancelled returned true between two passes.
+	//! Positions, normals, texture coordinates and colors are kept, tangents are not. Runs on the calling
+	//! thread if \a pool is null.
+	static ci::TriMeshRef	subdivide( const ci::TriMesh &mesh, int divisions, Scheme scheme = LINEAR, ThreadPool *pool = nullptr,
+								const std::function<bool()> &isCancelled = std::function<bool()>() );
+};
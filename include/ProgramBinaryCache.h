@@ -0,0 +1,65 @@
+#pragma once
+
+#include "cinder/Filesystem.h"
+#include "cinder/gl/GlslProg.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+typedef std::shared_ptr<class ProgramBinaryCache>	ProgramBinaryCacheRef;
+
+//! Linked programs kept on disk between runs (glGetProgramBinary), so that a program is only compiled the
+//! first time the application sees its source. A program's file is named after two hashes: one of the
+//! driver (vendor, renderer and version strings) and one of the sources, defines included. Files of other
+//! drivers are deleted when the cache is created, so a driver update throws the old binaries away; a
+//! binary the driver turns down anyway is deleted and the program compiled again.
+//!
+//! Each file starts with a Header, followed by the binary. Without a driver that offers at least one binary
+//! format, programs are simply compiled every time. The same goes for a Cinder whose GlslProg cannot take
+//! over a program loaded from a binary (see BinaryGlslProg in the source); the cache finds out with the
+//! first binary it loads and turns itself off.
+class ProgramBinaryCache {
+public:
+	static const uint32_t	VERSION = 1;
+
+	struct Header {
+		char		magic[8];
+		uint32_t	version;
+		uint32_t	format;			// binary format reported by glGetProgramBinary
+		uint64_t	driverHash;
+		uint64_t	sourceHash;
+		uint64_t	size;			// of the binary, in bytes
+	};
+
+	//! Needs a current GL context. \a directory is created if it does not exist.
+	static ProgramBinaryCacheRef	create( const ci::fs::path &directory ) { return ProgramBinaryCacheRef( new ProgramBinaryCache( directory ) ); }
+
+	//! The program linked from the given sources; \a geometry may be empty. Loaded from disk if an earlier
+	//! run stored one the driver still accepts, compiled (and stored) otherwise. Compile and link errors
+	//! are thrown as by GlslProg::create().
+	ci::gl::GlslProgRef		getProgram( const std::string &vertex, const std::string &fragment, const std::string &geometry = std::string() );
+
+	//! Whether the driver hands out program binaries at all, and GlslProg has not turned down one yet.
+	bool					isSupported() const { return mSupported; }
+	const ci::fs::path&		getDirectory() const { return mDirectory; }
+	//! Programs getProgram() loaded from disk and compiled, respectively.
+	size_t					getNumLoaded() const { return mNumLoaded; }
+	size_t					getNumCompiled() const { return mNumCompiled; }
+
+private:
+	explicit ProgramBinaryCache( const ci::fs::path &directory );
+
+	ci::fs::path			getPath( uint64_t sourceHash ) const;
+	//! The program stored at \a path, or null if there is none or the driver does not take it. Turns the cache
+	//! off if GlslProg does not see the interface of the loaded program.
+	ci::gl::GlslProgRef		load( const ci::fs::path &path, uint64_t sourceHash );
+	//! Writes the binary of \a program to \a path, if the driver gives one. Errors are ignored; the program
+	//! is just compiled again next time.
+	void					store( const ci::gl::GlslProgRef &program, const ci::fs::path &path, uint64_t sourceHash ) const;
+
+	ci::fs::path			mDirectory;
+	bool					mSupported;
+	uint64_t				mDriverHash;
+	size_t					mNumLoaded, mNumCompiled;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "cinder/AxisAlignedBox.h"
+#include "cinder/Vector.h"
+
+#include <cstdint>
+#include <vector>
+
+//! The six planes of a view frustum, extracted from a view-projection matrix (Gribb and Hartmann, "Fast
+//! Extraction of Viewing Frustum Planes from the World-View-Projection Matrix", 2001). A point p is
+//! inside plane i if dot(planes[i], vec4(p, 1)) >= 0.
+struct Frustum {
+	explicit Frustum( const ci::mat4 &viewProjection );
+
+	//! Whether \a box may be visible. Boxes outside the frustum but near one of its edges may pass too.
+	bool		intersects( const ci::AxisAlignedBox3f &box ) const;
+
+	ci::vec4	planes[6];		// left, right, bottom, top, near, far
+};
+
+//! A bounding volume hierarchy over the boxes of a set of objects, for finding the ones in view without
+//! testing every box. The tree is built once with the surface area heuristic on binned centroids; when
+//! objects move or deform, refit() only recomputes the boxes of the nodes, bottom up, and the tree is
+//! rebuilt once refitting has made it much looser than a fresh one would be.
+class SceneBvh {
+public:
+	SceneBvh();
+
+	//! Builds the tree over \a bounds, one box per object.
+	void		build( const std::vector<ci::AxisAlignedBox3f> &bounds );
+	//! Takes the new boxes of the same objects as the last build(). Rebuilds if the count changed or the
+	//! tree has become too loose.
+	void		refit( const std::vector<ci::AxisAlignedBox3f> &bounds );
+
+	//! Appends the objects whose boxes may intersect \a frustum to \a visible. Subtrees entirely inside the
+	//! frustum are taken as a whole, and planes a node is entirely inside of are not tested below it.
+	void		cull( const Frustum &frustum, std::vector<uint32_t> *visible ) const;
+
+	size_t		getNumObjects() const { return mObjects.size(); }
+	size_t		getNumNodes() const { return mNodes.size(); }
+	//! Number of build() calls, including those refit() made.
+	size_t		getNumBuilds() const { return mNumBuilds; }
+
+private:
+	struct Node {
+		ci::vec3	lower, upper;
+		uint32_t	first;		// first child (the second one follows it), or first object in mObjects
+		uint32_t	count;		// objects of a leaf, 0 for inner nodes
+	};
+
+	//! Sets the box of mNodes[node] around the objects mObjects[begin, end) and splits them up below it;
+	//! \a centroids is indexed by object.
+	void		split( uint32_t node, uint32_t begin, uint32_t end, const std::vector<ci::vec3> &centroids );
+	//! Surface area of every node, times the number of objects for leaves: what the heuristic minimizes.
+	float		calcCost() const;
+	void		cullNode( uint32_t node, const Frustum &frustum, uint32_t planeMask, std::vector<uint32_t> *visible ) const;
+	void		appendObjects( uint32_t node, std::vector<uint32_t> *visible ) const;
+
+	std::vector<Node>		mNodes;			// root first
+	std::vector<uint32_t>	mObjects;		// object indices, grouped by leaf
+	std::vector<ci::AxisAlignedBox3f>	mBounds;	// per object
+	float					mBuildCost;		// calcCost() right after the last build
+	size_t					mNumBuilds;
+};
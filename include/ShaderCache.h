@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ProgramBinaryCache.h"
+
+#include "cinder/gl/GlslProg.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+typedef std::shared_ptr<class ShaderCache>	ShaderCacheRef;
+
+//! The permutations of one vertex and one fragment shader, which differ only in the #defines in front of
+//! their code. A permutation is a set of feature bits that a function turns into #define lines. Each one is
+//! compiled the first time it is asked for and kept from then on, so only the permutations in use cost
+//! anything. With a ProgramBinaryCache, a permutation compiled by an earlier run is loaded instead.
+class ShaderCache {
+public:
+	typedef std::function<std::string( uint32_t )>	DefinesFn;
+
+	//! Both sources start with a #version line; the defines \a defines makes of a permutation go right after it.
+	//! Programs go through \a binaries if it is not null.
+	static ShaderCacheRef	create( const std::string &vertex, const std::string &fragment, const DefinesFn &defines,
+								const ProgramBinaryCacheRef &binaries = ProgramBinaryCacheRef() ) { return ShaderCacheRef( new ShaderCache( vertex, fragment, defines, binaries ) ); }
+
+	//! The program for \a permutation, compiled first if it is the first time it is asked for. Compile and
+	//! link errors are thrown that first time; after that, the permutation gives null.
+	ci::gl::GlslProgRef		get( uint32_t permutation );
+	//! Drops every program, so they are compiled (or loaded) again on their next use.
+	void					clear() { mPrograms.clear(); }
+
+	size_t					getNumPrograms() const { return mPrograms.size(); }
+
+private:
+	ShaderCache( const std::string &vertex, const std::string &fragment, const DefinesFn &defines, const ProgramBinaryCacheRef &binaries );
+
+	//! \a source with \a defines after its first line.
+	static std::string		insertDefines( const std::string &source, const std::string &defines );
+
+	std::string								mVertex, mFragment;
+	DefinesFn								mDefines;
+	ProgramBinaryCacheRef					mBinaries;
+	std::map<uint32_t, ci::gl::GlslProgRef>	mPrograms;		// null for the ones that failed
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Pick the widest instruction set the compiler was told it may use. Define TRANSFORM_SIMD_DISABLE
+// to force the scalar path (handy when comparing results against the shaders).
+#if ! defined( TRANSFORM_SIMD_DISABLE )
+	#if defined( __AVX2__ )
+		#define TRANSFORM_SIMD_AVX2
+		#define TRANSFORM_SIMD_SSE
+	#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+		#define TRANSFORM_SIMD_SSE
+	#endif
+#endif
+
+#if defined( TRANSFORM_SIMD_AVX2 )
+	#include <immintrin.h>
+#elif defined( TRANSFORM_SIMD_SSE )
+	#include <emmintrin.h>
+#endif
+
+#if defined( _MSC_VER )
+	#define TRANSFORM_INLINE __forceinline
+#else
+	#define TRANSFORM_INLINE inline __attribute__((always_inline))
+#endif
+
+//! Thin wrappers around a register of floats, so that every kernel can be written once as a template
+//! and instantiated for AVX2 (8 lanes), SSE (4 lanes) and plain scalar code (1 lane, also used for tails).
+struct SimdScalar {
+	static const int Width = 1;
+
+	float v;
+
+	SimdScalar() {}
+	SimdScalar( float f ) : v( f ) {}
+
+	static TRANSFORM_INLINE SimdScalar	broadcast( float f ) { return SimdScalar( f ); }
+	static TRANSFORM_INLINE SimdScalar	load( const float *p ) { return SimdScalar( *p ); }
+	TRANSFORM_INLINE void				store( float *p ) const { *p = v; }
+
+	TRANSFORM_INLINE void				toArray( float *p ) const { *p = v; }
+	static TRANSFORM_INLINE SimdScalar	fromArray( const float *p ) { return SimdScalar( *p ); }
+
+	//! Loads base[indices[i]] into lane i.
+	static TRANSFORM_INLINE SimdScalar	gather( const float *base, const int32_t *indices ) { return SimdScalar( base[indices[0]] ); }
+};
+
+TRANSFORM_INLINE SimdScalar operator+( SimdScalar a, SimdScalar b ) { return SimdScalar( a.v + b.v ); }
+TRANSFORM_INLINE SimdScalar operator-( SimdScalar a, SimdScalar b ) { return SimdScalar( a.v - b.v ); }
+TRANSFORM_INLINE SimdScalar operator*( SimdScalar a, SimdScalar b ) { return SimdScalar( a.v * b.v ); }
+TRANSFORM_INLINE SimdScalar operator/( SimdScalar a, SimdScalar b ) { return SimdScalar( a.v / b.v ); }
+TRANSFORM_INLINE SimdScalar operator-( SimdScalar a ) { return SimdScalar( -a.v ); }
+TRANSFORM_INLINE SimdScalar sqrt( SimdScalar a ) { return SimdScalar( std::sqrt( a.v ) ); }
+TRANSFORM_INLINE SimdScalar abs( SimdScalar a ) { return SimdScalar( std::fabs( a.v ) ); }
+TRANSFORM_INLINE SimdScalar min( SimdScalar a, SimdScalar b ) { return SimdScalar( a.v < b.v ? a.v : b.v ); }
+TRANSFORM_INLINE SimdScalar max( SimdScalar a, SimdScalar b ) { return SimdScalar( a.v > b.v ? a.v : b.v ); }
+//! Magnitude of \a a with the sign bit of \a b.
+TRANSFORM_INLINE SimdScalar copySign( SimdScalar a, SimdScalar b )
+{
+	uint32_t ia, ib;
+	std::memcpy( &ia, &a.v, sizeof( ia ) );
+	std::memcpy( &ib, &b.v, sizeof( ib ) );
+	ia = ( ia & 0x7fffffffu ) | ( ib & 0x80000000u );
+	std::memcpy( &a.v, &ia, sizeof( ia ) );
+	return a;
+}
+
+#if defined( TRANSFORM_SIMD_SSE )
+struct SimdSse {
+	static const int Width = 4;
+
+	__m128 v;
+
+	SimdSse() {}
+	SimdSse( __m128 m ) : v( m ) {}
+	SimdSse( float f ) : v( _mm_set1_ps( f ) ) {}
+
+	static TRANSFORM_INLINE SimdSse	broadcast( float f ) { return SimdSse( _mm_set1_ps( f ) ); }
+	static TRANSFORM_INLINE SimdSse	load( const float *p ) { return SimdSse( _mm_loadu_ps( p ) ); }
+	TRANSFORM_INLINE void			store( float *p ) const { _mm_storeu_ps( p, v ); }
+
+	TRANSFORM_INLINE void			toArray( float *p ) const { _mm_storeu_ps( p, v ); }
+	static TRANSFORM_INLINE SimdSse	fromArray( const float *p ) { return SimdSse( _mm_loadu_ps( p ) ); }
+
+	static TRANSFORM_INLINE SimdSse	gather( const float *base, const int32_t *indices )
+	{
+		return SimdSse( _mm_setr_ps( base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]] ) );
+	}
+};
+
+TRANSFORM_INLINE SimdSse operator+( SimdSse a, SimdSse b ) { return SimdSse( _mm_add_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdSse operator-( SimdSse a, SimdSse b ) { return SimdSse( _mm_sub_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdSse operator*( SimdSse a, SimdSse b ) { return SimdSse( _mm_mul_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdSse operator/( SimdSse a, SimdSse b ) { return SimdSse( _mm_div_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdSse operator-( SimdSse a ) { return SimdSse( _mm_xor_ps( a.v, _mm_set1_ps( -0.0f ) ) ); }
+TRANSFORM_INLINE SimdSse sqrt( SimdSse a ) { return SimdSse( _mm_sqrt_ps( a.v ) ); }
+TRANSFORM_INLINE SimdSse abs( SimdSse a ) { return SimdSse( _mm_andnot_ps( _mm_set1_ps( -0.0f ), a.v ) ); }
+TRANSFORM_INLINE SimdSse min( SimdSse a, SimdSse b ) { return SimdSse( _mm_min_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdSse max( SimdSse a, SimdSse b ) { return SimdSse( _mm_max_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdSse copySign( SimdSse a, SimdSse b )
+{
+	__m128 sign = _mm_set1_ps( -0.0f );
+	return SimdSse( _mm_or_ps( _mm_andnot_ps( sign, a.v ), _mm_and_ps( sign, b.v ) ) );
+}
+#endif
+
+#if defined( TRANSFORM_SIMD_AVX2 )
+struct SimdAvx {
+	static const int Width = 8;
+
+	__m256 v;
+
+	SimdAvx() {}
+	SimdAvx( __m256 m ) : v( m ) {}
+	SimdAvx( float f ) : v( _mm256_set1_ps( f ) ) {}
+
+	static TRANSFORM_INLINE SimdAvx	broadcast( float f ) { return SimdAvx( _mm256_set1_ps( f ) ); }
+	static TRANSFORM_INLINE SimdAvx	load( const float *p ) { return SimdAvx( _mm256_loadu_ps( p ) ); }
+	TRANSFORM_INLINE void			store( float *p ) const { _mm256_storeu_ps( p, v ); }
+
+	TRANSFORM_INLINE void			toArray( float *p ) const { _mm256_storeu_ps( p, v ); }
+	static TRANSFORM_INLINE SimdAvx	fromArray( const float *p ) { return SimdAvx( _mm256_loadu_ps( p ) ); }
+
+	static TRANSFORM_INLINE SimdAvx	gather( const float *base, const int32_t *indices )
+	{
+		return SimdAvx( _mm256_i32gather_ps( base, _mm256_loadu_si256( (const __m256i*) indices ), 4 ) );
+	}
+};
+
+TRANSFORM_INLINE SimdAvx operator+( SimdAvx a, SimdAvx b ) { return SimdAvx( _mm256_add_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdAvx operator-( SimdAvx a, SimdAvx b ) { return SimdAvx( _mm256_sub_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdAvx operator*( SimdAvx a, SimdAvx b ) { return SimdAvx( _mm256_mul_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdAvx operator/( SimdAvx a, SimdAvx b ) { return SimdAvx( _mm256_div_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdAvx operator-( SimdAvx a ) { return SimdAvx( _mm256_xor_ps( a.v, _mm256_set1_ps( -0.0f ) ) ); }
+TRANSFORM_INLINE SimdAvx sqrt( SimdAvx a ) { return SimdAvx( _mm256_sqrt_ps( a.v ) ); }
+TRANSFORM_INLINE SimdAvx abs( SimdAvx a ) { return SimdAvx( _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), a.v ) ); }
+TRANSFORM_INLINE SimdAvx min( SimdAvx a, SimdAvx b ) { return SimdAvx( _mm256_min_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdAvx max( SimdAvx a, SimdAvx b ) { return SimdAvx( _mm256_max_ps( a.v, b.v ) ); }
+TRANSFORM_INLINE SimdAvx copySign( SimdAvx a, SimdAvx b )
+{
+	__m256 sign = _mm256_set1_ps( -0.0f );
+	return SimdAvx( _mm256_or_ps( _mm256_andnot_ps( sign, a.v ), _mm256_and_ps( sign, b.v ) ) );
+}
+#endif
+
+#if defined( TRANSFORM_SIMD_AVX2 )
+typedef SimdAvx		SimdFloat;
+#elif defined( TRANSFORM_SIMD_SSE )
+typedef SimdSse		SimdFloat;
+#else
+typedef SimdScalar	SimdFloat;
+#endif
+
+//! GLSL's mix(): a * (1 - t) + b * t, evaluated in the same order as the shaders do.
+template<typename V>
+TRANSFORM_INLINE V simdMix( V a, V b, V t )
+{
+	return a * ( V( 1.0f ) - t ) + b * t;
+}
+
+//! Per-lane sine and cosine using the C library, so results match std::sin / std::cos exactly.
+template<typename V>
+TRANSFORM_INLINE void simdSinCos( V x, V *s, V *c )
+{
+	float in[V::Width], outS[V::Width], outC[V::Width];
+	x.toArray( in );
+	for( int i = 0; i < V::Width; ++i ) {
+		outS[i] = std::sin( in[i] );
+		outC[i] = std::cos( in[i] );
+	}
+	*s = V::fromArray( outS );
+	*c = V::fromArray( outC );
+}
+
+//! Name of the instruction set the kernels were compiled for.
+inline const char* simdInstructionSet()
+{
+#if defined( TRANSFORM_SIMD_AVX2 )
+	return "AVX2";
+#elif defined( TRANSFORM_SIMD_SSE )
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
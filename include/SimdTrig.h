@@ -0,0 +1,121 @@
+#pragma once
+
+#include "SimdMath.h"
+
+#include <ostream>
+#include <utility>
+
+//! Accuracy of the sine and cosine used by the CPU kernels. TRIG_EXACT calls the C library for every
+//! lane; the others evaluate a polynomial whose absolute error from the exact value stays below 1e-3,
+//! 1e-5 and 1e-7 (the last one is about float precision) for |x| < 8192.
+typedef enum { TRIG_EXACT, TRIG_FAST_1E3, TRIG_FAST_1E5, TRIG_FAST_1E7 } TrigAccuracy;
+
+namespace kernels {
+
+// x - q * pi/2 in three steps (Cody-Waite); the high parts have few enough bits to make q * part exact.
+template<typename V>
+TRANSFORM_INLINE V reduceQuarterTurns( V x, V q )
+{
+	x = x - q * V( 1.5703125f );
+	x = x - q * V( 4.837512969970703125e-4f );
+	return x - q * V( 7.54978995489188216e-8f );
+}
+
+// Sine and cosine of r in [-pi/4, pi/4]. The two lower accuracies use truncated Taylor series, the
+// highest one the minimax coefficients from Cephes' sinf/cosf.
+template<typename V>
+TRANSFORM_INLINE void sinCosPolynomial( V r, TrigAccuracy accuracy, V *s, V *c )
+{
+	V r2 = r * r;
+	switch( accuracy ) {
+		case TRIG_FAST_1E3:
+			*s = r + r * r2 * ( V( -1.0f / 6.0f ) + r2 * V( 1.0f / 120.0f ) );
+			*c = V( 1.0f ) - r2 * V( 0.5f ) + r2 * r2 * V( 1.0f / 24.0f );
+			break;
+		case TRIG_FAST_1E5:
+			*s = r + r * r2 * ( V( -1.0f / 6.0f ) + r2 * ( V( 1.0f / 120.0f ) + r2 * V( -1.0f / 5040.0f ) ) );
+			*c = V( 1.0f ) - r2 * V( 0.5f ) + r2 * r2 * ( V( 1.0f / 24.0f ) + r2 * ( V( -1.0f / 720.0f ) + r2 * V( 1.0f / 40320.0f ) ) );
+			break;
+		default:
+			*s = r + r * r2 * ( V( -1.6666654611e-1f ) + r2 * ( V( 8.3321608736e-3f ) + r2 * V( -1.9515295891e-4f ) ) );
+			*c = V( 1.0f ) - r2 * V( 0.5f ) + r2 * r2 * ( V( 4.166664568298827e-2f ) + r2 * ( V( -1.388731625493765e-3f ) + r2 * V( 2.443315711809948e-5f ) ) );
+			break;
+	}
+}
+
+} // namespace kernels
+
+// The polynomial versions reduce x to r = x - q * pi/2 and then rotate the result of r by q quarter
+// turns: odd q swap sine and cosine, and bit 1 of q (of q + 1 for the cosine) flips the sign.
+
+TRANSFORM_INLINE void simdSinCos( SimdScalar x, SimdScalar *s, SimdScalar *c, TrigAccuracy accuracy )
+{
+	if( accuracy == TRIG_EXACT ) {
+		simdSinCos( x, s, c );
+		return;
+	}
+
+	int32_t q = (int32_t) std::lrint( x.v * 0.636619772f );
+	SimdScalar ss, cc;
+	kernels::sinCosPolynomial( kernels::reduceQuarterTurns( x, SimdScalar( (float) q ) ), accuracy, &ss, &cc );
+
+	if( q & 1 )
+		std::swap( ss, cc );
+	*s = ( q & 2 ) ? -ss : ss;
+	*c = ( ( q + 1 ) & 2 ) ? -cc : cc;
+}
+
+#if defined( TRANSFORM_SIMD_SSE )
+TRANSFORM_INLINE void simdSinCos( SimdSse x, SimdSse *s, SimdSse *c, TrigAccuracy accuracy )
+{
+	if( accuracy == TRIG_EXACT ) {
+		simdSinCos( x, s, c );
+		return;
+	}
+
+	__m128i q = _mm_cvtps_epi32( _mm_mul_ps( x.v, _mm_set1_ps( 0.636619772f ) ) );
+	SimdSse ss, cc;
+	kernels::sinCosPolynomial( kernels::reduceQuarterTurns( x, SimdSse( _mm_cvtepi32_ps( q ) ) ), accuracy, &ss, &cc );
+
+	const __m128i one = _mm_set1_epi32( 1 ), two = _mm_set1_epi32( 2 );
+	__m128 swap = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( q, one ), one ) );
+	__m128 sinSign = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( q, two ), 30 ) );
+	__m128 cosSign = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( _mm_add_epi32( q, one ), two ), 30 ) );
+	*s = SimdSse( _mm_xor_ps( _mm_or_ps( _mm_and_ps( swap, cc.v ), _mm_andnot_ps( swap, ss.v ) ), sinSign ) );
+	*c = SimdSse( _mm_xor_ps( _mm_or_ps( _mm_and_ps( swap, ss.v ), _mm_andnot_ps( swap, cc.v ) ), cosSign ) );
+}
+#endif
+
+#if defined( TRANSFORM_SIMD_AVX2 )
+TRANSFORM_INLINE void simdSinCos( SimdAvx x, SimdAvx *s, SimdAvx *c, TrigAccuracy accuracy )
+{
+	if( accuracy == TRIG_EXACT ) {
+		simdSinCos( x, s, c );
+		return;
+	}
+
+	__m256i q = _mm256_cvtps_epi32( _mm256_mul_ps( x.v, _mm256_set1_ps( 0.636619772f ) ) );
+	SimdAvx ss, cc;
+	kernels::sinCosPolynomial( kernels::reduceQuarterTurns( x, SimdAvx( _mm256_cvtepi32_ps( q ) ) ), accuracy, &ss, &cc );
+
+	const __m256i one = _mm256_set1_epi32( 1 ), two = _mm256_set1_epi32( 2 );
+	__m256 swap = _mm256_castsi256_ps( _mm256_cmpeq_epi32( _mm256_and_si256( q, one ), one ) );
+	__m256 sinSign = _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_and_si256( q, two ), 30 ) );
+	__m256 cosSign = _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_and_si256( _mm256_add_epi32( q, one ), two ), 30 ) );
+	*s = SimdAvx( _mm256_xor_ps( _mm256_blendv_ps( ss.v, cc.v, swap ), sinSign ) );
+	*c = SimdAvx( _mm256_xor_ps( _mm256_blendv_ps( cc.v, ss.v, swap ), cosSign ) );
+}
+#endif
+
+//! Result of comparing one accuracy of simdSinCos() with std::sin and std::cos in double precision.
+struct TrigAccuracyReport {
+	TrigAccuracy	accuracy;
+	float			maxSinError;		// largest absolute difference
+	float			maxCosError;
+	double			nanosecondsPerValue;	// time per sine/cosine pair with SimdFloat
+};
+
+//! Samples \a numSamples values evenly over [-range, range] and measures error and speed of \a accuracy.
+TrigAccuracyReport	measureTrigAccuracy( TrigAccuracy accuracy, float range = 100.0f, size_t numSamples = 1 << 20 );
+//! Measures all accuracies and writes a table to \a os.
+void				printTrigAccuracyReport( std::ostream &os );
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::shared_ptr<class ThreadPool> ThreadPoolRef;
+
+//! A fixed set of worker threads running any number of parallelFor() jobs at once. Each job is split up
+//! front into contiguous ranges, spread evenly over one slice per thread; a thread that runs out of work
+//! steals from the back of another thread's slice. The thread calling parallelFor() only works on its own
+//! job, so it never waits behind another caller's, and workers help the newest job first.
+class ThreadPool {
+public:
+	//! Creates a pool with \a numThreads workers (including the calling thread). Zero picks the number of hardware threads.
+	static ThreadPoolRef	create( size_t numThreads = 0 ) { return ThreadPoolRef( new ThreadPool( numThreads ) ); }
+	//! Shared pool sized to the machine, created on first use.
+	static ThreadPool&		instance();
+
+	~ThreadPool();
+
+	size_t	getNumThreads() const { return mNumThreads; }
+
+	//! Calls \a fn( begin, end ) for consecutive ranges of at most \a grainSize items covering [0, \a count),
+	//! and returns when all of them have finished. Range boundaries only depend on \a count and \a grainSize,
+	//! never on the number of threads, so per-item results are identical for any pool size.
+	//! Calls made from inside a worker run serially on that worker; nested calls from the calling thread's
+	//! own ranges are jobs of their own.
+	void	parallelFor( size_t count, size_t grainSize, const std::function<void( size_t, size_t )> &fn );
+	//! Same as above on \a pool, or all at once on the calling thread if \a pool is null.
+	static void	parallelFor( ThreadPool *pool, size_t count, size_t grainSize, const std::function<void( size_t, size_t )> &fn );
+
+private:
+	explicit ThreadPool( size_t numThreads );
+
+	//! Chunks [mFront, mBack) of a job, initially a contiguous run.
+	struct Slice {
+		std::mutex	mMutex;
+		size_t		mFront, mBack;
+	};
+
+	struct Job {
+		const std::function<void( size_t, size_t )>	*mFn;
+		size_t										mCount, mGrainSize;
+		std::atomic<size_t>							mRemaining;
+		std::vector<std::unique_ptr<Slice>>			mSlices;	// one per thread
+	};
+
+	struct Task {
+		Job		*mJob;
+		size_t	mBegin, mEnd;
+	};
+
+	void	workerLoop( size_t index );
+	//! Takes a task of any job in flight, newest first.
+	bool	findTask( size_t index, Task *task );
+	//! Pops from the front of slice \a index of \a job, or steals from the back of another one.
+	static bool	takeTask( Job *job, size_t index, Task *task );
+	void	runTask( const Task &task );
+	bool	isWorkerThread() const;
+
+	size_t									mNumThreads;
+	std::vector<std::thread>				mThreads;
+
+	std::mutex								mJobsMutex;
+	std::vector<Job*>						mJobs;			// in flight, oldest first
+	std::mutex								mWakeMutex;
+	std::condition_variable					mWakeCondition;
+	std::condition_variable					mDoneCondition;
+	size_t									mGeneration;
+	bool									mQuit;
+};
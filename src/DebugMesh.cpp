@@ -21,108 +21,304 @@
 */
 
 #include "DebugMesh.h"
+#include "DeformBounds.h"
+#include "HashTable.h"
+#include "ThreadPool.h"
+
+#include "cinder/gl/gl.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
 
 using namespace ci;
-using namespace ci::geom;
 using namespace std;
 
-DebugMesh::DebugMesh(void)
-	: mColor( Color::white() )
+namespace {
+
+// vertices per task
+const size_t	GRAIN_SIZE = 16384;
+// the lines are this fraction of the largest extent of the mesh long
+const float		LINE_SCALE = 1.0f / 25.0f;
+// how long update() waits for the GPU at a time, in nanoseconds
+const GLuint64	FENCE_TIMEOUT = 1000000;
+// a sampling grid cell is identified by 21 bits per axis
+const uint64_t	CELL_MASK = ( 1ull << 21 ) - 1;
+const uint64_t	EMPTY_CELL = ~0ull;
+
+//! Picks the lowest numbered vertex in every occupied cell of a grid with its corner at \a lower and
+//! cells \a cellSize wide, so the choice does not depend on the threads. The cells go into an open
+//! addressing hash table. Returns false, with \a samples incomplete, as soon as more than \a maxSamples
+//! cells are occupied.
+bool sampleGrid( const vec3 *positions, size_t count, const vec3 &lower, float cellSize, size_t maxSamples, vector<uint32_t> *samples,
+	ThreadPool *pool )
 {
-	enable( Attrib::POSITION );
-	enable( Attrib::COLOR );
+	// once the cells overflow, every thread adds one more at most; a quarter full keeps the probes short
+	size_t maxCells = maxSamples + ( pool ? pool->getNumThreads() : 1 );
+	size_t shift, capacity = tableCapacity( 4 * maxCells - 1, &shift );
+	unique_ptr<atomic<uint64_t>[]> cells( new atomic<uint64_t>[capacity] );
+	unique_ptr<atomic<uint32_t>[]> firsts( new atomic<uint32_t>[capacity] );
+	for( size_t s = 0; s < capacity; ++s ) {
+		cells[s].store( EMPTY_CELL, memory_order_relaxed );
+		firsts[s].store( numeric_limits<uint32_t>::max(), memory_order_relaxed );
+	}
+
+	atomic<size_t> numCells( 0 );
+	atomic<bool> overflow( false );
+	const float invCellSize = 1.0f / cellSize;
+	const size_t mask = capacity - 1;
+	ThreadPool::parallelFor( pool, count, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( size_t i = begin; i < end && ! overflow.load( memory_order_relaxed ); ++i ) {
+			// not a number falls through the comparisons and is left out
+			vec3 grid = ( positions[i] - lower ) * invCellSize;
+			if( ! ( grid.x >= 0.0f && grid.y >= 0.0f && grid.z >= 0.0f ) )
+				continue;
+
+			uint64_t cell = std::min( (uint64_t) grid.x, CELL_MASK ) | std::min( (uint64_t) grid.y, CELL_MASK ) << 21
+				| std::min( (uint64_t) grid.z, CELL_MASK ) << 42;
+			size_t slot = hashSlot( cell, shift );
+			for( ;; slot = ( slot + 1 ) & mask ) {
+				uint64_t found = cells[slot].load( memory_order_relaxed );
+				if( found == EMPTY_CELL && cells[slot].compare_exchange_strong( found, cell ) ) {
+					if( numCells.fetch_add( 1 ) >= maxSamples )
+						overflow.store( true );
+					break;
+				}
+				if( found == cell )
+					break;
+			}
 
-	clear();
+			uint32_t first = firsts[slot].load( memory_order_relaxed );
+			while( i < first && ! firsts[slot].compare_exchange_weak( first, (uint32_t) i ) )
+				;
+		}
+	} );
+	if( overflow.load() )
+		return false;
+
+	samples->clear();
+	for( size_t s = 0; s < capacity; ++s )
+		if( cells[s].load( memory_order_relaxed ) != EMPTY_CELL )
+			samples->push_back( firsts[s].load( memory_order_relaxed ) );
+	std::sort( samples->begin(), samples->end() );
+	return true;
 }
 
-DebugMesh::DebugMesh(const TriMesh& mesh, const ColorA& color)
-	: mColor( color )
+//! Writes the lines of \a count vertices, grouped by kind, into \a positions. Line i starts at vertex
+//! \a vertices[i] of the mesh, or i without \a vertices, and \a tangents are indexed by that vertex.
+//! Positions and normals in \a input are \a stride floats apart and indexed the same way, or by line if
+//! \a inputPerLine; so are its tangents, which take the place of \a tangents if it has any. Without
+//! \a tangents, only the normals are written; with \a orthogonalize, the tangents are made perpendicular
+//! to the normals first.
+void writeLines( const DeformInput &input, size_t stride, bool inputPerLine, const uint32_t *vertices, const vec3 *tangents,
+	bool orthogonalize, float scale, size_t count, vec3 *positions, ThreadPool *pool )
 {
-	enable( Attrib::POSITION );
-	enable( Attrib::COLOR );
+	vec3 *normalLines = positions;
+	vec3 *tangentLines = positions + 2 * count;
+	vec3 *bitangentLines = positions + 4 * count;
+	ThreadPool::parallelFor( pool, count, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( size_t i = begin; i < end; ++i ) {
+			const size_t v = vertices ? vertices[i] : i;
+			const size_t k = ( inputPerLine ? i : v ) * stride;
+			const vec3 p( input.px[k], input.py[k], input.pz[k] ), n( input.nx[k], input.ny[k], input.nz[k] );
+			normalLines[2 * i] = p;
+			normalLines[2 * i + 1] = p + scale * n;
+			if( tangents ) {
+				vec3 t = input.tx ? vec3( input.tx[k], input.ty[k], input.tz[k] ) : tangents[v];
+				if( orthogonalize ) {
+					t -= dot( n, t ) * n;
+					float length = glm::length( t );
+					t = length > 0.0f ? t / length : t;
+				}
+				tangentLines[2 * i] = p;
+				tangentLines[2 * i + 1] = p + scale * t;
+				bitangentLines[2 * i] = p;
+				bitangentLines[2 * i + 1] = p + scale * cross( n, t );
+			}
+		}
+	} );
+}
+
+} // anonymous namespace
 
-	setMesh(mesh);
+DebugMesh::DebugMesh( const TriMeshRef &mesh, const ColorA &color, ThreadPool *pool )
+	: mMesh( mesh ), mMaxLines( 0 ), mNumLinesPerKind( 0 ), mNumKinds( 0 ), mScale( 0.0f ), mNumRegions( 0 ), mRegion( 0 ), mMapped( nullptr )
+{
+	mColors[NORMALS] = color;
+	mColors[TANGENTS] = ColorA( 1, 0, 0, 1 );
+	mColors[BITANGENTS] = ColorA( 0, 1, 0, 1 );
+	for( size_t r = 0; r < NUM_REGIONS; ++r )
+		mFences[r] = nullptr;
+
+	if( ! mesh || ! mesh->hasNormals() || ! mesh->getNumVertices() )
+		return;
+
+	mNumLinesPerKind = mesh->getNumVertices();
+	mNumKinds = mesh->hasTangents() ? NUM_KINDS : 1;
+
+	RestBounds bounds( *mesh, pool );
+	float extent = std::max( std::max( bounds.position.x.hi - bounds.position.x.lo, bounds.position.y.hi - bounds.position.y.lo ),
+		bounds.position.z.hi - bounds.position.z.lo );
+	mScale = extent * LINE_SCALE;
+	mLower = vec3( bounds.position.x.lo, bounds.position.y.lo, bounds.position.z.lo );
 }
 
-DebugMesh::~DebugMesh(void)
+DebugMesh::~DebugMesh()
 {
+	release();
 }
 
-void DebugMesh::clear()
+void DebugMesh::setMaxLines( size_t maxLines, ThreadPool *pool )
 {
+	if( maxLines == mMaxLines )
+		return;
+
+	mMaxLines = maxLines;
+	release();
 	mVertices.clear();
-	mColors.clear();
-	mIndices.clear();
+	if( ! mNumKinds )
+		return;
+
+	size_t numVertices = mMesh->getNumVertices();
+	mNumLinesPerKind = numVertices;
+	if( ! maxLines || numVertices <= maxLines )
+		return;
+
+	// each doubling of the cells leaves about a quarter of them on a surface
+	float cellSize = mScale > 0.0f ? mScale : 1.0f;
+	while( ! sampleGrid( mMesh->getPositions<3>(), numVertices, mLower, cellSize, maxLines, &mVertices, pool ) )
+		cellSize *= 2.0f;
+	mNumLinesPerKind = mVertices.size();
+}
+
+void DebugMesh::write( vec3 *positions, ThreadPool *pool ) const
+{
+	if( ! mNumKinds )
+		return;
+
+	const float *p = &mMesh->getPositions<3>()->x, *n = &mMesh->getNormals().front().x;
+	DeformInput rest = { p, p + 1, p + 2, n, n + 1, n + 2, nullptr, nullptr, nullptr, nullptr, nullptr };
+	const uint32_t *vertices = mVertices.empty() ? nullptr : mVertices.data();
+	const vec3 *tangents = mNumKinds > TANGENTS ? mMesh->getTangents().data() : nullptr;
+	writeLines( rest, 3, false, vertices, tangents, false, mScale, mNumLinesPerKind, positions, pool );
 }
 
-void DebugMesh::setMesh(const TriMesh& mesh)
+void DebugMesh::upload( ThreadPool *pool )
 {
-	clear();
+	if( ! mNumKinds )
+		return;
 
-	// check if mesh is valid and count vertices
-	if(!mesh.hasNormals())
+	allocate( 1 );
+
+	// fill the mapped storage in place; without mapping, a copy goes through bufferData
+	size_t byteSize = getByteSize();
+	vec3 *mapped = (vec3*) mVbo->mapBufferRange( 0, byteSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+	if( mapped ) {
+		write( mapped, pool );
+		mVbo->unmap();
+	}
+	else {
+		vector<vec3> positions( getNumVertices() );
+		write( positions.data(), pool );
+		mVbo->bufferData( byteSize, positions.data(), GL_STATIC_DRAW );
+	}
+}
+
+void DebugMesh::update( const DeformInput &deformed, size_t stride, bool sampled, ThreadPool *pool )
+{
+	if( ! mNumKinds )
 		return;
 
-	size_t numVertices = mesh.getNumVertices();
-	if(numVertices < 1)
+	if( mNumRegions != NUM_REGIONS )
+		allocate( NUM_REGIONS );
+
+	// everything drawn from the current region so far comes before this fence
+	if( mFences[mRegion] )
+		glDeleteSync( mFences[mRegion] );
+	mFences[mRegion] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+
+	// the next region was last drawn NUM_REGIONS - 1 updates ago, so the GPU is normally done with it
+	mRegion = ( mRegion + 1 ) % NUM_REGIONS;
+	if( mFences[mRegion] ) {
+		while( glClientWaitSync( mFences[mRegion], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT ) == GL_TIMEOUT_EXPIRED )
+			;
+		glDeleteSync( mFences[mRegion] );
+		mFences[mRegion] = nullptr;
+	}
+
+	// without a persistent mapping, map just this region; the fence already keeps it from being in use
+	size_t numVertices = getNumVertices();
+	vec3 *positions = mMapped ? mMapped + mRegion * numVertices
+		: (vec3*) mVbo->mapBufferRange( mRegion * numVertices * sizeof( vec3 ), numVertices * sizeof( vec3 ),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+	if( ! positions )
 		return;
 
-	// reserve memory to prevent reallocations
-	bool hasTangents = mesh.hasTangents();
-	size_t numEntriesPerVertex = hasTangents ? 4 : 2;
-	size_t numIndicesPerVertex = hasTangents ? 6 : 2;
-
-	mVertices.reserve( numVertices * numEntriesPerVertex );
-	mColors.reserve( numVertices * numEntriesPerVertex );
-	mIndices.reserve( numVertices * numIndicesPerVertex );
-
-	// determine the right scale, based on the bounding box
-	AxisAlignedBox3f bbox = mesh.calcBoundingBox();
-	vec3 size = bbox.getMax() - bbox.getMin();
-	float scale = math<float>::max( math<float>::max( float(size.x), float(size.y) ), float(size.z) ) / 25.0f;
-
-	// construct mesh
-	for(size_t i=0;i<numVertices;++i) {
-		uint32_t idx = mVertices.size();
-
-		mVertices.push_back( mesh.getPositions<3>()[i] );
-		mVertices.push_back( mesh.getPositions<3>()[i] + scale * mesh.getNormals()[i] );
-		
-		mColors.push_back( mColor );
-		mColors.push_back( mColor );
-		
-		mIndices.push_back( idx );
-		mIndices.push_back( idx + 1 );
-
-		if(hasTangents)
-		{
-			mVertices.push_back( mesh.getPositions<3>()[i] + scale * mesh.getTangents()[i] );
-			mVertices.push_back( mesh.getPositions<3>()[i] + scale * cross( mesh.getNormals()[i], mesh.getTangents()[i] ) );
-
-			mColors.push_back( Color(1, 0, 0) );
-			mColors.push_back( Color(0, 1, 0) );
-
-			mIndices.push_back( idx );
-			mIndices.push_back( idx + 2 );
-			mIndices.push_back( idx );
-			mIndices.push_back( idx + 3 );
-		}
+	const uint32_t *vertices = mVertices.empty() ? nullptr : mVertices.data();
+	const vec3 *tangents = mNumKinds > TANGENTS ? mMesh->getTangents().data() : nullptr;
+	writeLines( deformed, stride, sampled, vertices, tangents, true, mScale, mNumLinesPerKind, positions, pool );
+	if( ! mMapped )
+		mVbo->unmap();
+}
+
+void DebugMesh::draw()
+{
+	if( ! mNumKinds )
+		return;
+	if( ! isUploaded() )
+		upload( &ThreadPool::instance() );
+
+	// the shader takes the current color when there is no color attribute
+	for( size_t kind = 0; kind < mNumKinds; ++kind ) {
+		gl::color( mColors[kind] );
+		mBatches[mRegion][kind]->draw();
 	}
 }
 
-uint8_t DebugMesh::getAttribDims( Attrib attr ) const
+void DebugMesh::release()
 {
-	switch( attr ) {
-		case Attrib::POSITION: return 3;
-		case Attrib::COLOR: return 3;
-		default:
-			return 0;
+	for( size_t r = 0; r < NUM_REGIONS; ++r ) {
+		if( mFences[r] )
+			glDeleteSync( mFences[r] );
+		mFences[r] = nullptr;
+		for( size_t kind = 0; kind < NUM_KINDS; ++kind )
+			mBatches[r][kind].reset();
 	}
+	mVbo.reset();
+	mNumRegions = 0;
+	mRegion = 0;
+	mMapped = nullptr;
 }
 
-void DebugMesh::loadInto( Target *target ) const
+void DebugMesh::allocate( size_t numRegions )
 {
-	target->copyAttrib( Attrib::POSITION, 3, 0, reinterpret_cast<const float*>(&mVertices.front()), mVertices.size() );
-	target->copyAttrib( Attrib::COLOR, 3, 0, reinterpret_cast<const float*>(&mColors.front()), mColors.size() );
-	target->copyIndices( Primitive::LINES, &mIndices.front(), mIndices.size(), 4 );
+	release();
+	mNumRegions = numRegions;
+
+	size_t numVertices = getNumVertices();
+	size_t byteSize = numVertices * sizeof( vec3 ) * numRegions;
+#if defined( GL_MAP_PERSISTENT_BIT )
+	// keep the regions update() writes to mapped for good, where buffer storage is available
+	if( numRegions > 1 && gl::isExtensionAvailable( "GL_ARB_buffer_storage" ) ) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		mVbo = gl::Vbo::create( GL_ARRAY_BUFFER );
+		gl::ScopedBuffer scopedBuffer( mVbo );
+		glBufferStorage( GL_ARRAY_BUFFER, byteSize, nullptr, flags );
+		mMapped = (vec3*) glMapBufferRange( GL_ARRAY_BUFFER, 0, byteSize, flags );
+	}
+#endif
+	if( ! mMapped )
+		mVbo = gl::Vbo::create( GL_ARRAY_BUFFER, byteSize, nullptr, numRegions > 1 ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW );
+
+	// one batch per kind of line and region, each on its own range of the buffer
+	gl::GlslProgRef shader = gl::context()->getStockShader( gl::ShaderDef().color() );
+	for( size_t region = 0; region < numRegions; ++region ) {
+		for( size_t kind = 0; kind < mNumKinds; ++kind ) {
+			geom::BufferLayout layout;
+			layout.append( geom::Attrib::POSITION, 3, 0, ( region * numVertices + 2 * mNumLinesPerKind * kind ) * sizeof( vec3 ) );
+			vector<pair<geom::BufferLayout, gl::VboRef>> buffers( 1, make_pair( layout, mVbo ) );
+			mBatches[region][kind] = gl::Batch::create( gl::VboMesh::create( (uint32_t)( 2 * mNumLinesPerKind ), GL_LINES, buffers ), shader );
+		}
+	}
 }
@@ -0,0 +1,158 @@
+#include "DeformBounds.h"
+#include "ThreadPool.h"
+
+#include <mutex>
+#include <vector>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+// elements per task
+const size_t	GRAIN_SIZE = 65536;
+// interleaved components the SIMD reduction keeps registers for; wider data is reduced with scalars
+const size_t	MAX_COMPONENTS = 4;
+// relative growth of toBox(), about a hundred units in the last place
+const float		BOX_MARGIN = 1e-5f;
+
+//! Includes elements [\a begin, \a end) into \a ranges. A step covers \a components registers, so lane i
+//! of register r always holds component (r * width + i) % components and the lanes only need sorting
+//! out once at the end.
+template<typename V>
+void reduceRanges( const float *values, size_t begin, size_t end, size_t components, Interval *ranges )
+{
+	const float *p = values + begin * components, *last = values + end * components;
+	const size_t step = components * V::Width;
+	if( components <= MAX_COMPONENTS && (size_t)( last - p ) >= step ) {
+		V lo[MAX_COMPONENTS], hi[MAX_COMPONENTS];
+		for( size_t r = 0; r < components; ++r )
+			lo[r] = hi[r] = V::load( p + r * V::Width );
+		for( p += step; (size_t)( last - p ) >= step; p += step ) {
+			for( size_t r = 0; r < components; ++r ) {
+				V v = V::load( p + r * V::Width );
+				lo[r] = min( lo[r], v );
+				hi[r] = max( hi[r], v );
+			}
+		}
+
+		float lanesLo[V::Width], lanesHi[V::Width];
+		for( size_t r = 0; r < components; ++r ) {
+			lo[r].toArray( lanesLo );
+			hi[r].toArray( lanesHi );
+			for( int i = 0; i < V::Width; ++i )
+				ranges[( r * V::Width + i ) % components].include( Interval( lanesLo[i], lanesHi[i] ) );
+		}
+	}
+
+	for( ; p < last; p += components )
+		for( size_t c = 0; c < components; ++c )
+			ranges[c].include( Interval( p[c] ) );
+}
+
+} // anonymous namespace
+
+void sinCosBounds( Interval angle, TrigAccuracy accuracy, Interval *s, Interval *c )
+{
+	const double HALF_PI = 1.5707963267948966;
+
+	// also catches infinite and undefined angles
+	if( ! ( angle.hi - angle.lo < 4.0 * HALF_PI ) ) {
+		*s = *c = Interval( -1.0f, 1.0f );
+	}
+	else {
+		float s0 = std::sin( angle.lo ), s1 = std::sin( angle.hi ), c0 = std::cos( angle.lo ), c1 = std::cos( angle.hi );
+		*s = Interval( std::min( s0, s1 ), std::max( s0, s1 ) );
+		*c = Interval( std::min( c0, c1 ), std::max( c0, c1 ) );
+
+		// the extremes in between lie on multiples of a quarter turn
+		for( double k = std::ceil( angle.lo / HALF_PI ); k * HALF_PI <= angle.hi; ++k ) {
+			switch( ( (int64_t) k % 4 + 4 ) % 4 ) {
+				case 0: c->hi = 1.0f; break;
+				case 1: s->hi = 1.0f; break;
+				case 2: c->lo = -1.0f; break;
+				case 3: s->lo = -1.0f; break;
+			}
+		}
+	}
+
+	// see TrigAccuracy; these bound the error from the exact value, and the C library is good to about float precision
+	float error = accuracy == TRIG_FAST_1E3 ? 1e-3f : accuracy == TRIG_FAST_1E5 ? 1e-5f : 1e-7f;
+	*s = *s + Interval( -error, error );
+	*c = *c + Interval( -error, error );
+}
+
+void calcRanges( const float *values, size_t count, size_t components, Interval *ranges, ThreadPool *pool )
+{
+	for( size_t c = 0; c < components; ++c )
+		ranges[c] = Interval::empty();
+
+	// minimum and maximum do not care about the order, so the chunks are merged as they finish
+	mutex merge;
+	ThreadPool::parallelFor( pool, count, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		vector<Interval> partial( components, Interval::empty() );
+		reduceRanges<SimdFloat>( values, begin, end, components, partial.data() );
+
+		lock_guard<mutex> lock( merge );
+		for( size_t c = 0; c < components; ++c )
+			ranges[c].include( partial[c] );
+	} );
+}
+
+AxisAlignedBox3f calcPositionBounds( const VertexStreams &streams, ThreadPool *pool )
+{
+	Interval x, y, z;
+	calcRanges( streams.getStream( VertexStreams::POSITION_X ), streams.getNumVertices(), 1, &x, pool );
+	calcRanges( streams.getStream( VertexStreams::POSITION_Y ), streams.getNumVertices(), 1, &y, pool );
+	calcRanges( streams.getStream( VertexStreams::POSITION_Z ), streams.getNumVertices(), 1, &z, pool );
+	return AxisAlignedBox3f( vec3( x.lo, y.lo, z.lo ), vec3( x.hi, y.hi, z.hi ) );
+}
+
+RestBounds::RestBounds()
+	: position( Interval::empty(), Interval::empty(), Interval::empty() ), u( Interval::empty() ), v( Interval::empty() )
+{
+}
+
+RestBounds::RestBounds( const VertexStreams &rest, ThreadPool *pool )
+{
+	size_t numVertices = rest.getNumVertices();
+	calcRanges( rest.getStream( VertexStreams::POSITION_X ), numVertices, 1, &position.x, pool );
+	calcRanges( rest.getStream( VertexStreams::POSITION_Y ), numVertices, 1, &position.y, pool );
+	calcRanges( rest.getStream( VertexStreams::POSITION_Z ), numVertices, 1, &position.z, pool );
+	calcRanges( rest.getStream( VertexStreams::TEX_COORD_U ), numVertices, 1, &u, pool );
+	calcRanges( rest.getStream( VertexStreams::TEX_COORD_V ), numVertices, 1, &v, pool );
+}
+
+RestBounds::RestBounds( const TriMesh &rest, ThreadPool *pool )
+{
+	size_t numVertices = rest.getNumVertices();
+	Interval ranges[MAX_COMPONENTS];
+
+	// missing components are zero, as in VertexStreams
+	size_t dims = rest.getAttribDims( geom::Attrib::POSITION );
+	calcRanges( (const float*) rest.getPositions<3>(), numVertices, dims, ranges, pool );
+	position.x = ranges[0];
+	position.y = ranges[1];
+	position.z = dims >= 3 ? ranges[2] : Interval( 0.0f );
+
+	dims = rest.getAttribDims( geom::Attrib::TEX_COORD_0 );
+	if( dims >= 2 ) {
+		calcRanges( rest.getBufferTexCoords0().data(), numVertices, dims, ranges, pool );
+		u = ranges[0];
+		v = ranges[1];
+	}
+	else
+		u = v = numVertices ? Interval( 0.0f ) : Interval::empty();
+}
+
+AxisAlignedBox3f toBox( const kernels::Vec3<Interval> &bounds )
+{
+	const Interval *axes[] = { &bounds.x, &bounds.y, &bounds.z };
+	vec3 lower, upper;
+	for( int a = 0; a < 3; ++a ) {
+		float margin = BOX_MARGIN * std::max( std::fabs( axes[a]->lo ), std::fabs( axes[a]->hi ) ) + numeric_limits<float>::min();
+		lower[a] = axes[a]->lo - margin;
+		upper[a] = axes[a]->hi + margin;
+	}
+	return AxisAlignedBox3f( lower, upper );
+}
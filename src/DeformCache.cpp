@@ -0,0 +1,260 @@
+#include "DeformCache.h"
+#include "DeformBounds.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const char kMagic[8] = { 'X', 'F', 'R', 'M', 'C', 'A', 'C', 'H' };
+const size_t NO_FRAME = (size_t) -1;
+
+size_t alignUp( size_t size, size_t alignment )
+{
+	return ( size + alignment - 1 ) / alignment * alignment;
+}
+
+void interleave( const VertexStreams &deformed, float *out )
+{
+	const float *px = deformed.getStream( VertexStreams::POSITION_X ), *py = deformed.getStream( VertexStreams::POSITION_Y ), *pz = deformed.getStream( VertexStreams::POSITION_Z );
+	const float *nx = deformed.getStream( VertexStreams::NORMAL_X ), *ny = deformed.getStream( VertexStreams::NORMAL_Y ), *nz = deformed.getStream( VertexStreams::NORMAL_Z );
+	for( size_t v = 0; v < deformed.getNumVertices(); ++v, out += DeformCache::FLOATS_PER_VERTEX ) {
+		out[0] = px[v];
+		out[1] = py[v];
+		out[2] = pz[v];
+		out[3] = nx[v];
+		out[4] = ny[v];
+		out[5] = nz[v];
+	}
+}
+
+} // anonymous namespace
+
+void DeformCache::bake( const string &path, const Deformer &deformer, const VertexStreams &rest, float startTime, float endTime,
+	float frameRate, ThreadPool *pool, const AnimateFn &animate, Encoding encoding, uint32_t keyFrameInterval )
+{
+	if( frameRate <= 0 || endTime <= startTime || rest.getNumVertices() == 0 )
+		throw DeformCacheExc( path, "nothing to bake" );
+
+	size_t numVertices = rest.getNumVertices();
+	size_t numFrames = (size_t) std::ceil( ( endTime - startTime ) * frameRate );
+	size_t frameSize = numVertices * VERTEX_STRIDE;
+	size_t indexEnd = sizeof( Header ) + numFrames * sizeof( FrameEntry );
+
+	const DeformParams &params = deformer.getParams();
+	Header header;
+	memset( &header, 0, sizeof( Header ) );
+	memcpy( header.magic, kMagic, sizeof( kMagic ) );
+	header.version = VERSION;
+	header.encoding = encoding;
+	header.numVertices = (uint32_t) numVertices;
+	header.numFrames = (uint32_t) numFrames;
+	header.startTime = startTime;
+	header.frameRate = frameRate;
+	header.frameIndexOffset = sizeof( Header );
+	header.deformerType = deformer.getType();
+	header.angleDegMax = params.angleDegMax;
+	header.height = params.height;
+	header.centerPoint[0] = params.centerPoint.x;
+	header.centerPoint[1] = params.centerPoint.y;
+	header.centerPoint[2] = params.centerPoint.z;
+	header.xlim = params.xlim;
+	header.ylim = params.ylim;
+	header.zlim = params.zlim;
+	header.move = params.move;
+	header.flag = params.flag ? 1 : 0;
+
+	// the rest invariants only depend on parameters that stay fixed over the sequence
+	Deformer frameDeformer( deformer );
+	frameDeformer.bake( rest );
+
+	VertexStreams deformed;
+	auto deformFrame = [&]( size_t frame ) -> float {
+		float time = startTime + frame / frameRate;
+
+		DeformParams frameParams = params;
+		frameParams.elapsedSeconds = time;
+		if( animate )
+			animate( time, &frameParams );
+		frameDeformer.setParams( frameParams );
+
+		if( pool )
+			frameDeformer.apply( rest, &deformed, *pool );
+		else
+			frameDeformer.apply( rest, &deformed );
+		return time;
+	};
+
+	string tempPath = path + ".part";
+	{
+		MappedFileRef file;
+		if( encoding == ENCODING_FLOAT32 ) {
+			// frames go straight into the mapping
+			size_t frameStride = alignUp( frameSize, FRAME_ALIGNMENT );
+			size_t dataOffset = alignUp( indexEnd, FRAME_ALIGNMENT );
+			file = MappedFile::create( tempPath, dataOffset + numFrames * frameStride );
+
+			uint8_t *data = file->getData();
+			memcpy( data, &header, sizeof( Header ) );
+			FrameEntry *frames = reinterpret_cast<FrameEntry*>( data + header.frameIndexOffset );
+			for( size_t i = 0; i < numFrames; ++i ) {
+				FrameEntry &entry = frames[i];
+				entry.time = deformFrame( i );
+				entry.offset = dataOffset + i * frameStride;
+				entry.size = frameSize;
+				entry.prediction = DeformCodec::PREDICT_NONE;
+				interleave( deformed, reinterpret_cast<float*>( data + entry.offset ) );
+			}
+		}
+		else {
+			// the quantization grid spans all frames, so find their bounds first
+			vec3 boundsMin( numeric_limits<float>::max() ), boundsMax( -numeric_limits<float>::max() );
+			for( size_t i = 0; i < numFrames; ++i ) {
+				deformFrame( i );
+				AxisAlignedBox3f bounds = calcPositionBounds( deformed, pool );
+				boundsMin = glm::min( boundsMin, bounds.getMin() );
+				boundsMax = glm::max( boundsMax, bounds.getMax() );
+			}
+
+			for( int c = 0; c < 3; ++c ) {
+				header.boundsMin[c] = boundsMin[c];
+				header.boundsMax[c] = boundsMax[c];
+			}
+			header.keyFrameInterval = max<uint32_t>( keyFrameInterval, 1 );
+
+			DeformCodec codec( numVertices, boundsMin, boundsMax );
+			vector<FrameEntry> frames( numFrames );
+			vector<uint8_t> encoded;
+			vector<float> interleaved( numVertices * FLOATS_PER_VERTEX );
+			size_t dataOffset = alignUp( indexEnd, 16 );
+			for( size_t i = 0; i < numFrames; ++i ) {
+				FrameEntry &entry = frames[i];
+				entry.time = deformFrame( i );
+				interleave( deformed, interleaved.data() );
+
+				size_t offset = encoded.size();
+				DeformCodec::Prediction prediction = i % header.keyFrameInterval ? DeformCodec::PREDICT_LINEAR : DeformCodec::PREDICT_NONE;
+				entry.prediction = codec.encode( interleaved.data(), prediction, &encoded );
+				entry.offset = dataOffset + offset;
+				entry.size = encoded.size() - offset;
+			}
+
+			file = MappedFile::create( tempPath, dataOffset + encoded.size() );
+			uint8_t *data = file->getData();
+			memcpy( data, &header, sizeof( Header ) );
+			memcpy( data + header.frameIndexOffset, frames.data(), numFrames * sizeof( FrameEntry ) );
+			memcpy( data + dataOffset, encoded.data(), encoded.size() );
+		}
+
+		file->flush();
+	}
+
+	// rename() does not replace an existing file on Windows
+	remove( path.c_str() );
+	if( rename( tempPath.c_str(), path.c_str() ) != 0 ) {
+		remove( tempPath.c_str() );
+		throw DeformCacheExc( path, "could not move the baked cache into place" );
+	}
+}
+
+DeformCacheRef DeformCache::open( const string &path )
+{
+	return DeformCacheRef( new DeformCache( MappedFile::open( path ) ) );
+}
+
+DeformCache::DeformCache( const MappedFileRef &file )
+	: mFile( file ), mHeader( nullptr ), mFrames( nullptr ), mDecodedFrame( NO_FRAME )
+{
+	const string &path = mFile->getPath();
+	const uint8_t *data = mFile->getData();
+	size_t size = mFile->getSize();
+
+	if( size < sizeof( Header ) || memcmp( data, kMagic, sizeof( kMagic ) ) != 0 )
+		throw DeformCacheExc( path, "not a deformation cache" );
+
+	mHeader = reinterpret_cast<const Header*>( data );
+	if( mHeader->version != VERSION )
+		throw DeformCacheExc( path, "unsupported version" );
+	if( mHeader->encoding > ENCODING_QUANTIZED )
+		throw DeformCacheExc( path, "unsupported encoding" );
+	if( mHeader->numFrames == 0 || mHeader->numVertices == 0 || ! ( mHeader->frameRate > 0 ) )
+		throw DeformCacheExc( path, "empty cache" );
+	if( mHeader->frameIndexOffset % sizeof( uint64_t ) != 0
+		|| mHeader->frameIndexOffset > size || ( size - mHeader->frameIndexOffset ) / sizeof( FrameEntry ) < mHeader->numFrames )
+		throw DeformCacheExc( path, "frame index out of bounds" );
+
+	mFrames = reinterpret_cast<const FrameEntry*>( data + mHeader->frameIndexOffset );
+	for( size_t i = 0; i < mHeader->numFrames; ++i ) {
+		const FrameEntry &entry = mFrames[i];
+		if( entry.offset > size || size - entry.offset < entry.size )
+			throw DeformCacheExc( path, "frame data out of bounds" );
+
+		if( getEncoding() == ENCODING_FLOAT32 ) {
+			if( entry.size != getFrameSize() || entry.offset % sizeof( float ) != 0 || entry.prediction != DeformCodec::PREDICT_NONE )
+				throw DeformCacheExc( path, "invalid frame" );
+		}
+		else if( entry.prediction > DeformCodec::PREDICT_LINEAR || ( i == 0 && entry.prediction != DeformCodec::PREDICT_NONE ) )
+			throw DeformCacheExc( path, "invalid frame" );
+	}
+
+	if( getEncoding() == ENCODING_QUANTIZED ) {
+		vec3 boundsMin( mHeader->boundsMin[0], mHeader->boundsMin[1], mHeader->boundsMin[2] );
+		vec3 boundsMax( mHeader->boundsMax[0], mHeader->boundsMax[1], mHeader->boundsMax[2] );
+		mCodec.reset( new DeformCodec( getNumVertices(), boundsMin, boundsMax ) );
+		mDecoded.resize( getNumVertices() * FLOATS_PER_VERTEX );
+	}
+}
+
+size_t DeformCache::getFrameIndex( float time, bool loop ) const
+{
+	double frame = std::floor( ( time - getStartTime() ) * (double) getFrameRate() );
+	double numFrames = (double) getNumFrames();
+
+	if( loop )
+		frame -= std::floor( frame / numFrames ) * numFrames;
+	else
+		frame = std::max( 0.0, std::min( frame, numFrames - 1 ) );
+
+	return std::min( (size_t) frame, getNumFrames() - 1 );
+}
+
+const float* DeformCache::readFrame( size_t frame )
+{
+	if( getEncoding() == ENCODING_FLOAT32 )
+		return reinterpret_cast<const float*>( mFile->getData() + mFrames[frame].offset );
+
+	if( frame == mDecodedFrame )
+		return mDecoded.data();
+
+	// continue from the last decoded frame if there is no key frame in between
+	size_t first = frame;
+	while( mFrames[first].prediction != DeformCodec::PREDICT_NONE )
+		--first;
+	if( mDecodedFrame != NO_FRAME && mDecodedFrame >= first && mDecodedFrame < frame )
+		first = mDecodedFrame + 1;
+
+	mDecodedFrame = NO_FRAME;
+	for( size_t i = first; i <= frame; ++i ) {
+		const FrameEntry &entry = mFrames[i];
+		if( ! mCodec->decode( mFile->getData() + entry.offset, (size_t) entry.size, static_cast<DeformCodec::Prediction>( entry.prediction ), i == frame ? mDecoded.data() : nullptr ) )
+			throw DeformCacheExc( mFile->getPath(), "corrupt frame data" );
+	}
+
+	mDecodedFrame = frame;
+	return mDecoded.data();
+}
+
+size_t DeformCache::getStoredSize() const
+{
+	size_t size = 0;
+	for( size_t i = 0; i < getNumFrames(); ++i )
+		size += (size_t) mFrames[i].size;
+	return size;
+}
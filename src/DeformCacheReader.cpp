@@ -0,0 +1,166 @@
+#include "DeformCacheReader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+DeformCacheReader::DeformCacheReader( const DeformCacheRef &cache, size_t readAhead, DropPolicy dropPolicy, bool loop )
+	: mCache( cache ), mDropPolicy( dropPolicy ), mLoop( loop ), mSlots( max<size_t>( readAhead, 1 ) + 1 ),
+	mWritePosition( 0 ), mReadPosition( 0 ), mWantedFrame( 0 ), mSeekFrame( 0 ), mSeekGeneration( 0 ), mQuit( false ), mFramesRead( 0 ),
+	mHolding( false ), mStarted( false ), mShownFrame( -1 ), mGeneration( 0 ), mFramesShown( 0 ), mFramesDropped( 0 ), mStalls( 0 )
+{
+	for( size_t i = 0; i < mSlots.size(); ++i ) {
+		mSlots[i].mData.resize( mCache->getNumVertices() * DeformCache::FLOATS_PER_VERTEX );
+		mSlots[i].mFrame = -1;
+		mSlots[i].mGeneration = 0;
+	}
+
+	mCache->getFile()->advise( 0, mCache->getFile()->getSize(), MappedFile::ADVISE_SEQUENTIAL );
+	mThread = thread( &DeformCacheReader::readLoop, this );
+}
+
+DeformCacheReader::~DeformCacheReader()
+{
+	mQuit = true;
+	mWakeUp.notify_all();
+	mThread.join();
+}
+
+size_t DeformCacheReader::getCacheFrame( int64_t frame ) const
+{
+	int64_t numFrames = (int64_t) mCache->getNumFrames();
+	if( mLoop )
+		return (size_t)( ( frame % numFrames + numFrames ) % numFrames );
+	else
+		return (size_t) min( max<int64_t>( frame, 0 ), numFrames - 1 );
+}
+
+void DeformCacheReader::prefetch( int64_t frame ) const
+{
+	const DeformCache::FrameEntry &entry = mCache->getFrameEntry( getCacheFrame( frame ) );
+	mCache->getFile()->advise( (size_t) entry.offset, (size_t) entry.size, MappedFile::ADVISE_WILL_NEED );
+}
+
+void DeformCacheReader::readLoop()
+{
+	uint32_t generation = mSeekGeneration.load( memory_order_acquire );
+	int64_t next = mSeekFrame.load( memory_order_relaxed );
+	int64_t prefetched = next - 1;
+
+	while( ! mQuit ) {
+		uint32_t seekGeneration = mSeekGeneration.load( memory_order_acquire );
+		if( seekGeneration != generation ) {
+			generation = seekGeneration;
+			next = mSeekFrame.load( memory_order_relaxed );
+			prefetched = next - 1;
+		}
+		else if( mDropPolicy == DROP_FRAMES )
+			next = max( next, mWantedFrame.load( memory_order_relaxed ) );
+
+		uint64_t write = mWritePosition.load( memory_order_relaxed );
+		bool full = write - mReadPosition.load( memory_order_acquire ) >= mSlots.size();
+		bool finished = ! mLoop && next >= (int64_t) mCache->getNumFrames();
+		if( full || finished ) {
+			unique_lock<mutex> lock( mMutex );
+			mWakeUp.wait_for( lock, chrono::milliseconds( 2 ) );
+			continue;
+		}
+
+		// keep the system reading the stored data a full ring ahead of the decoder
+		prefetched = max( prefetched, next - 1 );
+		while( prefetched < next + (int64_t) mSlots.size() )
+			prefetch( ++prefetched );
+
+		size_t cacheFrame = getCacheFrame( next );
+		Slot &slot = mSlots[write % mSlots.size()];
+		try {
+			memcpy( slot.mData.data(), mCache->readFrame( cacheFrame ), mCache->getFrameSize() );
+		}
+		catch( const exception & ) {
+			// corrupt data; playback keeps showing the last good frame
+			break;
+		}
+		slot.mFrame = next;
+		slot.mGeneration = generation;
+		mWritePosition.store( write + 1, memory_order_release );
+		mFramesRead.fetch_add( 1, memory_order_relaxed );
+
+		// the frame is decoded, so its pages can go; a loop that fits in memory finds them in the page cache
+		const DeformCache::FrameEntry &entry = mCache->getFrameEntry( cacheFrame );
+		mCache->getFile()->advise( (size_t) entry.offset, (size_t) entry.size, MappedFile::ADVISE_DONT_NEED );
+		++next;
+	}
+}
+
+const float* DeformCacheReader::update( float time )
+{
+	int64_t wanted = (int64_t) floor( ( time - mCache->getStartTime() ) * (double) mCache->getFrameRate() );
+	if( ! mLoop )
+		wanted = min( max<int64_t>( wanted, 0 ), (int64_t) mCache->getNumFrames() - 1 );
+
+	// the caller is done with the frame handed out last time
+	uint64_t read = mReadPosition.load( memory_order_relaxed );
+	if( mHolding ) {
+		mReadPosition.store( ++read, memory_order_release );
+		mHolding = false;
+	}
+
+	// on the first call, or if the clock went backwards, restart the reader at the wanted frame
+	if( ! mStarted || wanted < mShownFrame ) {
+		mStarted = true;
+		mShownFrame = wanted - 1;
+		mSeekFrame.store( wanted, memory_order_relaxed );
+		mSeekGeneration.store( ++mGeneration, memory_order_release );
+	}
+	mWantedFrame.store( wanted, memory_order_relaxed );
+	mWakeUp.notify_one();
+
+	// pick the latest ready frame not past the clock (or just the next one when keeping all frames)
+	uint64_t write = mWritePosition.load( memory_order_acquire );
+	uint64_t best = write, position = read;
+	for( ; position < write; ++position ) {
+		const Slot &slot = mSlots[position % mSlots.size()];
+		if( slot.mGeneration != mGeneration )
+			continue;
+		if( slot.mFrame > wanted )
+			break;
+
+		best = position;
+		if( mDropPolicy == KEEP_FRAMES )
+			break;
+	}
+
+	if( best == write ) {
+		// nothing new; the slots skipped so far were read before the last seek
+		mReadPosition.store( position, memory_order_release );
+		if( mShownFrame < wanted )
+			++mStalls;
+		return nullptr;
+	}
+
+	// release everything before the chosen frame and hold on to it until the next call
+	const Slot &slot = mSlots[best % mSlots.size()];
+	mReadPosition.store( best, memory_order_release );
+	mHolding = true;
+
+	if( slot.mFrame > mShownFrame + 1 )
+		mFramesDropped += slot.mFrame - mShownFrame - 1;
+	if( slot.mFrame < wanted )
+		++mStalls;
+	mShownFrame = slot.mFrame;
+	++mFramesShown;
+	return slot.mData.data();
+}
+
+DeformCacheReader::Stats DeformCacheReader::getStats() const
+{
+	Stats stats;
+	stats.framesRead = mFramesRead.load( memory_order_relaxed );
+	stats.framesShown = mFramesShown;
+	stats.framesDropped = mFramesDropped;
+	stats.stalls = mStalls;
+	return stats;
+}
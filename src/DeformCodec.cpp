@@ -0,0 +1,293 @@
+#include "DeformCodec.h"
+#include "SimdMath.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+// A block is packed as NUM_LANES interleaved bit streams, one per 16-bit lane of an SSE register.
+// Value i of the block goes to lane i % NUM_LANES, so unpacking one register's worth of values yields
+// NUM_LANES consecutive values.
+const size_t NUM_LANES = 8;
+const size_t VALUES_PER_LANE = DeformCodec::BLOCK_SIZE / NUM_LANES;
+const size_t BLOCK_VALUES = DeformCodec::NUM_COMPONENTS * DeformCodec::BLOCK_SIZE;
+
+const float OCTAHEDRAL_SCALE = 32767.0f;
+
+inline uint16_t zigzag( uint16_t delta )
+{
+	return (uint16_t)( ( delta << 1 ) ^ ( (int16_t) delta >> 15 ) );
+}
+
+inline uint16_t unzigzag( uint16_t value )
+{
+	return (uint16_t)( ( value >> 1 ) ^ -( value & 1 ) );
+}
+
+inline uint16_t predict( DeformCodec::Prediction prediction, uint16_t previous, uint16_t beforePrevious )
+{
+	switch( prediction ) {
+		case DeformCodec::PREDICT_PREVIOUS: return previous;
+		case DeformCodec::PREDICT_LINEAR: return (uint16_t)( 2 * previous - beforePrevious );
+		default: return 0;
+	}
+}
+
+//! Packs \a values with the smallest width that fits all of them: one byte width, then width 16-bit
+//! words per lane, word by word.
+void packBlock( const uint16_t *values, vector<uint8_t> *out )
+{
+	uint32_t all = 0;
+	for( size_t i = 0; i < DeformCodec::BLOCK_SIZE; ++i )
+		all |= values[i];
+
+	uint32_t width = 0;
+	while( all >> width )
+		++width;
+
+	out->push_back( (uint8_t) width );
+	size_t offset = out->size();
+	out->resize( offset + width * NUM_LANES * sizeof( uint16_t ), 0 );
+	uint8_t *packed = &( *out )[offset];
+
+	for( size_t lane = 0; lane < NUM_LANES; ++lane ) {
+		uint32_t bit = 0;
+		for( size_t k = 0; k < VALUES_PER_LANE; ++k, bit += width ) {
+			// spread over two words if needed; the bits shifted past 16 belong to the next word
+			uint32_t value = (uint32_t) values[k * NUM_LANES + lane] << ( bit % 16 );
+			for( uint32_t word = bit / 16; value; ++word, value >>= 16 ) {
+				uint8_t *p = packed + ( word * NUM_LANES + lane ) * sizeof( uint16_t );
+				p[0] |= (uint8_t)( value );
+				p[1] |= (uint8_t)( value >> 8 );
+			}
+		}
+	}
+}
+
+//! Reads the width byte of the block at \a data. Returns the size of the packed values after it, or
+//! -1 if the block is malformed or runs past \a end.
+inline ptrdiff_t blockSize( const uint8_t *data, const uint8_t *end, uint32_t *width )
+{
+	if( data == end || *data > 16 )
+		return -1;
+
+	*width = *data;
+	ptrdiff_t size = *width * NUM_LANES * sizeof( uint16_t );
+	return end - data - 1 >= size ? size : -1;
+}
+
+#if defined( TRANSFORM_SIMD_SSE )
+
+//! Unpacks the block at \a packed and combines the residuals with the prediction from \a previous and
+//! \a beforePrevious. The result overwrites \a beforePrevious.
+void unpackBlock( const uint8_t *packed, uint32_t width, DeformCodec::Prediction prediction, const uint16_t *previous, uint16_t *beforePrevious )
+{
+	const __m128i *words = reinterpret_cast<const __m128i*>( packed );
+	const __m128i mask = _mm_set1_epi16( (short)( ( 1u << width ) - 1 ) );
+	const __m128i one = _mm_set1_epi16( 1 ), zero = _mm_setzero_si128();
+
+	__m128i word = width ? _mm_loadu_si128( words ) : zero;
+	uint32_t bit = 0, index = 0;
+	for( size_t k = 0; k < VALUES_PER_LANE; ++k ) {
+		__m128i value = _mm_srl_epi16( word, _mm_cvtsi32_si128( bit ) );
+		bit += width;
+		if( bit >= 16 && k + 1 < VALUES_PER_LANE ) {
+			word = _mm_loadu_si128( words + ++index );
+			bit -= 16;
+			if( bit )
+				value = _mm_or_si128( value, _mm_sll_epi16( word, _mm_cvtsi32_si128( width - bit ) ) );
+		}
+		value = _mm_and_si128( value, mask );
+
+		__m128i *out = reinterpret_cast<__m128i*>( beforePrevious + k * NUM_LANES );
+		if( prediction != DeformCodec::PREDICT_NONE ) {
+			__m128i delta = _mm_xor_si128( _mm_srli_epi16( value, 1 ), _mm_sub_epi16( zero, _mm_and_si128( value, one ) ) );
+			__m128i base = _mm_loadu_si128( reinterpret_cast<const __m128i*>( previous + k * NUM_LANES ) );
+			if( prediction == DeformCodec::PREDICT_LINEAR )
+				base = _mm_sub_epi16( _mm_add_epi16( base, base ), _mm_loadu_si128( out ) );
+			value = _mm_add_epi16( base, delta );
+		}
+		_mm_storeu_si128( out, value );
+	}
+}
+
+#else
+
+inline uint32_t readWord( const uint8_t *packed, uint32_t word, size_t lane )
+{
+	const uint8_t *p = packed + ( word * NUM_LANES + lane ) * sizeof( uint16_t );
+	return p[0] | ( p[1] << 8 );
+}
+
+void unpackBlock( const uint8_t *packed, uint32_t width, DeformCodec::Prediction prediction, const uint16_t *previous, uint16_t *beforePrevious )
+{
+	const uint32_t mask = ( 1u << width ) - 1;
+
+	for( size_t lane = 0; lane < NUM_LANES; ++lane ) {
+		uint32_t bit = 0;
+		for( size_t k = 0; k < VALUES_PER_LANE; ++k, bit += width ) {
+			uint32_t word = bit / 16, shift = bit % 16;
+			uint32_t value = readWord( packed, word, lane ) >> shift;
+			if( shift + width > 16 )
+				value |= readWord( packed, word + 1, lane ) << ( 16 - shift );
+			value &= mask;
+
+			size_t i = k * NUM_LANES + lane;
+			if( prediction != DeformCodec::PREDICT_NONE )
+				value = (uint16_t)( predict( prediction, previous[i], beforePrevious[i] ) + unzigzag( (uint16_t) value ) );
+			beforePrevious[i] = (uint16_t) value;
+		}
+	}
+}
+
+#endif
+
+//! Positions and normals of one block in structure-of-arrays form.
+template<typename V>
+void dequantizeBlock( const uint16_t *quantized, const vec3 &boundsMin, const vec3 &scale, float *out )
+{
+	float values[DeformCodec::NUM_COMPONENTS][DeformCodec::BLOCK_SIZE];
+	for( size_t c = 0; c < 3; ++c )
+		for( size_t i = 0; i < DeformCodec::BLOCK_SIZE; ++i )
+			values[c][i] = (float) quantized[c * DeformCodec::BLOCK_SIZE + i];
+	for( size_t c = 3; c < DeformCodec::NUM_COMPONENTS; ++c )
+		for( size_t i = 0; i < DeformCodec::BLOCK_SIZE; ++i )
+			values[c][i] = (float)(int16_t) quantized[c * DeformCodec::BLOCK_SIZE + i];
+
+	const size_t n = DeformCodec::BLOCK_SIZE;
+	for( size_t i = 0; i < n; i += V::Width ) {
+		( V( boundsMin.x ) + V::load( &values[0][i] ) * V( scale.x ) ).store( &out[0 * n + i] );
+		( V( boundsMin.y ) + V::load( &values[1][i] ) * V( scale.y ) ).store( &out[1 * n + i] );
+		( V( boundsMin.z ) + V::load( &values[2][i] ) * V( scale.z ) ).store( &out[2 * n + i] );
+
+		// unfold the octahedron: points outside the center diamond map to the lower hemisphere
+		V u = V::load( &values[3][i] ) * V( 1.0f / OCTAHEDRAL_SCALE );
+		V v = V::load( &values[4][i] ) * V( 1.0f / OCTAHEDRAL_SCALE );
+		V z = V( 1.0f ) - abs( u ) - abs( v );
+		V t = max( -z, V( 0.0f ) );
+		V x = u - copySign( t, u );
+		V y = v - copySign( t, v );
+		V invLength = V( 1.0f ) / sqrt( x * x + y * y + z * z );
+		( x * invLength ).store( &out[3 * n + i] );
+		( y * invLength ).store( &out[4 * n + i] );
+		( z * invLength ).store( &out[5 * n + i] );
+	}
+}
+
+} // anonymous namespace
+
+DeformCodec::DeformCodec( size_t numVertices, const vec3 &boundsMin, const vec3 &boundsMax )
+	: mNumVertices( numVertices ), mNumBlocks( ( numVertices + BLOCK_SIZE - 1 ) / BLOCK_SIZE ), mBoundsMin( boundsMin ),
+	mScale( ( boundsMax - boundsMin ) / 65535.0f ), mHistory( 0 )
+{
+	mPrevious.resize( mNumBlocks * BLOCK_VALUES, 0 );
+	mBeforePrevious.resize( mNumBlocks * BLOCK_VALUES, 0 );
+}
+
+float DeformCodec::getPositionTolerance() const
+{
+	return 0.5f * length( mScale );
+}
+
+void DeformCodec::quantize( const float *frame, uint16_t *quantized ) const
+{
+	vec3 invScale( mScale.x > 0 ? 1.0f / mScale.x : 0.0f, mScale.y > 0 ? 1.0f / mScale.y : 0.0f, mScale.z > 0 ? 1.0f / mScale.z : 0.0f );
+
+	for( size_t v = 0; v < mNumVertices; ++v, frame += FLOATS_PER_VERTEX ) {
+		uint16_t *q = quantized + v / BLOCK_SIZE * BLOCK_VALUES + v % BLOCK_SIZE;
+
+		for( int c = 0; c < 3; ++c ) {
+			float steps = floor( ( frame[c] - mBoundsMin[c] ) * invScale[c] + 0.5f );
+			q[c * BLOCK_SIZE] = (uint16_t) min( max( steps, 0.0f ), 65535.0f );
+		}
+
+		// project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper one
+		vec3 n( frame[3], frame[4], frame[5] );
+		float sum = abs( n.x ) + abs( n.y ) + abs( n.z );
+		vec2 oct = sum > 0 ? vec2( n.x, n.y ) / sum : vec2( 0 );
+		if( n.z < 0 )
+			oct = vec2( ( 1.0f - abs( oct.y ) ) * ( oct.x >= 0 ? 1.0f : -1.0f ), ( 1.0f - abs( oct.x ) ) * ( oct.y >= 0 ? 1.0f : -1.0f ) );
+		for( int c = 0; c < 2; ++c )
+			q[( 3 + c ) * BLOCK_SIZE] = (uint16_t)(int16_t) floor( min( max( oct[c], -1.0f ), 1.0f ) * OCTAHEDRAL_SCALE + 0.5f );
+	}
+}
+
+void DeformCodec::dequantize( const uint16_t *quantized, float *frame ) const
+{
+	float block[FLOATS_PER_VERTEX * BLOCK_SIZE];
+
+	for( size_t b = 0; b < mNumBlocks; ++b ) {
+		dequantizeBlock<SimdFloat>( quantized + b * BLOCK_VALUES, mBoundsMin, mScale, block );
+
+		size_t begin = b * BLOCK_SIZE, end = min( begin + BLOCK_SIZE, mNumVertices );
+		float *out = frame + begin * FLOATS_PER_VERTEX;
+		for( size_t i = 0; i < end - begin; ++i, out += FLOATS_PER_VERTEX )
+			for( size_t c = 0; c < FLOATS_PER_VERTEX; ++c )
+				out[c] = block[c * BLOCK_SIZE + i];
+	}
+}
+
+DeformCodec::Prediction DeformCodec::encode( const float *frame, Prediction prediction, vector<uint8_t> *out )
+{
+	if( prediction == PREDICT_LINEAR && mHistory < 2 )
+		prediction = PREDICT_PREVIOUS;
+	if( prediction == PREDICT_PREVIOUS && mHistory < 1 )
+		prediction = PREDICT_NONE;
+
+	vector<uint16_t> quantized( mPrevious.size(), 0 );
+	quantize( frame, quantized.data() );
+
+	uint16_t residuals[BLOCK_SIZE];
+	for( size_t block = 0; block < mNumBlocks * NUM_COMPONENTS; ++block ) {
+		size_t offset = block * BLOCK_SIZE;
+		for( size_t i = 0; i < BLOCK_SIZE; ++i ) {
+			uint16_t value = quantized[offset + i];
+			if( prediction != PREDICT_NONE )
+				value = zigzag( (uint16_t)( value - predict( prediction, mPrevious[offset + i], mBeforePrevious[offset + i] ) ) );
+			residuals[i] = value;
+		}
+		packBlock( residuals, out );
+	}
+
+	mBeforePrevious.swap( mPrevious );
+	mPrevious.swap( quantized );
+	mHistory = prediction == PREDICT_NONE ? 1 : min<size_t>( mHistory + 1, 2 );
+	return prediction;
+}
+
+bool DeformCodec::decode( const uint8_t *data, size_t size, Prediction prediction, float *frame )
+{
+	if( ( prediction == PREDICT_LINEAR && mHistory < 2 ) || ( prediction == PREDICT_PREVIOUS && mHistory < 1 ) || prediction > PREDICT_LINEAR )
+		return false;
+
+	// the decoded values replace the oldest frame, which the linear prediction reads element by element first
+	const uint8_t *end = data + size;
+	for( size_t block = 0; block < mNumBlocks * NUM_COMPONENTS; ++block ) {
+		uint32_t width;
+		ptrdiff_t packedSize = blockSize( data, end, &width );
+		if( packedSize < 0 ) {
+			mHistory = 0;
+			return false;
+		}
+
+		size_t offset = block * BLOCK_SIZE;
+		unpackBlock( data + 1, width, prediction, &mPrevious[offset], &mBeforePrevious[offset] );
+		data += 1 + packedSize;
+	}
+
+	if( data != end ) {
+		mHistory = 0;
+		return false;
+	}
+
+	mBeforePrevious.swap( mPrevious );
+	mHistory = prediction == PREDICT_NONE ? 1 : min<size_t>( mHistory + 1, 2 );
+
+	if( frame )
+		dequantize( mPrevious.data(), frame );
+	return true;
+}
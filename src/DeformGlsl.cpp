@@ -0,0 +1,319 @@
+#include "DeformGlsl.h"
+
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+//! What uberVertexShader() knows about each DeformGlsl::StageType: the #define guarding its functions,
+//! the function running it, the one computing its invariant, if any, and the other types whose functions
+//! it calls (one bit per type).
+const struct {
+	const char	*feature;
+	const char	*function;
+	const char	*invariant;
+	uint32_t	calls;
+} sStageTypes[] = {
+	{ nullptr, nullptr, nullptr, 0 },
+	{ "USE_TWIST", "twistStage", "twistInvariant", 0 },
+	{ "USE_STRETCH", "stretchStage", "stretchInvariant", 0 },
+	{ "USE_SPHERE", "sphereStage", nullptr, 0 },
+	{ "USE_PLANE_MORPH", "planeMorphStage", nullptr, 0 },
+	{ "USE_TWIST_BRANCH", "twistBranchStage", nullptr, 1u << DeformGlsl::TWIST },
+	{ "USE_TWIST_STRETCH_BRANCH", "twistStretchBranchStage", nullptr, ( 1u << DeformGlsl::TWIST ) | ( 1u << DeformGlsl::STRETCH ) }
+};
+
+} // anonymous namespace
+
+uint32_t DeformGlsl::permutation( const StageType *stages, size_t count )
+{
+	uint32_t bits = 0;
+	for( size_t s = 0; s < count && s < MAX_STAGES; ++s )
+		bits |= (uint32_t) stages[s] << ( s * STAGE_BITS );
+	return bits;
+}
+
+string DeformGlsl::defines( uint32_t permutation )
+{
+	const uint32_t mask = ( 1u << STAGE_BITS ) - 1;
+
+	size_t numStages = 0;
+	bool used[NUM_STAGE_TYPES] = {};
+	ostringstream calls;
+	for( size_t s = 0; s < MAX_STAGES; ++s ) {
+		uint32_t type = ( permutation >> ( s * STAGE_BITS ) ) & mask;
+		if( type == NO_STAGE || type >= NUM_STAGE_TYPES )
+			break;
+
+		// the first stage reads its invariant from the baked attribute, later ones compute it
+		calls << "#define STAGE_" << s << " " << sStageTypes[type].function << "(position, normal, stageAmount[" << s << "]";
+		if( sStageTypes[type].invariant && s == 0 )
+			calls << ", restInvariant";
+		else if( sStageTypes[type].invariant )
+			calls << ", " << sStageTypes[type].invariant << "(position.xyz)";
+		calls << ")\n";
+
+		if( s == 0 && sStageTypes[type].invariant )
+			calls << "#define HAS_REST_INVARIANT\n";
+		used[type] = true;
+		for( int other = 0; other < NUM_STAGE_TYPES; ++other )
+			if( sStageTypes[type].calls & ( 1u << other ) )
+				used[other] = true;
+		++numStages;
+	}
+
+	ostringstream source;
+	source << "#define NUM_STAGES " << numStages << "\n";
+	for( int type = 0; type < NUM_STAGE_TYPES; ++type )
+		if( used[type] )
+			source << "#define " << sStageTypes[type].feature << "\n";
+	source << calls.str();
+	return source.str();
+}
+
+const string& DeformGlsl::uberVertexShader()
+{
+	static string source;
+	if( ! source.empty() )
+		return source;
+
+	ostringstream stream;
+	stream << vertexHeader();
+	stream <<
+		"#if NUM_STAGES > 0\n"
+		"uniform float stageAmount[NUM_STAGES];\n"
+		"#endif\n"
+		"#ifdef HAS_REST_INVARIANT\n"
+		"in float restInvariant;\n"
+		"#endif\n"
+		"\n";
+
+	// types only call the functions of types before them
+	const char *functions[] = { nullptr, twistStage(), stretchStage(), sphereStage(), planeMorphStage(), twistBranchStage(), twistStretchBranchStage() };
+	for( int type = 1; type < NUM_STAGE_TYPES; ++type )
+		stream << "#ifdef " << sStageTypes[type].feature << "\n" << functions[type] << "#endif\n";
+
+	stream <<
+		"\n"
+		"void main(void) {\n"
+		"	vec4 position = ciPosition;\n"
+		"	vec3 normal = ciNormal;\n";
+	for( size_t s = 0; s < MAX_STAGES; ++s )
+		stream << "#ifdef STAGE_" << s << "\n	STAGE_" << s << ";\n#endif\n";
+	stream << vertexFooter();
+
+	source = stream.str();
+	return source;
+}
+
+const char* DeformGlsl::vertexHeader()
+{
+	return
+		"#version 150\n"
+		"\n"
+		"uniform mat4	ciModelViewProjection;\n"
+		"uniform mat4	ciModelView;\n"
+		"uniform mat3	ciNormalMatrix;\n"
+		"uniform float ciElapsedSeconds;\n"
+		"uniform float angle_deg_max;\n"
+		"uniform float height;\n"
+		"uniform vec3 centerPoint;\n"
+		"uniform float xlim;\n"
+		"uniform float ylim;\n"
+		"uniform float zlim;\n"
+		"\n"
+		"in vec4		ciPosition;\n"
+		"in vec3		ciNormal;\n"
+		"in vec4		ciColor;\n"
+		"in vec2		ciTexCoord0;\n"
+		"\n"
+		"out vec2 vUv;\n"
+		"out VertexData {\n"
+		"	vec4 position;\n"
+		"	vec3 normal;\n"
+		"	vec4 color;\n"
+		"} vVertexOut;\n"
+		"\n"
+		"// Transforms normal n by mix(identity, f, amount), given the Jacobian columns dx, dy, dz of f. Uses the\n"
+		"// cofactor matrix, which is the inverse-transpose up to a scale factor.\n"
+		"vec3 transformNormal(vec3 dx, vec3 dy, vec3 dz, float amount, vec3 n) {\n"
+		"	vec3 a = mix(vec3(1.0, 0.0, 0.0), dx, amount);\n"
+		"	vec3 b = mix(vec3(0.0, 1.0, 0.0), dy, amount);\n"
+		"	vec3 c = mix(vec3(0.0, 0.0, 1.0), dz, amount);\n"
+		"	return n.x * cross(b, c) + n.y * cross(c, a) + n.z * cross(a, b);\n"
+		"}\n"
+		"\n";
+}
+
+const char* DeformGlsl::vertexFooter()
+{
+	return
+		"	vUv = ciTexCoord0;\n"
+		"	vVertexOut.position = ciModelView * position;\n"
+		"	vVertexOut.normal = ciNormalMatrix * normalize(normal);\n"
+		"	vVertexOut.color = ciColor;\n"
+		"	gl_Position = ciModelViewProjection * position;\n"
+		"}\n";
+}
+
+const char* DeformGlsl::phongFragment()
+{
+	return
+		"#version 150\n"
+		"\n"
+		"in VertexData	{\n"
+		"	vec4 position;\n"
+		"	vec3 normal;\n"
+		"	vec4 color;\n"
+		"} vVertexIn;\n"
+		"\n"
+		"out vec4 oColor;\n"
+		"in vec2 vUv;\n"
+		"uniform sampler2D baseTexture;\n"
+		"\n"
+		"void main(void) {\n"
+		"	// set diffuse and specular colors\n"
+		"	vec3 cDiffuse = vVertexIn.color.rgb;\n"
+		"	vec3 cSpecular = vec3(0.3, 0.3, 0.3);\n"
+		"\n"
+		"	// light properties in view space\n"
+		"	vec3 vLightPosition = vec3(0.0, 0.0, 0.0);\n"
+		"\n"
+		"	// lighting calculations\n"
+		"	vec3 vVertex = vVertexIn.position.xyz;\n"
+		"	vec3 vNormal = normalize( vVertexIn.normal );\n"
+		"	vec3 vToLight = normalize( vLightPosition - vVertex );\n"
+		"	vec3 vToEye = normalize( -vVertex );\n"
+		"	vec3 vReflect = normalize( -reflect(vToLight, vNormal) );\n"
+		"\n"
+		"	// diffuse coefficient\n"
+		"	vec3 diffuse = max( dot( vNormal, vToLight ), 0.0 ) * cDiffuse;\n"
+		"\n"
+		"	// specular coefficient with energy conservation\n"
+		"	const float shininess = 20.0;\n"
+		"	const float coeff = (2.0 + shininess) / (2.0 * 3.14159265);\n"
+		"	vec3 specular = pow( max( dot( vReflect, vToEye ), 0.0 ), shininess ) * coeff * cSpecular;\n"
+		"\n"
+		"	// to conserve energy, diffuse and specular colors should not exceed one\n"
+		"	float maxDiffuse = max(diffuse.r, max(diffuse.g, diffuse.b));\n"
+		"	float maxSpecular = max(specular.r, max(specular.g, specular.b));\n"
+		"	float fConserve = 1.0 / max(1.0, maxDiffuse + maxSpecular);\n"
+		"\n"
+		"	// final color\n"
+		"	oColor.rgb = (diffuse + specular) * fConserve;\n"
+		"	oColor.a = 1.0;\n"
+		"}\n";
+}
+
+const char* DeformGlsl::twistStage()
+{
+	return
+		"float twistInvariant(vec3 pos) {\n"
+		"	return (height*0.5 + pos.y)/height;\n"
+		"}\n"
+		"\n"
+		"void twistStage(inout vec4 position, inout vec3 normal, float amount, float factor) {\n"
+		"	float angle_deg = angle_deg_max * sin(ciElapsedSeconds);\n"
+		"	float angle_rad = angle_deg * 3.14159 / 180.0;\n"
+		"	float ang = factor * angle_rad;\n"
+		"	float st = sin(ang);\n"
+		"	float ct = cos(ang);\n"
+		"	vec3 twistedPosition = vec3(position.x * ct - position.z * st, position.y, position.x * st + position.z * ct);\n"
+		"	float k = angle_rad / height;\n"
+		"	vec3 dx = vec3(ct, 0.0, st);\n"
+		"	vec3 dy = vec3(-k * twistedPosition.z, 1.0, k * twistedPosition.x);\n"
+		"	vec3 dz = vec3(-st, 0.0, ct);\n"
+		"	normal = transformNormal(dx, dy, dz, amount, normal);\n"
+		"	position.xyz = mix(position.xyz, twistedPosition, amount);\n"
+		"}\n"
+		"\n";
+}
+
+const char* DeformGlsl::stretchStage()
+{
+	return
+		"float stretchInvariant(vec3 pos) {\n"
+		"	return abs(distance(centerPoint, pos));\n"
+		"}\n"
+		"\n"
+		"vec3 stretch(vec3 pos, float dist, out vec3 dx, out vec3 dy, out vec3 dz) {\n"
+		"	vec3 k = vec3(xlim / 2.0, ylim / 2.0, zlim);\n"
+		"	vec3 s = k * pos;\n"
+		"	vec3 g = (pos - centerPoint) / max(dist, 1e-20);\n"
+		"	dx = vec3(k.x * dist, 0.0, 0.0) + s * g.x;\n"
+		"	dy = vec3(0.0, k.y * dist, 0.0) + s * g.y;\n"
+		"	dz = vec3(0.0, 0.0, k.z * dist) + s * g.z;\n"
+		"	return vec3(xlim * dist/2.0 * pos.x, ylim * dist/2.0 * pos.y, zlim * dist * pos.z);\n"
+		"}\n"
+		"\n"
+		"void stretchStage(inout vec4 position, inout vec3 normal, float amount, float dist) {\n"
+		"	vec3 dx, dy, dz;\n"
+		"	vec3 stretchedPosition = stretch(position.xyz, dist, dx, dy, dz);\n"
+		"	normal = transformNormal(dx, dy, dz, amount, normal);\n"
+		"	position.xyz = mix(position.xyz, stretchedPosition, amount);\n"
+		"}\n"
+		"\n";
+}
+
+const char* DeformGlsl::sphereStage()
+{
+	return
+		"vec3 sphere(vec3 pos, out vec3 dx, out vec3 dy, out vec3 dz) {\n"
+		"	float sx = sqrt(1.0 - (pos.y*pos.y/2.0) - (pos.z*pos.z/2.0) + (pos.y*pos.y*pos.z*pos.z / 3.0) );\n"
+		"	float sy = sqrt(1.0 - (pos.z*pos.z/2.0) - (pos.x*pos.x/2.0) + (pos.z*pos.z*pos.x*pos.x / 3.0) );\n"
+		"	float sz = sqrt(1.0 - (pos.x*pos.x/2.0) - (pos.y*pos.y/2.0) + (pos.x*pos.x*pos.y*pos.y / 3.0) );\n"
+		"	vec3 sq = pos * pos;\n"
+		"	vec3 h = pos / max(vec3(sx, sy, sz), vec3(1e-20));\n"
+		"	dx = vec3(sx, h.y * pos.x * (2.0/3.0 * sq.z - 1.0) / 2.0, h.z * pos.x * (2.0/3.0 * sq.y - 1.0) / 2.0);\n"
+		"	dy = vec3(h.x * pos.y * (2.0/3.0 * sq.z - 1.0) / 2.0, sy, h.z * pos.y * (2.0/3.0 * sq.x - 1.0) / 2.0);\n"
+		"	dz = vec3(h.x * pos.z * (2.0/3.0 * sq.y - 1.0) / 2.0, h.y * pos.z * (2.0/3.0 * sq.x - 1.0) / 2.0, sz);\n"
+		"	return vec3(pos.x * sx, pos.y * sy, pos.z * sz);\n"
+		"}\n"
+		"\n"
+		"void sphereStage(inout vec4 position, inout vec3 normal, float amount) {\n"
+		"	vec3 dx, dy, dz;\n"
+		"	vec3 spherePosition = sphere(position.xyz, dx, dy, dz);\n"
+		"	normal = transformNormal(dx, dy, dz, amount, normal);\n"
+		"	position.xyz = mix(position.xyz, spherePosition, amount);\n"
+		"}\n"
+		"\n";
+}
+
+const char* DeformGlsl::planeMorphStage()
+{
+	return
+		"void planeMorphStage(inout vec4 position, inout vec3 normal, float amount) {\n"
+		"	vec3 goalPosition = 5.0 * vec3(-ciTexCoord0.x,ciTexCoord0.y,-ciTexCoord0.x);\n"
+		"	position = mix(position, vec4(goalPosition,1.0), amount);\n"
+		"	normal = mix(normalize(normal), vec3(0.70710678, 0.0, -0.70710678), amount);\n"
+		"}\n"
+		"\n";
+}
+
+const char* DeformGlsl::twistBranchStage()
+{
+	return
+		"void twistBranchStage(inout vec4 position, inout vec3 normal, float amount) {\n"
+		"	vec4 branchPosition = ciPosition;\n"
+		"	vec3 branchNormal = ciNormal;\n"
+		"	twistStage(branchPosition, branchNormal, 1.0, twistInvariant(ciPosition.xyz));\n"
+		"	position = mix(position, branchPosition, amount);\n"
+		"	normal = mix(normalize(normal), normalize(branchNormal), amount);\n"
+		"}\n"
+		"\n";
+}
+
+const char* DeformGlsl::twistStretchBranchStage()
+{
+	return
+		"void twistStretchBranchStage(inout vec4 position, inout vec3 normal, float amount) {\n"
+		"	vec4 branchPosition = ciPosition;\n"
+		"	vec3 branchNormal = ciNormal;\n"
+		"	twistStage(branchPosition, branchNormal, 1.0, twistInvariant(ciPosition.xyz));\n"
+		"	stretchStage(branchPosition, branchNormal, 1.0, stretchInvariant(branchPosition.xyz));\n"
+		"	position = mix(position, branchPosition, amount);\n"
+		"	normal = mix(normalize(normal), normalize(branchNormal), amount);\n"
+		"}\n"
+		"\n";
+}
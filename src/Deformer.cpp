@@ -0,0 +1,295 @@
+#include "Deformer.h"
+#include "DeformPipeline.h"
+#include "ThreadPool.h"
+
+#include "cinder/CinderMath.h"
+
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+using namespace ci;
+using namespace std;
+
+DeformParams::DeformParams()
+	: elapsedSeconds( 0 ), angleDegMax( 0 ), height( 0.9f ), centerPoint( 0 ),
+	xlim( 0.01f ), ylim( 2.0f ), zlim( 0.05f ), flag( true ), move( 0 ), trigAccuracy( TRIG_EXACT )
+{
+}
+
+VertexStreams::VertexStreams()
+	: mNumVertices( 0 ), mHasTangents( false )
+{
+}
+
+VertexStreams::VertexStreams( const TriMesh &mesh, bool withTangents )
+	: mNumVertices( 0 ), mHasTangents( false )
+{
+	setMesh( mesh, withTangents );
+}
+
+void VertexStreams::resize( size_t numVertices, bool withTangents )
+{
+	mNumVertices = numVertices;
+	mHasTangents = withTangents;
+	for( int i = 0; i < NUM_STREAMS; ++i ) {
+		if( i < TANGENT_X || withTangents )
+			mStreams[i].resize( numVertices, 0.0f );
+		else
+			vector<float>().swap( mStreams[i] );
+	}
+}
+
+void VertexStreams::setMesh( const TriMesh &mesh, bool withTangents )
+{
+	size_t numVertices = mesh.getNumVertices();
+	resize( numVertices, withTangents && mesh.hasTangents() );
+
+	const vec3 *positions = mesh.getPositions<3>();
+	for( size_t i = 0; i < numVertices; ++i ) {
+		mStreams[POSITION_X][i] = positions[i].x;
+		mStreams[POSITION_Y][i] = positions[i].y;
+		mStreams[POSITION_Z][i] = positions[i].z;
+	}
+
+	if( mesh.hasNormals() ) {
+		const vector<vec3> &normals = mesh.getNormals();
+		for( size_t i = 0; i < numVertices; ++i ) {
+			mStreams[NORMAL_X][i] = normals[i].x;
+			mStreams[NORMAL_Y][i] = normals[i].y;
+			mStreams[NORMAL_Z][i] = normals[i].z;
+		}
+	}
+
+	if( mesh.hasTexCoords0() ) {
+		const vector<float> &texCoords = mesh.getBufferTexCoords0();
+		size_t dims = mesh.getAttribDims( geom::Attrib::TEX_COORD_0 );
+		for( size_t i = 0; i < numVertices; ++i ) {
+			mStreams[TEX_COORD_U][i] = texCoords[i * dims];
+			mStreams[TEX_COORD_V][i] = texCoords[i * dims + 1];
+		}
+	}
+
+	if( mHasTangents ) {
+		const vector<vec3> &tangents = mesh.getTangents();
+		for( size_t i = 0; i < numVertices; ++i ) {
+			mStreams[TANGENT_X][i] = tangents[i].x;
+			mStreams[TANGENT_Y][i] = tangents[i].y;
+			mStreams[TANGENT_Z][i] = tangents[i].z;
+		}
+	}
+}
+
+void VertexStreams::copyTo( TriMesh *mesh ) const
+{
+	size_t numVertices = math<size_t>::min( mesh->getNumVertices(), mNumVertices );
+
+	vec3 *positions = mesh->getPositions<3>();
+	for( size_t i = 0; i < numVertices; ++i )
+		positions[i] = vec3( mStreams[POSITION_X][i], mStreams[POSITION_Y][i], mStreams[POSITION_Z][i] );
+
+	if( mesh->hasNormals() ) {
+		vector<vec3> &normals = mesh->getNormals();
+		for( size_t i = 0; i < numVertices; ++i )
+			normals[i] = vec3( mStreams[NORMAL_X][i], mStreams[NORMAL_Y][i], mStreams[NORMAL_Z][i] );
+	}
+}
+
+void VertexStreams::gather( const VertexStreams &source, const vector<uint32_t> &indices )
+{
+	resize( indices.size(), source.mHasTangents );
+	for( int s = 0; s < ( mHasTangents ? NUM_STREAMS : TANGENT_X ); ++s )
+		for( size_t i = 0; i < indices.size(); ++i )
+			mStreams[s][i] = source.mStreams[s][indices[i]];
+}
+
+DeformInput VertexStreams::getInput() const
+{
+	DeformInput input = {
+		mStreams[POSITION_X].data(), mStreams[POSITION_Y].data(), mStreams[POSITION_Z].data(),
+		mStreams[NORMAL_X].data(), mStreams[NORMAL_Y].data(), mStreams[NORMAL_Z].data(),
+		mStreams[TEX_COORD_U].data(), mStreams[TEX_COORD_V].data(),
+		nullptr, nullptr, nullptr
+	};
+	if( mHasTangents ) {
+		input.tx = mStreams[TANGENT_X].data();
+		input.ty = mStreams[TANGENT_Y].data();
+		input.tz = mStreams[TANGENT_Z].data();
+	}
+	return input;
+}
+
+DeformOutput VertexStreams::getOutput()
+{
+	DeformOutput output = {
+		mStreams[POSITION_X].data(), mStreams[POSITION_Y].data(), mStreams[POSITION_Z].data(),
+		mStreams[NORMAL_X].data(), mStreams[NORMAL_Y].data(), mStreams[NORMAL_Z].data(),
+		nullptr, nullptr, nullptr
+	};
+	if( mHasTangents ) {
+		output.tx = mStreams[TANGENT_X].data();
+		output.ty = mStreams[TANGENT_Y].data();
+		output.tz = mStreams[TANGENT_Z].data();
+	}
+	return output;
+}
+
+void RestInvariants::buildRings( float quantization, size_t minRingSize )
+{
+	ringIndices.clear();
+	ringValues.clear();
+
+	size_t maxRings = values.size() / math<size_t>::max( minRingSize, 1 );
+	std::unordered_map<int64_t, int32_t> rings;
+	std::vector<int32_t> indices( values.size() );
+
+	for( size_t i = 0; i < values.size(); ++i ) {
+		// exact mode keys on the bit pattern, so the ring value is bit-identical to the vertex value
+		int64_t key;
+		if( quantization > 0 )
+			key = (int64_t) std::floor( values[i] / quantization + 0.5f );
+		else {
+			int32_t bits;
+			std::memcpy( &bits, &values[i], sizeof( bits ) );
+			key = bits;
+		}
+
+		auto inserted = rings.insert( std::make_pair( key, (int32_t) ringValues.size() ) );
+		if( inserted.second ) {
+			if( ringValues.size() == maxRings ) {
+				ringValues.clear();
+				return;
+			}
+			ringValues.push_back( quantization > 0 ? key * quantization : values[i] );
+		}
+		indices[i] = inserted.first->second;
+	}
+
+	ringIndices.swap( indices );
+}
+
+namespace {
+
+template<typename PipelineT>
+RestInvariantsRef bakePipeline( PipelineT pipeline, const DeformParams &params, const VertexStreams &rest, float ringQuantization )
+{
+	pipeline.setParams( params );
+	pipeline.bake( rest, ringQuantization );
+	return pipeline.getRestInvariants();
+}
+
+template<typename PipelineT>
+void applyPipeline( PipelineT pipeline, const DeformParams &params, const RestInvariantsRef &invariants, const DeformParams &bakedParams,
+	const DeformInput &rest, const DeformOutput &result, size_t begin, size_t end )
+{
+	pipeline.setParams( params );
+	if( invariants )
+		pipeline.setRestInvariants( invariants, bakedParams );
+	pipeline.apply( rest, result, begin, end );
+}
+
+template<typename PipelineT>
+void applyPipeline( PipelineT pipeline, const DeformParams &params, const RestInvariantsRef &invariants, const DeformParams &bakedParams,
+	const VertexStreams &rest, VertexStreams *result, ThreadPool &pool )
+{
+	pipeline.setParams( params );
+	if( invariants )
+		pipeline.setRestInvariants( invariants, bakedParams );
+	pipeline.apply( rest, result, pool );
+}
+
+// Bounds of the current frame if \a angleDegMax is null, of the whole animation otherwise.
+template<typename PipelineT>
+AxisAlignedBox3f boundPipeline( PipelineT pipeline, const DeformParams &params, const RestBounds &rest, const Interval *angleDegMax )
+{
+	pipeline.setParams( params );
+	return angleDegMax ? pipeline.getAnimationBounds( rest, *angleDegMax ) : pipeline.getBounds( rest );
+}
+
+AxisAlignedBox3f boundDeformer( Deformer::Type type, const DeformParams &params, const RestBounds &rest, const Interval *angleDegMax )
+{
+	switch( type ) {
+		case Deformer::PLANE: return boundPipeline( createPlanePipeline( params.flag, params.move ), params, rest, angleDegMax );
+		case Deformer::TWIST: return boundPipeline( createTwistPipeline(), params, rest, angleDegMax );
+		case Deformer::SQUASH: return boundPipeline( createSquashPipeline(), params, rest, angleDegMax );
+		case Deformer::SQUASH2: return boundPipeline( createSquash2Pipeline(), params, rest, angleDegMax );
+		case Deformer::SPHERE: return boundPipeline( createSpherePipeline(), params, rest, angleDegMax );
+		case Deformer::CUSTOM23: return boundPipeline( createCustom23Pipeline(), params, rest, angleDegMax );
+		case Deformer::CUSTOM123: return boundPipeline( createCustom123Pipeline(), params, rest, angleDegMax );
+	}
+	return AxisAlignedBox3f( vec3( 0.0f ), vec3( 0.0f ) );
+}
+
+} // anonymous namespace
+
+Deformer::Deformer( Type type )
+	: mType( type ), mBakedType( type )
+{
+}
+
+void Deformer::bake( const VertexStreams &rest, float ringQuantization )
+{
+	switch( mType ) {
+		case PLANE: mRestInvariants = bakePipeline( createPlanePipeline( mParams.flag, mParams.move ), mParams, rest, ringQuantization ); break;
+		case TWIST: mRestInvariants = bakePipeline( createTwistPipeline(), mParams, rest, ringQuantization ); break;
+		case SQUASH: mRestInvariants = bakePipeline( createSquashPipeline(), mParams, rest, ringQuantization ); break;
+		case SQUASH2: mRestInvariants = bakePipeline( createSquash2Pipeline(), mParams, rest, ringQuantization ); break;
+		case SPHERE: mRestInvariants = bakePipeline( createSpherePipeline(), mParams, rest, ringQuantization ); break;
+		case CUSTOM23: mRestInvariants = bakePipeline( createCustom23Pipeline(), mParams, rest, ringQuantization ); break;
+		case CUSTOM123: mRestInvariants = bakePipeline( createCustom123Pipeline(), mParams, rest, ringQuantization ); break;
+	}
+
+	mBakedType = mType;
+	mBakedParams = mParams;
+}
+
+void Deformer::apply( const VertexStreams &rest, VertexStreams *result ) const
+{
+	if( result->getNumVertices() != rest.getNumVertices() || result->hasTangents() != rest.hasTangents() )
+		result->resize( rest.getNumVertices(), rest.hasTangents() );
+
+	apply( rest.getInput(), result->getOutput(), 0, rest.getNumVertices() );
+}
+
+void Deformer::apply( const VertexStreams &rest, VertexStreams *result, ThreadPool &pool ) const
+{
+	// the pipeline computes the per-frame terms once and then spreads the chunks over the pool
+	RestInvariantsRef invariants = mBakedType == mType ? mRestInvariants : RestInvariantsRef();
+
+	switch( mType ) {
+		case PLANE: applyPipeline( createPlanePipeline( mParams.flag, mParams.move ), mParams, invariants, mBakedParams, rest, result, pool ); break;
+		case TWIST: applyPipeline( createTwistPipeline(), mParams, invariants, mBakedParams, rest, result, pool ); break;
+		case SQUASH: applyPipeline( createSquashPipeline(), mParams, invariants, mBakedParams, rest, result, pool ); break;
+		case SQUASH2: applyPipeline( createSquash2Pipeline(), mParams, invariants, mBakedParams, rest, result, pool ); break;
+		case SPHERE: applyPipeline( createSpherePipeline(), mParams, invariants, mBakedParams, rest, result, pool ); break;
+		case CUSTOM23: applyPipeline( createCustom23Pipeline(), mParams, invariants, mBakedParams, rest, result, pool ); break;
+		case CUSTOM123: applyPipeline( createCustom123Pipeline(), mParams, invariants, mBakedParams, rest, result, pool ); break;
+	}
+}
+
+void Deformer::apply( const DeformInput &rest, const DeformOutput &result, size_t begin, size_t end ) const
+{
+	// invariants baked for another type belong to a different first stage
+	RestInvariantsRef invariants = mBakedType == mType ? mRestInvariants : RestInvariantsRef();
+
+	switch( mType ) {
+		case PLANE: applyPipeline( createPlanePipeline( mParams.flag, mParams.move ), mParams, invariants, mBakedParams, rest, result, begin, end ); break;
+		case TWIST: applyPipeline( createTwistPipeline(), mParams, invariants, mBakedParams, rest, result, begin, end ); break;
+		case SQUASH: applyPipeline( createSquashPipeline(), mParams, invariants, mBakedParams, rest, result, begin, end ); break;
+		case SQUASH2: applyPipeline( createSquash2Pipeline(), mParams, invariants, mBakedParams, rest, result, begin, end ); break;
+		case SPHERE: applyPipeline( createSpherePipeline(), mParams, invariants, mBakedParams, rest, result, begin, end ); break;
+		case CUSTOM23: applyPipeline( createCustom23Pipeline(), mParams, invariants, mBakedParams, rest, result, begin, end ); break;
+		case CUSTOM123: applyPipeline( createCustom123Pipeline(), mParams, invariants, mBakedParams, rest, result, begin, end ); break;
+	}
+}
+
+AxisAlignedBox3f Deformer::getBounds( const RestBounds &rest ) const
+{
+	return boundDeformer( mType, mParams, rest, nullptr );
+}
+
+AxisAlignedBox3f Deformer::getAnimationBounds( const RestBounds &rest, float minAngleDeg, float maxAngleDeg ) const
+{
+	Interval angleDegMax( minAngleDeg, maxAngleDeg );
+	return boundDeformer( mType, mParams, rest, &angleDegMax );
+}
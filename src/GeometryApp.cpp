@@ -2,6 +2,7 @@
 #include "cinder/GeomIo.h"
 #include "cinder/ImageIo.h"
 #include "cinder/MayaCamUI.h"
+#include "cinder/Timer.h"
 #include "cinder/app/AppNative.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/gl.h"
@@ -13,6 +14,16 @@
 #include "cinder/params/Params.h"
 
 #include "DebugMesh.h"
+#include "DeformCacheReader.h"
+#include "DeformPipeline.h"
+#include "MeshBuilder.h"
+#include "LodSelector.h"
+#include "MeshCache.h"
+#include "MeshImport.h"
+#include "ProgramBinaryCache.h"
+#include "SceneBvh.h"
+#include "ShaderCache.h"
+#include "ThreadPool.h"
 
 using namespace ci;
 using namespace ci::app;
@@ -20,7 +31,7 @@ using namespace std;
 
 class GeometryApp : public AppNative {
   public:
-	typedef enum { CAPSULE, CONE, CUBE, CYLINDER, HELIX, ICOSAHEDRON, ICOSPHERE, SPHERE, TEAPOT, TORUS, PLANE } Primitive;
+	typedef enum { CAPSULE, CONE, CUBE, CYLINDER, HELIX, ICOSAHEDRON, ICOSPHERE, SPHERE, TEAPOT, TORUS, PLANE, IMPORTED } Primitive;
     typedef enum { PLA,TWIST,SQUASH,SQUASH2,SPH,CUSTOM23,CUSTOM123 } Transformative;
 	typedef enum { LOW, DEFAULT, HIGH } Quality;
 	typedef enum { SHADED, WIREFRAME } ViewMode;
@@ -35,23 +46,80 @@ class GeometryApp : public AppNative {
 
 	void keyDown( KeyEvent event );
 
+	void fileDrop( FileDropEvent event );
+
 	void resize();
   private:
 	void createGrid();
-	void createPlaneShader();
 	void createWireframeShader();
+	//! The permutation of the transformation shader with the feature bits \a permutation, compiled on first
+	//! use. Errors go to the console and give null.
+	gl::GlslProgRef getDeformShader( uint32_t permutation );
+	//! The permutation for the current transformation.
+	uint32_t getDeformPermutation() const;
+	//! The current primitive at \a quality, with colors if they are shown.
+	geom::SourceRef createSource( Quality quality );
+	//! Identifies the current primitive at \a quality and \a subdivision, decimated to \a detail percent.
+	MeshKey makeMeshKey( Quality quality, int subdivision, int detail ) const;
+	//! Shows the mesh for the current primitive, quality, subdivision and detail: right away if it is cached,
+	//! otherwise once mMeshBuilder has built it.
 	void createPrimitive();
+	//! Unless the chain of levels of detail for \a key's primitive is known already, resets mLodSelector
+	//! and has mMeshBuilder build the levels that are not cached.
+	void prefetchLodChain( const MeshKey &key );
+	//! The finest level of detail no finer than \a quality, \a subdivision and \a detail.
+	size_t findLodLevel( Quality quality, int subdivision, int detail ) const;
+	//! Conservative bounds of \a entry as drawn with \a params: deformed by the current transformation, or at
+	//! rest in wireframe mode.
+	AxisAlignedBox3f getDeformedBounds( const MeshCacheEntry &entry, const DeformParams &params ) const;
+	//! The movement and rotation the Translate and Rotate toggles apply to every object this frame.
+	mat4 getAnimationTransform() const;
+	//! Places mNumObjects copies of the primitive on a grid around the origin.
+	void layoutObjects();
+	//! Refits mSceneBvh to where the objects are this frame and collects the ones in view into mVisibleObjects.
+	void cullObjects( const mat4 &animation, const DeformParams &params );
+	//! Samples the normal lines down to mNormalsBudget.
+	void sampleNormals();
+	//! Moves the normal lines onto the vertices as the current transformation deforms them with \a params.
+	void updateNormals( const DeformParams &params );
+	//! Pixels covered by the sphere around the deformed bounds of \a entry, or a huge number if the camera is inside it.
+	float getProjectedArea( const MeshCacheEntry &entry ) const;
+	//! Uploads a mesh built by mMeshBuilder.
+	MeshCacheEntryRef uploadMesh( const MeshBuilder::Result &result );
+	//! Makes \a entry the mesh that is drawn.
+	void showMesh( const MeshKey &key, const MeshCacheEntryRef &entry );
+	//! (Re)creates the batches drawing mMeshEntry with the current transformation.
+	void createBatches();
 	void createParams();
-    
-    void createTwistShader();
-    void createSquashShader();
-    void createSquashShader2();
-    void createSphereShader();
-    void createCustomShader23();
-    void createCustomShader123();
+
+	//! Creates the batch that draws \a entry with \a shader. If \a pipeline's first stage has a per-vertex
+	//! invariant, it is passed to the shader as the 'restInvariant' attribute; it is baked once per entry
+	//! and transformation and kept with the entry.
+	template<typename PipelineT>
+	gl::BatchRef createDeformBatch( MeshCacheEntry &entry, PipelineT &pipeline, const gl::GlslProgRef &shader );
+
+	//! The uniforms of the current transformation as CPU deformer parameters.
+	DeformParams getDeformParams() const;
+	//! Bakes the current primitive and transformation into a cache file and loads it for playback.
+	void bakeCache();
+	//! Creates the batch that draws the cached frames: positions and normals come from a streamed vertex
+	//! buffer, everything else from the buffers of mMeshEntry.
+	void createCachePrimitive();
+	//! (Re)starts streaming mCache with the current read-ahead and drop settings.
+	void createCacheReader();
+	//! Loads the mesh file at \a path as the imported primitive and shows it. Errors go to the console.
+	void loadMesh( const fs::path &path );
+	//! Asks for a mesh file and loads it.
+	void openMesh();
 
 	void setSubdivision(int subdivision) { mSubdivision = math<int>::clamp(subdivision, 1, 5); createPrimitive(); }
 	int  getSubdivision() const { return mSubdivision; }
+
+	void enableSmoothSubdivision(bool enabled=true) { mSmoothSubdivision = enabled; createPrimitive(); }
+	bool isSmoothSubdivisionEnabled() const { return mSmoothSubdivision; }
+
+	void setDetail(int detail) { mDetail = math<int>::clamp(detail, 1, 100); createPrimitive(); }
+	int  getDetail() const { return mDetail; }
     
     void setXlim(float x_lim) { xlim = math<float>::clamp(x_lim, 0, 5); }
 	int  getXlim() const { return xlim; }
@@ -74,6 +142,27 @@ class GeometryApp : public AppNative {
 	void enableColors(bool enabled=true) { mShowColors = enabled; createPrimitive(); }
 	bool isColorsEnabled() const { return mShowColors; }
 
+	void setReadAhead(int readAhead) { mReadAhead = math<int>::clamp(readAhead, 1, 120); createCacheReader(); }
+	int  getReadAhead() const { return mReadAhead; }
+
+	void setMeshCacheBudget(int megabytes) { mMeshCache.setBudget( (size_t) math<int>::max(megabytes, 0) * 1024 * 1024 ); }
+	int  getMeshCacheBudget() const { return (int)( mMeshCache.getBudget() / ( 1024 * 1024 ) ); }
+
+	void enableDropFrames(bool enabled=true) { mDropFrames = enabled; createCacheReader(); }
+	bool isDropFramesEnabled() const { return mDropFrames; }
+
+	void enableAutoLod(bool enabled=true) { mAutoLod = enabled; mLodChain.primitive = -1; createPrimitive(); }
+	bool isAutoLodEnabled() const { return mAutoLod; }
+
+	void setNumObjects(int count) { mNumObjects = math<int>::clamp(count, 1, 4096); layoutObjects(); }
+	int  getNumObjects() const { return mNumObjects; }
+
+	void setNormalsBudget(int lines) { mNormalsBudget = math<int>::clamp(lines, 0, 1 << 20); sampleNormals(); }
+	int  getNormalsBudget() const { return mNormalsBudget; }
+
+	void setTargetFps(int fps) { mLodSelector.setTargetFrameTime( 1.0 / math<int>::clamp(fps, 10, 240) ); }
+	int  getTargetFps() const { return (int)( 1.0 / mLodSelector.getTargetFrameTime() + 0.5 ); }
+
 	Primitive			mPrimitiveSelected;
     Transformative      mTransformation;
     Transformative      mTransformationSelected;
@@ -83,6 +172,8 @@ class GeometryApp : public AppNative {
 	ViewMode			mViewMode;
 
 	int					mSubdivision;
+	bool				mSmoothSubdivision;
+	int					mDetail;			// percentage of the triangles kept, see MeshDecimation
     float               xlim,ylim,zlim;
     float               red,green,blue;
 
@@ -101,24 +192,58 @@ class GeometryApp : public AppNative {
 
 	gl::VertBatchRef	mGrid;
 
+	int					mNumObjects;
+	std::vector<mat4>	mObjectTransforms;		// per object, on top of the animation
+	std::vector<AxisAlignedBox3f>	mObjectBounds;	// deformed and in world space, this frame
+	SceneBvh			mSceneBvh;
+	std::vector<uint32_t>	mVisibleObjects;
+	int32_t				mNumVisibleObjects;
+
+	TriMeshRef			mImportedMesh;	// of the IMPORTED primitive, centered and scaled like the built-in ones
+
 	gl::BatchRef		mPrimitive;
 	gl::BatchRef		mPrimitiveWireframe;
-	gl::BatchRef		mNormals;
-    gl::BatchRef		mNormals_to_plane;
-
-	gl::GlslProgRef		mPlaneShader;
-    gl::GlslProgRef		mTwistShader;
-    gl::GlslProgRef		mSquashShader;
-    gl::GlslProgRef		mSquashShader2;
-    gl::GlslProgRef		mSphereShader;
-    gl::GlslProgRef		mCustomShader23;
-    gl::GlslProgRef		mCustomShader123;
+	DebugMeshRef		mNormals;
+	int					mNormalsBudget;		// lines of each kind at most, 0 for all of them
+	Deformer			mNormalsDeformer;	// runs the current transformation for updateNormals()
+	VertexStreams		mNormalsRest;		// of the vertices of mNormals, filled when they are first shown
+	VertexStreams		mNormalsDeformed;
+
+	MeshCache			mMeshCache;
+	MeshBuilderRef		mMeshBuilder;
+	MeshCacheEntryRef	mMeshEntry;
+	MeshKey				mWantedKey;		// of the mesh createPrimitive() was last asked for
+	bool				mAutoLod;
+	LodSelector			mLodSelector;
+	MeshKey				mLodChain;		// primitive, smoothing and attributes of the levels mLodSelector knows
+	double				mLastFrameTime;
+	DeformCacheRef		mCache;
+	gl::VboRef			mCacheVbo;
+	gl::BatchRef		mCachePrimitive;
+	DeformCacheReaderRef	mCacheReader;
+	bool				mPlayCache;
+	int					mReadAhead;
+	bool				mDropFrames;
+	int32_t				mCacheStalls, mCacheDropped;
+
+	ProgramBinaryCacheRef	mProgramBinaries;	// linked programs of earlier runs
+	ShaderCacheRef		mDeformShaders;	// permutations of DeformGlsl::uberVertexShader()
+	gl::GlslProgRef		mDeformShader;	// of the current transformation
 	gl::GlslProgRef		mWireframeShader;
+	bool				mStartupReported;	// whether the time to the first frame was logged
 
 	gl::TextureRef		mTexture;
+
+	PlanePipeline		mPlanePipeline;
+	TwistPipeline		mTwistPipeline;
+	SquashPipeline		mSquashPipeline;
+	Squash2Pipeline		mSquash2Pipeline;
+	SpherePipeline		mSpherePipeline;
+	Custom23Pipeline	mCustom23Pipeline;
+	Custom123Pipeline	mCustom123Pipeline;
     
     float angle_deg_max =0;
-    float height_of_cube = 0;
+    float height_of_cube = 0.9f;
     bool positive = true;
     bool flag = true;
     bool flagSelected = true;
@@ -129,6 +254,186 @@ class GeometryApp : public AppNative {
 #endif
 };
 
+//! The chain of levels of detail the app picks from with Auto LOD, coarsest first. The coarse levels are
+//! decimated from the high quality shape, which works for every primitive, unlike lower qualities;
+//! subdivision adds vertices for the transformations to bend.
+static const struct {
+	GeometryApp::Quality	quality;
+	int						subdivision;
+	int						detail;
+} sLodLevels[] = {
+	{ GeometryApp::HIGH, 1, 10 },
+	{ GeometryApp::HIGH, 1, 30 },
+	{ GeometryApp::HIGH, 1, 100 },
+	{ GeometryApp::HIGH, 2, 100 },
+	{ GeometryApp::HIGH, 3, 100 }
+};
+static const size_t NUM_LOD_LEVELS = sizeof( sLodLevels ) / sizeof( sLodLevels[0] );
+
+//! Distance between the objects of the scene; the plane morph alone moves vertices up to 5 units away.
+static const float OBJECT_SPACING = 6.0f;
+
+//! Uploads the per-stage blend amounts \a pipeline's generated shader expects.
+template<typename PipelineT>
+static void setStageAmounts( const gl::GlslProgRef &shader, const PipelineT &pipeline, float elapsedSeconds )
+{
+	float amounts[PipelineT::NUM_STAGES];
+	pipeline.getAmounts( elapsedSeconds, amounts );
+	shader->uniform( "stageAmount", amounts, (int) PipelineT::NUM_STAGES );
+}
+
+template<typename PipelineT>
+gl::BatchRef GeometryApp::createDeformBatch( MeshCacheEntry &entry, PipelineT &pipeline, const gl::GlslProgRef &shader )
+{
+	if( ! PipelineT::hasRestInvariant() )
+		return gl::Batch::create( entry.vboMesh, shader );
+
+	// the invariants depend on the uniforms below, which stay fixed for a given mesh
+	gl::VboRef &invariants = entry.restInvariants[mTransformation];
+	if( ! invariants ) {
+		DeformParams params = pipeline.getParams();
+		params.centerPoint = entry.center;
+		params.height = height_of_cube;
+		pipeline.setParams( params );
+		pipeline.bake( VertexStreams( *entry.mesh ) );
+		invariants = gl::Vbo::create( GL_ARRAY_BUFFER, pipeline.getRestInvariants()->values, GL_STATIC_DRAW );
+	}
+
+	geom::BufferLayout layout;
+	layout.append( geom::Attrib::CUSTOM_0, 1, 0, 0 );
+	gl::Batch::AttributeMapping mapping;
+	mapping[geom::Attrib::CUSTOM_0] = "restInvariant";
+	return gl::Batch::create( entry.createVboMesh( VertexBuffers( 1, make_pair( layout, invariants ) ) ), shader, mapping );
+}
+
+DeformParams GeometryApp::getDeformParams() const
+{
+	DeformParams params;
+	params.elapsedSeconds = (float) getElapsedSeconds();
+	params.angleDegMax = angle_deg_max;
+	params.height = height_of_cube;
+	params.centerPoint = mCameraCOI;
+	params.xlim = xlim;
+	params.ylim = ylim;
+	params.zlim = zlim;
+	params.flag = flag;
+	params.move = move;
+	return params;
+}
+
+void GeometryApp::bakeCache()
+{
+	// draw() sweeps angle_deg_max back and forth between 0 and 360 by one degree per frame, which
+	// repeats every 12 seconds at 60 frames per second.
+	const float duration = 12.0f, frameRate = 30.0f;
+
+	Deformer deformer( static_cast<Deformer::Type>( mTransformation ) );
+	deformer.setParams( getDeformParams() );
+
+	// let go of the previous cache first; Windows cannot replace a mapped file
+	mCacheReader.reset();
+	mCachePrimitive.reset();
+	mCache.reset();
+
+	fs::path path = getDocumentsDirectory() / "GeometryApp.xfcache";
+	try {
+		Timer timer( true );
+		DeformCache::bake( path.string(), deformer, VertexStreams( *mMeshEntry->mesh ), 0.0f, duration, frameRate, &ThreadPool::instance(),
+			[]( float time, DeformParams *params ) {
+				float degrees = fmod( time * 60.0f, 720.0f );
+				params->angleDegMax = degrees <= 360.0f ? degrees : 720.0f - degrees;
+			}, DeformCache::ENCODING_QUANTIZED );
+		mCache = DeformCache::open( path.string() );
+		console() << "Baked " << mCache->getNumFrames() << " frames to " << path << " in " << timer.getSeconds() << " s, "
+			<< mCache->getStoredSize() / 1024 << " KiB (" << mCache->getNumFrames() * mCache->getFrameSize() / 1024 << " KiB decoded)" << std::endl;
+	}
+	catch( const std::exception& e ) {
+		console() << e.what() << std::endl;
+		mCache.reset();
+	}
+
+	createCachePrimitive();
+}
+
+void GeometryApp::loadMesh( const fs::path &path )
+{
+	TriMeshRef mesh;
+	try {
+		Timer timer( true );
+		mesh = MeshImport::load( path.string(), &ThreadPool::instance() );
+		console() << "Loaded " << mesh->getNumTriangles() << " triangles from " << path << " in " << timer.getSeconds() << " s" << std::endl;
+	}
+	catch( const MeshImportExc& e ) {
+		console() << e.what() << std::endl;
+		return;
+	}
+
+	// about the size of the built-in primitives, around the origin
+	vec3 *positions = mesh->getPositions<3>();
+	size_t numVertices = mesh->getNumVertices();
+	if( numVertices == 0 )
+		return;
+	vec3 lower = positions[0], upper = positions[0];
+	for( size_t i = 1; i < numVertices; ++i ) {
+		lower = glm::min( lower, positions[i] );
+		upper = glm::max( upper, positions[i] );
+	}
+	vec3 center = 0.5f * ( lower + upper ), extent = upper - lower;
+	float size = glm::max( extent.x, glm::max( extent.y, extent.z ) );
+	float scale = size > 0.0f ? 2.0f / size : 1.0f;
+	for( size_t i = 0; i < numVertices; ++i )
+		positions[i] = ( positions[i] - center ) * scale;
+
+	// whatever was built from the previous import is stale
+	mMeshBuilder->cancel();
+	mMeshBuilder->cancelPrefetches();
+	mMeshCache.clear();
+	mLodChain.primitive = -1;
+
+	mImportedMesh = mesh;
+	mPrimitiveSelected = mPrimitiveCurrent = IMPORTED;
+	mSubdivision = 1;
+	createPrimitive();
+}
+
+void GeometryApp::openMesh()
+{
+	vector<string> extensions;
+	extensions.push_back( "obj" );
+	extensions.push_back( "ply" );
+	extensions.push_back( "stl" );
+	fs::path path = getOpenFilePath( "", extensions );
+	if( ! path.empty() )
+		loadMesh( path );
+}
+
+void GeometryApp::createCachePrimitive()
+{
+	mCacheReader.reset();
+	mCachePrimitive.reset();
+	// the cached positions and normals are already deformed, so the permutation without stages draws them
+	gl::GlslProgRef shader = getDeformShader( 0 );
+	if( ! mCache || ! shader || ! mMeshEntry || mCache->getNumVertices() != mMeshEntry->mesh->getNumVertices() )
+		return;
+
+	// the first frame is read here, before the reader takes over the cache
+	mCacheVbo = gl::Vbo::create( GL_ARRAY_BUFFER, mCache->getFrameSize(), mCache->readFrame( 0 ), GL_STREAM_DRAW );
+
+	geom::BufferLayout frameLayout;
+	frameLayout.append( geom::Attrib::POSITION, 3, DeformCache::VERTEX_STRIDE, 0 );
+	frameLayout.append( geom::Attrib::NORMAL, 3, DeformCache::VERTEX_STRIDE, 3 * sizeof( float ) );
+	mCachePrimitive = gl::Batch::create( mMeshEntry->createVboMesh( VertexBuffers( 1, make_pair( frameLayout, mCacheVbo ) ), false ), shader );
+	createCacheReader();
+}
+
+void GeometryApp::createCacheReader()
+{
+	// only one reader may use the cache at a time
+	mCacheReader.reset();
+	if( mCache && mCachePrimitive )
+		mCacheReader = DeformCacheReader::create( mCache, mReadAhead, mDropFrames ? DeformCacheReader::DROP_FRAMES : DeformCacheReader::KEEP_FRAMES );
+}
+
 void GeometryApp::prepareSettings( Settings* settings )
 {
 	settings->setWindowSize(1024, 768);
@@ -146,13 +451,27 @@ void GeometryApp::setup()
 
 	mShowColors = false;
 	mShowNormals = false;
+	mNormalsBudget = 16384;
 	mShowGrid = false;
     mRotate = false;
     mRotatexz = false;
     mTranslate = false;
     mTranslatexz = false;
+	mPlayCache = false;
+	mReadAhead = 8;
+	mDropFrames = true;
+	mCacheStalls = mCacheDropped = 0;
+	mNumObjects = 1;
+	mNumVisibleObjects = 0;
+	layoutObjects();
 
 	mSubdivision = 1;
+	mSmoothSubdivision = false;
+	mDetail = 100;
+	mAutoLod = false;
+	mLodChain.primitive = -1;
+	mLastFrameTime = 0.0;
+	mStartupReported = false;
     xlim = 0.01;
     ylim = 2.0;
     zlim = 0.05;
@@ -165,6 +484,14 @@ void GeometryApp::setup()
     red = 0.0;
     green = 0.9;
     blue = 1.0;
+
+	mPlanePipeline = createPlanePipeline( flag, move );
+	mTwistPipeline = createTwistPipeline();
+	mSquashPipeline = createSquashPipeline();
+	mSquash2Pipeline = createSquash2Pipeline();
+	mSpherePipeline = createSpherePipeline();
+	mCustom23Pipeline = createCustom23Pipeline();
+	mCustom123Pipeline = createCustom123Pipeline();
 	
 	// Load the textures.
 	gl::Texture::Format fmt;
@@ -181,17 +508,14 @@ void GeometryApp::setup()
 //    mCamera.setPerspective(60, getWindowAspectRatio(), 0.1, 100);
     
 
-	// Load and compile the shaders.
-	createPlaneShader();
-    createTwistShader();
-    createSquashShader();
-    createSquashShader2();
-    createSphereShader();
-    createCustomShader23();
-    createCustomShader123();
+	// Load and compile the shaders. The transformation shaders are compiled when first used, or loaded
+	// from the binaries the last run left.
+	mProgramBinaries = ProgramBinaryCache::create( getDocumentsDirectory() / "GeometryApp.shaders" );
+	mDeformShaders = ShaderCache::create( DeformGlsl::uberVertexShader(), DeformGlsl::phongFragment(), &DeformGlsl::defines, mProgramBinaries );
 	createWireframeShader();
 
 	// Create the meshes.
+	mMeshBuilder = MeshBuilder::create();
 	createGrid();
 	createPrimitive();
 
@@ -205,6 +529,11 @@ void GeometryApp::setup()
 
 void GeometryApp::update()
 {
+	// Space steps past the last primitive, and IMPORTED has nothing to show until a file is loaded; both
+	// wrap around to the first primitive.
+	if( mPrimitiveSelected > IMPORTED || ( mPrimitiveSelected == IMPORTED && ! mImportedMesh ) )
+		mPrimitiveSelected = CAPSULE;
+
 	// If another primitive or quality was selected, reset the subdivision and recreate the primitive.
 	if( mPrimitiveCurrent != mPrimitiveSelected || mQualitySelected != mQualityCurrent ) {
 		mSubdivision = 1;
@@ -222,6 +551,47 @@ void GeometryApp::update()
         flag = flagSelected;
         move = 0.0;
     }
+
+	// Swap in the mesh the builder finished; the previous one was drawn until now. Prefetched levels of
+	// detail only go into the cache, one per frame so that uploading them does not stall a frame.
+	MeshBuilder::Result built;
+	if( mMeshBuilder->takeResult( &built ) ) {
+		MeshCacheEntryRef entry = uploadMesh( built );
+		if( built.key == mWantedKey )
+			showMesh( built.key, entry );
+		else
+			mMeshCache.insert( built.key, entry );
+	}
+
+	// Pick the level of detail from how long the previous frame took and how large the mesh appears.
+	double now = getElapsedSeconds();
+	if( mAutoLod && mMeshEntry && ! mPlayCache ) {
+		size_t level = mLodSelector.update( now - mLastFrameTime, getProjectedArea( *mMeshEntry ) );
+		if( sLodLevels[level].quality != mQualityCurrent || sLodLevels[level].subdivision != mSubdivision || sLodLevels[level].detail != mDetail ) {
+			mQualitySelected = mQualityCurrent = sLodLevels[level].quality;
+			mSubdivision = sLodLevels[level].subdivision;
+			mDetail = sLodLevels[level].detail;
+			createPrimitive();
+		}
+	}
+	mLastFrameTime = now;
+
+	// Stream the cached frame for the current time into the playback buffer.
+	if( mPlayCache && mCacheReader ) {
+		if( const float *frame = mCacheReader->update( (float) getElapsedSeconds() ) ) {
+			mCacheVbo->bufferSubData( 0, mCache->getFrameSize(), frame );
+
+			// the cached normals are deformed already
+			if( mShowNormals && mNormals && mNormals->getMesh()->getNumVertices() == mCache->getNumVertices() ) {
+				DeformInput deformed = { frame, frame + 1, frame + 2, frame + 3, frame + 4, frame + 5, nullptr, nullptr, nullptr, nullptr, nullptr };
+				mNormals->update( deformed, DeformCache::FLOATS_PER_VERTEX, false, &ThreadPool::instance() );
+			}
+		}
+
+		DeformCacheReader::Stats stats = mCacheReader->getStats();
+		mCacheStalls = (int32_t) stats.stalls;
+		mCacheDropped = (int32_t) stats.framesDropped;
+	}
     
 //    cout << "mTransformation - " << mTransformation <<endl;
 
@@ -309,18 +679,16 @@ void GeometryApp::draw()
     gl::setMatrices( mCamera );
     
     
-    float mxAm = 0.05 * (1.0 + sin(getElapsedSeconds()));
-    
-    
-    switch (mTransformation) {
+	// the uniforms, the normals and the culling bounds all see this frame's values, before they advance below
+	DeformParams params = getDeformParams();
+
+    if (mDeformShader) switch (mTransformation) {
         case PLA:
-            mPlaneShader->uniform("mixAmount", mxAm);
-            mPlaneShader->uniform("worldUp", mCamera.getWorldUp());
-            mPlaneShader->uniform("angle_deg_max", angle_deg_max);
-            mPlaneShader->uniform("height", height_of_cube);
-            mPlaneShader->uniform("centerPoint", mCameraCOI);
-            mPlaneShader->uniform("flag", flag);
-            mPlaneShader->uniform("move", move);
+            mPlanePipeline = createPlanePipeline( flag, move );
+            setStageAmounts( mDeformShader, mPlanePipeline, params.elapsedSeconds );
+            mDeformShader->uniform("angle_deg_max", params.angleDegMax);
+            mDeformShader->uniform("height", height_of_cube);
+            mDeformShader->uniform("centerPoint", mCameraCOI);
             
             
             if (flag == false) {
@@ -339,73 +707,67 @@ void GeometryApp::draw()
 //            }
             break;
         case TWIST:
-            mTwistShader->uniform("mixAmount", mxAm);
-            mTwistShader->uniform("worldUp", mCamera.getWorldUp());
-            mTwistShader->uniform("angle_deg_max", angle_deg_max);
-            mTwistShader->uniform("height", height_of_cube);
-            mTwistShader->uniform("centerPoint", mCameraCOI);
+            setStageAmounts( mDeformShader, mTwistPipeline, params.elapsedSeconds );
+            mDeformShader->uniform("angle_deg_max", params.angleDegMax);
+            mDeformShader->uniform("height", height_of_cube);
+            mDeformShader->uniform("centerPoint", mCameraCOI);
             
             break;
         case SQUASH:
-            mSquashShader->uniform("mixAmount", mxAm);
-            mSquashShader->uniform("worldUp", mCamera.getWorldUp());
-            mSquashShader->uniform("angle_deg_max", angle_deg_max);
-            mSquashShader->uniform("height", height_of_cube);
-            mSquashShader->uniform("centerPoint", mCameraCOI);
+            setStageAmounts( mDeformShader, mSquashPipeline, params.elapsedSeconds );
+            mDeformShader->uniform("angle_deg_max", params.angleDegMax);
+            mDeformShader->uniform("height", height_of_cube);
+            mDeformShader->uniform("centerPoint", mCameraCOI);
             
-            mSquashShader->uniform("xlim", xlim);
-            mSquashShader->uniform("ylim", ylim);
-            mSquashShader->uniform("zlim", zlim);
+            mDeformShader->uniform("xlim", xlim);
+            mDeformShader->uniform("ylim", ylim);
+            mDeformShader->uniform("zlim", zlim);
             
             break;
         case SQUASH2:
-            mSquashShader2->uniform("mixAmount", mxAm);
-            mSquashShader2->uniform("worldUp", mCamera.getWorldUp());
-            mSquashShader2->uniform("angle_deg_max", angle_deg_max);
-            mSquashShader2->uniform("height", height_of_cube);
-            mSquashShader2->uniform("centerPoint", mCameraCOI);
+            setStageAmounts( mDeformShader, mSquash2Pipeline, params.elapsedSeconds );
+            mDeformShader->uniform("angle_deg_max", params.angleDegMax);
+            mDeformShader->uniform("height", height_of_cube);
+            mDeformShader->uniform("centerPoint", mCameraCOI);
             
-            mSquashShader2->uniform("xlim", xlim);
-            mSquashShader2->uniform("ylim", ylim);
-            mSquashShader2->uniform("zlim", zlim);
+            mDeformShader->uniform("xlim", xlim);
+            mDeformShader->uniform("ylim", ylim);
+            mDeformShader->uniform("zlim", zlim);
             
             break;
             
             
         case SPH:
-            mSphereShader->uniform("mixAmount", mxAm);
-            mSphereShader->uniform("worldUp", mCamera.getWorldUp());
-            mSphereShader->uniform("angle_deg_max", angle_deg_max);
-            mSphereShader->uniform("height", height_of_cube);
-            mSphereShader->uniform("centerPoint", mCameraCOI);
+            setStageAmounts( mDeformShader, mSpherePipeline, params.elapsedSeconds );
+            mDeformShader->uniform("angle_deg_max", params.angleDegMax);
+            mDeformShader->uniform("height", height_of_cube);
+            mDeformShader->uniform("centerPoint", mCameraCOI);
             
             break;
         
         case CUSTOM23:
-            mCustomShader23->uniform("mixAmount", mxAm);
-            mCustomShader23->uniform("worldUp", mCamera.getWorldUp());
-            mCustomShader23->uniform("angle_deg_max", angle_deg_max);
-            mCustomShader23->uniform("height", height_of_cube);
-            mCustomShader23->uniform("centerPoint", mCameraCOI);
+            setStageAmounts( mDeformShader, mCustom23Pipeline, params.elapsedSeconds );
+            mDeformShader->uniform("angle_deg_max", params.angleDegMax);
+            mDeformShader->uniform("height", height_of_cube);
+            mDeformShader->uniform("centerPoint", mCameraCOI);
             
-            mCustomShader23->uniform("xlim", xlim);
-            mCustomShader23->uniform("ylim", ylim);
-            mCustomShader23->uniform("zlim", zlim);
+            mDeformShader->uniform("xlim", xlim);
+            mDeformShader->uniform("ylim", ylim);
+            mDeformShader->uniform("zlim", zlim);
             
             break;
             
             
             
         case CUSTOM123:
-            mCustomShader123->uniform("mixAmount", mxAm);
-            mCustomShader123->uniform("worldUp", mCamera.getWorldUp());
-            mCustomShader123->uniform("angle_deg_max", angle_deg_max);
-            mCustomShader123->uniform("height", height_of_cube);
-            mCustomShader123->uniform("centerPoint", mCameraCOI);
+            setStageAmounts( mDeformShader, mCustom123Pipeline, params.elapsedSeconds );
+            mDeformShader->uniform("angle_deg_max", params.angleDegMax);
+            mDeformShader->uniform("height", height_of_cube);
+            mDeformShader->uniform("centerPoint", mCameraCOI);
             
-            mCustomShader123->uniform("xlim", xlim);
-            mCustomShader123->uniform("ylim", ylim);
-            mCustomShader123->uniform("zlim", zlim);
+            mDeformShader->uniform("xlim", xlim);
+            mDeformShader->uniform("ylim", ylim);
+            mDeformShader->uniform("zlim", zlim);
             
             break;
             
@@ -413,6 +775,8 @@ void GeometryApp::draw()
             
             break;
     }
+
+	updateNormals( params );
     
 
     
@@ -442,66 +806,53 @@ void GeometryApp::draw()
 		mGrid->draw();
 	}
 
-	if( mPrimitive ) {
+	if( mPrimitive && mMeshEntry ) {
 		gl::ScopedTextureBind scopedTextureBind( mTexture );
 
-		// Rotate it slowly around the y-axis.
-		gl::pushModelView();
-        
-        if (mTranslate) {
-            gl::translate(vec3(0,-mxAm*50,-mxAm*100));
-        }
-        
-        if (mTranslatexz) {
-            gl::translate(vec3(0,sin(-mxAm*50),cos(-mxAm*100)));
-        }
-        
-        
-        
-        if (mRotate) {
-            gl::rotate( float( getElapsedSeconds() / 5 ), 0.0f, 1.0f, 0.0f );
-        }
-        
-        if (mRotatexz) {
-            gl::rotate( float( getElapsedSeconds() / 5 ), 0.5f, 0.0f, 0.5f );
-        }
-        
-
+		// Only the objects in view cost a draw call.
+		mat4 animation = getAnimationTransform();
+		cullObjects( animation, params );
+		for( size_t v = 0; v < mVisibleObjects.size(); ++v ) {
+			gl::pushModelView();
+			gl::multModelMatrix( mObjectTransforms[mVisibleObjects[v]] * animation );
 
-		// Draw the normals.
-		if( mShowNormals && mNormals )
-			mNormals->draw();
+			// Draw the normals.
+			if( mShowNormals && mNormals )
+				mNormals->draw();
 
-		// Draw the primitive.
-		gl::color( Color(red, green, blue) );
+			// Draw the primitive.
+			gl::color( Color(red, green, blue) );
 		
-		// (If transparent, render the back side first).
-		if( mViewMode == WIREFRAME ) {
-			gl::enableAlphaBlending();
+			// (If transparent, render the back side first).
+			if( mViewMode == WIREFRAME ) {
+				gl::enableAlphaBlending();
 
-			gl::enable( GL_CULL_FACE );
-			glCullFace( GL_FRONT );
+				gl::enable( GL_CULL_FACE );
+				glCullFace( GL_FRONT );
 
-			mWireframeShader->uniform( "uBrightness", 0.5f );
-			mPrimitiveWireframe->draw();
-		}
+				mWireframeShader->uniform( "uBrightness", 0.5f );
+				mPrimitiveWireframe->draw();
+			}
 
-		// (Now render the front side.)
-		if( mViewMode == WIREFRAME ) {
-			glCullFace( GL_BACK );
+			// (Now render the front side.)
+			if( mViewMode == WIREFRAME ) {
+				glCullFace( GL_BACK );
 
-			mWireframeShader->uniform( "uBrightness", 1.0f );
-			mPrimitiveWireframe->draw();
+				mWireframeShader->uniform( "uBrightness", 1.0f );
+				mPrimitiveWireframe->draw();
 			
-			gl::disable( GL_CULL_FACE );
+				gl::disable( GL_CULL_FACE );
 
-			gl::disableAlphaBlending();
-		}
-		else
-			mPrimitive->draw();
+				gl::disableAlphaBlending();
+			}
+			else if( mPlayCache && mCachePrimitive )
+				mCachePrimitive->draw();
+			else
+				mPrimitive->draw();
 		
-		// Done.
-		gl::popModelView();
+			// Done.
+			gl::popModelView();
+		}
 	}
 
 	// Render the parameter window.
@@ -509,6 +860,14 @@ void GeometryApp::draw()
 	if( mParams )
 		mParams->draw();
 #endif
+
+	// Report the time from launch to the first frame, with everything that went into it done.
+	if( ! mStartupReported ) {
+		glFinish();
+		console() << "First frame after " << getElapsedSeconds() << " s, " << mProgramBinaries->getNumLoaded() << " programs loaded and "
+			<< mProgramBinaries->getNumCompiled() << " compiled" << ( mProgramBinaries->isSupported() ? "" : " (no program binaries)" ) << std::endl;
+		mStartupReported = true;
+	}
 }
 
 void GeometryApp::mouseDown( MouseEvent event )
@@ -559,17 +918,26 @@ void GeometryApp::keyDown( KeyEvent event )
 			else
 				mViewMode = WIREFRAME;
 			break;
+		case KeyEvent::KEY_t:
+			printTrigAccuracyReport( console() );
+			break;
 		case KeyEvent::KEY_RETURN:
-			createPlaneShader();
+			mDeformShaders->clear();
 			createPrimitive();
 			break;
 	}
 }
 
+void GeometryApp::fileDrop( FileDropEvent event )
+{
+	if( event.getNumFiles() > 0 )
+		loadMesh( event.getFile( 0 ) );
+}
+
 void GeometryApp::createParams()
 {
 #if ! defined( CINDER_GL_ES )
-	std::string primitives[] = { "Capsule", "Cone", "Cube", "Cylinder", "Helix", "Icosahedron", "Icosphere", "Sphere", "Teapot", "Torus", "Plane" };
+	std::string primitives[] = { "Capsule", "Cone", "Cube", "Cylinder", "Helix", "Icosahedron", "Icosphere", "Sphere", "Teapot", "Torus", "Plane", "Imported" };
     std::string transformation[] = { "Plane","Twist","Squash","Squash2","Sphere","Custom23","Custom123" };
 	std::string qualities[] = { "Low", "Default", "High" };
 //	std::string viewmodes[] = { "Shaded", "Wireframe" };
@@ -577,7 +945,7 @@ void GeometryApp::createParams()
 	mParams = params::InterfaceGl::create( getWindow(), "Transformations", ivec2( 340, 200 ) );
 	mParams->setOptions( "", "valueswidth=100 refresh=0.1" );
 
-	mParams->addParam( "Original", vector<string>(primitives,primitives+11), (int*) &mPrimitiveSelected );
+	mParams->addParam( "Original", vector<string>(primitives,primitives+12), (int*) &mPrimitiveSelected );
     mParams->addParam( "Transformation", vector<string>(transformation,transformation+7), (int*) &mTransformationSelected );
     mParams->addParam( "Translate", &mTranslate );
     mParams->addParam( "Translate", &mTranslatexz );
@@ -638,11 +1006,68 @@ void GeometryApp::createParams()
 		std::function<int()> getter		= std::bind( &GeometryApp::getSubdivision, this );
 		mParams->addParam( "Subdivision", setter, getter );
 	}
+	{
+		std::function<void(bool)> setter	= std::bind( &GeometryApp::enableSmoothSubdivision, this, std::placeholders::_1 );
+		std::function<bool()> getter		= std::bind( &GeometryApp::isSmoothSubdivisionEnabled, this );
+		mParams->addParam( "Smooth Subdivision", setter, getter );
+	}
+	{
+		std::function<void(int)> setter	= std::bind( &GeometryApp::setDetail, this, std::placeholders::_1 );
+		std::function<int()> getter		= std::bind( &GeometryApp::getDetail, this );
+		mParams->addParam( "Detail %", setter, getter );
+	}
+	{
+		std::function<void(bool)> setter	= std::bind( &GeometryApp::enableAutoLod, this, std::placeholders::_1 );
+		std::function<bool()> getter		= std::bind( &GeometryApp::isAutoLodEnabled, this );
+		mParams->addParam( "Auto LOD", setter, getter );
+	}
+	{
+		std::function<void(int)> setter	= std::bind( &GeometryApp::setTargetFps, this, std::placeholders::_1 );
+		std::function<int()> getter		= std::bind( &GeometryApp::getTargetFps, this );
+		mParams->addParam( "Target FPS", setter, getter );
+	}
+
+	mParams->addSeparator();
+
+	mParams->addButton( "Load Mesh", std::bind( &GeometryApp::openMesh, this ) );
+	mParams->addButton( "Bake Cache", std::bind( &GeometryApp::bakeCache, this ) );
+	mParams->addParam( "Play Cache", &mPlayCache );
+	{
+		std::function<void(int)> setter	= std::bind( &GeometryApp::setReadAhead, this, std::placeholders::_1 );
+		std::function<int()> getter		= std::bind( &GeometryApp::getReadAhead, this );
+		mParams->addParam( "Read Ahead", setter, getter );
+	}
+	{
+		std::function<void(bool)> setter	= std::bind( &GeometryApp::enableDropFrames, this, std::placeholders::_1 );
+		std::function<bool()> getter		= std::bind( &GeometryApp::isDropFramesEnabled, this );
+		mParams->addParam( "Drop Frames", setter, getter );
+	}
+	mParams->addParam( "Cache Stalls", &mCacheStalls, true );
+	mParams->addParam( "Frames Dropped", &mCacheDropped, true );
+	{
+		std::function<void(int)> setter	= std::bind( &GeometryApp::setMeshCacheBudget, this, std::placeholders::_1 );
+		std::function<int()> getter		= std::bind( &GeometryApp::getMeshCacheBudget, this );
+		mParams->addParam( "Mesh Cache MB", setter, getter );
+	}
+
+	mParams->addSeparator();
+
+	{
+		std::function<void(int)> setter	= std::bind( &GeometryApp::setNumObjects, this, std::placeholders::_1 );
+		std::function<int()> getter		= std::bind( &GeometryApp::getNumObjects, this );
+		mParams->addParam( "Objects", setter, getter );
+	}
+	mParams->addParam( "Visible Objects", &mNumVisibleObjects, true );
 
 	mParams->addSeparator();
 
 	mParams->addParam( "Show Grid", &mShowGrid );
 	mParams->addParam( "Show Normals", &mShowNormals );
+	{
+		std::function<void(int)> setter	= std::bind( &GeometryApp::setNormalsBudget, this, std::placeholders::_1 );
+		std::function<int()> getter		= std::bind( &GeometryApp::getNormalsBudget, this );
+		mParams->addParam( "Normals Budget", setter, getter );
+	}
 	{
 		std::function<void(bool)> setter	= std::bind( &GeometryApp::enableColors, this, std::placeholders::_1 );
 		std::function<bool()> getter		= std::bind( &GeometryApp::isColorsEnabled, this );
@@ -682,23 +1107,25 @@ void GeometryApp::createGrid()
 	mGrid->end();
 }
 
-void GeometryApp::createPrimitive(void)
+geom::SourceRef GeometryApp::createSource( Quality quality )
 {
 	geom::SourceRef primitive;
-	std::string     name;
 
 	switch( mPrimitiveCurrent ) {
+	case IMPORTED:
+		// shared with the builder thread, so colors are whatever the file had
+		return mImportedMesh;
 	default:
 		mPrimitiveSelected = CAPSULE;
 	case CAPSULE:
-		switch(mQualityCurrent) {
+		switch(quality) {
 			case DEFAULT: primitive = geom::SourceRef( new geom::Capsule( geom::Capsule() ) ); break;
 			case LOW: primitive = geom::SourceRef( new geom::Capsule( geom::Capsule().subdivisionsAxis( 6 ).subdivisionsHeight( 1 ) ) ); break;
 			case HIGH: primitive = geom::SourceRef( new geom::Capsule( geom::Capsule().subdivisionsAxis( 60 ).subdivisionsHeight( 20 ) ) ); break;
 		}
 		break;
 	case CONE:
-		switch(mQualityCurrent) {
+		switch(quality) {
 			case DEFAULT: primitive = geom::SourceRef( new geom::Cone() ); break;
 			case LOW: primitive = geom::SourceRef( new geom::Cone( geom::Cone().subdivisionsAxis( 6 ).subdivisionsHeight( 1 ) ) ); break;
 			case HIGH: primitive = geom::SourceRef( new geom::Cone( geom::Cone().subdivisionsAxis( 60 ).subdivisionsHeight( 60 ) ) ); break;
@@ -708,14 +1135,14 @@ void GeometryApp::createPrimitive(void)
 		primitive = geom::SourceRef( new geom::Cube( geom::Cube() ) );
 		break;
 	case CYLINDER:
-		switch(mQualityCurrent) {
+		switch(quality) {
 			case DEFAULT: primitive = geom::SourceRef( new geom::Cylinder( geom::Cylinder() ) ); break;
 			case LOW: primitive = geom::SourceRef( new geom::Cylinder( geom::Cylinder().subdivisionsAxis( 6 ) ) ); break;
 			case HIGH: primitive = geom::SourceRef( new geom::Cylinder( geom::Cylinder().subdivisionsAxis( 60 ).subdivisionsHeight( 20 ) ) ); break;
 		}
 		break;
 	case HELIX:
-		switch(mQualityCurrent) {
+		switch(quality) {
 			case DEFAULT: primitive = geom::SourceRef( new geom::Helix( geom::Helix() ) ); break;
 			case LOW: primitive = geom::SourceRef( new geom::Helix( geom::Helix().subdivisionsHeight( 12 ).subdivisionsHeight( 6 ) ) ); break;
 			case HIGH: primitive = geom::SourceRef( new geom::Helix( geom::Helix().subdivisionsHeight( 60 ).subdivisionsHeight( 60 ) ) ); break;
@@ -725,28 +1152,28 @@ void GeometryApp::createPrimitive(void)
 		primitive = geom::SourceRef( new geom::Icosahedron( geom::Icosahedron() ) );
 		break;
 	case ICOSPHERE:
-		switch(mQualityCurrent) {
+		switch(quality) {
 			case DEFAULT: primitive = geom::SourceRef( new geom::Icosphere( geom::Icosphere() ) ); break;
 			case LOW: primitive = geom::SourceRef( new geom::Icosphere( geom::Icosphere().subdivisions( 1 ) ) ); break;
 			case HIGH: primitive = geom::SourceRef( new geom::Icosphere( geom::Icosphere().subdivisions( 5 ) ) ); break;
 		}
 		break;
 	case SPHERE:
-		switch(mQualityCurrent) {
+		switch(quality) {
 			case DEFAULT: primitive = geom::SourceRef( new geom::Sphere( geom::Sphere() ) ); break;
 			case LOW: primitive = geom::SourceRef( new geom::Sphere( geom::Sphere().subdivisions( 6 ) ) ); break;
 			case HIGH: primitive = geom::SourceRef( new geom::Sphere( geom::Sphere().subdivisions( 60 ) ) ); break;
 		}
 		break;
 	case TEAPOT:
-		switch(mQualityCurrent) {
+		switch(quality) {
 			case DEFAULT: primitive = geom::SourceRef( new geom::Teapot( geom::Teapot() ) ); break;
 			case LOW: primitive = geom::SourceRef( new geom::Teapot( geom::Teapot().subdivisions( 2 ) ) ); break;
 			case HIGH: primitive = geom::SourceRef( new geom::Teapot( geom::Teapot().subdivisions( 12 ) ) ); break;
 		}
 		break;
 	case TORUS:
-		switch(mQualityCurrent) {
+		switch(quality) {
 			case DEFAULT: primitive = geom::SourceRef( new geom::Torus( geom::Torus() ) ); break;
 			case LOW: primitive = geom::SourceRef( new geom::Torus( geom::Torus().subdivisionsAxis( 12 ).subdivisionsHeight( 6 ) ) ); break;
 			case HIGH: primitive = geom::SourceRef( new geom::Torus( geom::Torus().subdivisionsAxis( 60 ).subdivisionsHeight( 60 ) ) ); break;
@@ -754,7 +1181,7 @@ void GeometryApp::createPrimitive(void)
 		break;
 	case PLANE:
 			ivec2 numSegments;
-			switch( mQualityCurrent ) {
+			switch( quality ) {
 				case DEFAULT: numSegments = ivec2( 10, 10 ); break;
 				case LOW: numSegments = ivec2( 2, 2 ); break;
 				case HIGH: numSegments = ivec2( 100, 100 ); break;
@@ -773,1150 +1200,392 @@ void GeometryApp::createPrimitive(void)
 
 	if( mShowColors )
 		primitive->enable( geom::Attrib::COLOR );
-	
-	TriMesh mesh( *primitive );
-	mCameraCOI = mesh.calcBoundingBox().getCenter();
+	return primitive;
+}
+
+MeshKey GeometryApp::makeMeshKey( Quality quality, int subdivision, int detail ) const
+{
+	MeshKey key;
+	key.primitive = mPrimitiveCurrent;
+	key.quality = quality;
+	key.subdivision = subdivision;
+	key.smooth = mSmoothSubdivision;
+	key.detail = detail;
+	key.attributes = mShowColors ? ( 1u << static_cast<int>( geom::Attrib::COLOR ) ) : 0;
+	return key;
+}
+
+void GeometryApp::createPrimitive(void)
+{
+	// update() moves off IMPORTED before anything was imported; nothing is built for it meanwhile, as it
+	// would be cached under the key of the import
+	if( mPrimitiveCurrent == IMPORTED && ! mImportedMesh )
+		return;
+
+	// building and uploading the mesh is the expensive part, so it is only done once per geometry
+	MeshKey key = makeMeshKey( mQualityCurrent, mSubdivision, mDetail );
+	mWantedKey = key;
+
+	MeshCacheEntryRef entry = mMeshCache.find( key );
+	if( entry ) {
+		// anything still being built was superseded by this
+		mMeshBuilder->cancel();
+		showMesh( key, entry );
+	}
+	else if( ! mMeshEntry ) {
+		// nothing to draw meanwhile, so the first mesh is built right away
+		MeshBuilder::Result result;
+		MeshBuilder::build( *createSource( mQualityCurrent ), key, &result );
+		showMesh( key, uploadMesh( result ) );
+	}
+	else {
+		// keep drawing the current mesh, with the current transformation, until update() finds the new one
+		mMeshBuilder->request( key, createSource( mQualityCurrent ) );
+		createBatches();
+		getWindow()->setTitle( "Transform (building mesh)" );
+	}
+
+	// after the request, so that the mesh just asked for is not prefetched as well
+	if( mAutoLod )
+		prefetchLodChain( key );
+}
+
+void GeometryApp::prefetchLodChain( const MeshKey &key )
+{
+	if( key.primitive == mLodChain.primitive && key.smooth == mLodChain.smooth && key.attributes == mLodChain.attributes )
+		return;
+
+	mLodChain = key;
+	mLodSelector.reset( NUM_LOD_LEVELS, findLodLevel( mQualityCurrent, mSubdivision, mDetail ) );
+
+	// the previous primitive's levels are of no use anymore; the coarse ones are what a slow frame falls back on, so they come first
+	mMeshBuilder->cancelPrefetches();
+	for( size_t level = 0; level < NUM_LOD_LEVELS; ++level ) {
+		MeshKey levelKey = makeMeshKey( sLodLevels[level].quality, sLodLevels[level].subdivision, sLodLevels[level].detail );
+		if( MeshCacheEntryRef entry = mMeshCache.find( levelKey ) )
+			mLodSelector.setTriangleCount( level, entry->mesh->getNumTriangles() );
+		else
+			mMeshBuilder->prefetch( levelKey, createSource( sLodLevels[level].quality ) );
+	}
+}
+
+size_t GeometryApp::findLodLevel( Quality quality, int subdivision, int detail ) const
+{
+	size_t level = 0;
+	while( level + 1 < NUM_LOD_LEVELS ) {
+		const Quality nextQuality = sLodLevels[level + 1].quality;
+		const int nextSubdivision = sLodLevels[level + 1].subdivision, nextDetail = sLodLevels[level + 1].detail;
+		if( nextQuality > quality || ( nextQuality == quality && ( nextSubdivision > subdivision
+			|| ( nextSubdivision == subdivision && nextDetail > detail ) ) ) )
+			break;
+		++level;
+	}
+	return level;
+}
+
+AxisAlignedBox3f GeometryApp::getDeformedBounds( const MeshCacheEntry &entry, const DeformParams &params ) const
+{
+	// the wireframe shader draws the mesh at rest, and the transformations also shrink it
+	if( mViewMode == WIREFRAME )
+		return toBox( entry.restBounds.position );
+
+	Deformer deformer( static_cast<Deformer::Type>( mTransformation ) );
+	deformer.setParams( params );
+	// the cached frames sweep the twist angle, see bakeCache()
+	if( mPlayCache && mCachePrimitive )
+		return deformer.getAnimationBounds( entry.restBounds, 0.0f, 360.0f );
+	return deformer.getBounds( entry.restBounds );
+}
+
+mat4 GeometryApp::getAnimationTransform() const
+{
+	float mxAm = 0.05 * (1.0 + sin(getElapsedSeconds()));
+
+	mat4 transform;
+	if( mTranslate )
+		transform = glm::translate( transform, vec3( 0, -mxAm * 50, -mxAm * 100 ) );
+	if( mTranslatexz )
+		transform = glm::translate( transform, vec3( 0, sin( -mxAm * 50 ), cos( -mxAm * 100 ) ) );
+	// Rotate it slowly around the y-axis.
+	if( mRotate )
+		transform = glm::rotate( transform, float( getElapsedSeconds() / 5 ), vec3( 0.0f, 1.0f, 0.0f ) );
+	if( mRotatexz )
+		transform = glm::rotate( transform, float( getElapsedSeconds() / 5 ), vec3( 0.5f, 0.0f, 0.5f ) );
+	return transform;
+}
+
+void GeometryApp::layoutObjects()
+{
+	int columns = (int) std::ceil( std::sqrt( (float) mNumObjects ) );
+	int rows = ( mNumObjects + columns - 1 ) / columns;
+	mObjectTransforms.resize( mNumObjects );
+	for( int i = 0; i < mNumObjects; ++i ) {
+		vec3 position( ( i % columns - 0.5f * ( columns - 1 ) ) * OBJECT_SPACING, 0.0f, ( i / columns - 0.5f * ( rows - 1 ) ) * OBJECT_SPACING );
+		mObjectTransforms[i] = glm::translate( mat4(), position );
+	}
+}
+
+void GeometryApp::cullObjects( const mat4 &animation, const DeformParams &params )
+{
+	// every object deforms alike, so one box in object space does for all of them
+	AxisAlignedBox3f bounds = getDeformedBounds( *mMeshEntry, params ).transformed( animation );
+	mObjectBounds.resize( mObjectTransforms.size() );
+	for( size_t i = 0; i < mObjectTransforms.size(); ++i )
+		mObjectBounds[i] = bounds.transformed( mObjectTransforms[i] );
+	mSceneBvh.refit( mObjectBounds );
+
+	mVisibleObjects.clear();
+	mSceneBvh.cull( Frustum( mCamera.getProjectionMatrix() * mCamera.getViewMatrix() ), &mVisibleObjects );
+	mNumVisibleObjects = (int32_t) mVisibleObjects.size();
+}
+
+float GeometryApp::getProjectedArea( const MeshCacheEntry &entry ) const
+{
+	// the transformations move vertices far outside the rest mesh, so its own sphere would not do
+	AxisAlignedBox3f bounds = getDeformedBounds( entry, getDeformParams() );
+	float boundsRadius = 0.5f * length( bounds.getSize() );
+	float distance = glm::distance( mCamera.getEyePoint(), bounds.getCenter() );
+	if( distance <= boundsRadius )
+		return 1e12f;
+
+	// radius in pixels: the sphere covers radius / distance of the half-height tan(fov / 2) at distance 1
+	float radius = boundsRadius / ( distance * tan( toRadians( mCamera.getFov() ) * 0.5f ) ) * 0.5f * toPixels( (float) getWindowHeight() );
+	return 3.14159265f * radius * radius;
+}
+
+MeshCacheEntryRef GeometryApp::uploadMesh( const MeshBuilder::Result &result )
+{
+	console() << "Built " << result.mesh->getNumTriangles() << " triangles, ACMR " << result.optimization.acmrBefore
+		<< " -> " << result.optimization.acmrAfter << std::endl;
+
+	// a level of detail can be stepped up to once it is built
+	if( mAutoLod && result.key.primitive == mLodChain.primitive && result.key.smooth == mLodChain.smooth && result.key.attributes == mLodChain.attributes ) {
+		for( size_t level = 0; level < NUM_LOD_LEVELS; ++level )
+			if( result.key.quality == sLodLevels[level].quality && result.key.subdivision == sLodLevels[level].subdivision
+				&& result.key.detail == sLodLevels[level].detail )
+				mLodSelector.setTriangleCount( level, result.mesh->getNumTriangles() );
+	}
+
+	MeshCacheEntryRef entry = MeshCacheEntry::create( result.mesh, result.center );
+	entry->normals = result.normals;
+	return entry;
+}
+
+void GeometryApp::sampleNormals()
+{
+	if( mNormals ) {
+		mNormals->setMaxLines( (size_t) mNormalsBudget, &ThreadPool::instance() );
+		mNormalsRest = VertexStreams();
+	}
+}
+
+void GeometryApp::updateNormals( const DeformParams &params )
+{
+	// during playback, update() moves them with every new frame
+	if( ! mShowNormals || ! mNormals || ! mMeshEntry || mPlayCache )
+		return;
+
+	mNormalsDeformer.setType( static_cast<Deformer::Type>( mTransformation ) );
+	mNormalsDeformer.setParams( params );
+	if( ! mNormalsRest.getNumVertices() ) {
+		// only the sampled vertices need deforming, along with their tangents
+		if( mNormals->getVertices().empty() )
+			mNormalsRest.setMesh( *mMeshEntry->mesh, true );
+		else
+			mNormalsRest.gather( VertexStreams( *mMeshEntry->mesh, true ), mNormals->getVertices() );
+		mNormalsDeformer.bake( mNormalsRest );
+	}
+
+	// the wireframe shader draws the mesh at rest
+	if( mViewMode == WIREFRAME )
+		mNormals->update( mNormalsRest.getInput(), 1, true, &ThreadPool::instance() );
+	else {
+		mNormalsDeformer.apply( mNormalsRest, &mNormalsDeformed, ThreadPool::instance() );
+		mNormals->update( mNormalsDeformed.getInput(), 1, true, &ThreadPool::instance() );
+	}
+}
+
+void GeometryApp::showMesh( const MeshKey &key, const MeshCacheEntryRef &entry )
+{
+	mCameraCOI = entry->center;
     //mCameraCOI += mCameraCOI + vec3(0.0,0.0,5.0);
 	mRecenterCamera = true;
 
-	if(mSubdivision > 1)
-		mesh.subdivide(mSubdivision);
+	// a baked cache belongs to the previous primitive
+	mMeshEntry = entry;
+	mCacheReader.reset();
+	mCache.reset();
+	mCachePrimitive.reset();
 
-	
-    switch (mTransformation) {
+	createBatches();
+
+	// (re)insert after the invariants were baked, so that they count towards the budget
+	mMeshCache.insert( key, entry );
+
+	getWindow()->setTitle( "Transform");
+}
+
+void GeometryApp::createBatches()
+{
+	MeshCacheEntry &entry = *mMeshEntry;
+	mDeformShader = getDeformShader( getDeformPermutation() );
+	if( ! mDeformShader )
+		mPrimitive.reset();
+	else switch (mTransformation) {
         case PLA:
-            mPrimitive = gl::Batch::create( mesh, mPlaneShader );
+            mPrimitive = createDeformBatch( entry, mPlanePipeline, mDeformShader );
             break;
         case TWIST:
-            mPrimitive = gl::Batch::create( mesh, mTwistShader );
+            mPrimitive = createDeformBatch( entry, mTwistPipeline, mDeformShader );
             break;
         case SQUASH:
-            mPrimitive = gl::Batch::create( mesh, mSquashShader );
+            mPrimitive = createDeformBatch( entry, mSquashPipeline, mDeformShader );
             break;
         case SQUASH2:
-            mPrimitive = gl::Batch::create( mesh, mSquashShader2 );
+            mPrimitive = createDeformBatch( entry, mSquash2Pipeline, mDeformShader );
             break;
         case SPH:
-            mPrimitive = gl::Batch::create( mesh, mSphereShader );
+            mPrimitive = createDeformBatch( entry, mSpherePipeline, mDeformShader );
             break;
         case CUSTOM23:
-            mPrimitive = gl::Batch::create( mesh, mCustomShader23 );
+            mPrimitive = createDeformBatch( entry, mCustom23Pipeline, mDeformShader );
             break;
         case CUSTOM123:
-            mPrimitive = gl::Batch::create( mesh, mCustomShader123 );
+            mPrimitive = createDeformBatch( entry, mCustom123Pipeline, mDeformShader );
             break;
         default:
-            mPrimitive = gl::Batch::create( mesh, mPlaneShader );
+            mPrimitive = gl::Batch::create( entry.vboMesh, mDeformShader );
             break;
     }
     
     
-	mPrimitiveWireframe = gl::Batch::create( mesh, mWireframeShader );
-	mNormals = gl::Batch::create( DebugMesh( mesh, Color(1,1,0) ), gl::context()->getStockShader( gl::ShaderDef().color() ) );
-    mNormals_to_plane = gl::Batch::create( DebugMesh( mesh, Color(1,1,0) ), gl::context()->getStockShader( gl::ShaderDef().color() ) );
-
-	getWindow()->setTitle( "Transform");
+	mPrimitiveWireframe = gl::Batch::create( entry.vboMesh, mWireframeShader );
+	mNormals = entry.normals;
+	mNormalsDeformer.clearBaked();
+	sampleNormals();
 }
 
 
 
-void GeometryApp::createCustomShader123(void){
-    try {
-		mCustomShader123 = gl::GlslProg::create( gl::GlslProg::Format()
-                                               .vertex(
-                                                       "#version 150\n"
-                                                       "\n"
-                                                       "uniform mat4	ciModelViewProjection;\n"
-                                                       "uniform mat4	ciModelView;\n"
-                                                       "uniform mat3	ciNormalMatrix;\n"
-                                                       "uniform float	mixAmount;\n"
-                                                       "uniform vec3 worldUp;\n"
-                                                       "uniform float ciElapsedSeconds;\n"
-                                                       "uniform float angle_deg_max;\n"
-                                                       "uniform float height;\n"
-                                                       "uniform vec3 centerPoint;\n"
-                                                       "const float PI = 3.1415926535897932384626433832795;\n"
-                                                       "\n"
-                                                       "in vec4		ciPosition;\n"
-                                                       "in vec3		ciNormal;\n"
-                                                       "in vec4		ciColor;\n"
-                                                       "\n"
-                                                       
-                                                       "uniform float xlim;\n"
-                                                       "uniform float ylim;\n"
-                                                       "uniform float zlim;\n"
-                                                       
-                                                       "in vec2		ciTexCoord0;\n"
-                                                       "out vec2 vUv;\n"
-                                                       "uniform bool flag;\n"
-                                                       "\n"
-                                                       "out VertexData {\n"
-                                                       "	vec4 position;\n"
-                                                       "	vec3 normal;\n"
-                                                       "	vec4 color;\n"
-                                                       "} vVertexOut;\n"
-                                                       "\n"
-                                                       
-                                                       "vec4 stretch(vec4 pos,bool stretch){\n"
-                                                       "float disty = centerPoint.y - pos.y;\n"
-                                                       "float distx = centerPoint.x - pos.x;\n"
-                                                       "float distz = centerPoint.z - pos.z;\n"
-                                                       "float dist = abs(distance(centerPoint,vec3(pos)));\n"
-                                                       "  vec4 new_pos;\n"
-                                                       "  new_pos.y = ylim * dist/2 * pos.y;\n"
-                                                       "  //new_pos.y = sin( -PI * sqrt(length(pos.xz)));\n"
-                                                       "  new_pos.x = xlim * dist/2 * pos.x;\n"
-                                                       "  new_pos.z = zlim * dist * pos.z;\n"
-                                                       "\n"
-                                                       "  //new_pos.y = pos.z;\n"
-                                                       "  //new_pos.x = dist * pos.y;\n"
-                                                       "  //new_pos.z = dist * pos.x;\n"
-                                                       "\n"
-                                                       "  //new_pos.z = pos.z;\n"
-                                                       "  new_pos.w = pos.w;\n"
-                                                       "  return new_pos;\n"
-                                                       "}\n"
-                                                       
-                                                       "\n"
-                                                       "   vec4 DoTwist(vec4 pos, float t){\n"
-                                                       "        float st = sin(t);\n"
-                                                       "        float ct = cos(t);\n"
-                                                       "        vec4 new_pos;\n"
-                                                       "        new_pos.y = pos.y;\n"
-                                                       "        new_pos.z = pos.x * st + pos.z * ct;\n"
-                                                       "        new_pos.x = pos.x * ct - pos.z * st;\n"
-                                                       "        new_pos.w = pos.w;\n"
-                                                       "\n"
-                                                       "        return(new_pos);\n"
-                                                       "    }\n"
-                                                       "\n"
-                                                       "void main(void) {\n"
-                                                       "float angle_deg = angle_deg_max * sin(ciElapsedSeconds);\n"
-                                                       "float angle_rad = angle_deg * 3.14159 / 180.0;\n"
-                                                       "float ang = (height*0.5 + ciPosition.y)/height * angle_rad;\n"
-                                                       "vec4 twistedPosition = DoTwist(ciPosition,ang);\n"
-                                                       "vec4 twistedNormal = DoTwist(vec4(ciNormal,1.0),ang);\n"
-                                                       "float mxAm = 0.1 * (1.0 + sin(ciElapsedSeconds));\n"
-                                                       "float mxAm2 = 0.5 * (1.0 + sin(ciElapsedSeconds));\n"
-                                                       
-                                                       "vec3 goalPosition = 5.0 * vec3(-ciTexCoord0.x,ciTexCoord0.y,-ciTexCoord0.x) ;\n"
-                                                       "vec4 newPosition_tt = mix(ciPosition,vec4(goalPosition,1.0),mxAm2);\n"
-                                                       "vec3 wU_tt = cross(worldUp,vec3(newPosition_tt));\n"
-                                                       "vec3 newNormal_tt = mix(ciNormal,wU_tt,mxAm2);\n"
-                                                       "vUv = ciTexCoord0;\n"
-                                                       
-                                                       "vec4 stretch_new_pos = stretch(twistedPosition,true);\n"
-                                                       "vec4 stretch_new_normal = stretch(twistedNormal,true);\n"
-                                                       
-                                                       "//vec4 newPosition = mix(ciPosition,vec4(goalPosition,1.0),mxAm);\n"
-                                                       "//vec3 wU = cross(worldUp,vec3(newPosition));\n"
-                                                       "//vec3 newNormal = mix(ciNormal,wU,mxAm);\n"
-                                                       "\n"
-                                                       "vec4 newPosition_t = mix(newPosition_tt,stretch_new_pos,mxAm);\n"
-                                                       "vec3 wU_t = cross(worldUp,vec3(stretch_new_pos));\n"
-                                                       "vec3 newNormal_t = mix(vec3(newNormal_tt),vec3(stretch_new_normal),mxAm);\n"
-                                                       
-                                                       "vec4 newPosition = mix(newPosition_t,twistedPosition,mxAm);\n"
-                                                       "vec3 wU = cross(worldUp,vec3(twistedPosition));\n"
-                                                       "vec3 newNormal = mix(newNormal_t,vec3(twistedNormal),mxAm);\n"
-                                                       
-                                                       "//vec4 newPosition = mix(twistedPosition,stretch_new_pos,mxAm);\n"
-                                                       "//vec3 wU = cross(worldUp,vec3(stretch_new_pos));\n"
-                                                       "//vec3 newNormal = mix(vec3(twistedNormal),vec3(stretch_new_normal),mxAm);\n"
-                                                       "\n"
-                                                       "	//vVertexOut.position = ciModelView * ciPosition;\n"
-                                                       "	vVertexOut.position = ciModelView * newPosition;\n"
-                                                       "	vVertexOut.normal = ciNormalMatrix * newNormal;\n"
-                                                       "	//vVertexOut.position = ciModelView * twistedPosition;\n"
-                                                       "	//vVertexOut.normal = ciNormalMatrix * vec3(twistedNormal);\n"
-                                                       "	vVertexOut.color = ciColor;\n"
-                                                       "	//gl_Position = ciModelViewProjection * ciPosition;\n"
-                                                       "	gl_Position = ciModelViewProjection * newPosition;\n"
-                                                       "	//gl_Position = ciModelViewProjection * twistedPosition;\n"
-                                                       "}\n"
-                                                       )
-                                               .fragment(
-                                                         "#version 150\n"
-                                                         "\n"
-                                                         "in VertexData	{\n"
-                                                         "	vec4 position;\n"
-                                                         "	vec3 normal;\n"
-                                                         "	vec4 color;\n"
-                                                         "} vVertexIn;\n"
-                                                         "\n"
-                                                         "out vec4 oColor;\n"
-                                                         "in vec2 vUv;\n"
-                                                         "uniform sampler2D baseTexture;\n"
-                                                         "\n"
-                                                         "void main(void) {\n"
-                                                         "	// set diffuse and specular colors\n"
-                                                         "	vec3 cDiffuse = vVertexIn.color.rgb;\n"
-                                                         "	vec3 cSpecular = vec3(0.3, 0.3, 0.3);\n"
-                                                         "\n"
-                                                         "	// light properties in view space\n"
-                                                         "	vec3 vLightPosition = vec3(0.0, 0.0, 0.0);\n"
-                                                         "\n"
-                                                         "	// lighting calculations\n"
-                                                         "	vec3 vVertex = vVertexIn.position.xyz;\n"
-                                                         "	vec3 vNormal = normalize( vVertexIn.normal );\n"
-                                                         "	vec3 vToLight = normalize( vLightPosition - vVertex );\n"
-                                                         "	vec3 vToEye = normalize( -vVertex );\n"
-                                                         "	vec3 vReflect = normalize( -reflect(vToLight, vNormal) );\n"
-                                                         "\n"
-                                                         "	// diffuse coefficient\n"
-                                                         "	vec3 diffuse = max( dot( vNormal, vToLight ), 0.0 ) * cDiffuse;\n"
-                                                         "\n"
-                                                         "	// specular coefficient with energy conservation\n"
-                                                         "	const float shininess = 20.0;\n"
-                                                         "	const float coeff = (2.0 + shininess) / (2.0 * 3.14159265);\n"
-                                                         "	vec3 specular = pow( max( dot( vReflect, vToEye ), 0.0 ), shininess ) * coeff * cSpecular;\n"
-                                                         "\n"
-                                                         "	// to conserve energy, diffuse and specular colors should not exceed one\n"
-                                                         "	float maxDiffuse = max(diffuse.r, max(diffuse.g, diffuse.b));\n"
-                                                         "	float maxSpecular = max(specular.r, max(specular.g, specular.b));\n"
-                                                         "	float fConserve = 1.0 / max(1.0, maxDiffuse + maxSpecular);\n"
-                                                         "\n"
-                                                         "	// final color\n"
-                                                         "	oColor.rgb = (diffuse + specular) * fConserve;\n"
-                                                         "	//oColor.rgb = vec3(texture(baseTexture,vUv),0.0);\n"
-                                                         "	oColor.a = 1.0;\n"
-                                                         "}\n"
-                                                         )
-                                               );
-	}
-	catch( const std::exception& e ) {
-		console() << e.what() << std::endl;
-	}
-}
-
-
-
-
-void GeometryApp::createCustomShader23(void){
-    try {
-		mCustomShader23 = gl::GlslProg::create( gl::GlslProg::Format()
-                                            .vertex(
-                                                    "#version 150\n"
-                                                    "\n"
-                                                    "uniform mat4	ciModelViewProjection;\n"
-                                                    "uniform mat4	ciModelView;\n"
-                                                    "uniform mat3	ciNormalMatrix;\n"
-                                                    "uniform float	mixAmount;\n"
-                                                    "uniform vec3 worldUp;\n"
-                                                    "uniform float ciElapsedSeconds;\n"
-                                                    "uniform float angle_deg_max;\n"
-                                                    "uniform float height;\n"
-                                                    "uniform vec3 centerPoint;\n"
-                                                    "const float PI = 3.1415926535897932384626433832795;\n"
-                                                    "\n"
-                                                    "in vec4		ciPosition;\n"
-                                                    "in vec3		ciNormal;\n"
-                                                    "in vec4		ciColor;\n"
-                                                    "\n"
-                                                    
-                                                    "uniform float xlim;\n"
-                                                    "uniform float ylim;\n"
-                                                    "uniform float zlim;\n"
-                                                    
-                                                    "in vec2		ciTexCoord0;\n"
-                                                    "out vec2 vUv;\n"
-                                                    "uniform bool flag;\n"
-                                                    "\n"
-                                                    "out VertexData {\n"
-                                                    "	vec4 position;\n"
-                                                    "	vec3 normal;\n"
-                                                    "	vec4 color;\n"
-                                                    "} vVertexOut;\n"
-                                                    "\n"
-                                                    
-                                                    "vec4 stretch(vec4 pos,bool stretch){\n"
-                                                    "float disty = centerPoint.y - pos.y;\n"
-                                                    "float distx = centerPoint.x - pos.x;\n"
-                                                    "float distz = centerPoint.z - pos.z;\n"
-                                                    "float dist = abs(distance(centerPoint,vec3(pos)));\n"
-                                                    "  vec4 new_pos;\n"
-                                                    "  new_pos.y = ylim * dist/2 * pos.y;\n"
-                                                    "  //new_pos.y = sin( -PI * sqrt(length(pos.xz)));\n"
-                                                    "  new_pos.x = xlim * dist/2 * pos.x;\n"
-                                                    "  new_pos.z = zlim * dist * pos.z;\n"
-                                                    "\n"
-                                                    "  //new_pos.y = pos.z;\n"
-                                                    "  //new_pos.x = dist * pos.y;\n"
-                                                    "  //new_pos.z = dist * pos.x;\n"
-                                                    "\n"
-                                                    "  //new_pos.z = pos.z;\n"
-                                                    "  new_pos.w = pos.w;\n"
-                                                    "  return new_pos;\n"
-                                                    "}\n"
-                                                    
-                                                    "\n"
-                                                    "   vec4 DoTwist(vec4 pos, float t){\n"
-                                                    "        float st = sin(t);\n"
-                                                    "        float ct = cos(t);\n"
-                                                    "        vec4 new_pos;\n"
-                                                    "        new_pos.y = pos.y;\n"
-                                                    "        new_pos.z = pos.x * st + pos.z * ct;\n"
-                                                    "        new_pos.x = pos.x * ct - pos.z * st;\n"
-                                                    "        new_pos.w = pos.w;\n"
-                                                    "\n"
-                                                    "        return(new_pos);\n"
-                                                    "    }\n"
-                                                    "\n"
-                                                    "void main(void) {\n"
-                                                    "float angle_deg = angle_deg_max * sin(ciElapsedSeconds);\n"
-                                                    "float angle_rad = angle_deg * 3.14159 / 180.0;\n"
-                                                    "float ang = (height*0.5 + ciPosition.y)/height * angle_rad;\n"
-                                                    "vec4 twistedPosition = DoTwist(ciPosition,ang);\n"
-                                                    "vec4 twistedNormal = DoTwist(vec4(ciNormal,1.0),ang);\n"
-                                                    "float mxAm = 0.1 * (1.0 + sin(ciElapsedSeconds));\n"
-                                                    "float mxAm2 = 0.5 * (1.0 + sin(ciElapsedSeconds));\n"
-                                                    "vUv = ciTexCoord0;\n"
-                                                    
-                                                    "vec4 stretch_new_pos = stretch(twistedPosition,true);\n"
-                                                    "vec4 stretch_new_normal = stretch(twistedNormal,true);\n"
-                                                    
-                                                    "//vec4 newPosition = mix(ciPosition,vec4(goalPosition,1.0),mxAm);\n"
-                                                    "//vec3 wU = cross(worldUp,vec3(newPosition));\n"
-                                                    "//vec3 newNormal = mix(ciNormal,wU,mxAm);\n"
-                                                    "\n"
-                                                    "vec4 newPosition_t = mix(ciPosition,stretch_new_pos,mxAm);\n"
-                                                    "vec3 wU_t = cross(worldUp,vec3(stretch_new_pos));\n"
-                                                    "vec3 newNormal_t = mix(vec3(ciNormal),vec3(stretch_new_normal),mxAm);\n"
-                                                    
-                                                    "vec4 newPosition = mix(newPosition_t,twistedPosition,mxAm);\n"
-                                                    "vec3 wU = cross(worldUp,vec3(twistedPosition));\n"
-                                                    "vec3 newNormal = mix(newNormal_t,vec3(twistedNormal),mxAm);\n"
-                                                    
-                                                    "//vec4 newPosition = mix(twistedPosition,stretch_new_pos,mxAm);\n"
-                                                    "//vec3 wU = cross(worldUp,vec3(stretch_new_pos));\n"
-                                                    "//vec3 newNormal = mix(vec3(twistedNormal),vec3(stretch_new_normal),mxAm);\n"
-                                                    "\n"
-                                                    "	//vVertexOut.position = ciModelView * ciPosition;\n"
-                                                    "	vVertexOut.position = ciModelView * newPosition;\n"
-                                                    "	vVertexOut.normal = ciNormalMatrix * newNormal;\n"
-                                                    "	//vVertexOut.position = ciModelView * twistedPosition;\n"
-                                                    "	//vVertexOut.normal = ciNormalMatrix * vec3(twistedNormal);\n"
-                                                    "	vVertexOut.color = ciColor;\n"
-                                                    "	//gl_Position = ciModelViewProjection * ciPosition;\n"
-                                                    "	gl_Position = ciModelViewProjection * newPosition;\n"
-                                                    "	//gl_Position = ciModelViewProjection * twistedPosition;\n"
-                                                    "}\n"
-                                                    )
-                                            .fragment(
-                                                      "#version 150\n"
-                                                      "\n"
-                                                      "in VertexData	{\n"
-                                                      "	vec4 position;\n"
-                                                      "	vec3 normal;\n"
-                                                      "	vec4 color;\n"
-                                                      "} vVertexIn;\n"
-                                                      "\n"
-                                                      "out vec4 oColor;\n"
-                                                      "in vec2 vUv;\n"
-                                                      "uniform sampler2D baseTexture;\n"
-                                                      "\n"
-                                                      "void main(void) {\n"
-                                                      "	// set diffuse and specular colors\n"
-                                                      "	vec3 cDiffuse = vVertexIn.color.rgb;\n"
-                                                      "	vec3 cSpecular = vec3(0.3, 0.3, 0.3);\n"
-                                                      "\n"
-                                                      "	// light properties in view space\n"
-                                                      "	vec3 vLightPosition = vec3(0.0, 0.0, 0.0);\n"
-                                                      "\n"
-                                                      "	// lighting calculations\n"
-                                                      "	vec3 vVertex = vVertexIn.position.xyz;\n"
-                                                      "	vec3 vNormal = normalize( vVertexIn.normal );\n"
-                                                      "	vec3 vToLight = normalize( vLightPosition - vVertex );\n"
-                                                      "	vec3 vToEye = normalize( -vVertex );\n"
-                                                      "	vec3 vReflect = normalize( -reflect(vToLight, vNormal) );\n"
-                                                      "\n"
-                                                      "	// diffuse coefficient\n"
-                                                      "	vec3 diffuse = max( dot( vNormal, vToLight ), 0.0 ) * cDiffuse;\n"
-                                                      "\n"
-                                                      "	// specular coefficient with energy conservation\n"
-                                                      "	const float shininess = 20.0;\n"
-                                                      "	const float coeff = (2.0 + shininess) / (2.0 * 3.14159265);\n"
-                                                      "	vec3 specular = pow( max( dot( vReflect, vToEye ), 0.0 ), shininess ) * coeff * cSpecular;\n"
-                                                      "\n"
-                                                      "	// to conserve energy, diffuse and specular colors should not exceed one\n"
-                                                      "	float maxDiffuse = max(diffuse.r, max(diffuse.g, diffuse.b));\n"
-                                                      "	float maxSpecular = max(specular.r, max(specular.g, specular.b));\n"
-                                                      "	float fConserve = 1.0 / max(1.0, maxDiffuse + maxSpecular);\n"
-                                                      "\n"
-                                                      "	// final color\n"
-                                                      "	oColor.rgb = (diffuse + specular) * fConserve;\n"
-                                                      "	//oColor.rgb = vec3(texture(baseTexture,vUv),0.0);\n"
-                                                      "	oColor.a = 1.0;\n"
-                                                      "}\n"
-                                                      )
-                                            );
-	}
-	catch( const std::exception& e ) {
-		console() << e.what() << std::endl;
-	}
-}
-
-void GeometryApp::createTwistShader(void){
+gl::GlslProgRef GeometryApp::getDeformShader( uint32_t permutation )
+{
 	try {
-		mTwistShader = gl::GlslProg::create( gl::GlslProg::Format()
-                                            .vertex(
-                                                    "#version 150\n"
-                                                    "\n"
-                                                    "uniform mat4	ciModelViewProjection;\n"
-                                                    "uniform mat4	ciModelView;\n"
-                                                    "uniform mat3	ciNormalMatrix;\n"
-                                                    "uniform float	mixAmount;\n"
-                                                    "uniform vec3 worldUp;\n"
-                                                    "uniform float ciElapsedSeconds;\n"
-                                                    "uniform float angle_deg_max;\n"
-                                                    "uniform float height;\n"
-                                                    "uniform vec3 centerPoint;\n"
-                                                    "const float PI = 3.1415926535897932384626433832795;\n"
-                                                    "\n"
-                                                    "in vec4		ciPosition;\n"
-                                                    "in vec3		ciNormal;\n"
-                                                    "in vec4		ciColor;\n"
-                                                    "\n"
-                                                    "in vec2		ciTexCoord0;\n"
-                                                    "out vec2 vUv;\n"
-                                                    "uniform bool flag;\n"
-                                                    "\n"
-                                                    "out VertexData {\n"
-                                                    "	vec4 position;\n"
-                                                    "	vec3 normal;\n"
-                                                    "	vec4 color;\n"
-                                                    "} vVertexOut;\n"
-                                                    "\n"
-                                                    "\n"
-                                                    "   vec4 DoTwist(vec4 pos, float t){\n"
-                                                    "        float st = sin(t);\n"
-                                                    "        float ct = cos(t);\n"
-                                                    "        vec4 new_pos;\n"
-                                                    "        new_pos.y = pos.y;\n"
-                                                    "        new_pos.z = pos.x * st + pos.z * ct;\n"
-                                                    "        new_pos.x = pos.x * ct - pos.z * st;\n"
-                                                    "        new_pos.w = pos.w;\n"
-                                                    "\n"
-                                                    "        return(new_pos);\n"
-                                                    "    }\n"
-                                                    "\n"
-                                                    "void main(void) {\n"
-                                                    "float angle_deg = angle_deg_max * sin(ciElapsedSeconds);\n"
-                                                    "float angle_rad = angle_deg * 3.14159 / 180.0;\n"
-                                                    "float ang = (height*0.5 + ciPosition.y)/height * angle_rad;\n"
-                                                    "vec4 twistedPosition = DoTwist(ciPosition,ang);\n"
-                                                    "vec4 twistedNormal = DoTwist(vec4(ciNormal,1.0),ang);\n"
-                                                    "float mxAm = 0.2 * (1.0 + sin(ciElapsedSeconds));\n"
-                                                    "vUv = ciTexCoord0;\n"
-                                                    
-                                                    
-                                                    "//vec4 newPosition = mix(ciPosition,vec4(goalPosition,1.0),mxAm);\n"
-                                                    "//vec3 wU = cross(worldUp,vec3(newPosition));\n"
-                                                    "//vec3 newNormal = mix(ciNormal,wU,mxAm);\n"
-                                                    "\n"
-                                                    "vec4 newPosition = mix(ciPosition,twistedPosition,mxAm);\n"
-                                                    "vec3 wU = cross(worldUp,vec3(twistedPosition));\n"
-                                                    "vec3 newNormal = mix(ciNormal,vec3(twistedNormal),mxAm);\n"
-                                                    "\n"
-                                                    "	//vVertexOut.position = ciModelView * ciPosition;\n"
-                                                    "	vVertexOut.position = ciModelView * newPosition;\n"
-                                                    "	vVertexOut.normal = ciNormalMatrix * newNormal;\n"
-                                                    "	//vVertexOut.position = ciModelView * twistedPosition;\n"
-                                                    "	//vVertexOut.normal = ciNormalMatrix * vec3(twistedNormal);\n"
-                                                    "	vVertexOut.color = ciColor;\n"
-                                                    "	//gl_Position = ciModelViewProjection * ciPosition;\n"
-                                                    "	gl_Position = ciModelViewProjection * newPosition;\n"
-                                                    "	//gl_Position = ciModelViewProjection * twistedPosition;\n"
-                                                    "}\n"
-                                                    )
-                                            .fragment(
-                                                      "#version 150\n"
-                                                      "\n"
-                                                      "in VertexData	{\n"
-                                                      "	vec4 position;\n"
-                                                      "	vec3 normal;\n"
-                                                      "	vec4 color;\n"
-                                                      "} vVertexIn;\n"
-                                                      "\n"
-                                                      "out vec4 oColor;\n"
-                                                      "in vec2 vUv;\n"
-                                                      "uniform sampler2D baseTexture;\n"
-                                                      "\n"
-                                                      "void main(void) {\n"
-                                                      "	// set diffuse and specular colors\n"
-                                                      "	vec3 cDiffuse = vVertexIn.color.rgb;\n"
-                                                      "	vec3 cSpecular = vec3(0.3, 0.3, 0.3);\n"
-                                                      "\n"
-                                                      "	// light properties in view space\n"
-                                                      "	vec3 vLightPosition = vec3(0.0, 0.0, 0.0);\n"
-                                                      "\n"
-                                                      "	// lighting calculations\n"
-                                                      "	vec3 vVertex = vVertexIn.position.xyz;\n"
-                                                      "	vec3 vNormal = normalize( vVertexIn.normal );\n"
-                                                      "	vec3 vToLight = normalize( vLightPosition - vVertex );\n"
-                                                      "	vec3 vToEye = normalize( -vVertex );\n"
-                                                      "	vec3 vReflect = normalize( -reflect(vToLight, vNormal) );\n"
-                                                      "\n"
-                                                      "	// diffuse coefficient\n"
-                                                      "	vec3 diffuse = max( dot( vNormal, vToLight ), 0.0 ) * cDiffuse;\n"
-                                                      "\n"
-                                                      "	// specular coefficient with energy conservation\n"
-                                                      "	const float shininess = 20.0;\n"
-                                                      "	const float coeff = (2.0 + shininess) / (2.0 * 3.14159265);\n"
-                                                      "	vec3 specular = pow( max( dot( vReflect, vToEye ), 0.0 ), shininess ) * coeff * cSpecular;\n"
-                                                      "\n"
-                                                      "	// to conserve energy, diffuse and specular colors should not exceed one\n"
-                                                      "	float maxDiffuse = max(diffuse.r, max(diffuse.g, diffuse.b));\n"
-                                                      "	float maxSpecular = max(specular.r, max(specular.g, specular.b));\n"
-                                                      "	float fConserve = 1.0 / max(1.0, maxDiffuse + maxSpecular);\n"
-                                                      "\n"
-                                                      "	// final color\n"
-                                                      "	oColor.rgb = (diffuse + specular) * fConserve;\n"
-                                                      "	//oColor.rgb = vec3(texture(baseTexture,vUv),0.0);\n"
-                                                      "	oColor.a = 1.0;\n"
-                                                      "}\n"
-                                                      )
-                                            );
-	}
-	catch( const std::exception& e ) {
-		console() << e.what() << std::endl;
-	}
-}
-
-void GeometryApp::createSquashShader(void){
-    try {
-		mSquashShader = gl::GlslProg::create( gl::GlslProg::Format()
-                                            .vertex(
-                                                    "#version 150\n"
-                                                    "\n"
-                                                    "uniform mat4	ciModelViewProjection;\n"
-                                                    "uniform mat4	ciModelView;\n"
-                                                    "uniform mat3	ciNormalMatrix;\n"
-                                                    "uniform float	mixAmount;\n"
-                                                    "uniform vec3 worldUp;\n"
-                                                    "uniform float ciElapsedSeconds;\n"
-                                                    "uniform float angle_deg_max;\n"
-                                                    "uniform float height;\n"
-                                                    "uniform vec3 centerPoint;\n"
-                                                    
-                                                    "uniform float xlim;\n"
-                                                    "uniform float ylim;\n"
-                                                    "uniform float zlim;\n"
-                                                    
-                                                    "const float PI = 3.1415926535897932384626433832795;\n"
-                                                    "\n"
-                                                    "in vec4		ciPosition;\n"
-                                                    "in vec3		ciNormal;\n"
-                                                    "in vec4		ciColor;\n"
-                                                    "\n"
-                                                    "in vec2		ciTexCoord0;\n"
-                                                    "out vec2 vUv;\n"
-                                                    "uniform bool flag;\n"
-                                                    "\n"
-                                                    "out VertexData {\n"
-                                                    "	vec4 position;\n"
-                                                    "	vec3 normal;\n"
-                                                    "	vec4 color;\n"
-                                                    "} vVertexOut;\n"
-                                                    "\n"
-                                                    "\n"
-
-                                                    "vec4 stretch(vec4 pos,bool stretch){\n"
-                                                    "float disty = centerPoint.y - pos.y;\n"
-                                                    "float distx = centerPoint.x - pos.x;\n"
-                                                    "float distz = centerPoint.z - pos.z;\n"
-                                                    "float dist = abs(distance(centerPoint,vec3(pos)));\n"
-                                                    "  vec4 new_pos;\n"
-                                                    "  new_pos.y = ylim * dist/2 * pos.y;\n"
-                                                    "  //new_pos.y = sin( -PI * sqrt(length(pos.xz)));\n"
-                                                    "  new_pos.x = xlim * dist/2 * pos.x;\n"
-                                                    "  new_pos.z = zlim * dist * pos.z;\n"
-                                                    "\n"
-                                                    "  //new_pos.y = pos.z;\n"
-                                                    "  //new_pos.x = dist * pos.y;\n"
-                                                    "  //new_pos.z = dist * pos.x;\n"
-                                                    "\n"
-                                                    "  //new_pos.z = pos.z;\n"
-                                                    "  new_pos.w = pos.w;\n"
-                                                    "  return new_pos;\n"
-                                                    "}\n"
-                                                    "void main(void) {\n"
-                                                    "float mxAm = 0.5 * (1.0 + sin(ciElapsedSeconds));\n"
-                                                    "vUv = ciTexCoord0;\n"
-                                                    
-                                                    "vec4 stretch_new_pos = stretch(ciPosition,true);\n"
-                                                    "vec4 stretch_new_normal = stretch(vec4(ciNormal,1.0),true);\n"
-                                                    
-                                                    "//vec4 newPosition = mix(ciPosition,vec4(goalPosition,1.0),mxAm);\n"
-                                                    "//vec3 wU = cross(worldUp,vec3(newPosition));\n"
-                                                    "//vec3 newNormal = mix(ciNormal,wU,mxAm);\n"
-                                                    "\n"
-                                                    "vec4 newPosition = mix(ciPosition,stretch_new_pos,mxAm);\n"
-                                                    "vec3 wU = cross(worldUp,vec3(stretch_new_pos));\n"
-                                                    "vec3 newNormal = mix(ciNormal,vec3(stretch_new_normal),mxAm);\n"
-                                                    "\n"
-                                                    "	//vVertexOut.position = ciModelView * ciPosition;\n"
-                                                    "	vVertexOut.position = ciModelView * newPosition;\n"
-                                                    "	vVertexOut.normal = ciNormalMatrix * newNormal;\n"
-                                                    "	vVertexOut.color = ciColor;\n"
-                                                    "	//gl_Position = ciModelViewProjection * ciPosition;\n"
-                                                    "	gl_Position = ciModelViewProjection * newPosition;\n"
-                                                    "}\n"
-                                                    )
-                                            .fragment(
-                                                      "#version 150\n"
-                                                      "\n"
-                                                      "in VertexData	{\n"
-                                                      "	vec4 position;\n"
-                                                      "	vec3 normal;\n"
-                                                      "	vec4 color;\n"
-                                                      "} vVertexIn;\n"
-                                                      "\n"
-                                                      "out vec4 oColor;\n"
-                                                      "in vec2 vUv;\n"
-                                                      "uniform sampler2D baseTexture;\n"
-                                                      "\n"
-                                                      "void main(void) {\n"
-                                                      "	// set diffuse and specular colors\n"
-                                                      "	vec3 cDiffuse = vVertexIn.color.rgb;\n"
-                                                      "	vec3 cSpecular = vec3(0.3, 0.3, 0.3);\n"
-                                                      "\n"
-                                                      "	// light properties in view space\n"
-                                                      "	vec3 vLightPosition = vec3(0.0, 0.0, 0.0);\n"
-                                                      "\n"
-                                                      "	// lighting calculations\n"
-                                                      "	vec3 vVertex = vVertexIn.position.xyz;\n"
-                                                      "	vec3 vNormal = normalize( vVertexIn.normal );\n"
-                                                      "	vec3 vToLight = normalize( vLightPosition - vVertex );\n"
-                                                      "	vec3 vToEye = normalize( -vVertex );\n"
-                                                      "	vec3 vReflect = normalize( -reflect(vToLight, vNormal) );\n"
-                                                      "\n"
-                                                      "	// diffuse coefficient\n"
-                                                      "	vec3 diffuse = max( dot( vNormal, vToLight ), 0.0 ) * cDiffuse;\n"
-                                                      "\n"
-                                                      "	// specular coefficient with energy conservation\n"
-                                                      "	const float shininess = 20.0;\n"
-                                                      "	const float coeff = (2.0 + shininess) / (2.0 * 3.14159265);\n"
-                                                      "	vec3 specular = pow( max( dot( vReflect, vToEye ), 0.0 ), shininess ) * coeff * cSpecular;\n"
-                                                      "\n"
-                                                      "	// to conserve energy, diffuse and specular colors should not exceed one\n"
-                                                      "	float maxDiffuse = max(diffuse.r, max(diffuse.g, diffuse.b));\n"
-                                                      "	float maxSpecular = max(specular.r, max(specular.g, specular.b));\n"
-                                                      "	float fConserve = 1.0 / max(1.0, maxDiffuse + maxSpecular);\n"
-                                                      "\n"
-                                                      "	// final color\n"
-                                                      "	oColor.rgb = (diffuse + specular) * fConserve;\n"
-                                                      "	//oColor.rgb = vec3(texture(baseTexture,vUv),0.0);\n"
-                                                      "	oColor.a = 1.0;\n"
-                                                      "}\n"
-                                                      )
-                                            );
-	}
-	catch( const std::exception& e ) {
-		console() << e.what() << std::endl;
-	}
-}
-
-
-
-void GeometryApp::createSquashShader2(void){
-    try {
-		mSquashShader2 = gl::GlslProg::create( gl::GlslProg::Format()
-                                             .vertex(
-                                                     "#version 150\n"
-                                                     "\n"
-                                                     "uniform mat4	ciModelViewProjection;\n"
-                                                     "uniform mat4	ciModelView;\n"
-                                                     "uniform mat3	ciNormalMatrix;\n"
-                                                     "uniform float	mixAmount;\n"
-                                                     "uniform vec3 worldUp;\n"
-                                                     "uniform float ciElapsedSeconds;\n"
-                                                     "uniform float angle_deg_max;\n"
-                                                     "uniform float height;\n"
-                                                     "uniform vec3 centerPoint;\n"
-                                                     
-                                                     "uniform float xlim;\n"
-                                                     "uniform float ylim;\n"
-                                                     "uniform float zlim;\n"
-                                                     
-                                                     "const float PI = 3.1415926535897932384626433832795;\n"
-                                                     "\n"
-                                                     "in vec4		ciPosition;\n"
-                                                     "in vec3		ciNormal;\n"
-                                                     "in vec4		ciColor;\n"
-                                                     "\n"
-                                                     "in vec2		ciTexCoord0;\n"
-                                                     "out vec2 vUv;\n"
-                                                     "uniform bool flag;\n"
-                                                     "\n"
-                                                     "out VertexData {\n"
-                                                     "	vec4 position;\n"
-                                                     "	vec3 normal;\n"
-                                                     "	vec4 color;\n"
-                                                     "} vVertexOut;\n"
-                                                     "\n"
-                                                     "\n"
-                                                     
-                                                     "vec4 stretch(vec4 pos,bool stretch){\n"
-                                                     "float disty = centerPoint.y - pos.y;\n"
-                                                     "float distx = centerPoint.x - pos.x;\n"
-                                                     "float distz = centerPoint.z - pos.z;\n"
-                                                     "float dist = abs(distance(centerPoint,vec3(pos)));\n"
-                                                     "  vec4 new_pos;\n"
-                                                     "  new_pos.y = ylim * dist/2 * pos.y;\n"
-                                                     "  //new_pos.y = sin( -PI * sqrt(length(pos.xz)));\n"
-                                                     "  new_pos.x = xlim * dist/2 * pos.x;\n"
-                                                     "  new_pos.z = zlim * dist * pos.z;\n"
-                                                     "\n"
-                                                     "  //new_pos.y = pos.z;\n"
-                                                     "  //new_pos.x = dist * pos.y;\n"
-                                                     "  //new_pos.z = dist * pos.x;\n"
-                                                     "\n"
-                                                     "  //new_pos.z = pos.z;\n"
-                                                     "  new_pos.w = pos.w;\n"
-                                                     "  return new_pos;\n"
-                                                     "}\n"
-                                                     "void main(void) {\n"
-                                                     "float mxAm = 0.5 * (1.0 + sin(ciElapsedSeconds));\n"
-                                                     "vUv = ciTexCoord0;\n"
-                                                     
-                                                     "vec4 stretch_new_pos = stretch(ciPosition,true);\n"
-                                                     "vec4 stretch_new_normal = stretch(vec4(ciNormal,1.0),true);\n"
-                                                     
-                                                     "//vec4 newPosition = mix(ciPosition,vec4(goalPosition,1.0),mxAm);\n"
-                                                     "//vec3 wU = cross(worldUp,vec3(newPosition));\n"
-                                                     "//vec3 newNormal = mix(ciNormal,wU,mxAm);\n"
-                                                     "\n"
-                                                     "vec4 newPosition = mix(ciPosition,stretch_new_pos,mxAm);\n"
-                                                     "vec4 newPosition_stretched = mix(ciPosition,stretch_new_pos,0.8);\n"
-                                                     "vec3 wU = cross(worldUp,vec3(stretch_new_pos));\n"
-                                                     "vec3 newNormal = mix(ciNormal,vec3(stretch_new_normal),mxAm);\n"
-                                                     "vec3 newNormal_stretched = mix(ciNormal,vec3(stretch_new_normal),0.8);\n"
-                                                     "\n"
-                                                     "vec4 stretch_new_pos2 = stretch(newPosition_stretched,true);\n"
-                                                     "vec4 stretch_new_normal2 = stretch(vec4(newNormal_stretched,1.0),true);\n"
-                                                     "vec4 newPosition2 = mix(newPosition_stretched,stretch_new_pos2,mxAm);\n"
-                                                     "vec3 newNormal2 = mix(newNormal_stretched,vec3(stretch_new_normal2),mxAm);\n"
-                                                     "	//vVertexOut.position = ciModelView * ciPosition;\n"
-                                                     "	vVertexOut.position = ciModelView * newPosition2;\n"
-                                                     "	vVertexOut.normal = ciNormalMatrix * newNormal2;\n"
-                                                     "	vVertexOut.color = ciColor;\n"
-                                                     "	//gl_Position = ciModelViewProjection * ciPosition;\n"
-                                                     "	gl_Position = ciModelViewProjection * newPosition2;\n"
-                                                     "}\n"
-                                                     )
-                                             .fragment(
-                                                       "#version 150\n"
-                                                       "\n"
-                                                       "in VertexData	{\n"
-                                                       "	vec4 position;\n"
-                                                       "	vec3 normal;\n"
-                                                       "	vec4 color;\n"
-                                                       "} vVertexIn;\n"
-                                                       "\n"
-                                                       "out vec4 oColor;\n"
-                                                       "in vec2 vUv;\n"
-                                                       "uniform sampler2D baseTexture;\n"
-                                                       "\n"
-                                                       "void main(void) {\n"
-                                                       "	// set diffuse and specular colors\n"
-                                                       "	vec3 cDiffuse = vVertexIn.color.rgb;\n"
-                                                       "	vec3 cSpecular = vec3(0.3, 0.3, 0.3);\n"
-                                                       "\n"
-                                                       "	// light properties in view space\n"
-                                                       "	vec3 vLightPosition = vec3(0.0, 0.0, 0.0);\n"
-                                                       "\n"
-                                                       "	// lighting calculations\n"
-                                                       "	vec3 vVertex = vVertexIn.position.xyz;\n"
-                                                       "	vec3 vNormal = normalize( vVertexIn.normal );\n"
-                                                       "	vec3 vToLight = normalize( vLightPosition - vVertex );\n"
-                                                       "	vec3 vToEye = normalize( -vVertex );\n"
-                                                       "	vec3 vReflect = normalize( -reflect(vToLight, vNormal) );\n"
-                                                       "\n"
-                                                       "	// diffuse coefficient\n"
-                                                       "	vec3 diffuse = max( dot( vNormal, vToLight ), 0.0 ) * cDiffuse;\n"
-                                                       "\n"
-                                                       "	// specular coefficient with energy conservation\n"
-                                                       "	const float shininess = 20.0;\n"
-                                                       "	const float coeff = (2.0 + shininess) / (2.0 * 3.14159265);\n"
-                                                       "	vec3 specular = pow( max( dot( vReflect, vToEye ), 0.0 ), shininess ) * coeff * cSpecular;\n"
-                                                       "\n"
-                                                       "	// to conserve energy, diffuse and specular colors should not exceed one\n"
-                                                       "	float maxDiffuse = max(diffuse.r, max(diffuse.g, diffuse.b));\n"
-                                                       "	float maxSpecular = max(specular.r, max(specular.g, specular.b));\n"
-                                                       "	float fConserve = 1.0 / max(1.0, maxDiffuse + maxSpecular);\n"
-                                                       "\n"
-                                                       "	// final color\n"
-                                                       "	oColor.rgb = (diffuse + specular) * fConserve;\n"
-                                                       "	//oColor.rgb = vec3(texture(baseTexture,vUv),0.0);\n"
-                                                       "	oColor.a = 1.0;\n"
-                                                       "}\n"
-                                                       )
-                                             );
+		return mDeformShaders->get( permutation );
 	}
 	catch( const std::exception& e ) {
 		console() << e.what() << std::endl;
+		return gl::GlslProgRef();
 	}
 }
 
-
-void GeometryApp::createSphereShader(void){
-    try {
-		mSphereShader = gl::GlslProg::create( gl::GlslProg::Format()
-                                             .vertex(
-                                                     "#version 150\n"
-                                                     "\n"
-                                                     "uniform mat4	ciModelViewProjection;\n"
-                                                     "uniform mat4	ciModelView;\n"
-                                                     "uniform mat3	ciNormalMatrix;\n"
-                                                     "uniform float	mixAmount;\n"
-                                                     "uniform vec3 worldUp;\n"
-                                                     "uniform float ciElapsedSeconds;\n"
-                                                     "uniform float angle_deg_max;\n"
-                                                     "uniform float height;\n"
-                                                     "uniform vec3 centerPoint;\n"
-                                                     
-                                                     "uniform float xlim;\n"
-                                                     "uniform float ylim;\n"
-                                                     "uniform float zlim;\n"
-                                                     
-                                                     "const float PI = 3.1415926535897932384626433832795;\n"
-                                                     "\n"
-                                                     "in vec4		ciPosition;\n"
-                                                     "in vec3		ciNormal;\n"
-                                                     "in vec4		ciColor;\n"
-                                                     "\n"
-                                                     "in vec2		ciTexCoord0;\n"
-                                                     "out vec2 vUv;\n"
-                                                     "uniform bool flag;\n"
-                                                     "\n"
-                                                     "out VertexData {\n"
-                                                     "	vec4 position;\n"
-                                                     "	vec3 normal;\n"
-                                                     "	vec4 color;\n"
-                                                     "} vVertexOut;\n"
-                                                     "\n"
-                                                     "\n"
-                                                     
-                                                     "vec4 sphere(vec4 pos){\n"
-                                                     "float dx = pos.x * sqrt(1.0 - (pos.y*pos.y/2.0) - (pos.z*pos.z/2.0) + (pos.y*pos.y*pos.z*pos.z / 3.0) );\n"
-                                                     "float dy = pos.y * sqrt(1.0 - (pos.z*pos.z/2.0) - (pos.x*pos.x/2.0) + (pos.z*pos.z*pos.x*pos.x / 3.0) );\n"
-                                                     "float dz = pos.z * sqrt(1.0 - (pos.x*pos.x/2.0) - (pos.y*pos.y/2.0) + (pos.x*pos.x*pos.y*pos.y / 3.0) );\n"
-                                                     "  vec4 new_pos;\n"
-                                                     "  new_pos.x = dx;\n"
-                                                     "  new_pos.y = dy;\n"
-                                                     "  new_pos.z = dz;\n"
-                                                     "\n"
-                                                     "  new_pos.w = pos.w;\n"
-                                                     "  return new_pos;\n"
-                                                     "}\n"
-                                                     "void main(void) {\n"
-                                                     "float mxAm = 0.5 * (1.0 + sin(ciElapsedSeconds));\n"
-                                                     "vUv = ciTexCoord0;\n"
-                                                     
-                                                     "vec4 sphere_new_pos = sphere(ciPosition);\n"
-                                                     "vec4 sphere_new_normal = sphere(vec4(ciNormal,1.0));\n"
-                                                     
-
-                                                     "\n"
-                                                     "vec4 newPosition = mix(ciPosition,sphere_new_pos,mxAm);\n"
-                                                     "vec3 newNormal = mix(ciNormal,vec3(sphere_new_normal),mxAm);\n"
-                                                     "\n"
-                                                     "	//vVertexOut.position = ciModelView * ciPosition;\n"
-                                                     "	vVertexOut.position = ciModelView * newPosition;\n"
-                                                     "	vVertexOut.normal = ciNormalMatrix * newNormal;\n"
-                                                     "	vVertexOut.color = ciColor;\n"
-                                                     "	//gl_Position = ciModelViewProjection * ciPosition;\n"
-                                                     "	gl_Position = ciModelViewProjection * newPosition;\n"
-                                                     "}\n"
-                                                     )
-                                             .fragment(
-                                                       "#version 150\n"
-                                                       "\n"
-                                                       "in VertexData	{\n"
-                                                       "	vec4 position;\n"
-                                                       "	vec3 normal;\n"
-                                                       "	vec4 color;\n"
-                                                       "} vVertexIn;\n"
-                                                       "\n"
-                                                       "out vec4 oColor;\n"
-                                                       "in vec2 vUv;\n"
-                                                       "uniform sampler2D baseTexture;\n"
-                                                       "\n"
-                                                       "void main(void) {\n"
-                                                       "	// set diffuse and specular colors\n"
-                                                       "	vec3 cDiffuse = vVertexIn.color.rgb;\n"
-                                                       "	vec3 cSpecular = vec3(0.3, 0.3, 0.3);\n"
-                                                       "\n"
-                                                       "	// light properties in view space\n"
-                                                       "	vec3 vLightPosition = vec3(0.0, 0.0, 0.0);\n"
-                                                       "\n"
-                                                       "	// lighting calculations\n"
-                                                       "	vec3 vVertex = vVertexIn.position.xyz;\n"
-                                                       "	vec3 vNormal = normalize( vVertexIn.normal );\n"
-                                                       "	vec3 vToLight = normalize( vLightPosition - vVertex );\n"
-                                                       "	vec3 vToEye = normalize( -vVertex );\n"
-                                                       "	vec3 vReflect = normalize( -reflect(vToLight, vNormal) );\n"
-                                                       "\n"
-                                                       "	// diffuse coefficient\n"
-                                                       "	vec3 diffuse = max( dot( vNormal, vToLight ), 0.0 ) * cDiffuse;\n"
-                                                       "\n"
-                                                       "	// specular coefficient with energy conservation\n"
-                                                       "	const float shininess = 20.0;\n"
-                                                       "	const float coeff = (2.0 + shininess) / (2.0 * 3.14159265);\n"
-                                                       "	vec3 specular = pow( max( dot( vReflect, vToEye ), 0.0 ), shininess ) * coeff * cSpecular;\n"
-                                                       "\n"
-                                                       "	// to conserve energy, diffuse and specular colors should not exceed one\n"
-                                                       "	float maxDiffuse = max(diffuse.r, max(diffuse.g, diffuse.b));\n"
-                                                       "	float maxSpecular = max(specular.r, max(specular.g, specular.b));\n"
-                                                       "	float fConserve = 1.0 / max(1.0, maxDiffuse + maxSpecular);\n"
-                                                       "\n"
-                                                       "	// final color\n"
-                                                       "	oColor.rgb = (diffuse + specular) * fConserve;\n"
-                                                       "	//oColor.rgb = vec3(texture(baseTexture,vUv),0.0);\n"
-                                                       "	oColor.a = 1.0;\n"
-                                                       "}\n"
-                                                       )
-                                             );
-	}
-	catch( const std::exception& e ) {
-		console() << e.what() << std::endl;
-	}
-}
-
-
-void GeometryApp::createPlaneShader(void)
+uint32_t GeometryApp::getDeformPermutation() const
 {
-	try {
-		mPlaneShader = gl::GlslProg::create( gl::GlslProg::Format()
-			.vertex(
-				"#version 150\n"
-				"\n"
-				"uniform mat4	ciModelViewProjection;\n"
-				"uniform mat4	ciModelView;\n"
-				"uniform mat3	ciNormalMatrix;\n"
-                "uniform float	mixAmount;\n"
-                "uniform vec3 worldUp;\n"
-                "uniform float ciElapsedSeconds;\n"
-                "uniform float angle_deg_max;\n"
-                "uniform float height;\n"
-                "uniform vec3 centerPoint;\n"
-                "const float PI = 3.1415926535897932384626433832795;\n"
-				"\n"
-				"in vec4		ciPosition;\n"
-				"in vec3		ciNormal;\n"
-				"in vec4		ciColor;\n"
-                "\n"
-                "in vec2		ciTexCoord0;\n"
-                "out vec2 vUv;\n"
-                "uniform bool flag;\n"
-                "uniform float move;\n"
-				"\n"
-				"out VertexData {\n"
-				"	vec4 position;\n"
-				"	vec3 normal;\n"
-				"	vec4 color;\n"
-				"} vVertexOut;\n"
-				"\n"
-                "\n"
-				"void main(void) {\n"
-
-                "float mxAm = 0.5 * (1.0 + sin(ciElapsedSeconds));\n"
-                "vUv = ciTexCoord0;\n"
-//                "vec3 goalPosition = 50.0 * vec3(0,ciTexCoord0.y,-ciTexCoord0.x) + vec3(-50.0,-100.0,100.0);\n"
-                "vec3 goalPosition = 5.0 * vec3(-ciTexCoord0.x,ciTexCoord0.y,-ciTexCoord0.x) ;\n"
-//                "vec4 newPosition = mix(ciPosition,vec4(goalPosition,1.0),mxAm);\n"
-                  
-        
-                    ///*Oval Shaped
-//                  "vec3 goalPosition = 5.0 * vec3(0,ciTexCoord0.y,0) ;\n"
-                "vec4 newPosition;\n"
-                "vec3 newNormal;\n"
-                  "if(flag == true){\n"
-                  "newPosition = mix(ciPosition,vec4(goalPosition,1.0),mxAm);\n"
-                    "}\n"
-                    "else{\n"
-                    "newPosition = mix(ciPosition,vec4(goalPosition,1.0),move);\n"
-                    "}\n"
-                   //*/
-                    
-                    
-//                "vec3 goalPosition;\n"
-//                    "if(flag){goalPosition = 50.0 * vec3(0,0,-ciTexCoord0.y) + vec3(-50.0,-100.0,100.0);}\n"
-//                    "else{goalPosition = 50.0 * vec3(0,0,-ciTexCoord0.y) + vec3(-50.0,-100.0,100.0);}\n"
-                    
-                
-
-                "vec3 wU = cross(worldUp,vec3(newPosition));\n"
-                "if(flag == true){\n"
-                "newNormal = mix(ciNormal,wU,mxAm);\n"
-                "}\n"
-                "else{"
-                "newNormal = mix(ciNormal,wU,move);\n"
-                "}\n"
-                "\n"
-                "	//vVertexOut.position = ciModelView * ciPosition;\n"
-                "	vVertexOut.position = ciModelView * newPosition;\n"
-				"	vVertexOut.normal = ciNormalMatrix * newNormal;\n"
-				"	vVertexOut.color = ciColor;\n"
-				"	//gl_Position = ciModelViewProjection * ciPosition;\n"
-                "	gl_Position = ciModelViewProjection * newPosition;\n"
-				"}\n"
-			)
-			.fragment(
-				"#version 150\n"
-				"\n"
-				"in VertexData	{\n"
-				"	vec4 position;\n"
-				"	vec3 normal;\n"
-				"	vec4 color;\n"
-				"} vVertexIn;\n"
-				"\n"
-				"out vec4 oColor;\n"
-                "in vec2 vUv;\n"
-                "uniform sampler2D baseTexture;\n"
-				"\n"
-				"void main(void) {\n"
-				"	// set diffuse and specular colors\n"
-				"	vec3 cDiffuse = vVertexIn.color.rgb;\n"
-				"	vec3 cSpecular = vec3(0.3, 0.3, 0.3);\n"
-				"\n"
-				"	// light properties in view space\n"
-				"	vec3 vLightPosition = vec3(0.0, 0.0, 0.0);\n"
-				"\n"
-				"	// lighting calculations\n"
-				"	vec3 vVertex = vVertexIn.position.xyz;\n"
-				"	vec3 vNormal = normalize( vVertexIn.normal );\n"
-				"	vec3 vToLight = normalize( vLightPosition - vVertex );\n"
-				"	vec3 vToEye = normalize( -vVertex );\n"
-				"	vec3 vReflect = normalize( -reflect(vToLight, vNormal) );\n"
-				"\n"
-				"	// diffuse coefficient\n"
-				"	vec3 diffuse = max( dot( vNormal, vToLight ), 0.0 ) * cDiffuse;\n"
-				"\n"
-				"	// specular coefficient with energy conservation\n"
-				"	const float shininess = 20.0;\n"
-				"	const float coeff = (2.0 + shininess) / (2.0 * 3.14159265);\n"
-				"	vec3 specular = pow( max( dot( vReflect, vToEye ), 0.0 ), shininess ) * coeff * cSpecular;\n"
-				"\n"
-				"	// to conserve energy, diffuse and specular colors should not exceed one\n"
-				"	float maxDiffuse = max(diffuse.r, max(diffuse.g, diffuse.b));\n"
-				"	float maxSpecular = max(specular.r, max(specular.g, specular.b));\n"
-				"	float fConserve = 1.0 / max(1.0, maxDiffuse + maxSpecular);\n"
-				"\n"
-				"	// final color\n"
-				"	oColor.rgb = (diffuse + specular) * fConserve;\n"
-                "	//oColor.rgb = vec3(texture(baseTexture,vUv),0.0);\n"
-				"	oColor.a = 1.0;\n"
-				"}\n"
-			)
-		);
-	}
-	catch( const std::exception& e ) {
-		console() << e.what() << std::endl;
+	switch( mTransformation ) {
+		case TWIST: return TwistPipeline::glslPermutation();
+		case SQUASH: return SquashPipeline::glslPermutation();
+		case SQUASH2: return Squash2Pipeline::glslPermutation();
+		case SPH: return SpherePipeline::glslPermutation();
+		case CUSTOM23: return Custom23Pipeline::glslPermutation();
+		case CUSTOM123: return Custom123Pipeline::glslPermutation();
+		default: return PlanePipeline::glslPermutation();
 	}
 }
 
 void GeometryApp::createWireframeShader(void)
 {
 	try {
-		mWireframeShader = gl::GlslProg::create( gl::GlslProg::Format()
-			.vertex(
-				"#version 150\n"
-				"\n"
-				"uniform mat4	ciModelViewProjection;\n"
-				"in vec4		ciPosition;\n"
-				"in vec4		ciColor;\n"
-				"in vec2		ciTexCoord0;\n"
-				"\n"
-				"out VertexData {\n"
-				"	vec4 color;\n"
-				"	vec2 texcoord;\n"
-				"} vVertexOut;\n"
-				"\n"
-				"void main(void) {\n"
-				"	vVertexOut.color = ciColor;\n"
-				"	vVertexOut.texcoord = ciTexCoord0;\n"
-				"	gl_Position = ciModelViewProjection * ciPosition;\n"
-				"}\n"
-			) 
-			.geometry(
-				"#version 150\n"
-				"\n"
-				"layout (triangles) in;\n"
-				"layout (triangle_strip, max_vertices = 3) out;\n"
-				"\n"
-				"uniform vec2 			uViewportSize;\n"
-				"\n"
-				"in VertexData	{\n"
-				"	vec4 color;\n"
-				"	vec2 texcoord;\n"
-				"} vVertexIn[];\n"
-				"\n"
-				"out VertexData	{\n"
-				"	noperspective vec3 distance;\n"
-				"	vec4 color;\n"
-				"	vec2 texcoord;\n"
-				"} vVertexOut;\n"
-				"\n"
-				"void main(void)\n"
-				"{\n"
-				"	// taken from 'Single-Pass Wireframe Rendering'\n"
-				"	vec2 p0 = uViewportSize * gl_in[0].gl_Position.xy / gl_in[0].gl_Position.w;\n"
-				"	vec2 p1 = uViewportSize * gl_in[1].gl_Position.xy / gl_in[1].gl_Position.w;\n"
-				"	vec2 p2 = uViewportSize * gl_in[2].gl_Position.xy / gl_in[2].gl_Position.w;\n"
-				"\n"
-				"	vec2 v0 = p2-p1;\n"
-				"	vec2 v1 = p2-p0;\n"
-				"	vec2 v2 = p1-p0;\n"
-				"	float fArea = abs(v1.x*v2.y - v1.y * v2.x);\n"
-				"\n"
-				"	vVertexOut.distance = vec3(fArea/length(v0),0,0);\n"
-				"	vVertexOut.color = vVertexIn[0].color;\n"
-				"	vVertexOut.texcoord = vVertexIn[0].texcoord;\n"
-				"	gl_Position = gl_in[0].gl_Position;\n"
-				"	EmitVertex();\n"
-				"\n"
-				"	vVertexOut.distance = vec3(0,fArea/length(v1),0);\n"
-				"	vVertexOut.color = vVertexIn[1].color;\n"
-				"	vVertexOut.texcoord = vVertexIn[1].texcoord;\n"
-				"	gl_Position = gl_in[1].gl_Position;\n"
-				"	EmitVertex();\n"
-				"\n"
-				"	vVertexOut.distance = vec3(0,0,fArea/length(v2));\n"
-				"	vVertexOut.color = vVertexIn[2].color;\n"
-				"	vVertexOut.texcoord = vVertexIn[2].texcoord;\n"
-				"	gl_Position = gl_in[2].gl_Position;\n"
-				"	EmitVertex();\n"
-				"\n"
-				"	EndPrimitive();\n"
-				"}\n"
-			) 
-			.fragment(
-				"#version 150\n"
-				"\n"
-				"uniform float uBrightness;\n"
-				"\n"
-				"in VertexData	{\n"
-				"	noperspective vec3 distance;\n"
-				"	vec4 color;\n"
-				"	vec2 texcoord;\n"
-				"} vVertexIn;\n"
-				"\n"
-				"out vec4				oColor;\n"
-				"\n"
-				"void main(void) {\n"
-				"	// determine frag distance to closest edge\n"
-				"	float fNearest = min(min(vVertexIn.distance[0],vVertexIn.distance[1]),vVertexIn.distance[2]);\n"
-				"	float fEdgeIntensity = exp2(-1.0*fNearest*fNearest);\n"
-				"\n"
-				"	// blend between edge color and face color\n"
-				"	vec3 vFaceColor = vVertexIn.color.rgb;\n"
-				"	vec3 vEdgeColor = vec3(0.2, 0.2, 0.2);\n"
-				"	oColor.rgb = mix(vFaceColor, vEdgeColor, fEdgeIntensity) * uBrightness;\n"
-				"	oColor.a = 0.65;\n"
-				"}\n"
-			)
+		// vertex, fragment and geometry shader
+		mWireframeShader = mProgramBinaries->getProgram(
+			"#version 150\n"
+			"\n"
+			"uniform mat4	ciModelViewProjection;\n"
+			"in vec4		ciPosition;\n"
+			"in vec4		ciColor;\n"
+			"in vec2		ciTexCoord0;\n"
+			"\n"
+			"out VertexData {\n"
+			"	vec4 color;\n"
+			"	vec2 texcoord;\n"
+			"} vVertexOut;\n"
+			"\n"
+			"void main(void) {\n"
+			"	vVertexOut.color = ciColor;\n"
+			"	vVertexOut.texcoord = ciTexCoord0;\n"
+			"	gl_Position = ciModelViewProjection * ciPosition;\n"
+			"}\n",
+			"#version 150\n"
+			"\n"
+			"uniform float uBrightness;\n"
+			"\n"
+			"in VertexData	{\n"
+			"	noperspective vec3 distance;\n"
+			"	vec4 color;\n"
+			"	vec2 texcoord;\n"
+			"} vVertexIn;\n"
+			"\n"
+			"out vec4				oColor;\n"
+			"\n"
+			"void main(void) {\n"
+			"	// determine frag distance to closest edge\n"
+			"	float fNearest = min(min(vVertexIn.distance[0],vVertexIn.distance[1]),vVertexIn.distance[2]);\n"
+			"	float fEdgeIntensity = exp2(-1.0*fNearest*fNearest);\n"
+			"\n"
+			"	// blend between edge color and face color\n"
+			"	vec3 vFaceColor = vVertexIn.color.rgb;\n"
+			"	vec3 vEdgeColor = vec3(0.2, 0.2, 0.2);\n"
+			"	oColor.rgb = mix(vFaceColor, vEdgeColor, fEdgeIntensity) * uBrightness;\n"
+			"	oColor.a = 0.65;\n"
+			"}\n",
+			"#version 150\n"
+			"\n"
+			"layout (triangles) in;\n"
+			"layout (triangle_strip, max_vertices = 3) out;\n"
+			"\n"
+			"uniform vec2 			uViewportSize;\n"
+			"\n"
+			"in VertexData	{\n"
+			"	vec4 color;\n"
+			"	vec2 texcoord;\n"
+			"} vVertexIn[];\n"
+			"\n"
+			"out VertexData	{\n"
+			"	noperspective vec3 distance;\n"
+			"	vec4 color;\n"
+			"	vec2 texcoord;\n"
+			"} vVertexOut;\n"
+			"\n"
+			"void main(void)\n"
+			"{\n"
+			"	// taken from 'Single-Pass Wireframe Rendering'\n"
+			"	vec2 p0 = uViewportSize * gl_in[0].gl_Position.xy / gl_in[0].gl_Position.w;\n"
+			"	vec2 p1 = uViewportSize * gl_in[1].gl_Position.xy / gl_in[1].gl_Position.w;\n"
+			"	vec2 p2 = uViewportSize * gl_in[2].gl_Position.xy / gl_in[2].gl_Position.w;\n"
+			"\n"
+			"	vec2 v0 = p2-p1;\n"
+			"	vec2 v1 = p2-p0;\n"
+			"	vec2 v2 = p1-p0;\n"
+			"	float fArea = abs(v1.x*v2.y - v1.y * v2.x);\n"
+			"\n"
+			"	vVertexOut.distance = vec3(fArea/length(v0),0,0);\n"
+			"	vVertexOut.color = vVertexIn[0].color;\n"
+			"	vVertexOut.texcoord = vVertexIn[0].texcoord;\n"
+			"	gl_Position = gl_in[0].gl_Position;\n"
+			"	EmitVertex();\n"
+			"\n"
+			"	vVertexOut.distance = vec3(0,fArea/length(v1),0);\n"
+			"	vVertexOut.color = vVertexIn[1].color;\n"
+			"	vVertexOut.texcoord = vVertexIn[1].texcoord;\n"
+			"	gl_Position = gl_in[1].gl_Position;\n"
+			"	EmitVertex();\n"
+			"\n"
+			"	vVertexOut.distance = vec3(0,0,fArea/length(v2));\n"
+			"	vVertexOut.color = vVertexIn[2].color;\n"
+			"	vVertexOut.texcoord = vVertexIn[2].texcoord;\n"
+			"	gl_Position = gl_in[2].gl_Position;\n"
+			"	EmitVertex();\n"
+			"\n"
+			"	EndPrimitive();\n"
+			"}\n"
 		);
 	}
 	catch( const std::exception& e ) {
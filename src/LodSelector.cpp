@@ -0,0 +1,112 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+//! Frames right after a level change are ignored: they include building the batches, maybe an upload.
+const double	SETTLE_TIME = 0.25;
+//! Weight of the newest frame in the smoothed frame time.
+const double	SMOOTHING = 0.1;
+//! Frames are too slow above SLOW_FACTOR times the target, and fast enough up to FAST_FACTOR times it;
+//! the margins keep vertical sync jitter from counting either way.
+const double	SLOW_FACTOR = 1.2, FAST_FACTOR = 1.1;
+//! How long frames have to be too slow before stepping down, and fast enough before stepping up.
+const double	SLOW_TIME = 0.25, FAST_TIME = 1.0;
+//! How long a level that was stepped up to has to hold the target before it counts as proven.
+const double	STABLE_TIME = 10.0;
+//! How long a level that was too slow is left alone the first time, and at most.
+const double	INITIAL_BACKOFF = 4.0, MAX_BACKOFF = 64.0;
+//! Triangles per covered pixel up to which a finer level is worth it. Only the front half of the
+//! triangles is visible, so this allows about four pixels per visible triangle.
+const double	TRIANGLES_PER_PIXEL = 0.5;
+//! A level is only dropped for its size on screen once it has this many times the triangles allowed.
+const double	SCREEN_HYSTERESIS = 2.0;
+
+} // anonymous namespace
+
+LodSelector::LodSelector( size_t numLevels, double targetFrameTime )
+	: mTargetFrameTime( targetFrameTime )
+{
+	reset( numLevels, 0 );
+}
+
+void LodSelector::reset( size_t numLevels, size_t level )
+{
+	Level unknown;
+	unknown.triangles = 0;
+	unknown.blockedUntil = 0.0;
+	unknown.backoff = INITIAL_BACKOFF;
+	mLevels.assign( max<size_t>( numLevels, 1 ), unknown );
+
+	mTime = 0.0;
+	setLevel( min( level, mLevels.size() - 1 ) );
+}
+
+void LodSelector::setTriangleCount( size_t level, size_t count )
+{
+	if( level < mLevels.size() )
+		mLevels[level].triangles = count;
+}
+
+void LodSelector::setLevel( size_t level )
+{
+	mLevel = level;
+	mLevelTime = 0.0;
+	mSmoothedFrameTime = 0.0;
+	mSlowTime = mFastTime = 0.0;
+	mProbing = false;
+}
+
+size_t LodSelector::update( double frameTime, float screenArea )
+{
+	mTime += frameTime;
+	mLevelTime += frameTime;
+	if( mLevelTime < SETTLE_TIME )
+		return mLevel;
+
+	mSmoothedFrameTime = mSmoothedFrameTime > 0.0 ? mSmoothedFrameTime + SMOOTHING * ( frameTime - mSmoothedFrameTime ) : frameTime;
+	if( mSmoothedFrameTime > SLOW_FACTOR * mTargetFrameTime ) {
+		mSlowTime += frameTime;
+		mFastTime = 0.0;
+	}
+	else {
+		mSlowTime = 0.0;
+		mFastTime = mSmoothedFrameTime <= FAST_FACTOR * mTargetFrameTime ? mFastTime + frameTime : 0.0;
+	}
+
+	if( mProbing && mLevelTime >= STABLE_TIME ) {
+		mProbing = false;
+		mLevels[mLevel].backoff = INITIAL_BACKOFF;
+	}
+
+	// too slow: step down, and leave this level alone for a while; longer if it just failed a try
+	if( mLevel > 0 && mSlowTime >= SLOW_TIME ) {
+		Level &level = mLevels[mLevel];
+		if( ! mProbing )
+			level.backoff = INITIAL_BACKOFF;
+		level.blockedUntil = mTime + level.backoff;
+		level.backoff = min( 2.0 * level.backoff, MAX_BACKOFF );
+		setLevel( mLevel - 1 );
+		return mLevel;
+	}
+
+	// more triangles than the screen can show
+	double screenLimit = TRIANGLES_PER_PIXEL * screenArea;
+	if( mLevel > 0 && mLevels[mLevel].triangles > SCREEN_HYSTERESIS * screenLimit ) {
+		setLevel( mLevel - 1 );
+		return mLevel;
+	}
+
+	// fast enough for a while: try the next finer level, if it is ready and would be visible
+	if( mLevel + 1 < mLevels.size() && mFastTime >= FAST_TIME ) {
+		const Level &next = mLevels[mLevel + 1];
+		if( next.triangles && next.triangles <= screenLimit && mTime >= next.blockedUntil ) {
+			setLevel( mLevel + 1 );
+			mProbing = true;
+		}
+	}
+	return mLevel;
+}
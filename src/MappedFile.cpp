@@ -0,0 +1,180 @@
+#include "MappedFile.h"
+
+#if defined( _WIN32 )
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <algorithm>
+	#include <cerrno>
+	#include <cstring>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFileRef MappedFile::open( const string &path, Mode mode )
+{
+	return MappedFileRef( new MappedFile( path, mode, 0 ) );
+}
+
+MappedFileRef MappedFile::create( const string &path, size_t size )
+{
+	if( size == 0 )
+		throw MappedFileExc( path, "cannot create an empty mapping" );
+
+	return MappedFileRef( new MappedFile( path, READ_WRITE, size ) );
+}
+
+#if defined( _WIN32 )
+
+namespace {
+
+string lastError()
+{
+	char message[256] = "";
+	FormatMessageA( FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, NULL, GetLastError(), 0, message, sizeof( message ), NULL );
+	return message;
+}
+
+} // anonymous namespace
+
+MappedFile::MappedFile( const string &path, Mode mode, size_t createSize )
+	: mPath( path ), mMode( mode ), mData( nullptr ), mSize( 0 ), mFile( INVALID_HANDLE_VALUE ), mMapping( NULL )
+{
+	DWORD access = ( mode == READ ) ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE;
+	DWORD disposition = createSize ? CREATE_ALWAYS : OPEN_EXISTING;
+	mFile = CreateFileA( path.c_str(), access, FILE_SHARE_READ, NULL, disposition, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( mFile == INVALID_HANDLE_VALUE )
+		throw MappedFileExc( path, lastError() );
+
+	LARGE_INTEGER size;
+	if( createSize )
+		size.QuadPart = (LONGLONG) createSize;
+	else if( ! GetFileSizeEx( mFile, &size ) ) {
+		CloseHandle( mFile );
+		throw MappedFileExc( path, lastError() );
+	}
+
+	mSize = (size_t) size.QuadPart;
+	if( mSize == 0 ) {
+		CloseHandle( mFile );
+		throw MappedFileExc( path, "file is empty" );
+	}
+
+	// mapping a writable view larger than the file grows the file
+	mMapping = CreateFileMappingA( mFile, NULL, mode == READ ? PAGE_READONLY : PAGE_READWRITE, size.HighPart, size.LowPart, NULL );
+	if( mMapping == NULL ) {
+		CloseHandle( mFile );
+		throw MappedFileExc( path, lastError() );
+	}
+
+	mData = static_cast<uint8_t*>( MapViewOfFile( mMapping, mode == READ ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, mSize ) );
+	if( ! mData ) {
+		CloseHandle( mMapping );
+		CloseHandle( mFile );
+		throw MappedFileExc( path, lastError() );
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	UnmapViewOfFile( mData );
+	CloseHandle( mMapping );
+	CloseHandle( mFile );
+}
+
+void MappedFile::flush()
+{
+	if( mMode == READ_WRITE ) {
+		FlushViewOfFile( mData, mSize );
+		FlushFileBuffers( mFile );
+	}
+}
+
+void MappedFile::advise( size_t /*offset*/, size_t /*size*/, Advice /*advice*/ ) const
+{
+}
+
+#else
+
+MappedFile::MappedFile( const string &path, Mode mode, size_t createSize )
+	: mPath( path ), mMode( mode ), mData( nullptr ), mSize( 0 ), mFile( -1 )
+{
+	int flags = ( mode == READ ) ? O_RDONLY : O_RDWR;
+	if( createSize )
+		flags |= O_CREAT | O_TRUNC;
+
+	mFile = ::open( path.c_str(), flags, 0644 );
+	if( mFile < 0 )
+		throw MappedFileExc( path, strerror( errno ) );
+
+	if( createSize ) {
+		if( ftruncate( mFile, (off_t) createSize ) != 0 ) {
+			int error = errno;
+			::close( mFile );
+			throw MappedFileExc( path, strerror( error ) );
+		}
+		mSize = createSize;
+	}
+	else {
+		struct stat info;
+		if( fstat( mFile, &info ) != 0 ) {
+			int error = errno;
+			::close( mFile );
+			throw MappedFileExc( path, strerror( error ) );
+		}
+		mSize = (size_t) info.st_size;
+	}
+
+	if( mSize == 0 ) {
+		::close( mFile );
+		throw MappedFileExc( path, "file is empty" );
+	}
+
+	int protection = ( mode == READ ) ? PROT_READ : PROT_READ | PROT_WRITE;
+	void *data = mmap( nullptr, mSize, protection, MAP_SHARED, mFile, 0 );
+	if( data == MAP_FAILED ) {
+		int error = errno;
+		::close( mFile );
+		throw MappedFileExc( path, strerror( error ) );
+	}
+	mData = static_cast<uint8_t*>( data );
+}
+
+MappedFile::~MappedFile()
+{
+	munmap( mData, mSize );
+	::close( mFile );
+}
+
+void MappedFile::flush()
+{
+	if( mMode == READ_WRITE )
+		msync( mData, mSize, MS_SYNC );
+}
+
+void MappedFile::advise( size_t offset, size_t size, Advice advice ) const
+{
+	if( offset >= mSize )
+		return;
+
+	// madvise() wants a page-aligned start
+	static const size_t pageSize = (size_t) sysconf( _SC_PAGESIZE );
+	size_t begin = offset / pageSize * pageSize;
+	size_t end = offset + std::min( size, mSize - offset );
+
+	int flag = MADV_NORMAL;
+	switch( advice ) {
+		case ADVISE_NORMAL: flag = MADV_NORMAL; break;
+		case ADVISE_SEQUENTIAL: flag = MADV_SEQUENTIAL; break;
+		case ADVISE_WILL_NEED: flag = MADV_WILLNEED; break;
+		case ADVISE_DONT_NEED: flag = MADV_DONTNEED; break;
+	}
+	madvise( mData + begin, end - begin, flag );
+}
+
+#endif
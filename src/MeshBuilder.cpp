@@ -0,0 +1,170 @@
+#include "MeshBuilder.h"
+#include "MeshDecimation.h"
+#include "MeshSubdivision.h"
+
+#include <algorithm>
+
+using namespace ci;
+using namespace std;
+
+MeshBuilder::MeshBuilder()
+	: mActive( false ), mQuit( false ), mPrefetching( false ), mGeneration( 0 )
+{
+	mThread = thread( &MeshBuilder::buildLoop, this );
+}
+
+MeshBuilder::~MeshBuilder()
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mQuit = true;
+		++mGeneration;
+	}
+	mWakeUp.notify_all();
+	mThread.join();
+}
+
+void MeshBuilder::request( const MeshKey &key, const geom::SourceRef &source )
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		if( mActive && mKey == key )
+			return;
+
+		mKey = key;
+		mActive = true;
+		++mGeneration;
+
+		// the request takes the place of a prefetch of the same mesh
+		for( auto it = mPrefetches.begin(); it != mPrefetches.end(); ++it ) {
+			if( it->first == key ) {
+				mPrefetches.erase( it );
+				break;
+			}
+		}
+		if( mPrefetching && mPrefetchKey == key )
+			mSource.reset();
+		else
+			mSource = source;
+	}
+	mWakeUp.notify_all();
+}
+
+void MeshBuilder::cancel()
+{
+	lock_guard<mutex> lock( mMutex );
+	mSource.reset();
+	mActive = false;
+	++mGeneration;
+}
+
+void MeshBuilder::prefetch( const MeshKey &key, const geom::SourceRef &source )
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		if( ( mActive && mKey == key ) || ( mPrefetching && mPrefetchKey == key ) )
+			return;
+		for( size_t i = 0; i < mPrefetches.size(); ++i )
+			if( mPrefetches[i].first == key )
+				return;
+
+		mPrefetches.push_back( make_pair( key, source ) );
+	}
+	mWakeUp.notify_all();
+}
+
+void MeshBuilder::cancelPrefetches()
+{
+	lock_guard<mutex> lock( mMutex );
+	mPrefetches.clear();
+}
+
+bool MeshBuilder::isBuilding() const
+{
+	lock_guard<mutex> lock( mMutex );
+	return mActive;
+}
+
+bool MeshBuilder::takeResult( Result *result )
+{
+	lock_guard<mutex> lock( mMutex );
+	if( mResults.empty() )
+		return false;
+
+	*result = mResults.front();
+	mResults.pop_front();
+	if( mActive && result->key == mKey )
+		mActive = false;
+	return true;
+}
+
+bool MeshBuilder::build( const geom::Source &source, const MeshKey &key, Result *result, const function<bool()> &isCancelled )
+{
+	TriMeshRef mesh = TriMesh::create( source );
+	result->key = key;
+	result->center = mesh->calcBoundingBox().getCenter();
+	if( isCancelled && isCancelled() )
+		return false;
+
+	if( key.subdivision > 1 ) {
+		mesh = MeshSubdivision::subdivide( *mesh, key.subdivision, key.smooth ? MeshSubdivision::LOOP : MeshSubdivision::LINEAR,
+			&ThreadPool::instance(), isCancelled );
+		if( ! mesh )
+			return false;
+	}
+
+	if( key.detail < 100 ) {
+		size_t target = mesh->getNumTriangles() * max( key.detail, 1 ) / 100;
+		mesh = MeshDecimation::decimate( *mesh, target, &ThreadPool::instance(), isCancelled );
+		if( ! mesh )
+			return false;
+	}
+
+	// every transformation shader is heavy on the vertex stage, so shading fewer vertices pays off
+	result->optimization = MeshOptimizer::optimize( mesh.get() );
+	if( isCancelled && isCancelled() )
+		return false;
+
+	result->normals = DebugMesh::create( mesh, Color( 1, 1, 0 ), &ThreadPool::instance() );
+	result->mesh = mesh;
+	return true;
+}
+
+void MeshBuilder::buildLoop()
+{
+	unique_lock<mutex> lock( mMutex );
+	while( true ) {
+		mWakeUp.wait( lock, [this] { return mQuit || mSource || ! mPrefetches.empty(); } );
+		if( mQuit )
+			break;
+
+		// requests go first; prefetches are not cancelled, as every mesh they build ends up being used
+		geom::SourceRef source;
+		MeshKey key;
+		uint32_t generation = mGeneration;
+		bool cancellable = !! mSource;
+		if( cancellable ) {
+			source = mSource;
+			mSource.reset();
+			key = mKey;
+		}
+		else {
+			source = mPrefetches.front().second;
+			key = mPrefetches.front().first;
+			mPrefetches.pop_front();
+			mPrefetching = true;
+			mPrefetchKey = key;
+		}
+
+		lock.unlock();
+		Result result;
+		bool built = build( *source, key, &result, cancellable ? function<bool()>( [this, generation] { return mGeneration != generation; } ) : function<bool()>() );
+		source.reset();
+		lock.lock();
+		mPrefetching = false;
+
+		// a newer request or cancel() may have come in since the build was cancelled or finished
+		if( built && ( ! cancellable || mGeneration == generation ) )
+			mResults.push_back( result );
+	}
+}
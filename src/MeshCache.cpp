@@ -0,0 +1,141 @@
+#include "MeshCache.h"
+#include "ThreadPool.h"
+
+using namespace ci;
+using namespace std;
+
+bool MeshKey::operator<( const MeshKey &other ) const
+{
+	if( primitive != other.primitive )
+		return primitive < other.primitive;
+	if( quality != other.quality )
+		return quality < other.quality;
+	if( subdivision != other.subdivision )
+		return subdivision < other.subdivision;
+	if( smooth != other.smooth )
+		return other.smooth;
+	if( detail != other.detail )
+		return detail < other.detail;
+	return attributes < other.attributes;
+}
+
+bool MeshKey::operator==( const MeshKey &other ) const
+{
+	return primitive == other.primitive && quality == other.quality && subdivision == other.subdivision && smooth == other.smooth && detail == other.detail
+		&& attributes == other.attributes;
+}
+
+MeshCacheEntryRef MeshCacheEntry::create( const TriMeshRef &mesh, const vec3 &center )
+{
+	MeshCacheEntryRef entry( new MeshCacheEntry );
+	entry->mesh = mesh;
+	entry->center = center;
+	entry->restBounds = RestBounds( *mesh, &ThreadPool::instance() );
+	AxisAlignedBox3f bounds = toBox( entry->restBounds.position );
+	entry->radius = distance( center, bounds.getCenter() ) + 0.5f * length( bounds.getSize() );
+
+	const geom::Attrib attribs[] = { geom::Attrib::POSITION, geom::Attrib::NORMAL, geom::Attrib::TEX_COORD_0, geom::Attrib::COLOR };
+	for( size_t i = 0; i < sizeof( attribs ) / sizeof( attribs[0] ); ++i ) {
+		uint8_t dims = mesh->getAttribDims( attribs[i] );
+		if( ! dims )
+			continue;
+
+		const float *data = nullptr;
+		switch( attribs[i] ) {
+			case geom::Attrib::POSITION: data = (const float*) mesh->getPositions<3>(); break;
+			case geom::Attrib::NORMAL: data = (const float*) mesh->getNormals().data(); break;
+			case geom::Attrib::TEX_COORD_0: data = mesh->getBufferTexCoords0().data(); break;
+			case geom::Attrib::COLOR: data = mesh->getBufferColors().data(); break;
+			default: break;
+		}
+
+		geom::BufferLayout layout;
+		layout.append( attribs[i], dims, 0, 0 );
+		entry->vertexBuffers.push_back( make_pair( layout, gl::Vbo::create( GL_ARRAY_BUFFER, mesh->getNumVertices() * dims * sizeof( float ), data, GL_STATIC_DRAW ) ) );
+	}
+
+	entry->indices = gl::Vbo::create( GL_ELEMENT_ARRAY_BUFFER, mesh->getIndices(), GL_STATIC_DRAW );
+	entry->vboMesh = entry->createVboMesh();
+	return entry;
+}
+
+gl::VboMeshRef MeshCacheEntry::createVboMesh( const VertexBuffers &extraBuffers, bool withPositionsAndNormals ) const
+{
+	VertexBuffers buffers;
+	for( size_t i = 0; i < vertexBuffers.size(); ++i ) {
+		geom::Attrib attrib = vertexBuffers[i].first.getAttribs().front().getAttrib();
+		if( withPositionsAndNormals || ( attrib != geom::Attrib::POSITION && attrib != geom::Attrib::NORMAL ) )
+			buffers.push_back( vertexBuffers[i] );
+	}
+	buffers.insert( buffers.end(), extraBuffers.begin(), extraBuffers.end() );
+
+	return gl::VboMesh::create( (uint32_t) mesh->getNumVertices(), GL_TRIANGLES, buffers, (uint32_t) mesh->getNumIndices(), GL_UNSIGNED_INT, indices );
+}
+
+size_t MeshCacheEntry::getByteSize() const
+{
+	size_t floatsPerVertex = restInvariants.size();
+	for( size_t i = 0; i < vertexBuffers.size(); ++i )
+		floatsPerVertex += vertexBuffers[i].first.getAttribs().front().getDims();
+
+	// the mesh and the buffers hold the same data once each; the normal lines are counted as if already
+	// shown and following the deformation, which takes the most memory
+	size_t size = 2 * ( mesh->getNumVertices() * floatsPerVertex + mesh->getNumIndices() ) * sizeof( float );
+	if( normals )
+		size += normals->getMaxByteSize();
+	return size;
+}
+
+MeshCache::MeshCache( size_t budget )
+	: mBudget( budget ), mSize( 0 ), mNumHits( 0 ), mNumMisses( 0 )
+{
+}
+
+MeshCacheEntryRef MeshCache::find( const MeshKey &key )
+{
+	map<MeshKey, ItemList::iterator>::iterator it = mLookup.find( key );
+	if( it == mLookup.end() ) {
+		++mNumMisses;
+		return MeshCacheEntryRef();
+	}
+
+	++mNumHits;
+	mEntries.splice( mEntries.begin(), mEntries, it->second );
+	return it->second->entry;
+}
+
+void MeshCache::insert( const MeshKey &key, const MeshCacheEntryRef &entry )
+{
+	map<MeshKey, ItemList::iterator>::iterator it = mLookup.find( key );
+	if( it != mLookup.end() ) {
+		mSize -= it->second->size;
+		mEntries.erase( it->second );
+		mLookup.erase( it );
+	}
+
+	Item item;
+	item.key = key;
+	item.entry = entry;
+	item.size = entry->getByteSize();
+	mEntries.push_front( item );
+	mLookup[key] = mEntries.begin();
+	mSize += item.size;
+
+	evict();
+}
+
+void MeshCache::clear()
+{
+	mEntries.clear();
+	mLookup.clear();
+	mSize = 0;
+}
+
+void MeshCache::evict()
+{
+	while( mSize > mBudget && mEntries.size() > 1 ) {
+		mSize -= mEntries.back().size;
+		mLookup.erase( mEntries.back().key );
+		mEntries.pop_back();
+	}
+}
@@ -0,0 +1,779 @@
+#include "MeshDecimation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <queue>
+#include <utility>
+#include <vector>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const uint32_t	NO_INDEX = 0xffffffff;
+//! Cell of a vertex with triangles in more than one cell, and the cell argument meaning all of them.
+const uint32_t	SHARED_CELL = 0xfffffffe, ALL_CELLS = 0xffffffff;
+// wedges per task
+const size_t	GRAIN_SIZE = 4096;
+//! About this many triangles go into a cell, with at most MAX_CELLS_PER_AXIS cells along each axis.
+const size_t	TRIANGLES_PER_CELL = 16384, MAX_CELLS_PER_AXIS = 16;
+//! How much errors in normals and texture coordinates count against errors in positions, which are
+//! scaled to fit a unit cube.
+const float		NORMAL_WEIGHT = 0.5f, TEX_COORD_WEIGHT = 1.0f;
+//! Weight of the planes that hold borders and seams in place, per squared edge length.
+const float		BORDER_WEIGHT = 10.0f;
+//! Weight of the squared edge length, per area, added to every cost. Without it the collapses on flat
+//! parts all cost nothing and pile onto the same vertices, which gives fans of slivers.
+const float		SHAPE_WEIGHT = 1e-3f;
+//! A collapse is rejected if it turns a triangle by more than about 75 degrees.
+const float		MIN_NORMAL_COSINE = 0.25f;
+// collapses between two calls to isCancelled
+const size_t	CANCEL_INTERVAL = 1024;
+
+//! Area-weighted sum of squared distances to planes: p^T A p + 2 b.p + c.
+struct Quadric {
+	float	a00, a01, a02, a11, a12, a22;
+	float	b0, b1, b2;
+	float	c;
+
+	//! Adds the plane n.p + d = 0 with weight \a w. \a n need not be normalized, which turns the
+	//! distance into the error of a linear function.
+	void addPlane( const vec3 &n, float d, float w )
+	{
+		a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+		a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+		b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+		c += w * d * d;
+	}
+
+	void add( const Quadric &q )
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2;
+		c += q.c;
+	}
+
+	float evaluate( const vec3 &p ) const
+	{
+		return p.x * ( a00 * p.x + 2.0f * ( a01 * p.y + a02 * p.z + b0 ) )
+			+ p.y * ( a11 * p.y + 2.0f * ( a12 * p.z + b1 ) )
+			+ p.z * ( a22 * p.z + 2.0f * b2 ) + c;
+	}
+};
+
+typedef enum { MANIFOLD, BORDER, SEAM, LOCKED } Kind;
+
+//! A half-edge collapse of position onto target: wedge from[i] moves onto wedge to[i]. A position on a
+//! seam moves both of its wedges; otherwise from[1] is NO_INDEX.
+struct Collapse {
+	uint32_t	position, target;
+	uint32_t	from[2], to[2];
+	float		cost;
+
+	bool operator<( const Collapse &other ) const { return cost != other.cost ? cost < other.cost : target < other.target; }
+};
+
+struct Candidate {
+	float		cost;
+	uint32_t	position, target, stamp;
+
+	//! Cheapest first in a priority_queue, ties broken by position so the order is deterministic.
+	bool operator<( const Candidate &other ) const { return cost != other.cost ? cost > other.cost : position > other.position; }
+};
+
+//! Scratch space of one thread.
+struct Workspace {
+	vector<uint32_t>	neighbors, targetNeighbors, updated;
+	vector<Collapse>	collapses;
+};
+
+//! The mesh being simplified. Vertices of the input are wedges; wedges at exactly the same position form
+//! a position, identified by its lowest wedge. Triangles refer to wedges, topology is that of positions.
+class Decimator {
+public:
+	Decimator( const TriMesh &mesh, ThreadPool *pool );
+
+	size_t		getNumCells() const { return mCellPositionOffsets.size() - 1; }
+	size_t		getCellTriangles( size_t cell ) const { return mCellTriangles[cell]; }
+	size_t		countTriangles() const;
+
+	//! Collapses positions of \a cell, or of the whole mesh with ALL_CELLS, until no more than \a target
+	//! of the \a numTriangles triangles there are left. Returns false if cancelled.
+	bool		simplify( uint32_t cell, size_t *numTriangles, size_t target, const function<bool()> &isCancelled );
+	//! The remaining triangles, with the attributes of \a mesh, vertices in the order they are used.
+	TriMeshRef	createMesh( const TriMesh &mesh ) const;
+
+private:
+	//! Calls \a fn( t ) for every remaining triangle at wedge \a w, unlinking removed ones on the way.
+	template<typename FnT>
+	void		forEachTriangle( uint32_t w, FnT fn );
+	//! The positions sharing a remaining triangle with \a position, sorted.
+	void		collectNeighbors( uint32_t position, vector<uint32_t> *neighbors );
+	//! Adds the quadrics of triangle \a t to those of its wedge \a w.
+	void		addTriangle( uint32_t t, uint32_t w, Quadric *quadric, float *terms ) const;
+	//! The error of moving wedge \a from onto the position and attributes of wedge \a to, plus the shape term.
+	float		getError( uint32_t from, uint32_t to ) const;
+
+	//! Checks that \a position may move onto \a target along their edge, and fills in \a collapse with
+	//! the wedges that move and the cost.
+	bool		prepare( uint32_t position, uint32_t target, uint32_t cell, Collapse *collapse );
+	//! Checks that \a collapse keeps the surface manifold and turns no triangle over. \a neighbors are
+	//! those of the position that moves.
+	bool		isValid( const Collapse &collapse, const vector<uint32_t> &neighbors, Workspace *work );
+	//! The cheapest valid collapse of \a position, if any.
+	bool		findBest( uint32_t position, uint32_t cell, Workspace *work, Collapse *best );
+	//! Returns the number of triangles removed.
+	size_t		apply( const Collapse &collapse );
+
+	size_t				mNumAttributes, mTermStride;
+	vector<uint32_t>	mIndices;
+	vector<uint8_t>		mRemoved;			// per triangle
+	vector<uint8_t>		mOpenCorner;		// the edge from this corner to the next has a single triangle
+	vector<vec3>		mPositions;			// scaled to fit a unit cube
+	vector<float>		mAttributes;		// weighted normals and texture coordinates, mNumAttributes per wedge
+	vector<uint32_t>	mWeld;				// position of every wedge
+	vector<uint32_t>	mWedgeOffsets, mWedges;	// the wedges of position p are mWedges[mWedgeOffsets[p]] up to mWedgeOffsets[p + 1]
+	vector<uint8_t>		mKind;				// per position
+	vector<uint32_t>	mCell;				// per position
+	vector<uint32_t>	mStamps;			// per position, bumped whenever its candidate goes stale
+	vector<uint32_t>	mTargets;			// per position, of its candidate in the queue, or NO_INDEX
+	vector<float>		mCosts;				// of those candidates
+	vector<uint32_t>	mHead, mTail, mNext;	// the corners at each wedge, as linked lists
+	vector<Quadric>		mQuadrics;			// per wedge
+	vector<float>		mTerms;				// per wedge: area, then gradient and offset per attribute
+	vector<uint32_t>	mCellPositionOffsets, mCellPositions;
+	vector<size_t>		mCellTriangles;
+};
+
+Decimator::Decimator( const TriMesh &mesh, ThreadPool *pool )
+{
+	size_t numVertices = mesh.getNumVertices();
+	mIndices = mesh.getIndices();
+	size_t numTriangles = mIndices.size() / 3;
+
+	// positions scaled into a unit cube, so that the error does not depend on the size of the mesh
+	size_t positionDims = mesh.getAttribDims( geom::Attrib::POSITION );
+	const float *positions = mesh.getBufferPositions().data();
+	mPositions.assign( numVertices, vec3( 0 ) );
+	for( size_t v = 0; v < numVertices; ++v )
+		for( size_t d = 0; d < min<size_t>( positionDims, 3 ); ++d )
+			mPositions[v][d] = positions[v * positionDims + d];
+	vec3 low( 0 ), high( 0 );
+	if( numVertices ) {
+		low = high = mPositions[0];
+		for( size_t v = 1; v < numVertices; ++v ) {
+			low = glm::min( low, mPositions[v] );
+			high = glm::max( high, mPositions[v] );
+		}
+	}
+	vec3 extent = high - low;
+	float size = max( extent.x, max( extent.y, extent.z ) );
+	float scale = size > 0.0f ? 1.0f / size : 1.0f;
+	for( size_t v = 0; v < numVertices; ++v )
+		mPositions[v] = ( mPositions[v] - low ) * scale;
+
+	bool hasNormals = mesh.hasNormals() && mesh.getNormals().size() == numVertices;
+	size_t texCoordDims = mesh.getAttribDims( geom::Attrib::TEX_COORD_0 );
+	mNumAttributes = ( hasNormals ? 3 : 0 ) + ( texCoordDims >= 2 ? 2 : 0 );
+	mTermStride = 1 + 4 * mNumAttributes;
+	mAttributes.resize( numVertices * mNumAttributes );
+	for( size_t v = 0; v < numVertices; ++v ) {
+		float *attributes = &mAttributes[v * mNumAttributes];
+		if( hasNormals ) {
+			const vec3 &normal = mesh.getNormals()[v];
+			for( size_t d = 0; d < 3; ++d )
+				*attributes++ = NORMAL_WEIGHT * normal[d];
+		}
+		if( texCoordDims >= 2 ) {
+			for( size_t d = 0; d < 2; ++d )
+				*attributes++ = TEX_COORD_WEIGHT * mesh.getBufferTexCoords0()[v * texCoordDims + d];
+		}
+	}
+
+	// every wedge is welded to the lowest wedge at bitwise the same position
+	{
+		vector<uint32_t> order( numVertices );
+		iota( order.begin(), order.end(), 0u );
+		auto bits = [&]( uint32_t v, uint32_t out[3] ) {
+			for( size_t d = 0; d < 3; ++d ) {
+				float value = ( d < positionDims ? positions[v * positionDims + d] : 0.0f ) + 0.0f;
+				memcpy( &out[d], &value, sizeof( float ) );
+			}
+		};
+		sort( order.begin(), order.end(), [&]( uint32_t a, uint32_t b ) {
+			uint32_t bitsA[3], bitsB[3];
+			bits( a, bitsA );
+			bits( b, bitsB );
+			int compare = memcmp( bitsA, bitsB, sizeof( bitsA ) );
+			return compare != 0 ? compare < 0 : a < b;
+		} );
+
+		mWeld.resize( numVertices );
+		uint32_t first = 0, firstBits[3], currentBits[3];
+		for( size_t i = 0; i < numVertices; ++i ) {
+			bits( order[i], currentBits );
+			if( i == 0 || memcmp( firstBits, currentBits, sizeof( firstBits ) ) != 0 ) {
+				first = order[i];
+				memcpy( firstBits, currentBits, sizeof( firstBits ) );
+			}
+			mWeld[order[i]] = first;
+		}
+	}
+
+	// triangles with two corners at the same position have no area and no proper edges
+	mRemoved.assign( numTriangles, 0 );
+	for( size_t t = 0; t < numTriangles; ++t ) {
+		uint32_t a = mWeld[mIndices[3 * t]], b = mWeld[mIndices[3 * t + 1]], c = mWeld[mIndices[3 * t + 2]];
+		mRemoved[t] = a == b || b == c || c == a;
+	}
+
+	mHead.assign( numVertices, NO_INDEX );
+	mTail.assign( numVertices, NO_INDEX );
+	mNext.assign( mIndices.size(), NO_INDEX );
+	for( uint32_t corner = 0; corner < mIndices.size(); ++corner ) {
+		if( mRemoved[corner / 3] )
+			continue;
+		uint32_t w = mIndices[corner];
+		if( mHead[w] == NO_INDEX )
+			mHead[w] = corner;
+		else
+			mNext[mTail[w]] = corner;
+		mTail[w] = corner;
+	}
+
+	// open edges: with a single triangle between wedges, they are borders or seams; with a single
+	// triangle between positions, they are borders
+	vector<uint8_t> openWedgeEdges( numVertices, 0 ), openPositionEdges( numVertices, 0 ), nonManifold( numVertices, 0 );
+	mOpenCorner.assign( mIndices.size(), 0 );
+	{
+		vector<pair<uint64_t, uint32_t>> edges;
+		edges.reserve( mIndices.size() );
+		for( int welded = 0; welded < 2; ++welded ) {
+			edges.clear();
+			for( uint32_t corner = 0; corner < mIndices.size(); ++corner ) {
+				if( mRemoved[corner / 3] )
+					continue;
+				uint32_t a = mIndices[corner], b = mIndices[corner - corner % 3 + ( corner + 1 ) % 3];
+				if( welded ) {
+					a = mWeld[a];
+					b = mWeld[b];
+				}
+				edges.push_back( make_pair( a < b ? (uint64_t) a << 32 | b : (uint64_t) b << 32 | a, corner ) );
+			}
+			sort( edges.begin(), edges.end() );
+
+			for( size_t i = 0; i < edges.size(); ) {
+				size_t j = i + 1;
+				while( j < edges.size() && edges[j].first == edges[i].first )
+					++j;
+				uint32_t a = (uint32_t)( edges[i].first >> 32 ), b = (uint32_t) edges[i].first;
+				if( j - i == 1 ) {
+					vector<uint8_t> &open = welded ? openPositionEdges : openWedgeEdges;
+					open[a] = (uint8_t) min( open[a] + 1, 255 );
+					open[b] = (uint8_t) min( open[b] + 1, 255 );
+					if( ! welded )
+						mOpenCorner[edges[i].second] = 1;
+				}
+				else if( welded && j - i > 2 )
+					nonManifold[a] = nonManifold[b] = 1;
+				i = j;
+			}
+		}
+	}
+
+	// the wedges of every position that are still in use
+	mWedgeOffsets.assign( numVertices + 1, 0 );
+	for( size_t w = 0; w < numVertices; ++w )
+		if( mHead[w] != NO_INDEX )
+			++mWedgeOffsets[mWeld[w] + 1];
+	for( size_t p = 0; p < numVertices; ++p )
+		mWedgeOffsets[p + 1] += mWedgeOffsets[p];
+	mWedges.resize( mWedgeOffsets.back() );
+	{
+		vector<uint32_t> cursors( mWedgeOffsets.begin(), mWedgeOffsets.end() - 1 );
+		for( uint32_t w = 0; w < numVertices; ++w )
+			if( mHead[w] != NO_INDEX )
+				mWedges[cursors[mWeld[w]]++] = w;
+	}
+
+	// what a position may do: anything inside the surface, move along a border, or move along a seam
+	// with exactly two wedges each side of which is open on two edges
+	mKind.assign( numVertices, LOCKED );
+	for( uint32_t p = 0; p < numVertices; ++p ) {
+		size_t numWedges = mWedgeOffsets[p + 1] - mWedgeOffsets[p];
+		if( mWeld[p] != p || nonManifold[p] || ! numWedges )
+			continue;
+		if( numWedges == 1 && openPositionEdges[p] == 0 )
+			mKind[p] = MANIFOLD;
+		else if( numWedges == 1 && openPositionEdges[p] == 2 )
+			mKind[p] = BORDER;
+		else if( numWedges == 2 && openPositionEdges[p] == 0 && openWedgeEdges[mWedges[mWedgeOffsets[p]]] == 2
+			&& openWedgeEdges[mWedges[mWedgeOffsets[p] + 1]] == 2 )
+			mKind[p] = SEAM;
+	}
+
+	Quadric zero;
+	memset( &zero, 0, sizeof( zero ) );
+	mQuadrics.assign( numVertices, zero );
+	mTerms.assign( numVertices * mTermStride, 0.0f );
+	ThreadPool::parallelFor( pool, numVertices, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( uint32_t w = (uint32_t) begin; w < end; ++w )
+			for( uint32_t corner = mHead[w]; corner != NO_INDEX; corner = mNext[corner] )
+				addTriangle( corner / 3, w, &mQuadrics[w], &mTerms[w * mTermStride] );
+	} );
+	mStamps.assign( numVertices, 0 );
+	mTargets.assign( numVertices, NO_INDEX );
+	mCosts.assign( numVertices, 0.0f );
+
+	// a grid of cells over the bounding box, by triangle centroid; positions with triangles in more than
+	// one cell are shared
+	size_t numLive = countTriangles();
+	size_t cellsPerAxis = (size_t) max( 1.0, min( (double) MAX_CELLS_PER_AXIS, floor( pow( (double) numLive / TRIANGLES_PER_CELL, 1.0 / 3.0 ) ) ) );
+	size_t numCells = cellsPerAxis * cellsPerAxis * cellsPerAxis;
+	vec3 cellSize = extent * scale / (float) cellsPerAxis;
+	mCell.assign( numVertices, NO_INDEX );
+	mCellTriangles.assign( numCells, 0 );
+	for( size_t t = 0; t < numTriangles; ++t ) {
+		if( mRemoved[t] )
+			continue;
+		vec3 centroid = ( mPositions[mIndices[3 * t]] + mPositions[mIndices[3 * t + 1]] + mPositions[mIndices[3 * t + 2]] ) / 3.0f;
+		size_t cell = 0;
+		for( int d = 2; d >= 0; --d ) {
+			size_t i = cellSize[d] > 0.0f ? min( (size_t) max( 0.0f, centroid[d] / cellSize[d] ), cellsPerAxis - 1 ) : 0;
+			cell = cell * cellsPerAxis + i;
+		}
+		++mCellTriangles[cell];
+		for( size_t k = 0; k < 3; ++k ) {
+			uint32_t &positionCell = mCell[mWeld[mIndices[3 * t + k]]];
+			if( positionCell == NO_INDEX )
+				positionCell = (uint32_t) cell;
+			else if( positionCell != cell )
+				positionCell = SHARED_CELL;
+		}
+	}
+
+	mCellPositionOffsets.assign( numCells + 1, 0 );
+	for( size_t p = 0; p < numVertices; ++p )
+		if( mCell[p] < numCells )
+			++mCellPositionOffsets[mCell[p] + 1];
+	for( size_t c = 0; c < numCells; ++c )
+		mCellPositionOffsets[c + 1] += mCellPositionOffsets[c];
+	mCellPositions.resize( mCellPositionOffsets.back() );
+	vector<uint32_t> cursors( mCellPositionOffsets.begin(), mCellPositionOffsets.end() - 1 );
+	for( uint32_t p = 0; p < numVertices; ++p )
+		if( mCell[p] < numCells )
+			mCellPositions[cursors[mCell[p]]++] = p;
+}
+
+size_t Decimator::countTriangles() const
+{
+	return count( mRemoved.begin(), mRemoved.end(), 0 );
+}
+
+template<typename FnT>
+void Decimator::forEachTriangle( uint32_t w, FnT fn )
+{
+	uint32_t previous = NO_INDEX;
+	for( uint32_t corner = mHead[w]; corner != NO_INDEX; ) {
+		uint32_t next = mNext[corner];
+		if( mRemoved[corner / 3] ) {
+			if( previous == NO_INDEX )
+				mHead[w] = next;
+			else
+				mNext[previous] = next;
+			if( mTail[w] == corner )
+				mTail[w] = previous;
+		}
+		else {
+			fn( corner / 3 );
+			previous = corner;
+		}
+		corner = next;
+	}
+}
+
+void Decimator::collectNeighbors( uint32_t position, vector<uint32_t> *neighbors )
+{
+	neighbors->clear();
+	for( uint32_t i = mWedgeOffsets[position]; i < mWedgeOffsets[position + 1]; ++i ) {
+		forEachTriangle( mWedges[i], [&]( uint32_t t ) {
+			for( size_t k = 0; k < 3; ++k ) {
+				uint32_t p = mWeld[mIndices[3 * t + k]];
+				if( p != position )
+					neighbors->push_back( p );
+			}
+		} );
+	}
+	sort( neighbors->begin(), neighbors->end() );
+	neighbors->erase( unique( neighbors->begin(), neighbors->end() ), neighbors->end() );
+}
+
+void Decimator::addTriangle( uint32_t t, uint32_t w, Quadric *quadric, float *terms ) const
+{
+	const uint32_t *corners = &mIndices[3 * t];
+	const vec3 &p0 = mPositions[corners[0]], &p1 = mPositions[corners[1]], &p2 = mPositions[corners[2]];
+	vec3 e1 = p1 - p0, e2 = p2 - p0;
+	vec3 normal = cross( e1, e2 );
+	float length = glm::length( normal );
+	if( length == 0.0f )
+		return;
+	float area = 0.5f * length;
+	normal /= length;
+	quadric->addPlane( normal, -dot( normal, p0 ), area );
+
+	// a plane through every open edge at w, upright on the triangle, keeps borders and seams in place
+	for( size_t k = 0; k < 3; ++k ) {
+		uint32_t a = corners[k], b = corners[( k + 1 ) % 3];
+		if( ! mOpenCorner[3 * t + k] || ( a != w && b != w ) )
+			continue;
+		vec3 edge = mPositions[b] - mPositions[a];
+		vec3 side = cross( edge, normal );
+		float sideLength = glm::length( side );
+		if( sideLength > 0.0f ) {
+			side /= sideLength;
+			quadric->addPlane( side, -dot( side, mPositions[a] ), BORDER_WEIGHT * dot( edge, edge ) );
+		}
+	}
+
+	// every attribute varies linearly over the triangle: s(p) = g.p + d with g in the plane of the triangle
+	terms[0] += area;
+	if( ! mNumAttributes )
+		return;
+	float d00 = dot( e1, e1 ), d01 = dot( e1, e2 ), d11 = dot( e2, e2 ), determinant = length * length;
+	for( size_t j = 0; j < mNumAttributes; ++j ) {
+		float s0 = mAttributes[corners[0] * mNumAttributes + j];
+		float ds1 = mAttributes[corners[1] * mNumAttributes + j] - s0, ds2 = mAttributes[corners[2] * mNumAttributes + j] - s0;
+		vec3 gradient = ( ( ds1 * d11 - ds2 * d01 ) * e1 + ( ds2 * d00 - ds1 * d01 ) * e2 ) / determinant;
+		float offset = s0 - dot( gradient, p0 );
+		quadric->addPlane( gradient, offset, area );
+
+		float *term = terms + 1 + 4 * j;
+		term[0] += area * gradient.x;
+		term[1] += area * gradient.y;
+		term[2] += area * gradient.z;
+		term[3] += area * offset;
+	}
+}
+
+float Decimator::getError( uint32_t from, uint32_t to ) const
+{
+	// the quadric holds sum( area (g.p + d)^2 ); with the attribute at s this becomes
+	// sum( area (g.p + d - s)^2 ) = quadric(p) + s (area s - 2 (g.p + d))
+	const vec3 &p = mPositions[to];
+	float error = mQuadrics[from].evaluate( p );
+	const float *terms = &mTerms[from * mTermStride];
+	const float *attributes = mNumAttributes ? &mAttributes[to * mNumAttributes] : nullptr;
+	for( size_t j = 0; j < mNumAttributes; ++j ) {
+		const float *term = terms + 1 + 4 * j;
+		float s = attributes[j];
+		error += s * ( terms[0] * s - 2.0f * ( term[0] * p.x + term[1] * p.y + term[2] * p.z + term[3] ) );
+	}
+	vec3 edge = p - mPositions[from];
+	return max( error, 0.0f ) + SHAPE_WEIGHT * terms[0] * dot( edge, edge );
+}
+
+bool Decimator::prepare( uint32_t position, uint32_t target, uint32_t cell, Collapse *collapse )
+{
+	Kind kind = (Kind) mKind[position];
+	if( kind == LOCKED || position == target )
+		return false;
+	if( cell != ALL_CELLS && ( mCell[position] != cell || mCell[target] != cell ) )
+		return false;
+
+	// the triangles on the edge: two inside the surface, one on a border, one each side of a seam; their
+	// corner at the target is where each wedge goes
+	size_t perWedge = kind == MANIFOLD ? 2 : 1;
+	collapse->position = position;
+	collapse->target = target;
+	collapse->from[1] = collapse->to[1] = NO_INDEX;
+	collapse->cost = 0.0f;
+	for( uint32_t i = mWedgeOffsets[position]; i < mWedgeOffsets[position + 1]; ++i ) {
+		uint32_t from = mWedges[i], to = NO_INDEX;
+		size_t shared = 0;
+		bool consistent = true;
+		forEachTriangle( from, [&]( uint32_t t ) {
+			const uint32_t *corners = &mIndices[3 * t];
+			for( size_t k = 0; k < 3; ++k ) {
+				if( mWeld[corners[k]] == target ) {
+					consistent = consistent && ( to == NO_INDEX || to == corners[k] );
+					to = corners[k];
+					++shared;
+				}
+			}
+		} );
+		if( ! consistent || shared != perWedge )
+			return false;
+
+		size_t side = i - mWedgeOffsets[position];
+		collapse->from[side] = from;
+		collapse->to[side] = to;
+		collapse->cost += getError( from, to );
+	}
+	return true;
+}
+
+bool Decimator::isValid( const Collapse &collapse, const vector<uint32_t> &neighbors, Workspace *work )
+{
+	// link condition: the two positions may only have the corners opposite their edge in common, or
+	// the surface would pinch. Those are two, or one on a border, and must be distinct.
+	size_t expected = mKind[collapse.position] == BORDER ? 1 : 2;
+	collectNeighbors( collapse.target, &work->targetNeighbors );
+	const vector<uint32_t> &targetNeighbors = work->targetNeighbors;
+	size_t common = 0;
+	for( size_t i = 0, j = 0; i < neighbors.size() && j < targetNeighbors.size() && common <= expected; ) {
+		if( neighbors[i] < targetNeighbors[j] )
+			++i;
+		else if( targetNeighbors[j] < neighbors[i] )
+			++j;
+		else {
+			++common;
+			++i;
+			++j;
+		}
+	}
+	if( common != expected )
+		return false;
+
+	// the triangles that stay must not turn over
+	const vec3 &moved = mPositions[collapse.target];
+	bool folds = false;
+	for( size_t i = 0; i < 2 && collapse.from[i] != NO_INDEX && ! folds; ++i ) {
+		uint32_t from = collapse.from[i];
+		forEachTriangle( from, [&]( uint32_t t ) {
+			const uint32_t *corners = &mIndices[3 * t];
+			if( folds || mWeld[corners[0]] == collapse.target || mWeld[corners[1]] == collapse.target || mWeld[corners[2]] == collapse.target )
+				return;
+			vec3 before[3], after[3];
+			for( size_t k = 0; k < 3; ++k ) {
+				before[k] = mPositions[corners[k]];
+				after[k] = corners[k] == from ? moved : before[k];
+			}
+			vec3 normalBefore = cross( before[1] - before[0], before[2] - before[0] );
+			vec3 normalAfter = cross( after[1] - after[0], after[2] - after[0] );
+			folds = dot( normalBefore, normalAfter ) <= MIN_NORMAL_COSINE * glm::length( normalBefore ) * glm::length( normalAfter );
+		} );
+	}
+	return ! folds;
+}
+
+bool Decimator::findBest( uint32_t position, uint32_t cell, Workspace *work, Collapse *best )
+{
+	if( mKind[position] == LOCKED || ( cell != ALL_CELLS && mCell[position] != cell ) )
+		return false;
+
+	// costs are cheap to compute, validity is not: check the cheapest collapses first
+	collectNeighbors( position, &work->neighbors );
+	work->collapses.clear();
+	for( size_t i = 0; i < work->neighbors.size(); ++i ) {
+		Collapse collapse;
+		if( prepare( position, work->neighbors[i], cell, &collapse ) )
+			work->collapses.push_back( collapse );
+	}
+	sort( work->collapses.begin(), work->collapses.end() );
+	for( size_t i = 0; i < work->collapses.size(); ++i ) {
+		if( isValid( work->collapses[i], work->neighbors, work ) ) {
+			*best = work->collapses[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t Decimator::apply( const Collapse &collapse )
+{
+	size_t removed = 0;
+	for( size_t i = 0; i < 2 && collapse.from[i] != NO_INDEX; ++i ) {
+		uint32_t from = collapse.from[i], to = collapse.to[i];
+		forEachTriangle( from, [&]( uint32_t t ) {
+			uint32_t *corners = &mIndices[3 * t];
+			if( mWeld[corners[0]] == collapse.target || mWeld[corners[1]] == collapse.target || mWeld[corners[2]] == collapse.target ) {
+				mRemoved[t] = 1;
+				++removed;
+			}
+			else {
+				for( size_t k = 0; k < 3; ++k )
+					if( corners[k] == from )
+						corners[k] = to;
+			}
+		} );
+
+		// the corners of from now belong to to
+		if( mHead[from] != NO_INDEX ) {
+			if( mHead[to] == NO_INDEX )
+				mHead[to] = mHead[from];
+			else
+				mNext[mTail[to]] = mHead[from];
+			mTail[to] = mTail[from];
+			mHead[from] = mTail[from] = NO_INDEX;
+		}
+
+		mQuadrics[to].add( mQuadrics[from] );
+		for( size_t j = 0; j < mTermStride; ++j )
+			mTerms[to * mTermStride + j] += mTerms[from * mTermStride + j];
+	}
+
+	mKind[collapse.position] = LOCKED;
+	return removed;
+}
+
+bool Decimator::simplify( uint32_t cell, size_t *numTriangles, size_t target, const function<bool()> &isCancelled )
+{
+	Workspace work;
+	priority_queue<Candidate> queue;
+	auto push = [&]( uint32_t position, uint32_t target, float cost ) {
+		mTargets[position] = target;
+		mCosts[position] = cost;
+		Candidate candidate = { cost, position, target, ++mStamps[position] };
+		queue.push( candidate );
+	};
+	auto update = [&]( uint32_t position ) {
+		if( cell != ALL_CELLS && mCell[position] != cell )
+			return;
+		++mStamps[position];
+		mTargets[position] = NO_INDEX;
+		Collapse best;
+		if( findBest( position, cell, &work, &best ) )
+			push( position, best.target, best.cost );
+	};
+
+	if( cell == ALL_CELLS ) {
+		for( uint32_t p = 0; p < mKind.size(); ++p )
+			if( mKind[p] != LOCKED )
+				update( p );
+	}
+	else {
+		for( uint32_t i = mCellPositionOffsets[cell]; i < mCellPositionOffsets[cell + 1]; ++i )
+			update( mCellPositions[i] );
+	}
+
+	size_t numCollapses = 0;
+	while( *numTriangles > target && ! queue.empty() ) {
+		Candidate candidate = queue.top();
+		queue.pop();
+		if( candidate.stamp != mStamps[candidate.position] )
+			continue;
+
+		// the cost only changes with the quadric, which bumps the stamp, but the neighborhood may have
+		// changed since the candidate was found valid
+		Collapse collapse;
+		if( ! prepare( candidate.position, candidate.target, cell, &collapse ) ) {
+			update( candidate.position );
+			continue;
+		}
+		collectNeighbors( candidate.position, &work.neighbors );
+		if( ! isValid( collapse, work.neighbors, &work ) ) {
+			update( candidate.position );
+			continue;
+		}
+
+		*numTriangles -= min( *numTriangles, apply( collapse ) );
+		++mStamps[collapse.position];
+
+		// the target has a new quadric, so all of its costs change. Half-edge collapses move no vertex,
+		// so for its neighbors only a collapse onto the target is new, unless they were headed for the
+		// position that just went away.
+		collectNeighbors( collapse.target, &work.updated );
+		update( collapse.target );
+		for( size_t i = 0; i < work.updated.size(); ++i ) {
+			uint32_t neighbor = work.updated[i];
+			if( cell != ALL_CELLS && mCell[neighbor] != cell )
+				continue;
+			if( mTargets[neighbor] == NO_INDEX || mTargets[neighbor] == collapse.position )
+				update( neighbor );
+			else {
+				Collapse offer;
+				if( prepare( neighbor, collapse.target, cell, &offer ) && offer.cost < mCosts[neighbor] )
+					push( neighbor, collapse.target, offer.cost );
+			}
+		}
+
+		if( isCancelled && ++numCollapses % CANCEL_INTERVAL == 0 && isCancelled() )
+			return false;
+	}
+	return true;
+}
+
+TriMeshRef Decimator::createMesh( const TriMesh &mesh ) const
+{
+	vector<uint32_t> remap( mesh.getNumVertices(), NO_INDEX ), order, indices;
+	indices.reserve( mIndices.size() );
+	for( size_t t = 0; t < mRemoved.size(); ++t ) {
+		if( mRemoved[t] )
+			continue;
+		for( size_t k = 0; k < 3; ++k ) {
+			uint32_t w = mIndices[3 * t + k];
+			if( remap[w] == NO_INDEX ) {
+				remap[w] = (uint32_t) order.size();
+				order.push_back( w );
+			}
+			indices.push_back( remap[w] );
+		}
+	}
+
+	size_t positionDims = mesh.getAttribDims( geom::Attrib::POSITION );
+	size_t texCoordDims = mesh.getAttribDims( geom::Attrib::TEX_COORD_0 ), colorDims = mesh.getAttribDims( geom::Attrib::COLOR );
+	bool hasNormals = mesh.hasNormals() && mesh.getNormals().size() == mesh.getNumVertices();
+	TriMesh::Format format = TriMesh::Format().positions( (uint8_t) positionDims );
+	if( hasNormals )
+		format.normals();
+	if( texCoordDims )
+		format.texCoords0( (uint8_t) texCoordDims );
+	if( colorDims )
+		format.colors( (uint8_t) colorDims );
+	TriMeshRef result = TriMesh::create( format );
+
+	auto gather = [&]( const float *src, size_t dims, vector<float> *dst ) {
+		dst->resize( order.size() * dims );
+		for( size_t v = 0; v < order.size(); ++v )
+			copy( src + order[v] * dims, src + ( order[v] + 1 ) * dims, dst->begin() + v * dims );
+	};
+	gather( mesh.getBufferPositions().data(), positionDims, &result->getBufferPositions() );
+	if( hasNormals ) {
+		result->getNormals().resize( order.size() );
+		for( size_t v = 0; v < order.size(); ++v )
+			result->getNormals()[v] = mesh.getNormals()[order[v]];
+	}
+	if( texCoordDims )
+		gather( mesh.getBufferTexCoords0().data(), texCoordDims, &result->getBufferTexCoords0() );
+	if( colorDims )
+		gather( mesh.getBufferColors().data(), colorDims, &result->getBufferColors() );
+	result->getIndices().swap( indices );
+	return result;
+}
+
+} // anonymous namespace
+
+TriMeshRef MeshDecimation::decimate( const TriMesh &mesh, size_t targetTriangles, ThreadPool *pool, const function<bool()> &isCancelled )
+{
+	if( mesh.getNumTriangles() <= targetTriangles )
+		return TriMeshRef( new TriMesh( mesh ) );
+
+	Decimator decimator( mesh, pool );
+	if( isCancelled && isCancelled() )
+		return TriMeshRef();
+
+	// every cell gets its share of the target; the shared positions the cells leave over are collapsed below
+	size_t numTriangles = decimator.countTriangles();
+	if( decimator.getNumCells() > 1 && numTriangles > targetTriangles ) {
+		double ratio = (double) targetTriangles / numTriangles;
+		atomic<bool> cancelled( false );
+		ThreadPool::parallelFor( pool, decimator.getNumCells(), 1, [&]( size_t begin, size_t end ) {
+			for( size_t c = begin; c < end && ! cancelled; ++c ) {
+				size_t cellTriangles = decimator.getCellTriangles( c );
+				if( ! decimator.simplify( (uint32_t) c, &cellTriangles, (size_t)( cellTriangles * ratio ), isCancelled ) )
+					cancelled = true;
+			}
+		} );
+		if( cancelled )
+			return TriMeshRef();
+		numTriangles = decimator.countTriangles();
+	}
+
+	if( ! decimator.simplify( ALL_CELLS, &numTriangles, targetTriangles, isCancelled ) )
+		return TriMeshRef();
+	return decimator.createMesh( mesh );
+}
@@ -0,0 +1,1182 @@
+#include "MeshImport.h"
+#include "HashTable.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const uint32_t	NO_INDEX = 0xffffffff;
+//! Bytes of text per task; a chunk ends at the first line break after this many.
+const size_t	CHUNK_SIZE = 4 << 20;
+// vertices, corners or binary faces per task
+const size_t	GRAIN_SIZE = 16384;
+
+//! What the parsers produce, with attributes per vertex; those the file does not have stay empty.
+struct Geometry {
+	vector<float>		positions, texCoords, colors;	// 3, 2 and 3 per vertex
+	vector<vec3>		normals;
+	vector<uint32_t>	indices;
+};
+
+//! Throws the error of the first chunk that failed, if any, so that the error does not depend on timing.
+void throwFirstError( const string &path, const vector<const char*> &errors )
+{
+	for( size_t i = 0; i < errors.size(); ++i )
+		if( errors[i] )
+			throw MeshImportExc( path, errors[i] );
+}
+
+// ---- numbers
+
+//! Whether the eight bytes at \a p are all digits, tested at once on a 64-bit word: adding 0x46 carries
+//! into the top bit of every byte above '9', subtracting 0x30 borrows into it for every byte below '0'.
+inline bool isEightDigits( const char *p )
+{
+	uint64_t word;
+	memcpy( &word, p, 8 );
+	return ! ( ( ( word + 0x4646464646464646ull ) | ( word - 0x3030303030303030ull ) ) & 0x8080808080808080ull );
+}
+
+//! The value of the eight digits at \a p: neighboring digits are combined into pairs, pairs into fours and
+//! fours into the result, with one multiplication per step. Assumes a little endian machine.
+inline uint32_t parseEightDigits( const char *p )
+{
+	uint64_t word;
+	memcpy( &word, p, 8 );
+	word -= 0x3030303030303030ull;
+	word = word * 10 + ( word >> 8 );
+	word = ( ( word & 0x000000FF000000FFull ) * ( 100 + ( 1000000ull << 32 ) )
+		+ ( ( word >> 16 ) & 0x000000FF000000FFull ) * ( 1 + ( 10000ull << 32 ) ) ) >> 32;
+	return (uint32_t) word;
+}
+
+inline bool isDigit( char c )
+{
+	return (unsigned char)( c - '0' ) < 10;
+}
+
+//! The powers of ten a double holds exactly.
+const double POWERS_OF_TEN[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16,
+	1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+//! Parses a decimal number with optional sign, fraction and exponent at \a p and moves past it. The
+//! first 18 or so significant digits are collected into an integer, which is then scaled by an exact
+//! power of ten, so the usual short decimals come out as the nearest float. Returns false if there is
+//! no number at \a p.
+bool parseFloat( const char *&p, const char *end, float *value )
+{
+	const char *s = p;
+	bool negative = s != end && *s == '-';
+	if( s != end && ( *s == '-' || *s == '+' ) )
+		++s;
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	bool hasDigits = false;
+	while( end - s >= 8 && mantissa < 100000000000ull && isEightDigits( s ) ) {
+		mantissa = mantissa * 100000000 + parseEightDigits( s );
+		s += 8;
+		hasDigits = true;
+	}
+	for( ; s != end && isDigit( *s ); ++s ) {
+		if( mantissa < 1000000000000000000ull )
+			mantissa = mantissa * 10 + ( *s - '0' );
+		else
+			++exponent;
+		hasDigits = true;
+	}
+	if( s != end && *s == '.' ) {
+		++s;
+		while( end - s >= 8 && mantissa < 100000000000ull && isEightDigits( s ) ) {
+			mantissa = mantissa * 100000000 + parseEightDigits( s );
+			exponent -= 8;
+			s += 8;
+			hasDigits = true;
+		}
+		for( ; s != end && isDigit( *s ); ++s ) {
+			if( mantissa < 1000000000000000000ull ) {
+				mantissa = mantissa * 10 + ( *s - '0' );
+				--exponent;
+			}
+			hasDigits = true;
+		}
+	}
+	if( ! hasDigits )
+		return false;
+
+	if( s != end && ( *s == 'e' || *s == 'E' ) ) {
+		++s;
+		bool negativeExponent = s != end && *s == '-';
+		if( s != end && ( *s == '-' || *s == '+' ) )
+			++s;
+		if( s == end || ! isDigit( *s ) )
+			return false;
+		int written = 0;
+		for( ; s != end && isDigit( *s ); ++s )
+			written = min( written * 10 + ( *s - '0' ), 100000 );
+		exponent += negativeExponent ? -written : written;
+	}
+
+	double result = (double) mantissa;
+	if( mantissa && exponent ) {
+		if( exponent < 0 )
+			result = exponent >= -22 ? result / POWERS_OF_TEN[-exponent] : result * pow( 10.0, exponent );
+		else
+			result = exponent <= 22 ? result * POWERS_OF_TEN[exponent] : result * pow( 10.0, exponent );
+	}
+	*value = (float)( negative ? -result : result );
+	p = s;
+	return true;
+}
+
+//! Parses an integer with optional sign at \a p and moves past it.
+bool parseInt( const char *&p, const char *end, long long *value )
+{
+	const char *s = p;
+	bool negative = s != end && *s == '-';
+	if( s != end && ( *s == '-' || *s == '+' ) )
+		++s;
+	if( s == end || ! isDigit( *s ) )
+		return false;
+	long long result = 0;
+	for( ; s != end && isDigit( *s ); ++s )
+		result = min( result * 10 + ( *s - '0' ), 0xffffffffffffll );
+	*value = negative ? -result : result;
+	p = s;
+	return true;
+}
+
+// ---- text
+
+inline bool isBlank( char c )
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline void skipBlanks( const char *&p, const char *end )
+{
+	while( p != end && isBlank( *p ) )
+		++p;
+}
+
+inline bool isLineEnd( const char *p, const char *end )
+{
+	return p == end || *p == '\n';
+}
+
+//! The start of the line after the one \a p is on.
+inline const char* nextLine( const char *p, const char *end )
+{
+	const void *newline = memchr( p, '\n', end - p );
+	return newline ? (const char*) newline + 1 : end;
+}
+
+//! Moves past the token at \a p, if any, and the blanks in front of it.
+inline bool skipToken( const char *&p, const char *end )
+{
+	skipBlanks( p, end );
+	if( isLineEnd( p, end ) )
+		return false;
+	while( p != end && ! isBlank( *p ) && *p != '\n' )
+		++p;
+	return true;
+}
+
+//! The number of blank-separated tokens from \a p to the end of its line.
+size_t countTokens( const char *p, const char *end )
+{
+	size_t count = 0;
+	while( skipToken( p, end ) )
+		++count;
+	return count;
+}
+
+//! If the line at \a p starts with \a word on its own, moves past it and returns true.
+inline bool readWord( const char *&p, const char *end, const char *word )
+{
+	size_t length = strlen( word );
+	if( (size_t)( end - p ) < length || memcmp( p, word, length ) != 0 )
+		return false;
+	const char *after = p + length;
+	if( ! isLineEnd( after, end ) && ! isBlank( *after ) )
+		return false;
+	p = after;
+	return true;
+}
+
+//! Parses \a count blank-separated numbers into \a values.
+bool parseFloats( const char *&p, const char *end, float *values, size_t count )
+{
+	for( size_t i = 0; i < count; ++i ) {
+		skipBlanks( p, end );
+		if( ! parseFloat( p, end, &values[i] ) )
+			return false;
+	}
+	return true;
+}
+
+//! Bounds of pieces of [\a begin, \a end) of about CHUNK_SIZE bytes that end at line breaks.
+vector<const char*> splitLines( const char *begin, const char *end )
+{
+	vector<const char*> bounds( 1, begin );
+	while( bounds.back() != end )
+		bounds.push_back( (size_t)( end - bounds.back() ) > CHUNK_SIZE ? nextLine( bounds.back() + CHUNK_SIZE, end ) : end );
+	return bounds;
+}
+
+//! The end of the \a count lines starting at \a p, or null if the text ends before.
+const char* skipLines( const char *p, const char *end, size_t count )
+{
+	for( size_t i = 0; i < count; ++i ) {
+		if( p == end )
+			return nullptr;
+		p = nextLine( p, end );
+	}
+	return p;
+}
+
+size_t countLines( const char *p, const char *end )
+{
+	size_t count = 0;
+	for( ; p != end; p = nextLine( p, end ) )
+		++count;
+	return count;
+}
+
+// ---- vertices
+
+//! For every one of \a count items, the lowest index of an item equal to it, found with a concurrent
+//! open-addressing hash map in which every slot keeps the lowest index seen for its item.
+template<typename HashT, typename EqualT>
+vector<uint32_t> findFirstEqual( size_t count, const HashT &hash, const EqualT &equal, ThreadPool *pool )
+{
+	size_t shift, capacity = tableCapacity( 2 * count, &shift );
+	unique_ptr<atomic<uint32_t>[]> slots( new atomic<uint32_t>[capacity] );
+	ThreadPool::parallelFor( pool, capacity, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( size_t i = begin; i < end; ++i )
+			slots[i].store( NO_INDEX, memory_order_relaxed );
+	} );
+
+	ThreadPool::parallelFor( pool, count, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( uint32_t i = (uint32_t) begin; i < end; ++i ) {
+			size_t slot = hashSlot( hash( i ), shift );
+			while( true ) {
+				uint32_t current = slots[slot].load( memory_order_relaxed );
+				if( current == NO_INDEX ) {
+					if( slots[slot].compare_exchange_strong( current, i, memory_order_relaxed ) )
+						break;
+					// look at the item that got there first
+					continue;
+				}
+				if( equal( current, i ) ) {
+					while( i < current && ! slots[slot].compare_exchange_weak( current, i, memory_order_relaxed ) ) {
+					}
+					break;
+				}
+				slot = ( slot + 1 ) & ( capacity - 1 );
+			}
+		}
+	} );
+
+	vector<uint32_t> first( count );
+	ThreadPool::parallelFor( pool, count, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( uint32_t i = (uint32_t) begin; i < end; ++i ) {
+			size_t slot = hashSlot( hash( i ), shift );
+			while( ! equal( slots[slot].load( memory_order_relaxed ), i ) )
+				slot = ( slot + 1 ) & ( capacity - 1 );
+			first[i] = slots[slot].load( memory_order_relaxed );
+		}
+	} );
+	return first;
+}
+
+//! Turns \a first from findFirstEqual() into the vertex of every item, numbering the items that come
+//! first in order, and returns those items.
+vector<uint32_t> numberVertices( vector<uint32_t> *first )
+{
+	vector<uint32_t> items;
+	for( uint32_t i = 0; i < first->size(); ++i ) {
+		uint32_t &vertex = ( *first )[i];
+		if( vertex == i ) {
+			vertex = (uint32_t) items.size();
+			items.push_back( i );
+		}
+		else
+			vertex = ( *first )[vertex];
+	}
+	return items;
+}
+
+//! Area-weighted average of the normals of the triangles at every vertex. The sums are scattered over
+//! the vertices, so only normalizing them runs in parallel.
+void computeNormals( Geometry *geometry, ThreadPool *pool )
+{
+	size_t numVertices = geometry->positions.size() / 3;
+	const float *positions = geometry->positions.data();
+	vector<vec3> &normals = geometry->normals;
+	normals.assign( numVertices, vec3( 0 ) );
+	for( size_t corner = 0; corner + 2 < geometry->indices.size(); corner += 3 ) {
+		const uint32_t *triangle = &geometry->indices[corner];
+		const float *a = positions + 3 * triangle[0], *b = positions + 3 * triangle[1], *c = positions + 3 * triangle[2];
+		vec3 normal = cross( vec3( b[0] - a[0], b[1] - a[1], b[2] - a[2] ), vec3( c[0] - a[0], c[1] - a[1], c[2] - a[2] ) );
+		for( size_t k = 0; k < 3; ++k )
+			normals[triangle[k]] += normal;
+	}
+	ThreadPool::parallelFor( pool, numVertices, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( size_t v = begin; v < end; ++v ) {
+			float length = glm::length( normals[v] );
+			normals[v] = length > 0.0f ? normals[v] / length : vec3( 0, 1, 0 );
+		}
+	} );
+}
+
+//! Moves \a geometry into a TriMesh.
+TriMeshRef createMesh( Geometry *geometry, ThreadPool *pool )
+{
+	if( geometry->normals.empty() )
+		computeNormals( geometry, pool );
+
+	TriMesh::Format format = TriMesh::Format().positions( 3 ).normals();
+	if( ! geometry->texCoords.empty() )
+		format.texCoords0( 2 );
+	if( ! geometry->colors.empty() )
+		format.colors( 3 );
+	TriMeshRef mesh = TriMesh::create( format );
+	mesh->getBufferPositions().swap( geometry->positions );
+	mesh->getNormals().swap( geometry->normals );
+	mesh->getBufferTexCoords0().swap( geometry->texCoords );
+	mesh->getBufferColors().swap( geometry->colors );
+	mesh->getIndices().swap( geometry->indices );
+	return mesh;
+}
+
+// ---- OBJ
+
+//! Counts of what a piece of an OBJ file holds, or of what comes before it.
+struct ObjCounts {
+	size_t	positions, texCoords, normals, triangles;
+};
+
+//! An OBJ file parsed into arrays. Every corner holds a position, texture coordinate and normal index.
+struct ObjData {
+	vector<float>		positions, colors, texCoords, normals;	// 3, 3, 2 and 3 per element
+	vector<uint32_t>	corners;
+	ObjCounts			totals;
+};
+
+//! Counts the positions, texture coordinates, normals and triangles (of the faces split into fans) in
+//! [\a p, \a end). \a colored tells whether the first position comes with a color.
+ObjCounts countObj( const char *p, const char *end, bool *colored )
+{
+	ObjCounts counts = { 0, 0, 0, 0 };
+	*colored = false;
+	for( ; p != end; p = nextLine( p, end ) ) {
+		skipBlanks( p, end );
+		if( readWord( p, end, "v" ) ) {
+			// x y z r g b
+			if( ! counts.positions )
+				*colored = countTokens( p, end ) == 6;
+			++counts.positions;
+		}
+		else if( readWord( p, end, "vt" ) )
+			++counts.texCoords;
+		else if( readWord( p, end, "vn" ) )
+			++counts.normals;
+		else if( readWord( p, end, "f" ) ) {
+			size_t numCorners = countTokens( p, end );
+			if( numCorners >= 3 )
+				counts.triangles += numCorners - 2;
+		}
+	}
+	return counts;
+}
+
+//! Resolves the OBJ index \a index, counted from 1 or, if negative, back from the last of the \a before
+//! elements defined so far, against \a total elements in the file.
+inline bool resolveIndex( long long index, size_t before, size_t total, uint32_t *result )
+{
+	if( index > 0 && (unsigned long long) index <= total )
+		*result = (uint32_t)( index - 1 );
+	else if( index < 0 && (unsigned long long)( -index ) <= before )
+		*result = (uint32_t)( before + index );
+	else
+		return false;
+	return true;
+}
+
+//! Parses a face corner v, v/vt, v//vn or v/vt/vn into \a corner, with NO_INDEX for what is missing.
+bool parseCorner( const char *&p, const char *end, const ObjCounts &before, const ObjCounts &totals, uint32_t corner[3] )
+{
+	long long index;
+	corner[1] = corner[2] = NO_INDEX;
+	if( ! parseInt( p, end, &index ) || ! resolveIndex( index, before.positions, totals.positions, &corner[0] ) )
+		return false;
+	if( p != end && *p == '/' ) {
+		++p;
+		if( p != end && *p != '/' && ( ! parseInt( p, end, &index ) || ! resolveIndex( index, before.texCoords, totals.texCoords, &corner[1] ) ) )
+			return false;
+		if( p != end && *p == '/' ) {
+			++p;
+			if( ! parseInt( p, end, &index ) || ! resolveIndex( index, before.normals, totals.normals, &corner[2] ) )
+				return false;
+		}
+	}
+	return isLineEnd( p, end ) || isBlank( *p );
+}
+
+//! Parses [\a p, \a end) into \a data, from the position \a at says on. Returns an error message, or null.
+const char* parseObj( const char *p, const char *end, ObjCounts at, bool colored, ObjData *data )
+{
+	for( ; p != end; p = nextLine( p, end ) ) {
+		skipBlanks( p, end );
+		if( readWord( p, end, "v" ) ) {
+			if( ! parseFloats( p, end, &data->positions[3 * at.positions], 3 ) )
+				return "invalid vertex position";
+			if( colored ) {
+				float *color = &data->colors[3 * at.positions];
+				if( ! parseFloats( p, end, color, 3 ) )
+					color[0] = color[1] = color[2] = 1.0f;
+			}
+			++at.positions;
+		}
+		else if( readWord( p, end, "vt" ) ) {
+			float *texCoord = &data->texCoords[2 * at.texCoords];
+			if( ! parseFloats( p, end, texCoord, 1 ) )
+				return "invalid texture coordinate";
+			if( ! parseFloats( p, end, texCoord + 1, 1 ) )
+				texCoord[1] = 0.0f;
+			++at.texCoords;
+		}
+		else if( readWord( p, end, "vn" ) ) {
+			if( ! parseFloats( p, end, &data->normals[3 * at.normals], 3 ) )
+				return "invalid normal";
+			++at.normals;
+		}
+		else if( readWord( p, end, "f" ) ) {
+			uint32_t first[3], previous[3], corner[3];
+			for( size_t numCorners = 0; ; ++numCorners ) {
+				skipBlanks( p, end );
+				if( isLineEnd( p, end ) )
+					break;
+				if( ! parseCorner( p, end, at, data->totals, corner ) )
+					return "invalid face";
+				if( numCorners == 0 )
+					copy( corner, corner + 3, first );
+				else if( numCorners >= 2 ) {
+					uint32_t *triangle = &data->corners[9 * at.triangles++];
+					copy( first, first + 3, triangle );
+					copy( previous, previous + 3, triangle + 3 );
+					copy( corner, corner + 3, triangle + 6 );
+				}
+				copy( corner, corner + 3, previous );
+			}
+		}
+	}
+	return nullptr;
+}
+
+bool loadObj( const string &path, const char *begin, const char *end, ThreadPool *pool, const function<bool()> &isCancelled, Geometry *geometry )
+{
+	// count first, so that every chunk knows where its data goes and what its relative indices refer to
+	vector<const char*> chunks = splitLines( begin, end );
+	size_t numChunks = chunks.size() - 1;
+	vector<ObjCounts> starts( numChunks );
+	vector<uint8_t> colored( numChunks );
+	ThreadPool::parallelFor( pool, numChunks, 1, [&]( size_t first, size_t last ) {
+		for( size_t c = first; c < last; ++c ) {
+			bool isColored;
+			starts[c] = countObj( chunks[c], chunks[c + 1], &isColored );
+			colored[c] = isColored;
+		}
+	} );
+
+	ObjData data;
+	ObjCounts totals = { 0, 0, 0, 0 };
+	bool hasColors = true;
+	for( size_t c = 0; c < numChunks; ++c ) {
+		ObjCounts counts = starts[c];
+		starts[c] = totals;
+		totals.positions += counts.positions;
+		totals.texCoords += counts.texCoords;
+		totals.normals += counts.normals;
+		totals.triangles += counts.triangles;
+		hasColors = hasColors && ( colored[c] || ! counts.positions );
+	}
+	if( ! totals.triangles )
+		throw MeshImportExc( path, "no faces" );
+	if( totals.positions >= NO_INDEX || 3 * totals.triangles >= NO_INDEX )
+		throw MeshImportExc( path, "too large" );
+	if( isCancelled && isCancelled() )
+		return false;
+
+	data.totals = totals;
+	data.positions.resize( 3 * totals.positions );
+	if( hasColors )
+		data.colors.resize( 3 * totals.positions );
+	data.texCoords.resize( 2 * totals.texCoords );
+	data.normals.resize( 3 * totals.normals );
+	data.corners.resize( 9 * totals.triangles );
+	vector<const char*> errors( numChunks, nullptr );
+	ThreadPool::parallelFor( pool, numChunks, 1, [&]( size_t first, size_t last ) {
+		for( size_t c = first; c < last; ++c )
+			errors[c] = parseObj( chunks[c], chunks[c + 1], starts[c], hasColors, &data );
+	} );
+	throwFirstError( path, errors );
+	if( isCancelled && isCancelled() )
+		return false;
+
+	size_t numCorners = 3 * totals.triangles;
+	const uint32_t *corners = data.corners.data();
+	if( ! totals.texCoords && ! totals.normals ) {
+		// the positions are the vertices
+		geometry->positions.swap( data.positions );
+		geometry->colors.swap( data.colors );
+		geometry->indices.resize( numCorners );
+		ThreadPool::parallelFor( pool, numCorners, GRAIN_SIZE, [&]( size_t first, size_t last ) {
+			for( size_t i = first; i < last; ++i )
+				geometry->indices[i] = corners[3 * i];
+		} );
+		return true;
+	}
+
+	// a vertex per distinct combination of position, texture coordinate and normal. Most corners at a
+	// position have the same ones, so every position becomes the vertex of its lowest corner, and only the
+	// corners that differ from it, at seams, go through a hash map to be numbered after the positions.
+	size_t numPositions = totals.positions;
+	unique_ptr<atomic<uint32_t>[]> lowest( new atomic<uint32_t>[numPositions] );
+	ThreadPool::parallelFor( pool, numPositions, GRAIN_SIZE, [&]( size_t first, size_t last ) {
+		for( size_t p = first; p < last; ++p )
+			lowest[p].store( NO_INDEX, memory_order_relaxed );
+	} );
+	ThreadPool::parallelFor( pool, numCorners, GRAIN_SIZE, [&]( size_t first, size_t last ) {
+		for( uint32_t i = (uint32_t) first; i < last; ++i ) {
+			atomic<uint32_t> &slot = lowest[corners[3 * i]];
+			uint32_t current = slot.load( memory_order_relaxed );
+			while( i < current && ! slot.compare_exchange_weak( current, i, memory_order_relaxed ) ) {
+			}
+		}
+	} );
+
+	vector<uint32_t> vertices( numCorners );
+	vector<uint8_t> differs( numCorners );
+	ThreadPool::parallelFor( pool, numCorners, GRAIN_SIZE, [&]( size_t first, size_t last ) {
+		for( size_t i = first; i < last; ++i ) {
+			uint32_t position = corners[3 * i];
+			vertices[i] = position;
+			differs[i] = memcmp( corners + 3 * i, corners + 3 * lowest[position].load( memory_order_relaxed ), 3 * sizeof( uint32_t ) ) != 0;
+		}
+	} );
+	vector<uint32_t> seamCorners;
+	for( uint32_t i = 0; i < numCorners; ++i )
+		if( differs[i] )
+			seamCorners.push_back( i );
+	vector<uint32_t> seamVertices = findFirstEqual( seamCorners.size(),
+		[&]( uint32_t i ) { const uint32_t *c = corners + 3 * seamCorners[i]; return ( ( c[0] * 0x100000001B3ull ^ c[1] ) * 0x100000001B3ull ) ^ c[2]; },
+		[&]( uint32_t a, uint32_t b ) { return memcmp( corners + 3 * seamCorners[a], corners + 3 * seamCorners[b], 3 * sizeof( uint32_t ) ) == 0; }, pool );
+	vector<uint32_t> firstSeamCorners = numberVertices( &seamVertices );
+	for( size_t i = 0; i < seamCorners.size(); ++i )
+		vertices[seamCorners[i]] = (uint32_t)( numPositions + seamVertices[i] );
+
+	size_t numVertices = numPositions + firstSeamCorners.size();
+	if( numVertices >= NO_INDEX )
+		throw MeshImportExc( path, "too large" );
+	geometry->positions.resize( 3 * numVertices );
+	if( hasColors )
+		geometry->colors.resize( 3 * numVertices );
+	if( totals.texCoords )
+		geometry->texCoords.resize( 2 * numVertices );
+	if( totals.normals )
+		geometry->normals.resize( numVertices );
+	ThreadPool::parallelFor( pool, numVertices, GRAIN_SIZE, [&]( size_t first, size_t last ) {
+		for( size_t v = first; v < last; ++v ) {
+			// positions no face uses keep no texture coordinate and normal
+			uint32_t corner = v < numPositions ? lowest[v].load( memory_order_relaxed ) : seamCorners[firstSeamCorners[v - numPositions]];
+			uint32_t position = v < numPositions ? (uint32_t) v : corners[3 * corner];
+			uint32_t texCoord = corner != NO_INDEX ? corners[3 * corner + 1] : NO_INDEX, normal = corner != NO_INDEX ? corners[3 * corner + 2] : NO_INDEX;
+			copy( &data.positions[3 * position], &data.positions[3 * position] + 3, &geometry->positions[3 * v] );
+			if( hasColors )
+				copy( &data.colors[3 * position], &data.colors[3 * position] + 3, &geometry->colors[3 * v] );
+			if( totals.texCoords ) {
+				geometry->texCoords[2 * v] = texCoord != NO_INDEX ? data.texCoords[2 * texCoord] : 0.0f;
+				geometry->texCoords[2 * v + 1] = texCoord != NO_INDEX ? data.texCoords[2 * texCoord + 1] : 0.0f;
+			}
+			if( totals.normals )
+				geometry->normals[v] = normal != NO_INDEX ? vec3( data.normals[3 * normal], data.normals[3 * normal + 1], data.normals[3 * normal + 2] ) : vec3( 0 );
+		}
+	} );
+	geometry->indices.swap( vertices );
+	return true;
+}
+
+// ---- PLY
+
+typedef enum { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64 } PlyType;
+const size_t PLY_TYPE_SIZES[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+typedef enum { PLY_ASCII, PLY_BINARY_LITTLE_ENDIAN, PLY_BINARY_BIG_ENDIAN } PlyFormat;
+
+struct PlyProperty {
+	string	name;
+	PlyType	type;		// of the value, or of the items of a list
+	PlyType	countType;	// of the count in front of a list
+	bool	list;
+};
+
+struct PlyElement {
+	string				name;
+	size_t				count;
+	vector<PlyProperty>	properties;
+};
+
+bool parsePlyType( const string &name, PlyType *type )
+{
+	static const char *names[][2] = { { "char", "int8" }, { "uchar", "uint8" }, { "short", "int16" }, { "ushort", "uint16" },
+		{ "int", "int32" }, { "uint", "uint32" }, { "float", "float32" }, { "double", "float64" } };
+	for( int t = 0; t < 8; ++t ) {
+		if( name == names[t][0] || name == names[t][1] ) {
+			*type = (PlyType) t;
+			return true;
+		}
+	}
+	return false;
+}
+
+//! The binary value of \a type at \a p.
+inline double readPlyValue( const char *p, PlyType type, bool bigEndian )
+{
+	size_t size = PLY_TYPE_SIZES[type];
+	char bytes[8];
+	for( size_t i = 0; i < size; ++i )
+		bytes[i] = p[bigEndian ? size - 1 - i : i];
+	switch( type ) {
+		case PLY_INT8: { int8_t value; memcpy( &value, bytes, 1 ); return value; }
+		case PLY_UINT8: { uint8_t value; memcpy( &value, bytes, 1 ); return value; }
+		case PLY_INT16: { int16_t value; memcpy( &value, bytes, 2 ); return value; }
+		case PLY_UINT16: { uint16_t value; memcpy( &value, bytes, 2 ); return value; }
+		case PLY_INT32: { int32_t value; memcpy( &value, bytes, 4 ); return value; }
+		case PLY_UINT32: { uint32_t value; memcpy( &value, bytes, 4 ); return value; }
+		case PLY_FLOAT32: { float value; memcpy( &value, bytes, 4 ); return value; }
+		default: { double value; memcpy( &value, bytes, 8 ); return value; }
+	}
+}
+
+//! Moves past a binary \a property at \a p, setting \a listSize to its number of items if it is a list.
+//! Returns null if it does not fit before \a end.
+inline const char* skipPlyProperty( const PlyProperty &property, const char *p, const char *end, bool bigEndian, size_t *listSize )
+{
+	if( ! property.list )
+		return (size_t)( end - p ) >= PLY_TYPE_SIZES[property.type] ? p + PLY_TYPE_SIZES[property.type] : nullptr;
+	if( (size_t)( end - p ) < PLY_TYPE_SIZES[property.countType] )
+		return nullptr;
+	double count = readPlyValue( p, property.countType, bigEndian );
+	p += PLY_TYPE_SIZES[property.countType];
+	if( count < 0.0 || count * PLY_TYPE_SIZES[property.type] > (double)( end - p ) )
+		return nullptr;
+	*listSize = (size_t) count;
+	return p + *listSize * PLY_TYPE_SIZES[property.type];
+}
+
+//! Where a vertex property goes: 0 to 2 position, 3 to 5 normal, 6 and 7 texture coordinate, 8 to 10
+//! color, or -1 for nowhere.
+int getPlyVertexSlot( const string &name )
+{
+	static const char *names[][4] = { { "x" }, { "y" }, { "z" }, { "nx" }, { "ny" }, { "nz" },
+		{ "u", "s", "texture_u", "texture_s" }, { "v", "t", "texture_v", "texture_t" }, { "red", "diffuse_red" }, { "green", "diffuse_green" }, { "blue", "diffuse_blue" } };
+	for( int slot = 0; slot < 11; ++slot )
+		for( int i = 0; i < 4 && names[slot][i]; ++i )
+			if( name == names[slot][i] )
+				return slot;
+	return -1;
+}
+
+//! Parses the header into \a elements and returns the first byte after it.
+const char* parsePlyHeader( const string &path, const char *p, const char *end, PlyFormat *format, vector<PlyElement> *elements )
+{
+	bool hasFormat = false;
+	for( size_t lineNumber = 0; ; ++lineNumber ) {
+		if( p == end )
+			throw MeshImportExc( path, "header without end" );
+		const char *lineEnd = nextLine( p, end );
+		vector<string> words;
+		while( true ) {
+			skipBlanks( p, lineEnd );
+			if( isLineEnd( p, lineEnd ) )
+				break;
+			const char *word = p;
+			while( p != lineEnd && ! isBlank( *p ) && *p != '\n' )
+				++p;
+			words.push_back( string( word, p ) );
+		}
+		p = lineEnd;
+
+		if( lineNumber == 0 ) {
+			if( words.size() != 1 || words[0] != "ply" )
+				throw MeshImportExc( path, "not a PLY file" );
+		}
+		else if( words.empty() || words[0] == "comment" || words[0] == "obj_info" )
+			continue;
+		else if( words[0] == "format" && words.size() >= 2 ) {
+			if( words[1] == "ascii" )
+				*format = PLY_ASCII;
+			else if( words[1] == "binary_little_endian" )
+				*format = PLY_BINARY_LITTLE_ENDIAN;
+			else if( words[1] == "binary_big_endian" )
+				*format = PLY_BINARY_BIG_ENDIAN;
+			else
+				throw MeshImportExc( path, "unknown PLY format" );
+			hasFormat = true;
+		}
+		else if( words[0] == "element" && words.size() == 3 ) {
+			PlyElement element;
+			element.name = words[1];
+			const char *count = words[2].c_str();
+			long long value;
+			if( ! parseInt( count, count + words[2].size(), &value ) || value < 0 )
+				throw MeshImportExc( path, "invalid element count" );
+			element.count = (size_t) value;
+			elements->push_back( element );
+		}
+		else if( words[0] == "property" && ! elements->empty() ) {
+			PlyProperty property;
+			property.list = words.size() == 5 && words[1] == "list";
+			property.name = words.back();
+			property.countType = PLY_UINT8;
+			bool valid = property.list ? parsePlyType( words[2], &property.countType ) && parsePlyType( words[3], &property.type )
+				: words.size() == 3 && parsePlyType( words[1], &property.type );
+			if( ! valid )
+				throw MeshImportExc( path, "invalid property" );
+			elements->back().properties.push_back( property );
+		}
+		else if( words[0] == "end_header" )
+			break;
+		else
+			throw MeshImportExc( path, "invalid header" );
+	}
+	if( ! hasFormat )
+		throw MeshImportExc( path, "no format" );
+	return p;
+}
+
+//! Parses the faces on the lines [\a p, \a end), counting their triangles into \a numTriangles and, unless
+//! \a triangles is null, writing them there. Returns an error message, or null.
+const char* parsePlyFaces( const char *p, const char *end, const PlyElement &element, size_t numVertices, size_t *numTriangles, uint32_t *triangles )
+{
+	for( ; p != end; p = nextLine( p, end ) ) {
+		for( size_t i = 0; i < element.properties.size(); ++i ) {
+			const PlyProperty &property = element.properties[i];
+			if( ! property.list ) {
+				if( ! skipToken( p, end ) )
+					return "incomplete face";
+				continue;
+			}
+			long long count;
+			skipBlanks( p, end );
+			if( ! parseInt( p, end, &count ) || count < 0 )
+				return "invalid face";
+			if( property.name != "vertex_indices" && property.name != "vertex_index" ) {
+				for( long long k = 0; k < count; ++k )
+					if( ! skipToken( p, end ) )
+						return "incomplete face";
+				continue;
+			}
+
+			uint32_t first = 0, previous = 0;
+			for( long long k = 0; k < count; ++k ) {
+				long long index;
+				skipBlanks( p, end );
+				if( ! parseInt( p, end, &index ) || index < 0 || (unsigned long long) index >= numVertices )
+					return "invalid vertex index";
+				if( k >= 2 && triangles ) {
+					uint32_t *triangle = triangles + 3 * *numTriangles;
+					triangle[0] = first;
+					triangle[1] = previous;
+					triangle[2] = (uint32_t) index;
+				}
+				if( k >= 2 )
+					++*numTriangles;
+				if( k == 0 )
+					first = (uint32_t) index;
+				previous = (uint32_t) index;
+			}
+		}
+	}
+	return nullptr;
+}
+
+bool loadPly( const string &path, const char *begin, const char *end, ThreadPool *pool, const function<bool()> &isCancelled, Geometry *geometry )
+{
+	PlyFormat format = PLY_ASCII;
+	vector<PlyElement> elements;
+	const char *p = parsePlyHeader( path, begin, end, &format, &elements );
+	bool bigEndian = format == PLY_BINARY_BIG_ENDIAN;
+
+	size_t numVertices = 0;
+	bool hasFaces = false;
+	for( size_t e = 0; e < elements.size(); ++e ) {
+		const PlyElement &element = elements[e];
+		if( isCancelled && isCancelled() )
+			return false;
+
+		// record offsets of the binary properties; faces are found by name, vertex properties by slot
+		size_t stride = 0;
+		bool fixedSize = true;
+		vector<size_t> offsets;
+		vector<int> slots;
+		for( size_t i = 0; i < element.properties.size(); ++i ) {
+			offsets.push_back( stride );
+			slots.push_back( getPlyVertexSlot( element.properties[i].name ) );
+			stride += PLY_TYPE_SIZES[element.properties[i].type];
+			fixedSize = fixedSize && ! element.properties[i].list;
+		}
+
+		if( element.name == "vertex" ) {
+			if( ! fixedSize )
+				throw MeshImportExc( path, "lists in vertices are not supported" );
+			bool found[11] = { false };
+			for( size_t i = 0; i < slots.size(); ++i )
+				if( slots[i] >= 0 )
+					found[slots[i]] = true;
+			if( ! found[0] || ! found[1] || ! found[2] )
+				throw MeshImportExc( path, "vertices without positions" );
+			numVertices = element.count;
+			geometry->positions.assign( 3 * numVertices, 0.0f );
+			if( found[3] && found[4] && found[5] )
+				geometry->normals.assign( numVertices, vec3( 0 ) );
+			if( found[6] && found[7] )
+				geometry->texCoords.assign( 2 * numVertices, 0.0f );
+			if( found[8] && found[9] && found[10] )
+				geometry->colors.assign( 3 * numVertices, 1.0f );
+
+			// colors in integer types span their whole range
+			vector<float> scales( slots.size(), 1.0f );
+			for( size_t i = 0; i < slots.size(); ++i ) {
+				if( slots[i] >= 8 && element.properties[i].type == PLY_UINT8 )
+					scales[i] = 1.0f / 255.0f;
+				else if( slots[i] >= 8 && element.properties[i].type == PLY_UINT16 )
+					scales[i] = 1.0f / 65535.0f;
+			}
+			auto store = [&]( size_t v, int slot, float value ) {
+				if( slot < 3 )
+					geometry->positions[3 * v + slot] = value;
+				else if( slot < 6 && ! geometry->normals.empty() )
+					geometry->normals[v][slot - 3] = value;
+				else if( slot >= 6 && slot < 8 && ! geometry->texCoords.empty() )
+					geometry->texCoords[2 * v + slot - 6] = value;
+				else if( slot >= 8 && ! geometry->colors.empty() )
+					geometry->colors[3 * v + slot - 8] = value;
+			};
+
+			if( format != PLY_ASCII ) {
+				if( (double) numVertices * stride > (double)( end - p ) )
+					throw MeshImportExc( path, "truncated vertices" );
+				ThreadPool::parallelFor( pool, numVertices, GRAIN_SIZE, [&]( size_t first, size_t last ) {
+					for( size_t v = first; v < last; ++v ) {
+						const char *record = p + v * stride;
+						for( size_t i = 0; i < slots.size(); ++i )
+							if( slots[i] >= 0 )
+								store( v, slots[i], (float) readPlyValue( record + offsets[i], element.properties[i].type, bigEndian ) * scales[i] );
+					}
+				} );
+				p += numVertices * stride;
+			}
+			else {
+				const char *sectionEnd = skipLines( p, end, numVertices );
+				if( ! sectionEnd )
+					throw MeshImportExc( path, "truncated vertices" );
+				vector<const char*> chunks = splitLines( p, sectionEnd );
+				size_t numChunks = chunks.size() - 1;
+				vector<size_t> starts( numChunks + 1, 0 );
+				ThreadPool::parallelFor( pool, numChunks, 1, [&]( size_t first, size_t last ) {
+					for( size_t c = first; c < last; ++c )
+						starts[c + 1] = countLines( chunks[c], chunks[c + 1] );
+				} );
+				for( size_t c = 0; c < numChunks; ++c )
+					starts[c + 1] += starts[c];
+
+				vector<const char*> errors( numChunks, nullptr );
+				ThreadPool::parallelFor( pool, numChunks, 1, [&]( size_t first, size_t last ) {
+					for( size_t c = first; c < last; ++c ) {
+						size_t v = starts[c];
+						for( const char *line = chunks[c]; line != chunks[c + 1] && ! errors[c]; line = nextLine( line, chunks[c + 1] ), ++v ) {
+							const char *s = line;
+							for( size_t i = 0; i < slots.size() && ! errors[c]; ++i ) {
+								float value;
+								skipBlanks( s, chunks[c + 1] );
+								if( ! parseFloat( s, chunks[c + 1], &value ) )
+									errors[c] = "invalid vertex";
+								else if( slots[i] >= 0 )
+									store( v, slots[i], value * scales[i] );
+							}
+						}
+					}
+				} );
+				throwFirstError( path, errors );
+				p = sectionEnd;
+			}
+		}
+		else if( element.name == "face" && ! hasFaces ) {
+			size_t indexProperty = element.properties.size();
+			for( size_t i = 0; i < element.properties.size(); ++i )
+				if( element.properties[i].list && ( element.properties[i].name == "vertex_indices" || element.properties[i].name == "vertex_index" ) )
+					indexProperty = i;
+			if( indexProperty == element.properties.size() )
+				throw MeshImportExc( path, "faces without vertex indices" );
+			hasFaces = true;
+
+			if( format != PLY_ASCII ) {
+				// faces differ in size, so a quick pass over their counts finds where every block of them starts
+				size_t numBlocks = ( element.count + GRAIN_SIZE - 1 ) / GRAIN_SIZE;
+				vector<const char*> blockStarts( numBlocks + 1 );
+				vector<size_t> blockTriangles( numBlocks + 1, 0 );
+				size_t numTriangles = 0;
+				for( size_t f = 0; f < element.count; ++f ) {
+					if( f % GRAIN_SIZE == 0 ) {
+						blockStarts[f / GRAIN_SIZE] = p;
+						blockTriangles[f / GRAIN_SIZE] = numTriangles;
+					}
+					for( size_t i = 0; i < element.properties.size(); ++i ) {
+						size_t listSize = 0;
+						if( ! ( p = skipPlyProperty( element.properties[i], p, end, bigEndian, &listSize ) ) )
+							throw MeshImportExc( path, "truncated faces" );
+						if( i == indexProperty && listSize >= 3 )
+							numTriangles += listSize - 2;
+					}
+				}
+				blockStarts[numBlocks] = p;
+				blockTriangles[numBlocks] = numTriangles;
+				if( 3 * numTriangles >= NO_INDEX )
+					throw MeshImportExc( path, "too large" );
+
+				geometry->indices.resize( 3 * numTriangles );
+				vector<const char*> errors( numBlocks, nullptr );
+				const PlyProperty &indices = element.properties[indexProperty];
+				ThreadPool::parallelFor( pool, numBlocks, 1, [&]( size_t first, size_t last ) {
+					for( size_t b = first; b < last; ++b ) {
+						const char *s = blockStarts[b];
+						uint32_t *triangle = geometry->indices.data() + 3 * blockTriangles[b];
+						size_t numFaces = min( GRAIN_SIZE, element.count - b * GRAIN_SIZE );
+						for( size_t f = 0; f < numFaces; ++f ) {
+							for( size_t i = 0; i < element.properties.size(); ++i ) {
+								size_t listSize = 0;
+								const char *next = skipPlyProperty( element.properties[i], s, blockStarts[b + 1], bigEndian, &listSize );
+								if( i == indexProperty ) {
+									const char *items = s + PLY_TYPE_SIZES[indices.countType];
+									uint32_t first = 0, previous = 0;
+									for( size_t k = 0; k < listSize; ++k ) {
+										double index = readPlyValue( items + k * PLY_TYPE_SIZES[indices.type], indices.type, bigEndian );
+										if( index < 0.0 || index >= (double) numVertices ) {
+											errors[b] = "invalid vertex index";
+											break;
+										}
+										if( k >= 2 ) {
+											triangle[0] = first;
+											triangle[1] = previous;
+											triangle[2] = (uint32_t) index;
+											triangle += 3;
+										}
+										if( k == 0 )
+											first = (uint32_t) index;
+										previous = (uint32_t) index;
+									}
+								}
+								s = next;
+							}
+						}
+					}
+				} );
+				throwFirstError( path, errors );
+			}
+			else {
+				const char *sectionEnd = skipLines( p, end, element.count );
+				if( ! sectionEnd )
+					throw MeshImportExc( path, "truncated faces" );
+				vector<const char*> chunks = splitLines( p, sectionEnd );
+				size_t numChunks = chunks.size() - 1;
+				vector<size_t> starts( numChunks + 1, 0 );
+				vector<const char*> errors( numChunks, nullptr );
+				ThreadPool::parallelFor( pool, numChunks, 1, [&]( size_t first, size_t last ) {
+					for( size_t c = first; c < last; ++c )
+						errors[c] = parsePlyFaces( chunks[c], chunks[c + 1], element, numVertices, &starts[c + 1], nullptr );
+				} );
+				throwFirstError( path, errors );
+				for( size_t c = 0; c < numChunks; ++c )
+					starts[c + 1] += starts[c];
+				if( 3 * starts[numChunks] >= NO_INDEX )
+					throw MeshImportExc( path, "too large" );
+
+				geometry->indices.resize( 3 * starts[numChunks] );
+				ThreadPool::parallelFor( pool, numChunks, 1, [&]( size_t first, size_t last ) {
+					for( size_t c = first; c < last; ++c ) {
+						size_t numTriangles = 0;
+						parsePlyFaces( chunks[c], chunks[c + 1], element, numVertices, &numTriangles, geometry->indices.data() + 3 * starts[c] );
+					}
+				} );
+				p = sectionEnd;
+			}
+		}
+		else if( format == PLY_ASCII ) {
+			if( ! ( p = skipLines( p, end, element.count ) ) )
+				throw MeshImportExc( path, "truncated " + element.name );
+		}
+		else if( fixedSize ) {
+			if( (double) element.count * stride > (double)( end - p ) )
+				throw MeshImportExc( path, "truncated " + element.name );
+			p += element.count * stride;
+		}
+		else {
+			for( size_t k = 0; k < element.count; ++k ) {
+				for( size_t i = 0; i < element.properties.size(); ++i ) {
+					size_t listSize;
+					if( ! ( p = skipPlyProperty( element.properties[i], p, end, bigEndian, &listSize ) ) )
+						throw MeshImportExc( path, "truncated " + element.name );
+				}
+			}
+		}
+	}
+
+	if( ! hasFaces || geometry->indices.empty() )
+		throw MeshImportExc( path, "no faces" );
+	return true;
+}
+
+// ---- STL
+
+//! Welds the triangle corners at exactly the same position, which STL files repeat for every triangle.
+void weldCorners( vector<float> *corners, ThreadPool *pool, Geometry *geometry )
+{
+	size_t numCorners = corners->size() / 3;
+	float *positions = corners->data();
+	// -0 and 0 are the same position
+	ThreadPool::parallelFor( pool, 3 * numCorners, GRAIN_SIZE, [&]( size_t first, size_t last ) {
+		for( size_t i = first; i < last; ++i )
+			positions[i] += 0.0f;
+	} );
+
+	vector<uint32_t> vertices = findFirstEqual( numCorners,
+		[&]( uint32_t i ) {
+			uint32_t bits[3];
+			memcpy( bits, positions + 3 * i, sizeof( bits ) );
+			return ( ( bits[0] * 0x100000001B3ull ^ bits[1] ) * 0x100000001B3ull ) ^ bits[2];
+		},
+		[&]( uint32_t a, uint32_t b ) { return memcmp( positions + 3 * a, positions + 3 * b, 3 * sizeof( float ) ) == 0; }, pool );
+	vector<uint32_t> firstCorners = numberVertices( &vertices );
+	geometry->positions.resize( 3 * firstCorners.size() );
+	ThreadPool::parallelFor( pool, firstCorners.size(), GRAIN_SIZE, [&]( size_t first, size_t last ) {
+		for( size_t v = first; v < last; ++v )
+			copy( positions + 3 * firstCorners[v], positions + 3 * firstCorners[v] + 3, &geometry->positions[3 * v] );
+	} );
+	geometry->indices.swap( vertices );
+}
+
+bool loadStl( const string &path, const char *begin, const char *end, ThreadPool *pool, const function<bool()> &isCancelled, Geometry *geometry )
+{
+	// binary files are recognized by their size, as many of them start with "solid" as well
+	size_t size = end - begin;
+	uint32_t numTriangles = 0;
+	if( size >= 84 )
+		memcpy( &numTriangles, begin + 80, sizeof( numTriangles ) );
+	vector<float> corners;
+	if( size >= 84 && 84 + 50 * (uint64_t) numTriangles == size ) {
+		if( 3 * (uint64_t) numTriangles >= NO_INDEX )
+			throw MeshImportExc( path, "too large" );
+		// a normal, three corners and two bytes of attributes per triangle
+		corners.resize( 9 * (size_t) numTriangles );
+		ThreadPool::parallelFor( pool, numTriangles, GRAIN_SIZE, [&]( size_t first, size_t last ) {
+			for( size_t t = first; t < last; ++t )
+				memcpy( &corners[9 * t], begin + 84 + 50 * t + 12, 9 * sizeof( float ) );
+		} );
+	}
+	else {
+		const char *p = begin;
+		skipBlanks( p, end );
+		if( ! readWord( p, end, "solid" ) )
+			throw MeshImportExc( path, "not an STL file" );
+
+		vector<const char*> chunks = splitLines( begin, end );
+		size_t numChunks = chunks.size() - 1;
+		vector<size_t> starts( numChunks + 1, 0 );
+		ThreadPool::parallelFor( pool, numChunks, 1, [&]( size_t first, size_t last ) {
+			for( size_t c = first; c < last; ++c ) {
+				for( const char *line = chunks[c]; line != chunks[c + 1]; line = nextLine( line, chunks[c + 1] ) ) {
+					skipBlanks( line, chunks[c + 1] );
+					if( readWord( line, chunks[c + 1], "vertex" ) )
+						++starts[c + 1];
+				}
+			}
+		} );
+		for( size_t c = 0; c < numChunks; ++c )
+			starts[c + 1] += starts[c];
+		if( ! starts[numChunks] || starts[numChunks] % 3 )
+			throw MeshImportExc( path, "incomplete facets" );
+		if( starts[numChunks] >= NO_INDEX )
+			throw MeshImportExc( path, "too large" );
+		if( isCancelled && isCancelled() )
+			return false;
+
+		corners.resize( 3 * starts[numChunks] );
+		vector<const char*> errors( numChunks, nullptr );
+		ThreadPool::parallelFor( pool, numChunks, 1, [&]( size_t first, size_t last ) {
+			for( size_t c = first; c < last; ++c ) {
+				size_t corner = starts[c];
+				for( const char *line = chunks[c]; line != chunks[c + 1] && ! errors[c]; line = nextLine( line, chunks[c + 1] ) ) {
+					skipBlanks( line, chunks[c + 1] );
+					if( readWord( line, chunks[c + 1], "vertex" ) && ! parseFloats( line, chunks[c + 1], &corners[3 * corner++], 3 ) )
+						errors[c] = "invalid vertex";
+				}
+			}
+		} );
+		throwFirstError( path, errors );
+	}
+	if( corners.empty() )
+		throw MeshImportExc( path, "no faces" );
+	if( isCancelled && isCancelled() )
+		return false;
+
+	weldCorners( &corners, pool, geometry );
+	return true;
+}
+
+} // anonymous namespace
+
+TriMeshRef MeshImport::load( const string &path, ThreadPool *pool, const function<bool()> &isCancelled )
+{
+	string extension = path.substr( path.find_last_of( '.' ) + 1 );
+	for( size_t i = 0; i < extension.size(); ++i )
+		extension[i] = (char) tolower( (unsigned char) extension[i] );
+
+	if( extension != "obj" && extension != "ply" && extension != "stl" )
+		throw MeshImportExc( path, "unknown file type" );
+
+	MappedFileRef file;
+	try {
+		file = MappedFile::open( path );
+	}
+	catch( const MappedFileExc &exc ) {
+		throw MeshImportExc( path, exc.what() );
+	}
+	// every chunk is parsed at about the same time, so have all of the file read in right away
+	file->advise( 0, file->getSize(), MappedFile::ADVISE_WILL_NEED );
+	const char *begin = (const char*) file->getData(), *end = begin + file->getSize();
+
+	Geometry geometry;
+	bool loaded;
+	if( extension == "obj" )
+		loaded = loadObj( path, begin, end, pool, isCancelled, &geometry );
+	else if( extension == "ply" )
+		loaded = loadPly( path, begin, end, pool, isCancelled, &geometry );
+	else
+		loaded = loadStl( path, begin, end, pool, isCancelled, &geometry );
+	if( ! loaded || ( isCancelled && isCancelled() ) )
+		return TriMeshRef();
+	return createMesh( &geometry, pool );
+}
@@ -0,0 +1,234 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const uint32_t	NO_VERTEX = 0xffffffff;
+
+//! The triangles around each vertex: those of \a v are triangles[offsets[v]] up to triangles[offsets[v + 1]].
+void buildVertexTriangles( const uint32_t *indices, size_t numIndices, size_t numVertices, vector<uint32_t> *offsets, vector<uint32_t> *triangles )
+{
+	offsets->assign( numVertices + 1, 0 );
+	for( size_t i = 0; i < numIndices; ++i )
+		++( *offsets )[indices[i] + 1];
+	for( size_t v = 0; v < numVertices; ++v )
+		( *offsets )[v + 1] += ( *offsets )[v];
+
+	vector<uint32_t> cursors( offsets->begin(), offsets->end() - 1 );
+	triangles->resize( numIndices );
+	for( size_t i = 0; i < numIndices; ++i )
+		( *triangles )[cursors[indices[i]]++] = (uint32_t)( i / 3 );
+}
+
+template<typename T>
+void permute( vector<T> *values, size_t numVertices, const vector<uint32_t> &order )
+{
+	if( values->empty() || values->size() % numVertices != 0 )
+		return;
+
+	size_t dims = values->size() / numVertices;
+	vector<T> result( values->size() );
+	for( size_t v = 0; v < numVertices; ++v )
+		copy( values->begin() + order[v] * dims, values->begin() + ( order[v] + 1 ) * dims, result.begin() + v * dims );
+	values->swap( result );
+}
+
+struct Cluster {
+	size_t	begin, end;
+	float	sortKey;
+
+	bool operator<( const Cluster &other ) const { return sortKey > other.sortKey; }
+};
+
+} // anonymous namespace
+
+float MeshOptimizer::calcAcmr( const uint32_t *indices, size_t numIndices, size_t numVertices, size_t cacheSize )
+{
+	if( numIndices < 3 )
+		return 0.0f;
+
+	// a vertex is in the cache if fewer than cacheSize misses happened since it was loaded
+	vector<size_t> loaded( numVertices, 0 );
+	size_t misses = 0;
+	for( size_t i = 0; i < numIndices; ++i ) {
+		size_t &time = loaded[indices[i]];
+		if( time == 0 || misses + 1 - time > cacheSize )
+			time = ++misses;
+	}
+	return (float) misses / ( numIndices / 3 );
+}
+
+void MeshOptimizer::optimizeVertexCache( uint32_t *indices, size_t numIndices, size_t numVertices, size_t cacheSize, vector<size_t> *clusters )
+{
+	if( clusters )
+		clusters->assign( 1, 0 );
+	if( numIndices < 3 )
+		return;
+
+	vector<uint32_t> offsets, adjacency;
+	buildVertexTriangles( indices, numIndices, numVertices, &offsets, &adjacency );
+
+	// live triangles per vertex, and when it was last put in the cache
+	vector<uint32_t> live( numVertices ), cached( numVertices, 0 );
+	for( size_t v = 0; v < numVertices; ++v )
+		live[v] = offsets[v + 1] - offsets[v];
+	vector<uint8_t> emitted( numIndices / 3, 0 );
+	vector<uint32_t> output, deadEnds, candidates;
+	output.reserve( numIndices );
+
+	uint32_t time = (uint32_t) cacheSize + 1;
+	size_t cursor = 0, clusterStart = 0;
+	uint32_t fan = indices[0];
+	while( fan != NO_VERTEX ) {
+		// emit the remaining triangles around the fan vertex
+		candidates.clear();
+		for( uint32_t i = offsets[fan]; i < offsets[fan + 1]; ++i ) {
+			uint32_t t = adjacency[i];
+			if( emitted[t] )
+				continue;
+
+			for( size_t k = 0; k < 3; ++k ) {
+				uint32_t v = indices[3 * t + k];
+				output.push_back( v );
+				deadEnds.push_back( v );
+				candidates.push_back( v );
+				--live[v];
+				if( time - cached[v] > cacheSize )
+					cached[v] = time++;
+			}
+			emitted[t] = 1;
+		}
+
+		// continue at the vertex that has been in the cache longest and will still be after its own fan
+		uint32_t next = NO_VERTEX;
+		int priority = -1;
+		for( size_t i = 0; i < candidates.size(); ++i ) {
+			uint32_t v = candidates[i];
+			if( ! live[v] )
+				continue;
+			int p = time - cached[v] + 2 * live[v] <= cacheSize ? (int)( time - cached[v] ) : 0;
+			if( p > priority ) {
+				priority = p;
+				next = v;
+			}
+		}
+
+		if( next == NO_VERTEX ) {
+			// dead end: try the vertices used most recently, then the next one in input order
+			while( ! deadEnds.empty() && next == NO_VERTEX ) {
+				uint32_t v = deadEnds.back();
+				deadEnds.pop_back();
+				if( live[v] )
+					next = v;
+			}
+			while( cursor < numVertices && next == NO_VERTEX ) {
+				if( live[cursor] )
+					next = (uint32_t) cursor;
+				++cursor;
+			}
+
+			// the cache has mostly moved on by now, so this is a good place to start a cluster
+			if( clusters && next != NO_VERTEX && output.size() - clusterStart >= 3 * cacheSize ) {
+				clusterStart = output.size();
+				clusters->push_back( clusterStart );
+			}
+		}
+		fan = next;
+	}
+
+	copy( output.begin(), output.end(), indices );
+}
+
+void MeshOptimizer::optimizeOverdraw( uint32_t *indices, size_t numIndices, const vector<size_t> &clusters, const float *positions, size_t positionDims )
+{
+	if( clusters.size() < 2 || positionDims < 3 )
+		return;
+
+	auto position = [&]( uint32_t v ) { return vec3( positions[v * positionDims], positions[v * positionDims + 1], positions[v * positionDims + 2] ); };
+
+	// area-weighted centroid and normal of every cluster, and of the whole mesh
+	vector<Cluster> sorted( clusters.size() );
+	vector<vec3> centroids( clusters.size() ), normals( clusters.size() );
+	vec3 center( 0 );
+	float totalArea = 0.0f;
+	for( size_t c = 0; c < clusters.size(); ++c ) {
+		sorted[c].begin = clusters[c];
+		sorted[c].end = c + 1 < clusters.size() ? clusters[c + 1] : numIndices;
+
+		vec3 centroid( 0 ), normal( 0 );
+		float area = 0.0f;
+		for( size_t i = sorted[c].begin; i + 2 < sorted[c].end; i += 3 ) {
+			vec3 a = position( indices[i] ), b = position( indices[i + 1] ), d = position( indices[i + 2] );
+			vec3 n = cross( b - a, d - a );
+			float triangleArea = length( n );
+			centroid += triangleArea * ( a + b + d ) / 3.0f;
+			normal += n;
+			area += triangleArea;
+		}
+		centroids[c] = area > 0.0f ? centroid / area : position( indices[sorted[c].begin] );
+		normals[c] = length( normal ) > 0.0f ? normalize( normal ) : vec3( 0 );
+		center += centroid;
+		totalArea += area;
+	}
+	if( totalArea > 0.0f )
+		center /= totalArea;
+
+	for( size_t c = 0; c < clusters.size(); ++c )
+		sorted[c].sortKey = dot( centroids[c] - center, normals[c] );
+	stable_sort( sorted.begin(), sorted.end() );
+
+	vector<uint32_t> output;
+	output.reserve( numIndices );
+	for( size_t c = 0; c < sorted.size(); ++c )
+		output.insert( output.end(), indices + sorted[c].begin, indices + sorted[c].end );
+	copy( output.begin(), output.end(), indices );
+}
+
+void MeshOptimizer::optimizeVertexFetch( TriMesh *mesh )
+{
+	vector<uint32_t> &indices = mesh->getIndices();
+	size_t numVertices = mesh->getNumVertices();
+
+	// order[new] = old, remap[old] = new
+	vector<uint32_t> order, remap( numVertices, NO_VERTEX );
+	order.reserve( numVertices );
+	for( size_t i = 0; i < indices.size(); ++i ) {
+		uint32_t &index = indices[i];
+		if( remap[index] == NO_VERTEX ) {
+			remap[index] = (uint32_t) order.size();
+			order.push_back( index );
+		}
+		index = remap[index];
+	}
+	for( size_t v = 0; v < numVertices; ++v )
+		if( remap[v] == NO_VERTEX )
+			order.push_back( (uint32_t) v );
+
+	permute( &mesh->getBufferPositions(), numVertices, order );
+	permute( &mesh->getNormals(), numVertices, order );
+	permute( &mesh->getTangents(), numVertices, order );
+	permute( &mesh->getBitangents(), numVertices, order );
+	permute( &mesh->getBufferTexCoords0(), numVertices, order );
+	permute( &mesh->getBufferColors(), numVertices, order );
+}
+
+MeshOptimizer::Stats MeshOptimizer::optimize( TriMesh *mesh )
+{
+	vector<uint32_t> &indices = mesh->getIndices();
+	size_t numVertices = mesh->getNumVertices();
+
+	Stats stats;
+	stats.acmrBefore = calcAcmr( indices.data(), indices.size(), numVertices );
+
+	vector<size_t> clusters;
+	optimizeVertexCache( indices.data(), indices.size(), numVertices, CACHE_SIZE, &clusters );
+	optimizeOverdraw( indices.data(), indices.size(), clusters, mesh->getBufferPositions().data(), mesh->getAttribDims( geom::Attrib::POSITION ) );
+	optimizeVertexFetch( mesh );
+
+	stats.acmrAfter = calcAcmr( indices.data(), indices.size(), numVertices );
+	return stats;
+}
@@ -0,0 +1,558 @@
+#include "MeshSubdivision.h"
+#include "HashTable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const uint32_t	NO_INDEX = 0xffffffff;
+const uint64_t	NO_KEY = ~(uint64_t) 0;
+// triangles, edges or vertices per task
+const size_t	GRAIN_SIZE = 4096;
+
+//! The undirected edges of a triangle list in a concurrent open-addressing hash map. Edges are numbered
+//! in the order in which they first appear in the index list, which does not depend on how the threads
+//! inserting them were interleaved.
+class EdgeTable {
+public:
+	//! Adds the edges of the triangles in \a indices, which are below \a numVertices. With \a topology,
+	//! triangles with two equal corners are skipped, and the triangles on each edge are counted and the
+	//! opposite corners of the first two remembered.
+	EdgeTable( const uint32_t *indices, size_t numTriangles, size_t numVertices, bool topology, ThreadPool *pool );
+
+	size_t			getNumEdges() const { return mNumEdges; }
+	//! The edge from \a corner to the next corner of its triangle, or NO_INDEX for skipped triangles.
+	uint32_t		getCornerEdge( size_t corner ) const { return mCornerEdges[corner]; }
+	uint32_t		getLow( uint32_t edge ) const { return mVertices[2 * edge]; }
+	uint32_t		getHigh( uint32_t edge ) const { return mVertices[2 * edge + 1]; }
+	uint32_t		getNumFaces( uint32_t edge ) const { return mNumFaces[edge]; }
+	//! The corners opposite \a edge in its first two triangles, lowest first.
+	const uint32_t*	getOpposite( uint32_t edge ) const { return &mOpposite[2 * edge]; }
+	//! The edge between \a a and \a b, or NO_INDEX.
+	uint32_t		find( uint32_t a, uint32_t b ) const;
+
+private:
+	// everything about an edge sits together, so an insertion touches a single cache line
+	struct Slot {
+		std::atomic<uint64_t>	mKey;
+		std::atomic<uint32_t>	mFirstCorner;
+		std::atomic<uint32_t>	mNumFaces;
+		uint32_t				mOpposite[2];
+		uint32_t				mEdge;
+	};
+
+	static uint64_t	makeKey( uint32_t a, uint32_t b ) { return a < b ? (uint64_t) a << 32 | b : (uint64_t) b << 32 | a; }
+	//! Where probing for \a key starts. The edges of a vertex start next to each other and next to those
+	//! of the following vertex, so triangles that are close in the index list touch nearby slots.
+	size_t			getHome( uint64_t key ) const { return ( (size_t)( key >> 32 ) * mSpread + ( (uint32_t) key * 0x9E3779B1u ) % mSpread ) & ( mCapacity - 1 ); }
+	size_t			insert( uint64_t key );
+
+	size_t				mCapacity, mSpread;
+	unique_ptr<Slot[]>	mSlots;
+	size_t				mNumEdges;
+	vector<uint32_t>	mCornerEdges, mVertices, mNumFaces, mOpposite;
+};
+
+EdgeTable::EdgeTable( const uint32_t *indices, size_t numTriangles, size_t numVertices, bool topology, ThreadPool *pool )
+	: mNumEdges( 0 )
+{
+	// every corner starts at most one edge, so the table is never full
+	size_t numCorners = 3 * numTriangles, shift;
+	mCapacity = tableCapacity( numCorners, &shift );
+	mSpread = max<size_t>( mCapacity / max<size_t>( numVertices, 1 ), 1 );
+	mSlots.reset( new Slot[mCapacity] );
+	ThreadPool::parallelFor( pool, mCapacity, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( size_t i = begin; i < end; ++i ) {
+			mSlots[i].mKey.store( NO_KEY, memory_order_relaxed );
+			mSlots[i].mFirstCorner.store( NO_INDEX, memory_order_relaxed );
+			mSlots[i].mNumFaces.store( 0, memory_order_relaxed );
+		}
+	} );
+
+	// insert concurrently; until the edges are numbered, mCornerEdges holds slots
+	mCornerEdges.resize( numCorners );
+	ThreadPool::parallelFor( pool, numTriangles, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( size_t t = begin; t < end; ++t ) {
+			const uint32_t *corners = indices + 3 * t;
+			bool skip = topology && ( corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0] );
+			for( uint32_t k = 0; k < 3; ++k ) {
+				uint32_t corner = (uint32_t)( 3 * t + k );
+				if( skip ) {
+					mCornerEdges[corner] = NO_INDEX;
+					continue;
+				}
+
+				size_t index = insert( makeKey( corners[k], corners[( k + 1 ) % 3] ) );
+				mCornerEdges[corner] = (uint32_t) index;
+
+				Slot &slot = mSlots[index];
+				uint32_t first = slot.mFirstCorner.load( memory_order_relaxed );
+				while( corner < first && ! slot.mFirstCorner.compare_exchange_weak( first, corner, memory_order_relaxed ) ) {
+				}
+
+				if( topology ) {
+					uint32_t face = slot.mNumFaces.fetch_add( 1, memory_order_relaxed );
+					if( face < 2 )
+						slot.mOpposite[face] = corners[( k + 2 ) % 3];
+				}
+			}
+		}
+	} );
+
+	// number the edges at their first corners: count per block of corners, then hand out the numbers
+	size_t numBlocks = ( numCorners + GRAIN_SIZE - 1 ) / GRAIN_SIZE;
+	vector<uint32_t> blockEdges( numBlocks + 1, 0 );
+	ThreadPool::parallelFor( pool, numBlocks, 1, [&]( size_t begin, size_t end ) {
+		for( size_t block = begin; block < end; ++block ) {
+			uint32_t count = 0;
+			for( size_t c = block * GRAIN_SIZE; c < min( numCorners, ( block + 1 ) * GRAIN_SIZE ); ++c )
+				if( mCornerEdges[c] != NO_INDEX && mSlots[mCornerEdges[c]].mFirstCorner.load( memory_order_relaxed ) == c )
+					++count;
+			blockEdges[block + 1] = count;
+		}
+	} );
+	for( size_t block = 0; block < numBlocks; ++block )
+		blockEdges[block + 1] += blockEdges[block];
+	mNumEdges = blockEdges[numBlocks];
+
+	mVertices.resize( 2 * mNumEdges );
+	if( topology ) {
+		mNumFaces.resize( mNumEdges );
+		mOpposite.resize( 2 * mNumEdges );
+	}
+	ThreadPool::parallelFor( pool, numBlocks, 1, [&]( size_t begin, size_t end ) {
+		for( size_t block = begin; block < end; ++block ) {
+			uint32_t edge = blockEdges[block];
+			for( size_t c = block * GRAIN_SIZE; c < min( numCorners, ( block + 1 ) * GRAIN_SIZE ); ++c ) {
+				if( mCornerEdges[c] == NO_INDEX )
+					continue;
+				Slot &slot = mSlots[mCornerEdges[c]];
+				if( slot.mFirstCorner.load( memory_order_relaxed ) != c )
+					continue;
+
+				uint64_t key = slot.mKey.load( memory_order_relaxed );
+				slot.mEdge = edge;
+				mVertices[2 * edge] = (uint32_t)( key >> 32 );
+				mVertices[2 * edge + 1] = (uint32_t) key;
+				if( topology ) {
+					// in a fixed order, so that the weights are summed the same way on every run
+					uint32_t numFaces = slot.mNumFaces.load( memory_order_relaxed );
+					mNumFaces[edge] = numFaces;
+					mOpposite[2 * edge] = numFaces < 2 ? slot.mOpposite[0] : min( slot.mOpposite[0], slot.mOpposite[1] );
+					mOpposite[2 * edge + 1] = numFaces < 2 ? NO_INDEX : max( slot.mOpposite[0], slot.mOpposite[1] );
+				}
+				++edge;
+			}
+		}
+	} );
+
+	ThreadPool::parallelFor( pool, numCorners, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( size_t c = begin; c < end; ++c )
+			if( mCornerEdges[c] != NO_INDEX )
+				mCornerEdges[c] = mSlots[mCornerEdges[c]].mEdge;
+	} );
+}
+
+size_t EdgeTable::insert( uint64_t key )
+{
+	size_t index = getHome( key );
+	while( true ) {
+		uint64_t current = mSlots[index].mKey.load( memory_order_relaxed );
+		if( current == key )
+			return index;
+		if( current == NO_KEY ) {
+			if( mSlots[index].mKey.compare_exchange_strong( current, key, memory_order_relaxed ) || current == key )
+				return index;
+			// another edge took the slot first
+		}
+		index = ( index + 1 ) & ( mCapacity - 1 );
+	}
+}
+
+uint32_t EdgeTable::find( uint32_t a, uint32_t b ) const
+{
+	uint64_t key = makeKey( a, b );
+	for( size_t index = getHome( key ); ; index = ( index + 1 ) & ( mCapacity - 1 ) ) {
+		uint64_t current = mSlots[index].mKey.load( memory_order_relaxed );
+		if( current == key )
+			return mSlots[index].mEdge;
+		if( current == NO_KEY )
+			return NO_INDEX;
+	}
+}
+
+//! Bit patterns of a position, with -0 turned into +0 so that equal positions have equal bits.
+inline void positionBits( const float *positions, size_t dims, uint32_t index, uint32_t bits[4] )
+{
+	for( size_t d = 0; d < dims; ++d ) {
+		float value = positions[index * dims + d] + 0.0f;
+		memcpy( &bits[d], &value, sizeof( float ) );
+	}
+}
+
+inline bool samePosition( const float *positions, size_t dims, uint32_t a, uint32_t b )
+{
+	uint32_t bitsA[4], bitsB[4];
+	positionBits( positions, dims, a, bitsA );
+	positionBits( positions, dims, b, bitsB );
+	return memcmp( bitsA, bitsB, dims * sizeof( uint32_t ) ) == 0;
+}
+
+//! For every vertex, the lowest index of a vertex at exactly the same position.
+vector<uint32_t> weldVertices( const float *positions, size_t dims, size_t numVertices, ThreadPool *pool )
+{
+	size_t shift, capacity = tableCapacity( 2 * numVertices, &shift );
+	unique_ptr<atomic<uint32_t>[]> slots( new atomic<uint32_t>[capacity] );
+	ThreadPool::parallelFor( pool, capacity, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( size_t i = begin; i < end; ++i )
+			slots[i].store( NO_INDEX, memory_order_relaxed );
+	} );
+
+	auto firstSlot = [&]( uint32_t v ) -> size_t {
+		uint32_t bits[4];
+		positionBits( positions, dims, v, bits );
+		uint64_t hash = 0;
+		for( size_t d = 0; d < dims; ++d )
+			hash = ( hash ^ bits[d] ) * 0x100000001B3ull;
+		return hashSlot( hash, shift );
+	};
+
+	// each position keeps the lowest vertex index seen for it
+	ThreadPool::parallelFor( pool, numVertices, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( uint32_t v = (uint32_t) begin; v < end; ++v ) {
+			size_t slot = firstSlot( v );
+			while( true ) {
+				uint32_t current = slots[slot].load( memory_order_relaxed );
+				if( current == NO_INDEX ) {
+					if( slots[slot].compare_exchange_strong( current, v, memory_order_relaxed ) )
+						break;
+					// look at the vertex that got there first
+					continue;
+				}
+				if( samePosition( positions, dims, current, v ) ) {
+					while( v < current && ! slots[slot].compare_exchange_weak( current, v, memory_order_relaxed ) ) {
+					}
+					break;
+				}
+				slot = ( slot + 1 ) & ( capacity - 1 );
+			}
+		}
+	} );
+
+	vector<uint32_t> weld( numVertices );
+	ThreadPool::parallelFor( pool, numVertices, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( uint32_t v = (uint32_t) begin; v < end; ++v ) {
+			size_t slot = firstSlot( v );
+			while( ! samePosition( positions, dims, slots[slot].load( memory_order_relaxed ), v ) )
+				slot = ( slot + 1 ) & ( capacity - 1 );
+			weld[v] = slots[slot].load( memory_order_relaxed );
+		}
+	} );
+	return weld;
+}
+
+//! The edges at each vertex, sorted: those of \a v are adjacency[offsets[v]] up to adjacency[offsets[v + 1]].
+void buildAdjacency( const EdgeTable &edges, size_t numVertices, ThreadPool *pool, vector<uint32_t> *offsets, vector<uint32_t> *adjacency )
+{
+	unique_ptr<atomic<uint32_t>[]> cursors( new atomic<uint32_t>[numVertices] );
+	ThreadPool::parallelFor( pool, numVertices, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( size_t v = begin; v < end; ++v )
+			cursors[v].store( 0, memory_order_relaxed );
+	} );
+	ThreadPool::parallelFor( pool, edges.getNumEdges(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( uint32_t e = (uint32_t) begin; e < end; ++e ) {
+			cursors[edges.getLow( e )].fetch_add( 1, memory_order_relaxed );
+			cursors[edges.getHigh( e )].fetch_add( 1, memory_order_relaxed );
+		}
+	} );
+
+	offsets->assign( numVertices + 1, 0 );
+	for( size_t v = 0; v < numVertices; ++v ) {
+		( *offsets )[v + 1] = ( *offsets )[v] + cursors[v].load( memory_order_relaxed );
+		cursors[v].store( ( *offsets )[v], memory_order_relaxed );
+	}
+
+	adjacency->resize( offsets->back() );
+	ThreadPool::parallelFor( pool, edges.getNumEdges(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( uint32_t e = (uint32_t) begin; e < end; ++e ) {
+			( *adjacency )[cursors[edges.getLow( e )].fetch_add( 1, memory_order_relaxed )] = e;
+			( *adjacency )[cursors[edges.getHigh( e )].fetch_add( 1, memory_order_relaxed )] = e;
+		}
+	} );
+	ThreadPool::parallelFor( pool, numVertices, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( size_t v = begin; v < end; ++v )
+			sort( adjacency->begin() + ( *offsets )[v], adjacency->begin() + ( *offsets )[v + 1] );
+	} );
+}
+
+//! One vertex attribute of the input and output mesh.
+struct Channel {
+	const float	*src;
+	float		*dst;
+	size_t		dims;
+	bool		smooth;		// gets the Loop weights (positions and normals); the others are interpolated
+	bool		normalize;
+};
+
+void blend( const Channel &channel, size_t dst, const uint32_t *src, const float *weights, size_t count )
+{
+	float *out = channel.dst + dst * channel.dims;
+	for( size_t d = 0; d < channel.dims; ++d )
+		out[d] = 0.0f;
+	for( size_t i = 0; i < count; ++i ) {
+		const float *in = channel.src + src[i] * channel.dims;
+		for( size_t d = 0; d < channel.dims; ++d )
+			out[d] += weights[i] * in[d];
+	}
+
+	if( channel.normalize ) {
+		float length = 0.0f;
+		for( size_t d = 0; d < channel.dims; ++d )
+			length += out[d] * out[d];
+		if( length > 0.0f ) {
+			float scale = 1.0f / sqrt( length );
+			for( size_t d = 0; d < channel.dims; ++d )
+				out[d] *= scale;
+		}
+	}
+}
+
+//! Loop weights of welded vertex \a w: 1 - k * beta for itself and beta for its k neighbors inside the
+//! surface, 3/4 and 1/8 along a crease, or just itself at a corner.
+void evenWeights( uint32_t w, const EdgeTable &edges, const vector<uint32_t> &offsets, const vector<uint32_t> &adjacency,
+	vector<uint32_t> *src, vector<float> *weights )
+{
+	src->assign( 1, w );
+	weights->assign( 1, 1.0f );
+
+	uint32_t creases[2];
+	size_t numCreases = 0, valence = offsets[w + 1] - offsets[w];
+	for( uint32_t i = offsets[w]; i < offsets[w + 1]; ++i ) {
+		uint32_t e = adjacency[i];
+		if( edges.getNumFaces( e ) != 2 ) {
+			if( numCreases < 2 )
+				creases[numCreases] = edges.getLow( e ) == w ? edges.getHigh( e ) : edges.getLow( e );
+			++numCreases;
+		}
+	}
+
+	if( numCreases == 0 && valence >= 3 ) {
+		float c = 0.375f + 0.25f * cos( 6.28318531f / valence );
+		float beta = ( 0.625f - c * c ) / valence;
+		( *weights )[0] = 1.0f - valence * beta;
+		for( uint32_t i = offsets[w]; i < offsets[w + 1]; ++i ) {
+			uint32_t e = adjacency[i];
+			src->push_back( edges.getLow( e ) == w ? edges.getHigh( e ) : edges.getLow( e ) );
+			weights->push_back( beta );
+		}
+	}
+	else if( numCreases == 2 ) {
+		( *weights )[0] = 0.75f;
+		for( size_t i = 0; i < 2; ++i ) {
+			src->push_back( creases[i] );
+			weights->push_back( 0.125f );
+		}
+	}
+}
+
+//! Splits every edge of \a mesh into \a n segments. With \a smooth (and \a n = 2), this is one round of
+//! Loop subdivision.
+TriMeshRef split( const TriMesh &mesh, uint32_t n, bool smooth, ThreadPool *pool, const function<bool()> &isCancelled )
+{
+	const vector<uint32_t> &indices = mesh.getIndices();
+	size_t numVertices = mesh.getNumVertices(), numTriangles = indices.size() / 3;
+	size_t positionDims = mesh.getAttribDims( geom::Attrib::POSITION );
+
+	EdgeTable edges( indices.data(), numTriangles, numVertices, false, pool );
+
+	// Loop weights come from the surface with the seams welded shut
+	vector<uint32_t> weld, offsets, adjacency;
+	unique_ptr<EdgeTable> weldedEdges;
+	if( smooth ) {
+		weld = weldVertices( mesh.getBufferPositions().data(), positionDims, numVertices, pool );
+		vector<uint32_t> weldedIndices( indices.size() );
+		ThreadPool::parallelFor( pool, indices.size(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+			for( size_t i = begin; i < end; ++i )
+				weldedIndices[i] = weld[indices[i]];
+		} );
+		weldedEdges.reset( new EdgeTable( weldedIndices.data(), numTriangles, numVertices, true, pool ) );
+		buildAdjacency( *weldedEdges, numVertices, pool, &offsets, &adjacency );
+	}
+	if( isCancelled && isCancelled() )
+		return TriMeshRef();
+
+	// original vertices first, then those on the edges, then those inside the triangles
+	size_t perEdge = n - 1, perFace = ( n - 1 ) * ( n - 2 ) / 2;
+	size_t edgeBase = numVertices, faceBase = edgeBase + edges.getNumEdges() * perEdge;
+	size_t numOutVertices = faceBase + numTriangles * perFace;
+
+	size_t texCoordDims = mesh.getAttribDims( geom::Attrib::TEX_COORD_0 ), colorDims = mesh.getAttribDims( geom::Attrib::COLOR );
+	bool hasNormals = mesh.hasNormals() && mesh.getNormals().size() == numVertices;
+	TriMesh::Format format = TriMesh::Format().positions( (uint8_t) positionDims );
+	if( hasNormals )
+		format.normals();
+	if( texCoordDims )
+		format.texCoords0( (uint8_t) texCoordDims );
+	if( colorDims )
+		format.colors( (uint8_t) colorDims );
+	TriMeshRef result = TriMesh::create( format );
+
+	vector<Channel> channels;
+	{
+		result->getBufferPositions().resize( numOutVertices * positionDims );
+		Channel channel = { mesh.getBufferPositions().data(), result->getBufferPositions().data(), positionDims, true, false };
+		channels.push_back( channel );
+	}
+	if( hasNormals ) {
+		result->getNormals().resize( numOutVertices );
+		Channel channel = { (const float*) mesh.getNormals().data(), (float*) result->getNormals().data(), 3, true, true };
+		channels.push_back( channel );
+	}
+	if( texCoordDims ) {
+		result->getBufferTexCoords0().resize( numOutVertices * texCoordDims );
+		Channel channel = { mesh.getBufferTexCoords0().data(), result->getBufferTexCoords0().data(), texCoordDims, false, false };
+		channels.push_back( channel );
+	}
+	if( colorDims ) {
+		result->getBufferColors().resize( numOutVertices * colorDims );
+		Channel channel = { mesh.getBufferColors().data(), result->getBufferColors().data(), colorDims, false, false };
+		channels.push_back( channel );
+	}
+	result->getIndices().resize( 3 * numTriangles * n * n );
+
+	ThreadPool::parallelFor( pool, numVertices, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		vector<uint32_t> src;
+		vector<float> weights;
+		for( uint32_t v = (uint32_t) begin; v < end; ++v ) {
+			if( smooth )
+				evenWeights( weld[v], *weldedEdges, offsets, adjacency, &src, &weights );
+			for( size_t c = 0; c < channels.size(); ++c ) {
+				if( smooth && channels[c].smooth )
+					blend( channels[c], v, src.data(), weights.data(), src.size() );
+				else
+					copy( channels[c].src + v * channels[c].dims, channels[c].src + ( v + 1 ) * channels[c].dims, channels[c].dst + v * channels[c].dims );
+			}
+		}
+	} );
+
+	ThreadPool::parallelFor( pool, edges.getNumEdges(), GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		for( uint32_t e = (uint32_t) begin; e < end; ++e ) {
+			uint32_t linear[2] = { edges.getLow( e ), edges.getHigh( e ) };
+			for( uint32_t k = 1; k < n; ++k ) {
+				// both weights from integers, so that seam copies of an edge give bit-identical vertices
+				float weights[4] = { (float)( n - k ) / n, (float) k / n, 0.125f, 0.125f };
+				size_t dst = edgeBase + e * perEdge + k - 1;
+				if( ! smooth ) {
+					for( size_t c = 0; c < channels.size(); ++c )
+						blend( channels[c], dst, linear, weights, 2 );
+					continue;
+				}
+
+				// 3/8 of each end and 1/8 of each opposite corner, or the midpoint on a crease; the welded
+				// ends are taken in a fixed order, so that the copies of a seam edge come out bit-identical
+				uint32_t a = weld[linear[0]], b = weld[linear[1]];
+				uint32_t welded = a == b ? NO_INDEX : weldedEdges->find( a, b );
+				uint32_t src[4] = { min( a, b ), max( a, b ), NO_INDEX, NO_INDEX };
+				size_t count = 2;
+				if( welded != NO_INDEX && weldedEdges->getNumFaces( welded ) == 2 ) {
+					src[2] = weldedEdges->getOpposite( welded )[0];
+					src[3] = weldedEdges->getOpposite( welded )[1];
+					weights[0] = weights[1] = 0.375f;
+					count = 4;
+				}
+				for( size_t c = 0; c < channels.size(); ++c ) {
+					if( channels[c].smooth )
+						blend( channels[c], dst, src, weights, count );
+					else {
+						const float half[2] = { 0.5f, 0.5f };
+						blend( channels[c], dst, linear, half, 2 );
+					}
+				}
+			}
+		}
+	} );
+
+	// the points of triangle t are (a, b) with a steps towards corner 1 and b towards corner 2
+	uint32_t *outIndices = result->getIndices().data();
+	ThreadPool::parallelFor( pool, numTriangles, GRAIN_SIZE, [&]( size_t begin, size_t end ) {
+		vector<uint32_t> lattice( ( n + 1 ) * ( n + 1 ) );
+		for( size_t t = begin; t < end; ++t ) {
+			const uint32_t *corners = &indices[3 * t];
+			auto edgeVertex = [&]( uint32_t corner, uint32_t from, uint32_t k ) -> uint32_t {
+				uint32_t edge = edges.getCornerEdge( 3 * t + corner );
+				uint32_t step = edges.getLow( edge ) == from ? k : n - k;
+				return (uint32_t)( edgeBase + edge * perEdge + step - 1 );
+			};
+
+			size_t interior = faceBase + t * perFace;
+			for( uint32_t a = 0; a <= n; ++a ) {
+				for( uint32_t b = 0; a + b <= n; ++b ) {
+					uint32_t &vertex = lattice[a * ( n + 1 ) + b];
+					if( a == 0 && b == 0 )
+						vertex = corners[0];
+					else if( a == n )
+						vertex = corners[1];
+					else if( b == n )
+						vertex = corners[2];
+					else if( b == 0 )
+						vertex = edgeVertex( 0, corners[0], a );
+					else if( a + b == n )
+						vertex = edgeVertex( 1, corners[1], b );
+					else if( a == 0 )
+						vertex = edgeVertex( 2, corners[0], b );
+					else {
+						vertex = (uint32_t) interior++;
+						float weights[3] = { (float)( n - a - b ) / n, (float) a / n, (float) b / n };
+						for( size_t c = 0; c < channels.size(); ++c )
+							blend( channels[c], vertex, corners, weights, 3 );
+					}
+				}
+			}
+
+			// n^2 triangles with the winding of the original
+			uint32_t *out = outIndices + 3 * t * n * n;
+			for( uint32_t a = 0; a < n; ++a ) {
+				for( uint32_t b = 0; a + b < n; ++b ) {
+					*out++ = lattice[a * ( n + 1 ) + b];
+					*out++ = lattice[( a + 1 ) * ( n + 1 ) + b];
+					*out++ = lattice[a * ( n + 1 ) + b + 1];
+					if( a + b + 1 < n ) {
+						*out++ = lattice[( a + 1 ) * ( n + 1 ) + b];
+						*out++ = lattice[( a + 1 ) * ( n + 1 ) + b + 1];
+						*out++ = lattice[a * ( n + 1 ) + b + 1];
+					}
+				}
+			}
+		}
+	} );
+
+	return result;
+}
+
+} // anonymous namespace
+
+TriMeshRef MeshSubdivision::subdivide( const TriMesh &mesh, int divisions, Scheme scheme, ThreadPool *pool, const function<bool()> &isCancelled )
+{
+	if( divisions < 2 )
+		return TriMeshRef( new TriMesh( mesh ) );
+	if( scheme == LINEAR )
+		return split( mesh, (uint32_t) divisions, false, pool, isCancelled );
+
+	TriMeshRef result;
+	const TriMesh *current = &mesh;
+	for( int i = 1; i < divisions; ++i ) {
+		result = split( *current, 2, true, pool, isCancelled );
+		if( ! result )
+			break;
+		current = result.get();
+	}
+	return result;
+}
@@ -0,0 +1,253 @@
+#include "ProgramBinaryCache.h"
+#include "MappedFile.h"
+
+#include "cinder/gl/gl.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const char kMagic[8] = { 'G', 'L', 'P', 'R', 'O', 'G', 'B', 'N' };
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+// what a program loaded from a binary is created with; glProgramBinary() replaces all of it
+const char *PLACEHOLDER_VERTEX =
+	"#version 150\n"
+	"in vec4 ciPosition;\n"
+	"void main(void) { gl_Position = ciPosition; }\n";
+const char *PLACEHOLDER_FRAGMENT =
+	"#version 150\n"
+	"out vec4 oColor;\n"
+	"void main(void) { oColor = vec4( 1.0 ); }\n";
+
+//! FNV-1a of \a str and its terminating zero, so that consecutive strings cannot run into each other,
+//! continuing from \a hash. It only has to tell sources and drivers apart, not resist anyone.
+uint64_t hashString( const string &str, uint64_t hash = FNV_OFFSET_BASIS )
+{
+	const uint8_t *bytes = reinterpret_cast<const uint8_t*>( str.c_str() );
+	for( size_t i = 0; i <= str.size(); ++i ) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+string glString( GLenum name )
+{
+	const GLubyte *str = glGetString( name );
+	return str ? string( reinterpret_cast<const char*>( str ) ) : string();
+}
+
+string toHex( uint64_t value )
+{
+	ostringstream hex;
+	hex << std::hex << setfill( '0' ) << setw( 16 ) << value;
+	return hex.str();
+}
+
+#if defined( GL_PROGRAM_BINARY_LENGTH )
+//! GlslProg can only be created from sources, so a program from a binary starts out as a trivial one that
+//! glProgramBinary() then replaces. A binary the driver turns down leaves the program unlinked.
+//!
+//! Whether GlslProg then sees the replacement depends on the Cinder revision: the development revisions
+//! look uniforms and attributes up when they are first used, 0.9 caches them when the program is created,
+//! i.e. those of the trivial program. hasInterface() tells the two apart.
+class BinaryGlslProg : public gl::GlslProg {
+public:
+	BinaryGlslProg( GLenum format, const void *binary, size_t size )
+		: gl::GlslProg( gl::GlslProg::Format().vertex( PLACEHOLDER_VERTEX ).fragment( PLACEHOLDER_FRAGMENT ) )
+	{
+		glProgramBinary( getHandle(), format, binary, (GLsizei) size );
+	}
+
+	bool	isLinked() const
+	{
+		GLint linked = GL_FALSE;
+		glGetProgramiv( getHandle(), GL_LINK_STATUS, &linked );
+		return linked == GL_TRUE;
+	}
+
+	//! Whether GlslProg finds every active attribute and uniform of the linked program where GL does.
+	bool	hasInterface() const
+	{
+		GLint numAttribs = 0, numUniforms = 0, maxLength = 0, length = 0;
+		glGetProgramiv( getHandle(), GL_ACTIVE_ATTRIBUTES, &numAttribs );
+		glGetProgramiv( getHandle(), GL_ACTIVE_UNIFORMS, &numUniforms );
+		glGetProgramiv( getHandle(), GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &length );
+		maxLength = std::max( maxLength, length );
+		glGetProgramiv( getHandle(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &length );
+		maxLength = std::max( maxLength, length );
+
+		vector<GLchar> name( std::max( maxLength, 1 ) );
+		for( GLint i = 0; i < numAttribs; ++i ) {
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveAttrib( getHandle(), (GLuint) i, (GLsizei) name.size(), nullptr, &size, &type, name.data() );
+			// built-in inputs have no location
+			GLint location = glGetAttribLocation( getHandle(), name.data() );
+			if( location >= 0 && getAttribLocation( name.data() ) != location )
+				return false;
+		}
+		for( GLint i = 0; i < numUniforms; ++i ) {
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform( getHandle(), (GLuint) i, (GLsizei) name.size(), nullptr, &size, &type, name.data() );
+			// nor do built-ins and the members of uniform blocks
+			GLint location = glGetUniformLocation( getHandle(), name.data() );
+			if( location >= 0 && getUniformLocation( name.data() ) != location )
+				return false;
+		}
+		return true;
+	}
+};
+#endif
+
+} // anonymous namespace
+
+ProgramBinaryCache::ProgramBinaryCache( const fs::path &directory )
+	: mDirectory( directory ), mSupported( false ), mDriverHash( 0 ), mNumLoaded( 0 ), mNumCompiled( 0 )
+{
+#if defined( GL_PROGRAM_BINARY_LENGTH )
+	GLint numFormats = 0;
+	if( gl::isExtensionAvailable( "GL_ARB_get_program_binary" ) )
+		glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats );
+	mSupported = numFormats > 0;
+#endif
+	if( ! mSupported )
+		return;
+
+	mDriverHash = hashString( glString( GL_VERSION ), hashString( glString( GL_RENDERER ), hashString( glString( GL_VENDOR ) ) ) );
+
+	// binaries of other drivers will never load again, and temporary files are left over from failed stores
+	try {
+		fs::create_directories( mDirectory );
+		string prefix = toHex( mDriverHash ) + "-";
+		vector<fs::path> stale;
+		for( fs::directory_iterator it( mDirectory ), end; it != end; ++it ) {
+			string name = it->path().filename().string(), extension = it->path().extension().string();
+			if( ( extension == ".bin" && name.compare( 0, prefix.size(), prefix ) != 0 ) || extension == ".tmp" )
+				stale.push_back( it->path() );
+		}
+		for( size_t i = 0; i < stale.size(); ++i )
+			fs::remove( stale[i] );
+	}
+	catch( const std::exception & ) {
+		// without a directory to write to, stores fail and everything is compiled as before
+	}
+}
+
+gl::GlslProgRef ProgramBinaryCache::getProgram( const string &vertex, const string &fragment, const string &geometry )
+{
+	uint64_t sourceHash = 0;
+	fs::path path;
+	if( mSupported ) {
+		sourceHash = hashString( geometry, hashString( fragment, hashString( vertex ) ) );
+		path = getPath( sourceHash );
+		if( gl::GlslProgRef program = load( path, sourceHash ) ) {
+			++mNumLoaded;
+			return program;
+		}
+	}
+
+	gl::GlslProg::Format format;
+	format.vertex( vertex ).fragment( fragment );
+	if( ! geometry.empty() )
+		format.geometry( geometry );
+	gl::GlslProgRef program = gl::GlslProg::create( format );
+	++mNumCompiled;
+
+	if( mSupported )
+		store( program, path, sourceHash );
+	return program;
+}
+
+fs::path ProgramBinaryCache::getPath( uint64_t sourceHash ) const
+{
+	return mDirectory / ( toHex( mDriverHash ) + "-" + toHex( sourceHash ) + ".bin" );
+}
+
+gl::GlslProgRef ProgramBinaryCache::load( const fs::path &path, uint64_t sourceHash )
+{
+#if defined( GL_PROGRAM_BINARY_LENGTH )
+	if( ! fs::exists( path ) )
+		return gl::GlslProgRef();
+
+	try {
+		MappedFileRef file = MappedFile::open( path.string() );
+		const Header *header = reinterpret_cast<const Header*>( file->getData() );
+		if( file->getSize() >= sizeof( Header ) && memcmp( header->magic, kMagic, sizeof( kMagic ) ) == 0 && header->version == VERSION
+			&& header->driverHash == mDriverHash && header->sourceHash == sourceHash && header->size == file->getSize() - sizeof( Header ) ) {
+			shared_ptr<BinaryGlslProg> program( new BinaryGlslProg( header->format, file->getData() + sizeof( Header ), (size_t) header->size ) );
+			if( program->isLinked() ) {
+				if( program->hasInterface() )
+					return program;
+
+				// GlslProg kept what it found in the trivial program, and would with every other binary; the
+				// file is fine, it is just of no use with this Cinder
+				mSupported = false;
+				return gl::GlslProgRef();
+			}
+		}
+	}
+	catch( const std::exception & ) {
+	}
+
+	// damaged, or the driver has changed its mind without changing its version; stored again after compiling
+	try {
+		fs::remove( path );
+	}
+	catch( const std::exception & ) {
+	}
+#endif
+	return gl::GlslProgRef();
+}
+
+void ProgramBinaryCache::store( const gl::GlslProgRef &program, const fs::path &path, uint64_t sourceHash ) const
+{
+#if defined( GL_PROGRAM_BINARY_LENGTH )
+	// GL_PROGRAM_BINARY_RETRIEVABLE_HINT would have to be set before GlslProg links; drivers that need it
+	// give no binary and the program is compiled every time, as without the cache
+	GLint length = 0;
+	glGetProgramiv( program->getHandle(), GL_PROGRAM_BINARY_LENGTH, &length );
+	if( length <= 0 )
+		return;
+
+	string tempPath = path.string() + ".tmp";
+	try {
+		Header header;
+		memcpy( header.magic, kMagic, sizeof( kMagic ) );
+		header.version = VERSION;
+		header.driverHash = mDriverHash;
+		header.sourceHash = sourceHash;
+		header.size = (uint64_t) length;
+
+		GLsizei written = 0;
+		GLenum format = 0;
+		{
+			MappedFileRef file = MappedFile::create( tempPath, sizeof( Header ) + length );
+			glGetProgramBinary( program->getHandle(), length, &written, &format, file->getData() + sizeof( Header ) );
+			header.format = format;
+			memcpy( file->getData(), &header, sizeof( Header ) );
+			file->flush();
+		}
+
+		// rename() does not replace an existing file on Windows
+		if( written == length ) {
+			remove( path.string().c_str() );
+			if( rename( tempPath.c_str(), path.string().c_str() ) == 0 )
+				return;
+		}
+	}
+	catch( const std::exception & ) {
+	}
+	remove( tempPath.c_str() );
+#endif
+}
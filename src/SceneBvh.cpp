@@ -0,0 +1,254 @@
+#include "SceneBvh.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+// objects per leaf; below this the boxes are cheaper to test than to split
+const uint32_t	MAX_LEAF_SIZE = 4;
+// centroid bins per split
+const int		NUM_BINS = 16;
+// refit() rebuilds once the tree costs this many times what it did right after building
+const float		REBUILD_FACTOR = 2.0f;
+
+float surfaceArea( const vec3 &lower, const vec3 &upper )
+{
+	vec3 size = upper - lower;
+	return 2.0f * ( size.x * size.y + size.y * size.z + size.z * size.x );
+}
+
+struct Bin {
+	vec3		lower, upper;
+	uint32_t	count;
+};
+
+} // anonymous namespace
+
+Frustum::Frustum( const mat4 &viewProjection )
+{
+	// row i of the matrix; clip space x, y and z all run from -w to w
+	vec4 rows[4];
+	for( int i = 0; i < 4; ++i )
+		rows[i] = vec4( viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i] );
+
+	for( int i = 0; i < 3; ++i ) {
+		planes[2 * i] = rows[3] + rows[i];
+		planes[2 * i + 1] = rows[3] - rows[i];
+	}
+}
+
+bool Frustum::intersects( const AxisAlignedBox3f &box ) const
+{
+	const vec3 &lower = box.getMin(), &upper = box.getMax();
+	for( int i = 0; i < 6; ++i ) {
+		// the corner furthest along the plane normal
+		const vec4 &plane = planes[i];
+		vec3 corner( plane.x >= 0.0f ? upper.x : lower.x, plane.y >= 0.0f ? upper.y : lower.y, plane.z >= 0.0f ? upper.z : lower.z );
+		if( plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f )
+			return false;
+	}
+	return true;
+}
+
+SceneBvh::SceneBvh()
+	: mBuildCost( 0.0f ), mNumBuilds( 0 )
+{
+}
+
+void SceneBvh::build( const vector<AxisAlignedBox3f> &bounds )
+{
+	++mNumBuilds;
+	mBounds = bounds;
+	mNodes.clear();
+	mObjects.resize( bounds.size() );
+	for( size_t i = 0; i < bounds.size(); ++i )
+		mObjects[i] = (uint32_t) i;
+
+	mBuildCost = 0.0f;
+	if( bounds.empty() )
+		return;
+
+	vector<vec3> centroids( bounds.size() );
+	for( size_t i = 0; i < bounds.size(); ++i )
+		centroids[i] = bounds[i].getCenter();
+
+	mNodes.reserve( 2 * bounds.size() );
+	mNodes.push_back( Node() );
+	split( 0, 0, (uint32_t) bounds.size(), centroids );
+	mBuildCost = calcCost();
+}
+
+void SceneBvh::refit( const vector<AxisAlignedBox3f> &bounds )
+{
+	if( bounds.size() != mObjects.size() || mNodes.empty() ) {
+		build( bounds );
+		return;
+	}
+
+	// children always come after their parent
+	mBounds = bounds;
+	for( size_t n = mNodes.size(); n-- > 0; ) {
+		Node &node = mNodes[n];
+		if( node.count ) {
+			node.lower = vec3( numeric_limits<float>::max() );
+			node.upper = vec3( -numeric_limits<float>::max() );
+			for( uint32_t i = node.first; i < node.first + node.count; ++i ) {
+				node.lower = glm::min( node.lower, mBounds[mObjects[i]].getMin() );
+				node.upper = glm::max( node.upper, mBounds[mObjects[i]].getMax() );
+			}
+		}
+		else {
+			node.lower = glm::min( mNodes[node.first].lower, mNodes[node.first + 1].lower );
+			node.upper = glm::max( mNodes[node.first].upper, mNodes[node.first + 1].upper );
+		}
+	}
+
+	if( calcCost() > REBUILD_FACTOR * mBuildCost )
+		build( bounds );
+}
+
+void SceneBvh::cull( const Frustum &frustum, vector<uint32_t> *visible ) const
+{
+	if( ! mNodes.empty() )
+		cullNode( 0, frustum, ( 1u << 6 ) - 1, visible );
+}
+
+void SceneBvh::split( uint32_t node, uint32_t begin, uint32_t end, const vector<vec3> &centroids )
+{
+	vec3 lower( numeric_limits<float>::max() ), upper( -numeric_limits<float>::max() );
+	vec3 centroidLower( numeric_limits<float>::max() ), centroidUpper( -numeric_limits<float>::max() );
+	for( uint32_t i = begin; i < end; ++i ) {
+		uint32_t object = mObjects[i];
+		lower = glm::min( lower, mBounds[object].getMin() );
+		upper = glm::max( upper, mBounds[object].getMax() );
+		centroidLower = glm::min( centroidLower, centroids[object] );
+		centroidUpper = glm::max( centroidUpper, centroids[object] );
+	}
+	mNodes[node].lower = lower;
+	mNodes[node].upper = upper;
+
+	uint32_t count = end - begin;
+	if( count <= MAX_LEAF_SIZE ) {
+		mNodes[node].first = begin;
+		mNodes[node].count = count;
+		return;
+	}
+
+	// bin the centroids along the longest axis and split where the surface area heuristic is lowest
+	vec3 extent = centroidUpper - centroidLower;
+	int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+	uint32_t middle = begin + count / 2;
+	if( extent[axis] > 0.0f ) {
+		Bin bins[NUM_BINS];
+		for( int b = 0; b < NUM_BINS; ++b ) {
+			bins[b].lower = vec3( numeric_limits<float>::max() );
+			bins[b].upper = vec3( -numeric_limits<float>::max() );
+			bins[b].count = 0;
+		}
+
+		float scale = NUM_BINS / extent[axis];
+		auto binOf = [&]( uint32_t object ) { return std::min( (int)( ( centroids[object][axis] - centroidLower[axis] ) * scale ), NUM_BINS - 1 ); };
+		for( uint32_t i = begin; i < end; ++i ) {
+			Bin &bin = bins[binOf( mObjects[i] )];
+			bin.lower = glm::min( bin.lower, mBounds[mObjects[i]].getMin() );
+			bin.upper = glm::max( bin.upper, mBounds[mObjects[i]].getMax() );
+			++bin.count;
+		}
+
+		// cost of splitting after bin b, from the left side swept forwards and the right side backwards
+		float leftCost[NUM_BINS];
+		vec3 sweepLower( numeric_limits<float>::max() ), sweepUpper( -numeric_limits<float>::max() );
+		uint32_t sweepCount = 0;
+		for( int b = 0; b < NUM_BINS - 1; ++b ) {
+			sweepLower = glm::min( sweepLower, bins[b].lower );
+			sweepUpper = glm::max( sweepUpper, bins[b].upper );
+			sweepCount += bins[b].count;
+			leftCost[b] = sweepCount ? surfaceArea( sweepLower, sweepUpper ) * sweepCount : 0.0f;
+		}
+
+		float bestCost = numeric_limits<float>::max();
+		int bestBin = -1;
+		sweepLower = vec3( numeric_limits<float>::max() );
+		sweepUpper = vec3( -numeric_limits<float>::max() );
+		sweepCount = 0;
+		for( int b = NUM_BINS - 1; b > 0; --b ) {
+			sweepLower = glm::min( sweepLower, bins[b].lower );
+			sweepUpper = glm::max( sweepUpper, bins[b].upper );
+			sweepCount += bins[b].count;
+			if( sweepCount == 0 || sweepCount == count )
+				continue;
+
+			float cost = leftCost[b - 1] + surfaceArea( sweepLower, sweepUpper ) * sweepCount;
+			if( cost < bestCost ) {
+				bestCost = cost;
+				bestBin = b - 1;
+			}
+		}
+
+		if( bestBin >= 0 )
+			middle = (uint32_t)( std::partition( mObjects.begin() + begin, mObjects.begin() + end, [&]( uint32_t object ) { return binOf( object ) <= bestBin; } ) - mObjects.begin() );
+	}
+	// with all centroids in one spot, the halves in index order are as good as any
+
+	uint32_t children = (uint32_t) mNodes.size();
+	mNodes[node].first = children;
+	mNodes[node].count = 0;
+	mNodes.push_back( Node() );
+	mNodes.push_back( Node() );
+	split( children, begin, middle, centroids );
+	split( children + 1, middle, end, centroids );
+}
+
+float SceneBvh::calcCost() const
+{
+	float cost = 0.0f;
+	for( size_t n = 0; n < mNodes.size(); ++n )
+		cost += surfaceArea( mNodes[n].lower, mNodes[n].upper ) * std::max<uint32_t>( mNodes[n].count, 1 );
+	return cost;
+}
+
+void SceneBvh::cullNode( uint32_t index, const Frustum &frustum, uint32_t planeMask, vector<uint32_t> *visible ) const
+{
+	const Node &node = mNodes[index];
+	for( int i = 0; i < 6; ++i ) {
+		if( ! ( planeMask & ( 1u << i ) ) )
+			continue;
+
+		// outside if the corner furthest along the normal is, inside if the nearest one is
+		const vec4 &plane = frustum.planes[i];
+		vec3 furthest( plane.x >= 0.0f ? node.upper.x : node.lower.x, plane.y >= 0.0f ? node.upper.y : node.lower.y, plane.z >= 0.0f ? node.upper.z : node.lower.z );
+		if( plane.x * furthest.x + plane.y * furthest.y + plane.z * furthest.z + plane.w < 0.0f )
+			return;
+
+		vec3 nearest( plane.x >= 0.0f ? node.lower.x : node.upper.x, plane.y >= 0.0f ? node.lower.y : node.upper.y, plane.z >= 0.0f ? node.lower.z : node.upper.z );
+		if( plane.x * nearest.x + plane.y * nearest.y + plane.z * nearest.z + plane.w >= 0.0f )
+			planeMask &= ~( 1u << i );
+	}
+
+	if( ! planeMask )
+		appendObjects( index, visible );
+	else if( node.count ) {
+		for( uint32_t i = node.first; i < node.first + node.count; ++i )
+			if( frustum.intersects( mBounds[mObjects[i]] ) )
+				visible->push_back( mObjects[i] );
+	}
+	else {
+		cullNode( node.first, frustum, planeMask, visible );
+		cullNode( node.first + 1, frustum, planeMask, visible );
+	}
+}
+
+void SceneBvh::appendObjects( uint32_t index, vector<uint32_t> *visible ) const
+{
+	const Node &node = mNodes[index];
+	if( node.count )
+		visible->insert( visible->end(), mObjects.begin() + node.first, mObjects.begin() + node.first + node.count );
+	else {
+		appendObjects( node.first, visible );
+		appendObjects( node.first + 1, visible );
+	}
+}
@@ -0,0 +1,34 @@
+#include "ShaderCache.h"
+
+using namespace ci;
+using namespace std;
+
+ShaderCache::ShaderCache( const string &vertex, const string &fragment, const DefinesFn &defines, const ProgramBinaryCacheRef &binaries )
+	: mVertex( vertex ), mFragment( fragment ), mDefines( defines ), mBinaries( binaries )
+{
+}
+
+gl::GlslProgRef ShaderCache::get( uint32_t permutation )
+{
+	map<uint32_t, gl::GlslProgRef>::iterator it = mPrograms.find( permutation );
+	if( it != mPrograms.end() )
+		return it->second;
+
+	// a failure is remembered first, so it is reported once rather than every frame
+	gl::GlslProgRef &program = mPrograms[permutation];
+	string defines = mDefines( permutation );
+	string vertex = insertDefines( mVertex, defines ), fragment = insertDefines( mFragment, defines );
+	if( mBinaries )
+		program = mBinaries->getProgram( vertex, fragment );
+	else
+		program = gl::GlslProg::create( gl::GlslProg::Format().vertex( vertex ).fragment( fragment ) );
+	return program;
+}
+
+string ShaderCache::insertDefines( const string &source, const string &defines )
+{
+	size_t lineEnd = source.find( '\n' );
+	if( lineEnd == string::npos )
+		return source + "\n" + defines;
+	return source.substr( 0, lineEnd + 1 ) + defines + source.substr( lineEnd + 1 );
+}
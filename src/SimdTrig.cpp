@@ -0,0 +1,53 @@
+#include "SimdTrig.h"
+
+#include <chrono>
+#include <iomanip>
+#include <vector>
+
+using namespace std;
+
+TrigAccuracyReport measureTrigAccuracy( TrigAccuracy accuracy, float range, size_t numSamples )
+{
+	numSamples = ( numSamples + SimdFloat::Width - 1 ) / SimdFloat::Width * SimdFloat::Width;
+
+	vector<float> x( numSamples ), s( numSamples ), c( numSamples );
+	for( size_t i = 0; i < numSamples; ++i )
+		x[i] = -range + 2.0f * range * i / numSamples;
+
+	auto start = chrono::steady_clock::now();
+	for( size_t i = 0; i < numSamples; i += SimdFloat::Width ) {
+		SimdFloat st, ct;
+		simdSinCos( SimdFloat::load( &x[i] ), &st, &ct, accuracy );
+		st.store( &s[i] );
+		ct.store( &c[i] );
+	}
+	auto end = chrono::steady_clock::now();
+
+	TrigAccuracyReport report;
+	report.accuracy = accuracy;
+	report.maxSinError = 0;
+	report.maxCosError = 0;
+	report.nanosecondsPerValue = chrono::duration<double, nano>( end - start ).count() / numSamples;
+
+	for( size_t i = 0; i < numSamples; ++i ) {
+		report.maxSinError = max( report.maxSinError, (float) abs( s[i] - sin( (double) x[i] ) ) );
+		report.maxCosError = max( report.maxCosError, (float) abs( c[i] - cos( (double) x[i] ) ) );
+	}
+
+	return report;
+}
+
+void printTrigAccuracyReport( ostream &os )
+{
+	const char *names[] = { "exact", "fast 1e-3", "fast 1e-5", "fast 1e-7" };
+
+	os << "sin/cos accuracy (" << simdInstructionSet() << ")" << endl;
+	for( int i = TRIG_EXACT; i <= TRIG_FAST_1E7; ++i ) {
+		TrigAccuracyReport report = measureTrigAccuracy( (TrigAccuracy) i );
+		os << "  " << setw( 10 ) << left << names[i] << right
+		   << "  max error sin " << scientific << setprecision( 2 ) << report.maxSinError
+		   << "  cos " << report.maxCosError
+		   << "  " << fixed << setprecision( 2 ) << report.nanosecondsPerValue << " ns" << endl;
+	}
+	os.unsetf( ios::floatfield );
+}
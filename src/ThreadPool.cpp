@@ -0,0 +1,180 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+ThreadPool& ThreadPool::instance()
+{
+	static ThreadPool pool( 0 );
+	return pool;
+}
+
+ThreadPool::ThreadPool( size_t numThreads )
+	: mNumThreads( numThreads ), mGeneration( 0 ), mQuit( false )
+{
+	if( mNumThreads == 0 )
+		mNumThreads = max<size_t>( 1, thread::hardware_concurrency() );
+
+	// the last slice of every job belongs to whichever thread called parallelFor() for it
+	for( size_t i = 0; i + 1 < mNumThreads; ++i )
+		mThreads.push_back( thread( &ThreadPool::workerLoop, this, i ) );
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock( mWakeMutex );
+		mQuit = true;
+	}
+	mWakeCondition.notify_all();
+
+	for( size_t i = 0; i < mThreads.size(); ++i )
+		mThreads[i].join();
+}
+
+void ThreadPool::parallelFor( ThreadPool *pool, size_t count, size_t grainSize, const function<void( size_t, size_t )> &fn )
+{
+	if( pool )
+		pool->parallelFor( count, grainSize, fn );
+	else if( count )
+		fn( 0, count );
+}
+
+void ThreadPool::parallelFor( size_t count, size_t grainSize, const function<void( size_t, size_t )> &fn )
+{
+	if( count == 0 )
+		return;
+
+	if( grainSize == 0 )
+		grainSize = 1;
+
+	size_t numChunks = ( count + grainSize - 1 ) / grainSize;
+	if( numChunks == 1 || mThreads.empty() || isWorkerThread() ) {
+		for( size_t begin = 0; begin < count; begin += grainSize )
+			fn( begin, min( count, begin + grainSize ) );
+		return;
+	}
+
+	Job job;
+	job.mFn = &fn;
+	job.mCount = count;
+	job.mGrainSize = grainSize;
+	job.mRemaining = numChunks;
+
+	// hand each slice a contiguous run of chunks, so threads start out on neighbouring memory
+	for( size_t s = 0; s < mNumThreads; ++s ) {
+		job.mSlices.push_back( unique_ptr<Slice>( new Slice() ) );
+		job.mSlices[s]->mFront = numChunks * s / mNumThreads;
+		job.mSlices[s]->mBack = numChunks * ( s + 1 ) / mNumThreads;
+	}
+
+	{
+		lock_guard<mutex> lock( mJobsMutex );
+		mJobs.push_back( &job );
+	}
+	{
+		lock_guard<mutex> lock( mWakeMutex );
+		++mGeneration;
+	}
+	mWakeCondition.notify_all();
+
+	Task task;
+	while( takeTask( &job, mNumThreads - 1, &task ) )
+		runTask( task );
+
+	// workers only find the job through mJobs, so once it is gone none of them starts on it again
+	{
+		lock_guard<mutex> lock( mJobsMutex );
+		mJobs.erase( find( mJobs.begin(), mJobs.end(), &job ) );
+	}
+
+	unique_lock<mutex> lock( mWakeMutex );
+	while( job.mRemaining > 0 )
+		mDoneCondition.wait( lock );
+}
+
+void ThreadPool::workerLoop( size_t index )
+{
+	size_t generation = 0;
+
+	for( ;; ) {
+		{
+			unique_lock<mutex> lock( mWakeMutex );
+			while( ! mQuit && generation == mGeneration )
+				mWakeCondition.wait( lock );
+
+			if( mQuit )
+				return;
+
+			generation = mGeneration;
+		}
+
+		Task task;
+		while( findTask( index, &task ) )
+			runTask( task );
+	}
+}
+
+bool ThreadPool::findTask( size_t index, Task *task )
+{
+	// the newest job is the likeliest to have its caller waiting on it, or to be nested in an older one
+	lock_guard<mutex> lock( mJobsMutex );
+	for( size_t j = mJobs.size(); j-- > 0; )
+		if( takeTask( mJobs[j], index, task ) )
+			return true;
+
+	return false;
+}
+
+bool ThreadPool::takeTask( Job *job, size_t index, Task *task )
+{
+	size_t numSlices = job->mSlices.size(), chunk = 0;
+	bool found = false;
+	{
+		Slice &own = *job->mSlices[index];
+		lock_guard<mutex> lock( own.mMutex );
+		if( own.mFront < own.mBack ) {
+			chunk = own.mFront++;
+			found = true;
+		}
+	}
+
+	for( size_t i = 1; i < numSlices && ! found; ++i ) {
+		Slice &victim = *job->mSlices[( index + i ) % numSlices];
+		lock_guard<mutex> lock( victim.mMutex );
+		if( victim.mFront < victim.mBack ) {
+			chunk = --victim.mBack;
+			found = true;
+		}
+	}
+
+	if( found ) {
+		task->mJob = job;
+		task->mBegin = chunk * job->mGrainSize;
+		task->mEnd = min( job->mCount, ( chunk + 1 ) * job->mGrainSize );
+	}
+	return found;
+}
+
+void ThreadPool::runTask( const Task &task )
+{
+	( *task.mJob->mFn )( task.mBegin, task.mEnd );
+
+	// the job may be gone as soon as the count reaches zero
+	if( --task.mJob->mRemaining == 0 ) {
+		// take the lock so the waiting thread can't miss the notification
+		lock_guard<mutex> lock( mWakeMutex );
+		mDoneCondition.notify_all();
+	}
+}
+
+bool ThreadPool::isWorkerThread() const
+{
+	thread::id id = this_thread::get_id();
+	for( size_t i = 0; i < mThreads.size(); ++i )
+		if( mThreads[i].get_id() == id )
+			return true;
+
+	return false;
+}